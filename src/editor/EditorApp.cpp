@@ -39,6 +39,7 @@
 #include "Property.h"
 #include "RenderJob.h"
 #include "RenderPreset.h"
+#include "RenderedFrameCache.h"
 #include "RenderSettingsWindow.h"
 #include "StatusOutput.h"
 
@@ -258,6 +259,10 @@ ret = B_ERROR;
 			if (message->FindPointer("playlist", (void**)&playlist) < B_OK)
 				playlist = new Playlist(*fDocument->Playlist(), true);
 
+			// the sub-playlists may have been edited since the last export
+			if (RenderedFrameCache* frameCache = RenderedFrameCache::Default())
+				frameCache->MakeEmpty();
+
 			BString docName = playlist->Name();
 			int32 startFrame = 0;
 			int32 endFrame = playlist->Duration() - 1;
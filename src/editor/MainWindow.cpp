@@ -59,6 +59,7 @@
 #include "PlaylistRenderer.h"
 #include "PropertyListView.h"
 #include "RemoveObjectsCommand.h"
+#include "RenderedFrameCache.h"
 #include "RenderSettingsWindow.h"
 #include "SavePlaylistSnapshot.h"
 #include "ScrollView.h"
@@ -427,6 +428,11 @@ MainWindow::ObjectChanged(const Observable* object)
 		return;
 
 	if (object == fDocument->CommandStack()) {
+		// the document has been changed, the rendered frames of the
+		// sub-playlists may be outdated
+		if (RenderedFrameCache* frameCache = RenderedFrameCache::Default())
+			frameCache->MakeEmpty();
+
 		// relable Undo item and update enabled status
 		BString label("Undo");
 		fUndoMI->SetEnabled(fDocument->CommandStack()->GetUndoName(label));
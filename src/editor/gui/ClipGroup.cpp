@@ -494,110 +494,110 @@ ClipGroup::_NameContainsFilterString() const
 }
 
 class AllNonPublishedSorter : public ClipListView::ItemSorter {
-	virtual	int32 IndexForClip(ClipListView* listView, Clip* clip) const
+	virtual	bool AcceptClip(ClipListView* listView, Clip* clip) const
 	{
 		if (clip->Status() != SYNC_STATUS_PUBLISHED)
-			return ItemSorter::IndexForClip(listView, clip);
-		return -1;
+			return ItemSorter::AcceptClip(listView, clip);
+		return false;
 	}
 };
 
 class AllNewSorter : public ClipListView::ItemSorter {
-	virtual	int32 IndexForClip(ClipListView* listView, Clip* clip) const
+	virtual	bool AcceptClip(ClipListView* listView, Clip* clip) const
 	{
 		if (clip->Status() == SYNC_STATUS_LOCAL)
-			return ItemSorter::IndexForClip(listView, clip);
-		return -1;
+			return ItemSorter::AcceptClip(listView, clip);
+		return false;
 	}
 };
 
 class BitmapSorter : public ClipListView::ItemSorter {
-	virtual	int32 IndexForClip(ClipListView* listView, Clip* clip) const
+	virtual	bool AcceptClip(ClipListView* listView, Clip* clip) const
 	{
 		if (dynamic_cast<BitmapClip*>(clip))
-			return ItemSorter::IndexForClip(listView, clip);
-		return -1;
+			return ItemSorter::AcceptClip(listView, clip);
+		return false;
 	}
 };
 
 class ClockSorter : public ClipListView::ItemSorter {
-	virtual	int32 IndexForClip(ClipListView* listView, Clip* clip) const
+	virtual	bool AcceptClip(ClipListView* listView, Clip* clip) const
 	{
 		if (dynamic_cast<ClockClip*>(clip))
-			return ItemSorter::IndexForClip(listView, clip);
-		return -1;
+			return ItemSorter::AcceptClip(listView, clip);
+		return false;
 	}
 };
 
 class ColorSorter : public ClipListView::ItemSorter {
-	virtual	int32 IndexForClip(ClipListView* listView, Clip* clip) const
+	virtual	bool AcceptClip(ClipListView* listView, Clip* clip) const
 	{
 		if (dynamic_cast<ColorClip*>(clip))
-			return ItemSorter::IndexForClip(listView, clip);
-		return -1;
+			return ItemSorter::AcceptClip(listView, clip);
+		return false;
 	}
 };
 
 class TimerSorter : public ClipListView::ItemSorter {
-	virtual	int32 IndexForClip(ClipListView* listView, Clip* clip) const
+	virtual	bool AcceptClip(ClipListView* listView, Clip* clip) const
 	{
 		if (dynamic_cast<TimerClip*>(clip))
-			return ItemSorter::IndexForClip(listView, clip);
-		return -1;
+			return ItemSorter::AcceptClip(listView, clip);
+		return false;
 	}
 };
 
 class MediaSorter : public ClipListView::ItemSorter {
-	virtual	int32 IndexForClip(ClipListView* listView, Clip* clip) const
+	virtual	bool AcceptClip(ClipListView* listView, Clip* clip) const
 	{
 		if (dynamic_cast<MediaClip*>(clip))
-			return ItemSorter::IndexForClip(listView, clip);
-		return -1;
+			return ItemSorter::AcceptClip(listView, clip);
+		return false;
 	}
 };
 
 class PlaylistSorter : public ClipListView::ItemSorter {
-	virtual	int32 IndexForClip(ClipListView* listView, Clip* clip) const
+	virtual	bool AcceptClip(ClipListView* listView, Clip* clip) const
 	{
 		if (dynamic_cast<Playlist*>(clip))
-			return ItemSorter::IndexForClip(listView, clip);
-		return -1;
+			return ItemSorter::AcceptClip(listView, clip);
+		return false;
 	}
 };
 
 class TableSorter : public ClipListView::ItemSorter {
-	virtual	int32 IndexForClip(ClipListView* listView, Clip* clip) const
+	virtual	bool AcceptClip(ClipListView* listView, Clip* clip) const
 	{
 		if (dynamic_cast<TableClip*>(clip))
-			return ItemSorter::IndexForClip(listView, clip);
-		return -1;
+			return ItemSorter::AcceptClip(listView, clip);
+		return false;
 	}
 };
 
 class TickerSorter : public ClipListView::ItemSorter {
-	virtual	int32 IndexForClip(ClipListView* listView, Clip* clip) const
+	virtual	bool AcceptClip(ClipListView* listView, Clip* clip) const
 	{
 		if (dynamic_cast<ScrollingTextClip*>(clip))
-			return ItemSorter::IndexForClip(listView, clip);
-		return -1;
+			return ItemSorter::AcceptClip(listView, clip);
+		return false;
 	}
 };
 
 class TextSorter : public ClipListView::ItemSorter {
-	virtual	int32 IndexForClip(ClipListView* listView, Clip* clip) const
+	virtual	bool AcceptClip(ClipListView* listView, Clip* clip) const
 	{
 		if (dynamic_cast<TextClip*>(clip))
-			return ItemSorter::IndexForClip(listView, clip);
-		return -1;
+			return ItemSorter::AcceptClip(listView, clip);
+		return false;
 	}
 };
 
 class WeatherSorter : public ClipListView::ItemSorter {
-	virtual	int32 IndexForClip(ClipListView* listView, Clip* clip) const
+	virtual	bool AcceptClip(ClipListView* listView, Clip* clip) const
 	{
 		if (dynamic_cast<WeatherClip*>(clip))
-			return ItemSorter::IndexForClip(listView, clip);
-		return -1;
+			return ItemSorter::AcceptClip(listView, clip);
+		return false;
 	}
 };
 
@@ -19,8 +19,10 @@
 #include "Clip.h"
 #include "ClipPlaylistItem.h"
 #include "CommonPropertyIDs.h"
+#include "MediaClip.h"
 #include "Playlist.h"
 #include "Selection.h"
+#include "ThumbnailCache.h"
 #include "TimelineMessages.h"
 
 using std::nothrow;
@@ -36,7 +38,8 @@ ClipListItem::ClipListItem(Clip* c, ClipListView* listView)
 	  fListView(listView),
 	  fPainter(NULL),
 	  fRemoved(false),
-	  fReloadToken(0)
+	  fReloadToken(0),
+	  fThumbnailsRequested(false)
 {
 	SetClip(c);
 }
@@ -47,7 +50,8 @@ ClipListItem::ClipListItem(Clip* c, ClipListView* listView,
 	: SimpleItem(""),
 	  clip(NULL),
 	  fListView(listView),
-	  fPainter(painter)
+	  fPainter(painter),
+	  fThumbnailsRequested(false)
 {
 	SetClip(c);
 }
@@ -64,6 +68,10 @@ void
 ClipListItem::Draw(BView* owner, BRect frame, uint32 flags)
 {
 	if (fPainter) {
+		// thumbnails are only decoded for items which are actually shown
+		if (!fThumbnailsRequested)
+			_RequestThumbnails();
+
 		SimpleItem::DrawBackground(owner, frame, flags);
 		// additional graphics to distinguish clips
 		fPainter->PaintItem(owner, this, frame, flags);
@@ -90,13 +98,17 @@ ClipListItem::ObjectChanged(const Observable* object)
 	if (object != clip)
 		return;
 
-	if (clip->Name() != Text())
+	if (clip->Name() != Text()) {
 		UpdateText();
+		if (fListView)
+			fListView->ClipRenamed(clip);
+	}
 
 	SetRemoved(clip->HasRemovedStatus());
 
 	if (fReloadToken != clip->ChangeToken()) {
 		fReloadToken = clip->ChangeToken();
+		fThumbnailsRequested = false;
 		if (fPainter)
 			fPainter->MakeIcon(clip);
 		Invalidate();
@@ -125,6 +137,7 @@ ClipListItem::SetClip(Clip* c)
 		SetRemoved(clip->HasRemovedStatus());
 		fReloadToken = clip->ChangeToken();
 	}
+	fThumbnailsRequested = false;
 }
 
 // SetPainter
@@ -169,6 +182,36 @@ ClipListItem::Invalidate()
 	}
 }
 
+// UpdateIcon
+void
+ClipListItem::UpdateIcon()
+{
+	if (fPainter)
+		fPainter->MakeIcon(clip);
+	Invalidate();
+}
+
+// _RequestThumbnails
+void
+ClipListItem::_RequestThumbnails()
+{
+	fThumbnailsRequested = true;
+
+	MediaClip* mediaClip = dynamic_cast<MediaClip*>(clip);
+	ThumbnailCache* cache = ThumbnailCache::Default();
+	if (!mediaClip || !cache)
+		return;
+
+	// the list view is notified when the thumbnails have been decoded
+	ThumbnailStrip* thumbnails = cache->GetThumbnails(mediaClip,
+		BMessenger(fListView));
+	if (thumbnails) {
+		thumbnails->Release();
+		if (fPainter)
+			fPainter->MakeIcon(clip);
+	}
+}
+
 // #pragma mark - ClipItemPainter
 
 // constructor
@@ -285,52 +328,47 @@ ClipListView::ItemSorter::SetNameContainsFilterString(const char* string)
 	fNameContainsFilterString = string;
 }
 
+// AcceptClip
+bool
+ClipListView::ItemSorter::AcceptClip(ClipListView* listView, Clip* clip) const
+{
+	if (fNameContainsFilterString.Length() > 0
+		&& clip->Name().IFindFirst(fNameContainsFilterString) < 0) {
+		return false;
+	}
+
+	// TODO: this test isn't quite what we want, we actually
+	// want to assign clips to playlist, independent of wether
+	// they are already used in the playlist, because otherwise,
+	// newly created clips might not even show up in the list
+	// at all, and the user cannot drag them into the playlist
+	// (at which point they would show up)
+	if (fPlaylistClipsOnly && listView->Playlist()
+		&& !listView->PlaylistUsesClip(clip)) {
+		return false;
+	}
+
+	return true;
+}
+
 // IndexForClip
 int32
 ClipListView::ItemSorter::IndexForClip(ClipListView* listView,
 									   Clip* clip) const
 {
-	if (fNameContainsFilterString.Length() > 0
-		&& clip->Name().IFindFirst(fNameContainsFilterString) < 0) {
+	if (!AcceptClip(listView, clip))
 		return -1;
-	}
 
-	::Playlist* playlist = listView->Playlist();
-	if (fPlaylistClipsOnly && playlist) {
-		// TODO: this test isn't quite what we want, we actually
-		// want to assign clips to playlist, independent of wether
-		// they are already used in the playlist, because otherwise,
-		// newly created clips might not even show up in the list
-		// at all, and the user cannot drag them into the playlist
-		// (at which point they would show up)
-		bool usesClip = false;
-		int32 count = playlist->CountItems();
-		for (int32 i = 0; i < count; i++) {
-			PlaylistItem* item = playlist->ItemAtFast(i);
-			if (ClipPlaylistItem* clipItem
-					= dynamic_cast<ClipPlaylistItem*>(item)) {
-				if (clipItem->Clip() == clip) {
-					usesClip = true;
-					break;
-				}
-			}
-		}
-		if (!usesClip)
-			return -1;
-	}
+	return listView->IndexForName(clip->Name().String());
+}
 
-	// binary search
-	int32 lower = 0;
-	int32 upper = listView->CountItems();
-	while (lower < upper) {
-		int32 mid = (lower + upper) / 2;
-		ClipListItem* item = dynamic_cast<ClipListItem*>(listView->ItemAt(mid));
-		if (strcasecmp(item->Text(), clip->Name().String()) > 0)
-			upper = mid;
-		else
-			lower = mid + 1;
-	}
-	return lower;
+// compare_clip_names
+static int
+compare_clip_names(const void* _a, const void* _b)
+{
+	Clip* a = *(Clip**)_a;
+	Clip* b = *(Clip**)_b;
+	return strcasecmp(a->Name().String(), b->Name().String());
 }
 
 // #pragma mark - TemporaryIncrementer
@@ -363,6 +401,8 @@ ClipListView::ClipListView(const char* name,
 	  fClipLibrary(NULL),
 	  fSelection(NULL),
 	  fPlaylist(NULL),
+	  fSortedClips(1024),
+	  fPlaylistClips(),
 	  fSorter(new (nothrow) ItemSorter()),
 	  fIgnoreSelectionChanged(0)
 {
@@ -418,6 +458,12 @@ ClipListView::MessageReceived(BMessage* message)
 	if (message->what == B_SIMPLE_DATA) {
 		// drag and drop, most likely from Tracker
 		be_app->PostMessage(message);
+	} else if (message->what == MSG_THUMBNAILS_READY) {
+		Clip* clip;
+		if (message->FindPointer("clip", (void**)&clip) == B_OK) {
+			if (ClipListItem* item = _ItemForClip(clip))
+				item->UpdateIcon();
+		}
 	} else {
 		if (message->what != MSG_DRAG_CLIP)
 			// don't allow drag sorting for now
@@ -547,6 +593,8 @@ ClipListView::ObjectAdded(ServerObject* object, int32 index)
 	if (!LockLooper())
 		return;
 
+	_InsertSortedClip(clip);
+
 	index = _FilterClip(clip);
 	if (index >= 0)
 		_AddClip(clip, index);
@@ -566,7 +614,11 @@ ClipListView::ObjectRemoved(ServerObject* object)
 		return;
 
 	// NOTE: we're only interested in Clip objects
-	_RemoveClip(dynamic_cast<Clip*>(object));
+	Clip* clip = dynamic_cast<Clip*>(object);
+	if (clip) {
+		fSortedClips.RemoveItem(clip);
+		_RemoveClip(clip);
+	}
 
 	UnlockLooper();
 }
@@ -577,16 +629,52 @@ ClipListView::ObjectRemoved(ServerObject* object)
 void
 ClipListView::ItemAdded(::Playlist* playlist, PlaylistItem* item, int32 index)
 {
-	if (fSorter->PlaylistClipsOnly())
-		_Sync();
+	ClipPlaylistItem* clipItem = dynamic_cast<ClipPlaylistItem*>(item);
+	if (!clipItem || !clipItem->Clip())
+		return;
+
+	if (!LockLooper())
+		return;
+
+	_AddPlaylistClip(clipItem->Clip());
+
+	UnlockLooper();
 }
 
 // ItemRemoved
 void
 ClipListView::ItemRemoved(::Playlist* playlist, PlaylistItem* item)
 {
-	if (fSorter->PlaylistClipsOnly())
-		_Sync();
+	ClipPlaylistItem* clipItem = dynamic_cast<ClipPlaylistItem*>(item);
+	if (!clipItem || !clipItem->Clip())
+		return;
+
+	if (!LockLooper())
+		return;
+
+	_RemovePlaylistClip(clipItem->Clip());
+
+	UnlockLooper();
+}
+
+// ItemClipChanged
+void
+ClipListView::ItemClipChanged(::Playlist* playlist, PlaylistItem* item,
+	Clip* oldClip)
+{
+	ClipPlaylistItem* clipItem = dynamic_cast<ClipPlaylistItem*>(item);
+	if (!clipItem)
+		return;
+
+	if (!LockLooper())
+		return;
+
+	if (oldClip)
+		_RemovePlaylistClip(oldClip);
+	if (clipItem->Clip())
+		_AddPlaylistClip(clipItem->Clip());
+
+	UnlockLooper();
 }
 
 // #pragma mark -
@@ -623,6 +711,7 @@ ClipListView::SetObjectLibrary(ServerObjectManager* library)
 	_MakeEmpty();
 
 	fClipLibrary = library;
+	_RebuildSortedClips();
 
 	if (fClipLibrary == NULL)
 		return;
@@ -667,7 +756,9 @@ ClipListView::SetPlaylist(::Playlist* playlist)
 		fPlaylist->AddListObserver(this);
 	}
 
-	if (fSorter->PlaylistClipsOnly())
+	_RebuildPlaylistClips();
+
+	if (fSorter && fSorter->PlaylistClipsOnly())
 		_Sync();
 }
 
@@ -707,21 +798,84 @@ ClipListView::IndexForClip(Clip* clip) const
 	return -1;
 }
 
-// #pragma mark -
+// IndexForName
+int32
+ClipListView::IndexForName(const char* name) const
+{
+	// binary search
+	int32 lower = 0;
+	int32 upper = CountItems();
+	while (lower < upper) {
+		int32 mid = (lower + upper) / 2;
+		ClipListItem* item = (ClipListItem*)ItemAt(mid);
+		if (strcasecmp(item->Text(), name) > 0)
+			upper = mid;
+		else
+			lower = mid + 1;
+	}
+	return lower;
+}
 
-// _AddClip
+// PlaylistUsesClip
 bool
-ClipListView::_AddClip(Clip* clip, int32 index)
+ClipListView::PlaylistUsesClip(Clip* clip) const
 {
-	if (!clip)
-		return false;
+	return fPlaylistClips.ContainsKey(clip);
+}
+
+// ClipRenamed
+void
+ClipListView::ClipRenamed(Clip* clip)
+{
+	if (!LockLooper())
+		return;
+
+	if (fSortedClips.RemoveItem(clip))
+		_InsertSortedClip(clip);
 
+	// move the item of the clip to its new place
+	ClipListItem* item = _ItemForClip(clip);
+	int32 index = item ? IndexOf(item) : -1;
+	if (index >= 0) {
+		TemporaryIncrementer _(fIgnoreSelectionChanged);
+
+		// NOTE: the item is not deleted, this may be called from its
+		// ObjectChanged(), and the list has room for it again anyways
+		bool selected = item->IsSelected();
+		RemoveItem(index);
+		index = IndexForName(clip->Name().String());
+		if (AddItem(item, index) && selected)
+			Select(index, true);
+	}
+
+	UnlockLooper();
+}
+
+// #pragma mark -
+
+// _CreateItem
+ClipListItem*
+ClipListView::_CreateItem(Clip* clip)
+{
 	ClipItemPainter* painter = new (nothrow) ClipItemPainter();
 	if (!painter)
-		return false;
+		return NULL;
 	painter->MakeIcon(clip);
 
 	ClipListItem* item = new (nothrow) ClipListItem(clip, this, painter);
+	if (!item)
+		delete painter;
+	return item;
+}
+
+// _AddClip
+bool
+ClipListView::_AddClip(Clip* clip, int32 index)
+{
+	if (!clip)
+		return false;
+
+	ClipListItem* item = _CreateItem(clip);
 	if (!item || !AddItem(item, index)) {
 		delete item;
 		return false;
@@ -801,21 +955,51 @@ ClipListView::_Sync()
 
 	TemporaryIncrementer _(fIgnoreSelectionChanged);
 
-	_MakeEmpty();
+	_CheckSortedClips();
 
-	// sync
-	if (fClipLibrary->WriteLock()) {
-		int32 count = fClipLibrary->CountObjects();
+	// keep the items of the clips which are still shown, so
+	// that narrowing the filter doesn't recreate the icons
+	ClipItemMap oldItems;
+	for (int32 i = CountItems() - 1; i >= 0; i--) {
+		ClipListItem* item = (ClipListItem*)RemoveItem(i);
+		if (oldItems.Put(item->clip, item) < B_OK)
+			delete item;
+	}
+
+	// the clips are already sorted, so the items
+	// can be added to the list all at once
+	int32 count = fSortedClips.CountItems();
+	BList items(count);
+	if (fClipLibrary->ReadLock()) {
 		for (int32 i = 0; i < count; i++) {
-			// NOTE: we are only interested in Clip objects
-			Clip* clip = dynamic_cast<Clip*>(fClipLibrary->ObjectAtFast(i));
-			int32 index = _FilterClip(clip);
-			if (index >= 0) {
-				_AddClip(clip, index);
-			}
+			Clip* clip = (Clip*)fSortedClips.ItemAtFast(i);
+			if (fSorter && !fSorter->AcceptClip(this, clip))
+				continue;
+
+			ClipListItem* item = oldItems.Remove(clip);
+			if (!item)
+				item = _CreateItem(clip);
+			if (item && !items.AddItem(item))
+				delete item;
 		}
-	
-		fClipLibrary->WriteUnlock();
+
+		fClipLibrary->ReadUnlock();
+	}
+
+	ClipItemMap::Iterator iterator = oldItems.GetIterator();
+	while (iterator.HasNext())
+		delete iterator.Next().value;
+
+	if (AddList(&items)) {
+		count = items.CountItems();
+		for (int32 i = 0; i < count; i++) {
+			if (((ClipListItem*)items.ItemAtFast(i))->clip->IsSelected())
+				Select(i, true);
+		}
+	} else {
+		count = items.CountItems();
+		for (int32 i = 0; i < count; i++)
+			delete (ClipListItem*)items.ItemAtFast(i);
 	}
 
 // Begin hack to make list modification faster
@@ -839,3 +1023,107 @@ ClipListView::_FilterClip(Clip* clip)
 	return CountItems();
 }
 
+// _InsertSortedClip
+void
+ClipListView::_InsertSortedClip(Clip* clip)
+{
+	// binary search
+	BString name = clip->Name();
+	int32 lower = 0;
+	int32 upper = fSortedClips.CountItems();
+	while (lower < upper) {
+		int32 mid = (lower + upper) / 2;
+		Clip* other = (Clip*)fSortedClips.ItemAtFast(mid);
+		if (strcasecmp(other->Name().String(), name.String()) > 0)
+			upper = mid;
+		else
+			lower = mid + 1;
+	}
+	fSortedClips.AddItem(clip, lower);
+}
+
+// _CheckSortedClips
+void
+ClipListView::_CheckSortedClips()
+{
+	// the clips which are not shown are not observed,
+	// so they may have been renamed in the meantime
+	int32 count = fSortedClips.CountItems();
+	for (int32 i = 1; i < count; i++) {
+		Clip* previous = (Clip*)fSortedClips.ItemAtFast(i - 1);
+		Clip* clip = (Clip*)fSortedClips.ItemAtFast(i);
+		if (strcasecmp(previous->Name().String(),
+				clip->Name().String()) > 0) {
+			fSortedClips.SortItems(compare_clip_names);
+			return;
+		}
+	}
+}
+
+// _RebuildSortedClips
+void
+ClipListView::_RebuildSortedClips()
+{
+	fSortedClips.MakeEmpty();
+	if (!fClipLibrary || !fClipLibrary->ReadLock())
+		return;
+
+	int32 count = fClipLibrary->CountObjects();
+	for (int32 i = 0; i < count; i++) {
+		// NOTE: we are only interested in Clip objects
+		Clip* clip = dynamic_cast<Clip*>(fClipLibrary->ObjectAtFast(i));
+		if (clip)
+			fSortedClips.AddItem(clip);
+	}
+
+	fClipLibrary->ReadUnlock();
+
+	fSortedClips.SortItems(compare_clip_names);
+}
+
+// _RebuildPlaylistClips
+void
+ClipListView::_RebuildPlaylistClips()
+{
+	fPlaylistClips.Clear();
+	if (!fPlaylist)
+		return;
+
+	int32 count = fPlaylist->CountItems();
+	for (int32 i = 0; i < count; i++) {
+		ClipPlaylistItem* item
+			= dynamic_cast<ClipPlaylistItem*>(fPlaylist->ItemAtFast(i));
+		if (!item || !item->Clip())
+			continue;
+		fPlaylistClips.Put(item->Clip(), fPlaylistClips.Get(item->Clip()) + 1);
+	}
+}
+
+// _AddPlaylistClip
+void
+ClipListView::_AddPlaylistClip(Clip* clip)
+{
+	int32 useCount = fPlaylistClips.Get(clip) + 1;
+	fPlaylistClips.Put(clip, useCount);
+
+	// only the clip which is now used by the playlist can show up
+	if (useCount == 1 && fSorter && fSorter->PlaylistClipsOnly()) {
+		int32 index = _FilterClip(clip);
+		if (index >= 0)
+			_AddClip(clip, index);
+	}
+}
+
+// _RemovePlaylistClip
+void
+ClipListView::_RemovePlaylistClip(Clip* clip)
+{
+	int32 useCount = fPlaylistClips.Get(clip) - 1;
+	if (useCount > 0)
+		fPlaylistClips.Put(clip, useCount);
+	else {
+		fPlaylistClips.Remove(clip);
+		if (fSorter && fSorter->PlaylistClipsOnly())
+			_RemoveClip(clip);
+	}
+}
@@ -8,6 +8,7 @@
 
 #include <String.h>
 
+#include "HashMap.h"
 #include "ListViews.h"
 #include "Observer.h"
 #include "PlaylistObserver.h"
@@ -44,14 +45,18 @@ class ClipListItem : public SimpleItem,
 			void	SetRemoved(bool removed);
 			bool	Removed() const { return fRemoved; }
 			void	Invalidate();
+			void	UpdateIcon();
 
 	Clip* 			clip;
 
  private:
+			void	_RequestThumbnails();
+
 	ClipListView*	fListView;
 	ClipItemPainter* fPainter;
 	bool			fRemoved;
 	uint32			fReloadToken;
+	bool			fThumbnailsRequested;
 };
 
 class ClipItemPainter {
@@ -86,7 +91,12 @@ class ClipListView : public SimpleListView,
 				const BString&	NameContainsFilterString() const
 									{ return fNameContainsFilterString; }
 
-		virtual	int32			IndexForClip(ClipListView* listView,
+								// Subclasses filter by overriding
+								// AcceptClip() and calling the inherited
+								// version for the clips they accept.
+		virtual	bool			AcceptClip(ClipListView* listView,
+										   Clip* clip) const;
+				int32			IndexForClip(ClipListView* listView,
 											 Clip* clip) const;
 	 private:
 	 			bool			fPlaylistClipsOnly;
@@ -127,6 +137,8 @@ class ClipListView : public SimpleListView,
 									PlaylistItem* item, int32 index);
 	virtual	void				ItemRemoved(::Playlist* playlist,
 									PlaylistItem* item);
+	virtual	void				ItemClipChanged(::Playlist* playlist,
+									PlaylistItem* item, Clip* oldClip);
 
 	// Observer
 	virtual	void				ObjectChanged(const Observable* object);
@@ -142,8 +154,15 @@ class ClipListView : public SimpleListView,
 			const BString&		NameContainsFilterString() const;
 
 			int32				IndexForClip(Clip* clip) const;
+			int32				IndexForName(const char* name) const;
+			bool				PlaylistUsesClip(Clip* clip) const;
+			void				ClipRenamed(Clip* clip);
 
  private:
+	typedef HashMap<HashKey32<Clip*>, int32> ClipUseMap;
+	typedef HashMap<HashKey32<Clip*>, ClipListItem*> ClipItemMap;
+
+			ClipListItem*		_CreateItem(Clip* clip);
 			bool				_AddClip(Clip* clip, int32 index);
 			bool				_RemoveClip(Clip* clip);
 
@@ -153,6 +172,13 @@ class ClipListView : public SimpleListView,
 
 			int32				_FilterClip(Clip* clip);
 
+			void				_InsertSortedClip(Clip* clip);
+			void				_CheckSortedClips();
+			void				_RebuildSortedClips();
+			void				_RebuildPlaylistClips();
+			void				_AddPlaylistClip(Clip* clip);
+			void				_RemovePlaylistClip(Clip* clip);
+
 			BMessage*			fSelectionMessage;
 			BMessage*			fInvokeMessage;
 
@@ -160,6 +186,12 @@ class ClipListView : public SimpleListView,
 			Selection*			fSelection;
 			::Playlist*			fPlaylist;
 
+								// all clips of the library, sorted by name
+			BList				fSortedClips;
+								// the number of items in the playlist
+								// which use each clip
+			ClipUseMap			fPlaylistClips;
+
 			ItemSorter*			fSorter;
 			int32				fIgnoreSelectionChanged;
 };
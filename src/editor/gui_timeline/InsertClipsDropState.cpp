@@ -112,7 +112,8 @@ InsertClipsDropState::WouldAcceptDragMessage(const BMessage* dragMessage)
 
 	library->ReadUnlock();
 
-	fSnapFrames.CollectSnapFrames(fView->Playlist(), fDraggedClipDuration);
+	fSnapFrames.CollectSnapFrames(fView->Playlist(), fDraggedClipDuration,
+		fView->DisplayRange());
 	fSnapFrames.AddSnapFrame(0, fDraggedClipDuration);
 	if (fView->IsPaused())
 		fSnapFrames.AddSnapFrame(fView->CurrentFrame(), fDraggedClipDuration);
@@ -114,7 +114,7 @@ PlaylistItemManipulator::RebuildCachedData()
 	BRect oldItemFrame = fItemFrame;
 
 	fItemFrame = _ComputeFrameFor(fItem);
-	fView->Invalidate(oldItemFrame | fItemFrame);
+	fView->InvalidateContent(oldItemFrame | fItemFrame);
 }
 
 // #pragma mark -
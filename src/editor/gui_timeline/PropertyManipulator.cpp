@@ -337,7 +337,7 @@ PropertyManipulator::RebuildCachedData()
 {
 	fKeyPoints.MakeEmpty();
 	if (fParent->_View() && fParent->_View()->LockLooper()) {
-		fParent->_View()->Invalidate(fParent->_ItemFrame());
+		fParent->_View()->InvalidateContent(fParent->_ItemFrame());
 		fParent->_View()->UnlockLooper();
 	}
 }
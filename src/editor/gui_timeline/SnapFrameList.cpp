@@ -5,184 +5,140 @@
 
 #include "SnapFrameList.h"
 
-#include <new>
-
+#include <math.h>
 #include <stdlib.h>
 
+#include "DisplayRange.h"
 #include "Playlist.h"
-#include "PlaylistItem.h"
-
-using std::nothrow;
 
-struct snap_frame {
-	int64	startSnapFrame;
-	int64	endSnapFrame;
-	uint32	track;
-};
+// The snap frames are a copy of the boundary index of the playlist, which
+// is already sorted, so collecting them does not need to look at the items.
+// A copy is needed, because the items which are being dragged are changed
+// while the snap frames are in use, and should snap to where they were
+// when the dragging started.
+//
+// If snapToEndOffset is specified, every frame also snaps at snapToEndOffset
+// frames before it, so that something with that duration can be aligned
+// with its end instead. These frames are found by searching the index for
+// the frame plus the offset.
 
 // constructor
 SnapFrameList::SnapFrameList()
-	: fSnapFrames(24)
+	: fSnapFrames()
+	, fSnapToEndOffset(0)
 {
 }
 
 // destructor
 SnapFrameList::~SnapFrameList()
 {
-	_MakeEmpty();
 }
 
 // CollectSnapFrames
 void
 SnapFrameList::CollectSnapFrames(const Playlist* list,
-								 uint64 snapToEndOffset)
+								 uint64 snapToEndOffset,
+								 const DisplayRange* range)
 {
 	if (!list)
 		return;
 
-	_MakeEmpty();
+	fSnapToEndOffset = snapToEndOffset;
 
-	int32 count = list->CountItems();
-	for (int32 i = 0; i < count; i++) {
-		PlaylistItem* item = list->ItemAtFast(i);
-		snap_frame* startSnap = new (nothrow) snap_frame;
-		if (!startSnap || !fSnapFrames.AddItem((void*)startSnap)) {
-			delete startSnap;
-			break;
-		}
-		snap_frame* endSnap = new (nothrow) snap_frame;
-		if (!endSnap || !fSnapFrames.AddItem((void*)endSnap)) {
-			delete endSnap;
-			break;
-		}
-		// if snapToEndOffset is specified,
-		// add a snap frame snapToEndOffset frames
-		// before the items end frame, so that we
-		// can snap there too (which will result in
-		// something being aligned to the end instead)
-		startSnap->startSnapFrame = item->StartFrame();
-		startSnap->endSnapFrame = startSnap->startSnapFrame - snapToEndOffset;
-		endSnap->startSnapFrame = item->EndFrame() + 1;
-		endSnap->endSnapFrame = endSnap->startSnapFrame - snapToEndOffset;
-			// don't snap on the >end< frame, but on the next
-		startSnap->track = endSnap->track = item->Track();
+	int64 firstFrame = -9223372036854775807LL;
+	int64 lastFrame = 9223372036854775807LL;
+	if (range) {
+		// allow for some scrolling while the snap frames are in use
+		int64 margin = range->DisplayedFrames();
+		firstFrame = range->FirstFrame() - margin;
+		lastFrame = range->LastFrame() + margin + snapToEndOffset;
 	}
+
+	fSnapFrames.SetTo(list->BoundaryIndex(), firstFrame, lastFrame);
 }
 
 // AddSnapFrame
 void
 SnapFrameList::AddSnapFrame(int64 frame, uint64 snapToEndOffset)
 {
-	snap_frame* startSnap = new (nothrow) snap_frame;
-	if (!startSnap || !fSnapFrames.AddItem((void*)startSnap)) {
-		delete startSnap;
-		return;
-	}
-	// if snapToEndOffset is specified,
-	// add a snap frame snapToEndOffset frames
-	// before the items end frame, so that we
-	// can snap there too (which will result in
-	// something being aligned to the end instead)
-	startSnap->startSnapFrame = frame;
-	startSnap->endSnapFrame = startSnap->startSnapFrame - snapToEndOffset;
-	startSnap->track = 0;
+	// the offset is expected to be the one the frames were collected with
+	fSnapToEndOffset = snapToEndOffset;
+	fSnapFrames.AddBoundary(frame, -1);
 }
 
 // ClosestFrameFor
+//
+// Boundaries on all tracks are considered, so that an item on the given
+// track can be aligned with the items on the other tracks.
 int64
 SnapFrameList::ClosestFrameFor(int64 frame, uint32 track, double zoomLevel) const
 {
-	int64 closest = frame;
-	int32 snapDist = (int32)ceil(8 * zoomLevel);
-
-	int32 count = fSnapFrames.CountItems();
-	for (int32 i = 0; i < count; i++) {
-		snap_frame* snapFrame = (snap_frame*)fSnapFrames.ItemAtFast(i);
-		if (abs(snapFrame->startSnapFrame - frame) < snapDist) {
-			closest = snapFrame->startSnapFrame;
-		} else if (abs(snapFrame->endSnapFrame - frame) < snapDist) {
-			closest = snapFrame->endSnapFrame;
-		}
-	}
-	return closest;
+	int64 snapDist = (int64)ceil(8 * zoomLevel);
+
+	int64 closest;
+	if (_FindClosest(frame, -1, &closest) && llabs(closest - frame) < snapDist)
+		return closest;
+	return frame;
 }
 
 // ClosestSnapFrameFor
 int64
-SnapFrameList::ClosestSnapFrameFor(int64 frame) const
+SnapFrameList::ClosestSnapFrameFor(int64 frame, int32 track) const
 {
-	int64 closest = frame;
-	int64 minDist = LONG_MAX;
-
-	int32 count = fSnapFrames.CountItems();
-	for (int32 i = 0; i < count; i++) {
-		snap_frame* snapFrame = (snap_frame*)fSnapFrames.ItemAtFast(i);
-		int64 distStart = abs(snapFrame->startSnapFrame - frame);
-		int64 distEnd = abs(snapFrame->endSnapFrame - frame);
-		if (distStart < minDist) {
-			closest = snapFrame->startSnapFrame;
-			minDist = distStart;
-		} else if (distEnd < minDist) {
-			closest = snapFrame->endSnapFrame;
-			minDist = distEnd;
-		}
-	}
-	return closest;
+	int64 closest;
+	if (_FindClosest(frame, track, &closest))
+		return closest;
+	return frame;
 }
 
 // ClosestSnapFrameBackwardsFor
 int64
-SnapFrameList::ClosestSnapFrameBackwardsFor(int64 frame) const
+SnapFrameList::ClosestSnapFrameBackwardsFor(int64 frame, int32 track) const
 {
 	int64 closest = frame;
-	int64 minDist = LONG_MAX;
-
-	int32 count = fSnapFrames.CountItems();
-	for (int32 i = 0; i < count; i++) {
-		snap_frame* snapFrame = (snap_frame*)fSnapFrames.ItemAtFast(i);
-		int64 distStart = frame - snapFrame->startSnapFrame;
-		int64 distEnd = frame - snapFrame->endSnapFrame;
-		if (distStart > 0 && distStart < minDist) {
-			closest = snapFrame->startSnapFrame;
-			minDist = distStart;
-		} else if (distEnd > 0 && distEnd < minDist) {
-			closest = snapFrame->endSnapFrame;
-			minDist = distEnd;
-		}
+	bool found = fSnapFrames.FindBefore(frame, track, &closest);
+
+	int64 endSnap;
+	if (fSnapToEndOffset > 0 && fSnapFrames.FindBefore(
+			frame + fSnapToEndOffset, track, &endSnap)) {
+		endSnap -= fSnapToEndOffset;
+		if (!found || endSnap > closest)
+			closest = endSnap;
 	}
 	return closest;
 }
 
 // ClosestSnapFrameForwardFor
 int64
-SnapFrameList::ClosestSnapFrameForwardFor(int64 frame) const
+SnapFrameList::ClosestSnapFrameForwardFor(int64 frame, int32 track) const
 {
 	int64 closest = frame;
-	int64 minDist = LONG_MAX;
-
-	int32 count = fSnapFrames.CountItems();
-	for (int32 i = 0; i < count; i++) {
-		snap_frame* snapFrame = (snap_frame*)fSnapFrames.ItemAtFast(i);
-		int64 distStart = snapFrame->startSnapFrame - frame;
-		int64 distEnd = snapFrame->endSnapFrame - frame;
-		if (distStart > 0 && distStart < minDist) {
-			closest = snapFrame->startSnapFrame;
-			minDist = distStart;
-		} else if (distEnd > 0 && distEnd < minDist) {
-			closest = snapFrame->endSnapFrame;
-			minDist = distEnd;
-		}
+	bool found = fSnapFrames.FindAfter(frame, track, &closest);
+
+	int64 endSnap;
+	if (fSnapToEndOffset > 0 && fSnapFrames.FindAfter(
+			frame + fSnapToEndOffset, track, &endSnap)) {
+		endSnap -= fSnapToEndOffset;
+		if (!found || endSnap < closest)
+			closest = endSnap;
 	}
 	return closest;
 }
 
-// _MakeEmpty
-void
-SnapFrameList::_MakeEmpty()
+// _FindClosest
+bool
+SnapFrameList::_FindClosest(int64 frame, int32 track, int64* _closest) const
 {
-	int32 count = fSnapFrames.CountItems();
-	for (int32 i = 0; i < count; i++)
-		delete (snap_frame*)fSnapFrames.ItemAtFast(i);
-	fSnapFrames.MakeEmpty();
+	bool found = fSnapFrames.FindClosest(frame, track, _closest);
+
+	int64 endSnap;
+	if (fSnapToEndOffset > 0 && fSnapFrames.FindClosest(
+			frame + fSnapToEndOffset, track, &endSnap)) {
+		endSnap -= fSnapToEndOffset;
+		if (!found || llabs(endSnap - frame) < llabs(*_closest - frame)) {
+			*_closest = endSnap;
+			found = true;
+		}
+	}
+	return found;
 }
-
@@ -6,8 +6,9 @@
 #ifndef SNAP_FRAME_LIST_H
 #define SNAP_FRAME_LIST_H
 
-#include <List.h>
+#include "PlaylistBoundaryIndex.h"
 
+class DisplayRange;
 class Playlist;
 
 class SnapFrameList {
@@ -15,8 +16,11 @@ class SnapFrameList {
 								SnapFrameList();
 	virtual						~SnapFrameList();
 
+			// If a range is given, only the boundaries of the items
+			// which are visible in it are collected.
 			void				CollectSnapFrames(const Playlist* list,
-									uint64 snapToEndOffset);
+									uint64 snapToEndOffset,
+									const DisplayRange* range = NULL);
 
 			void				AddSnapFrame(int64 frame,
 									uint64 snapToEndOffset);
@@ -24,14 +28,20 @@ class SnapFrameList {
 			int64				ClosestFrameFor(int64 frame,
 									uint32 track,  double zoomLevel) const;
 
-			int64				ClosestSnapFrameFor(int64 frame) const;
-			int64				ClosestSnapFrameBackwardsFor(int64 frame) const;
-			int64				ClosestSnapFrameForwardFor(int64 frame) const;
+			// pass a track to consider only the boundaries on it
+			int64				ClosestSnapFrameFor(int64 frame,
+									int32 track = -1) const;
+			int64				ClosestSnapFrameBackwardsFor(int64 frame,
+									int32 track = -1) const;
+			int64				ClosestSnapFrameForwardFor(int64 frame,
+									int32 track = -1) const;
 
  private:
-			void				_MakeEmpty();
+			bool				_FindClosest(int64 frame, int32 track,
+									int64* _closest) const;
 
-			BList				fSnapFrames;
+			PlaylistBoundaryIndex fSnapFrames;
+			uint64				fSnapToEndOffset;
 };
 
 #endif // SNAP_FRAME_LIST_H
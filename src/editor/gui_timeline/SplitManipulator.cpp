@@ -17,13 +17,17 @@
 #include "support.h"
 #include "support_ui.h"
 
+#include "AutoDeleter.h"
 #include "ClipPlaylistItem.h"
 #include "MainWindow.h"
+#include "MediaClip.h"
 #include "Playlist.h"
 #include "PlaylistItem.h"
 #include "PropertyManipulator.h"
+#include "ThumbnailCache.h"
 #include "TimelineMessages.h"
 #include "TimelineView.h"
+#include "WaveformCache.h"
 
 using std::nothrow;
 
@@ -93,6 +97,10 @@ SplitManipulator::Draw(BView* into, BRect updateRect)
 		if (r.IntegerWidth() == 0)
 			return;
 
+		// video thumbnails and audio waveform behind the clip name
+		_DrawFilmstrip(into, r, updateRect);
+		_DrawWaveform(into, r, updateRect);
+
 		// clip name
 		BString truncated(fItem->Name());
 		BFont font;
@@ -202,7 +210,7 @@ SplitManipulator::MouseUp()
 		return fPropertyManipulator->MouseUp();
 
 	Command* command = ToolMouseUp();
-	fView->Invalidate(fItemFrame);
+	fView->InvalidateContent(fItemFrame);
 	return command;
 }
 
@@ -286,6 +294,111 @@ SplitManipulator::RebuildCachedData()
 
 // #pragma mark -
 
+// _DrawFilmstrip
+void
+SplitManipulator::_DrawFilmstrip(BView* into, BRect frame, BRect updateRect)
+{
+	ClipPlaylistItem* item = dynamic_cast<ClipPlaylistItem*>(fItem);
+	if (!item || !fView || !fView->Playlist() || !ThumbnailCache::Default())
+		return;
+	MediaClip* clip = dynamic_cast<MediaClip*>(item->Clip());
+	if (!clip || !clip->HasVideo() || clip->VideoFrameRate() <= 0.0)
+		return;
+
+	// the thumbnails are decoded in the background, the view is
+	// invalidated once they become available
+	ThumbnailStrip* thumbnails = ThumbnailCache::Default()->GetThumbnails(
+		clip, BMessenger(fView));
+	if (!thumbnails)
+		return;
+	Reference thumbnailsReference(thumbnails, true);
+
+	// tile the frame with thumbnails of the frame height, each showing
+	// the clip frame at the center of its tile
+	float height = frame.Height() + 1;
+	float width = max_c(1.0, roundf(height * thumbnails->Width()
+		/ thumbnails->Height()));
+	double framesToClip = clip->VideoFrameRate()
+		/ fView->Playlist()->VideoFrameRate();
+
+	for (float x = frame.left; x <= frame.right; x += width) {
+		BRect dest(x, frame.top, x + width - 1, frame.bottom);
+		if (!dest.Intersects(updateRect))
+			continue;
+
+		double videoFrame = fItem->ClipOffset()
+			+ (x + width / 2 - fItemFrame.left) * fView->FramesPerPixel();
+		int32 index = thumbnails->IndexForFrame(
+			(int64)(videoFrame * framesToClip));
+		BRect source = thumbnails->ThumbnailFrame(index);
+
+		if (dest.right > frame.right) {
+			// cut off the last thumbnail instead of squeezing it
+			source.right = source.left + floorf((frame.right - dest.left + 1)
+				* (source.Width() + 1) / width) - 1;
+			dest.right = frame.right;
+			if (source.right < source.left)
+				break;
+		}
+
+		into->DrawBitmap(thumbnails->Bitmap(), source, dest);
+	}
+}
+
+// _DrawWaveform
+void
+SplitManipulator::_DrawWaveform(BView* into, BRect frame, BRect updateRect)
+{
+	ClipPlaylistItem* item = dynamic_cast<ClipPlaylistItem*>(fItem);
+	if (!item || !fView || !fView->Playlist() || !WaveformCache::Default())
+		return;
+	MediaClip* clip = dynamic_cast<MediaClip*>(item->Clip());
+	if (!clip || !clip->HasAudio())
+		return;
+
+	// the peaks are computed in the background, the view is
+	// invalidated once they become available
+	Waveform* waveform = WaveformCache::Default()->GetWaveform(clip,
+		BMessenger(fView));
+	if (!waveform)
+		return;
+	Reference waveformReference(waveform, true);
+
+	BRect r = frame & updateRect;
+	if (!r.IsValid())
+		return;
+
+	int32 count = r.IntegerWidth() + 1;
+	float* minima = new (nothrow) float[count * 2];
+	if (!minima)
+		return;
+	ArrayDeleter<float> peaksDeleter(minima);
+	float* maxima = minima + count;
+
+	// map the (clip local) video frames of the item to audio frames
+	double framesToAudio = waveform->FrameRate()
+		/ fView->Playlist()->VideoFrameRate();
+	double framesPerPixel = fView->FramesPerPixel() * framesToAudio;
+	double videoFrame = fItem->ClipOffset()
+		+ (r.left - fItemFrame.left) * fView->FramesPerPixel();
+	int64 startFrame = (int64)(videoFrame * framesToAudio);
+
+	count = waveform->GetPeaks(startFrame, framesPerPixel, count,
+		minima, maxima);
+
+	float center = (frame.top + frame.bottom) / 2.0;
+	float scale = (frame.Height() - 2.0) / 2.0;
+	rgb_color color = (rgb_color){ 120, 140, 170, 120 };
+
+	into->BeginLineArray(count);
+	for (int32 i = 0; i < count; i++) {
+		float x = r.left + i;
+		into->AddLine(BPoint(x, center - maxima[i] * scale),
+			BPoint(x, center - minima[i] * scale), color);
+	}
+	into->EndLineArray();
+}
+
 // ToolDraw
 void
 SplitManipulator::ToolDraw(BView* into, BRect itemFrame)
@@ -46,6 +46,10 @@ protected:
 	friend class PropertyManipulator;
 
 			BRect				_UpperFrame() const;
+			void				_DrawFilmstrip(BView* into, BRect frame,
+									BRect updateRect);
+			void				_DrawWaveform(BView* into, BRect frame,
+									BRect updateRect);
 
 			PlaylistItem*		_Item() const
 									{ return fItem; }
@@ -0,0 +1,245 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+#include "TimelineTileCache.h"
+
+#include <new>
+#include <math.h>
+#include <stdio.h>
+
+#include <Bitmap.h>
+#include <View.h>
+
+using std::nothrow;
+
+struct TimelineTileCache::tile {
+	tile()
+		: column(0)
+		, row(0)
+		, valid(false)
+		, lastUsed(0)
+		, bitmap(NULL)
+	{
+	}
+
+	~tile()
+	{
+		delete bitmap;
+	}
+
+	int32		column;
+	int32		row;
+	bool		valid;
+	uint32		lastUsed;
+	BBitmap*	bitmap;
+};
+
+// constructor
+TimelineTileCache::TimelineTileCache()
+	: fTiles(MIN_TILES)
+	, fMaxTiles(MIN_TILES)
+	, fZoomLevel(0.0)
+	, fUsageCounter(0)
+	, fRenderedTiles(0)
+	, fReusedTiles(0)
+{
+}
+
+// destructor
+TimelineTileCache::~TimelineTileCache()
+{
+	int32 count = fTiles.CountItems();
+	for (int32 i = 0; i < count; i++)
+		delete (tile*)fTiles.ItemAtFast(i);
+}
+
+// SetZoomLevel
+void
+TimelineTileCache::SetZoomLevel(double zoomLevel)
+{
+	if (fZoomLevel == zoomLevel)
+		return;
+
+	fZoomLevel = zoomLevel;
+	MakeEmpty();
+}
+
+// SetVisibleSize
+//
+// Sizes the cache to the tiles which the visible part of the view can
+// intersect at any scrolling offset.
+void
+TimelineTileCache::SetVisibleSize(float width, float height)
+{
+	int32 columns = (int32)ceilf((width + 1) / TILE_SIZE) + 1;
+	int32 rows = (int32)ceilf((height + 1) / TILE_SIZE) + 1;
+	fMaxTiles = max_c(MIN_TILES, columns * rows);
+	_Trim();
+}
+
+// Invalidate
+void
+TimelineTileCache::Invalidate(BRect rect)
+{
+	if (!rect.IsValid())
+		return;
+
+	int32 count = fTiles.CountItems();
+	for (int32 i = 0; i < count; i++) {
+		tile* t = (tile*)fTiles.ItemAtFast(i);
+		if (t->valid && TileFrame(t->column, t->row).Intersects(rect))
+			t->valid = false;
+	}
+}
+
+// MakeEmpty
+//
+// Marks all tiles dirty, the bitmaps are kept for recycling.
+void
+TimelineTileCache::MakeEmpty()
+{
+	int32 count = fTiles.CountItems();
+	for (int32 i = 0; i < count; i++)
+		((tile*)fTiles.ItemAtFast(i))->valid = false;
+}
+
+// TileFrame
+BRect
+TimelineTileCache::TileFrame(int32 column, int32 row) const
+{
+	BRect frame(0, 0, TILE_SIZE - 1, TILE_SIZE - 1);
+	frame.OffsetBy(column * TILE_SIZE, row * TILE_SIZE);
+	return frame;
+}
+
+// GetTileRange
+void
+TimelineTileCache::GetTileRange(BRect rect, int32* firstColumn,
+	int32* firstRow, int32* lastColumn, int32* lastRow) const
+{
+	*firstColumn = (int32)floorf(rect.left / TILE_SIZE);
+	*firstRow = (int32)floorf(rect.top / TILE_SIZE);
+	*lastColumn = (int32)floorf(rect.right / TILE_SIZE);
+	*lastRow = (int32)floorf(rect.bottom / TILE_SIZE);
+}
+
+// TileAt
+BBitmap*
+TimelineTileCache::TileAt(int32 column, int32 row, bool* _valid)
+{
+	tile* t = _FindTile(column, row);
+	if (!t) {
+		t = _RecycleTile();
+		if (!t)
+			return NULL;
+		t->column = column;
+		t->row = row;
+		t->valid = false;
+	}
+
+	t->lastUsed = ++fUsageCounter;
+	*_valid = t->valid;
+	if (t->valid)
+		fReusedTiles++;
+
+	return t->bitmap;
+}
+
+// SetTileValid
+void
+TimelineTileCache::SetTileValid(int32 column, int32 row)
+{
+	tile* t = _FindTile(column, row);
+	if (t) {
+		t->valid = true;
+		fRenderedTiles++;
+	}
+}
+
+// GetStatistics
+void
+TimelineTileCache::GetStatistics(int64* renderedTiles,
+	int64* reusedTiles) const
+{
+	*renderedTiles = fRenderedTiles;
+	*reusedTiles = fReusedTiles;
+}
+
+// #pragma mark -
+
+// _FindTile
+TimelineTileCache::tile*
+TimelineTileCache::_FindTile(int32 column, int32 row) const
+{
+	int32 count = fTiles.CountItems();
+	for (int32 i = 0; i < count; i++) {
+		tile* t = (tile*)fTiles.ItemAtFast(i);
+		if (t->column == column && t->row == row)
+			return t;
+	}
+	return NULL;
+}
+
+// _RecycleTile
+//
+// Returns a new tile, or the least recently used one if there are
+// already enough.
+TimelineTileCache::tile*
+TimelineTileCache::_RecycleTile()
+{
+	int32 count = fTiles.CountItems();
+	if (count >= fMaxTiles) {
+		tile* oldest = NULL;
+		for (int32 i = 0; i < count; i++) {
+			tile* t = (tile*)fTiles.ItemAtFast(i);
+			if (!oldest || t->lastUsed < oldest->lastUsed)
+				oldest = t;
+		}
+		return oldest;
+	}
+
+	tile* t = new (nothrow) tile;
+	if (!t)
+		return NULL;
+
+	BRect bounds(0, 0, TILE_SIZE - 1, TILE_SIZE - 1);
+	t->bitmap = new (nothrow) BBitmap(bounds, B_RGB32, true);
+	if (!t->bitmap || !t->bitmap->IsValid()) {
+		fprintf(stderr, "TimelineTileCache::_RecycleTile() - "
+			"failed to allocate bitmap\n");
+		delete t;
+		return NULL;
+	}
+
+	BView* view = new (nothrow) BView(bounds, "tile", B_FOLLOW_NONE,
+		B_WILL_DRAW);
+	if (!view || !fTiles.AddItem(t)) {
+		delete view;
+		delete t;
+		return NULL;
+	}
+	t->bitmap->AddChild(view);
+
+	return t;
+}
+
+// _Trim
+//
+// Deletes the least recently used tiles which exceed the maximum.
+void
+TimelineTileCache::_Trim()
+{
+	while (fTiles.CountItems() > fMaxTiles) {
+		int32 count = fTiles.CountItems();
+		int32 oldest = 0;
+		for (int32 i = 1; i < count; i++) {
+			if (((tile*)fTiles.ItemAtFast(i))->lastUsed
+				< ((tile*)fTiles.ItemAtFast(oldest))->lastUsed) {
+				oldest = i;
+			}
+		}
+		delete (tile*)fTiles.RemoveItem(oldest);
+	}
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+// The TimelineTileCache keeps the drawing of the TimelineView items in
+// off-screen bitmaps of TILE_SIZE x TILE_SIZE pixels. The tiles are aligned
+// to the view coordinate system, which includes the scrolling offset, so
+// the tiles don't move when the view is scrolled. They are valid for one
+// zoom level, and they are marked dirty when the view invalidates the items
+// drawn in them. There are enough tiles to cover the visible part of the
+// view, the bitmaps of the least recently used tiles are recycled.
+
+#ifndef TIMELINE_TILE_CACHE_H
+#define TIMELINE_TILE_CACHE_H
+
+#include <List.h>
+#include <Rect.h>
+
+class BBitmap;
+
+class TimelineTileCache {
+ public:
+								TimelineTileCache();
+								~TimelineTileCache();
+
+			enum {
+				TILE_SIZE		= 256,
+				MIN_TILES		= 64
+			};
+
+			// drops all tiles, if the zoom level is different
+			void				SetZoomLevel(double zoomLevel);
+			void				SetVisibleSize(float width, float height);
+
+			void				Invalidate(BRect rect);
+			void				MakeEmpty();
+
+			BRect				TileFrame(int32 column, int32 row) const;
+			void				GetTileRange(BRect rect,
+									int32* firstColumn, int32* firstRow,
+									int32* lastColumn, int32* lastRow) const;
+
+			// Returns the bitmap of the tile, which has a BView attached
+			// to render into. If _valid is false, the tile needs to be
+			// rendered and SetTileValid() called afterwards.
+			BBitmap*			TileAt(int32 column, int32 row, bool* _valid);
+			void				SetTileValid(int32 column, int32 row);
+
+			void				GetStatistics(int64* renderedTiles,
+									int64* reusedTiles) const;
+
+ private:
+			struct tile;
+
+			tile*				_FindTile(int32 column, int32 row) const;
+			tile*				_RecycleTile();
+			void				_Trim();
+
+			BList				fTiles;
+			int32				fMaxTiles;
+			double				fZoomLevel;
+			uint32				fUsageCounter;
+
+			int64				fRenderedTiles;
+			int64				fReusedTiles;
+};
+
+#endif // TIMELINE_TILE_CACHE_H
@@ -9,6 +9,7 @@
 #include <stdio.h>
 
 #include <Autolock.h>
+#include <Bitmap.h>
 #include <Clipboard.h>
 #include <MenuItem.h>
 #include <Message.h>
@@ -22,6 +23,7 @@
 #include "support.h"
 #include "support_ui.h"
 
+#include "ClipPlaylistItem.h"
 #include "CloseGapCommand.h"
 #include "CompoundCommand.h"
 #include "CurrentFrame.h"
@@ -47,11 +49,15 @@
 #include "SetVideoMutedCommand.h"
 #include "TimelineMessages.h"
 #include "TimelineTool.h"
+#include "ThumbnailCache.h"
 #include "TimeView.h"
 #include "TrackView.h"
+#include "WaveformCache.h"
 
 using std::nothrow;
 
+//#define TRACE_TIMELINE_DRAWING
+
 enum {
 	MSG_CLOSE_GAP		= 'clgp'
 };
@@ -84,6 +90,11 @@ TimelineView::TimelineView(const char* name)
 
 	, fTimeView(NULL)
 	, fTrackView(NULL)
+
+	, fTileCache()
+	, fDrawCount(0)
+	, fDrawTime(0)
+	, fMaxDrawTime(0)
 {
 }
 
@@ -122,6 +133,7 @@ TimelineView::AttachedToWindow()
 	MakeFocus();
 
 	SetDataRect(_TimelineRect());
+	fTileCache.SetVisibleSize(Bounds().Width(), Bounds().Height());
 }
 
 // DetachedFromWindow
@@ -130,6 +142,17 @@ TimelineView::DetachedFromWindow()
 {
 	SetState(NULL);
 
+#ifdef TRACE_TIMELINE_DRAWING
+	if (fDrawCount > 0) {
+		int64 renderedTiles;
+		int64 reusedTiles;
+		fTileCache.GetStatistics(&renderedTiles, &reusedTiles);
+		printf("TimelineView: %lld draws, average %lld us, max %lld us, "
+			"%lld tiles rendered, %lld reused\n", fDrawCount,
+			fDrawTime / fDrawCount, fMaxDrawTime, renderedTiles, reusedTiles);
+	}
+#endif
+
 	StateView::DetachedFromWindow();
 }
 
@@ -198,6 +221,12 @@ TimelineView::MessageReceived(BMessage* message)
 			_SetZoom(_NetZoomInLevel(fZoomLevel));
 			break;
 
+		case MSG_WAVEFORM_READY:
+		case MSG_THUMBNAILS_READY:
+			// the waveform or thumbnails of one of the clips are ready
+			_InvalidateAllContent();
+			break;
+
 		default:
 			StateView::MessageReceived(message);
 			break;
@@ -227,10 +256,17 @@ TimelineView::MouseUp(BPoint where)
 void
 TimelineView::Draw(BRect updateRect)
 {
-	SetDrawingMode(B_OP_COPY);
-	FillRect(updateRect, B_SOLID_LOW);
+	bigtime_t startTime = system_time();
+
+	_DrawContent(updateRect);
 
-	StateView::Draw(updateRect);
+	// the drop indication and the current frame marker are drawn on top
+	// of the cached items, moving them does not draw any items
+	if (fDropAnticipatingState && (!fLocker || fLocker->ReadLock())) {
+		fDropAnticipatingState->Draw(this, updateRect);
+		if (fLocker)
+			fLocker->ReadUnlock();
+	}
 
 	// current frame marker
 	SetDrawingMode(B_OP_ALPHA);
@@ -238,6 +274,12 @@ TimelineView::Draw(BRect updateRect)
 	SetHighColor(0, 200, 0, 120);
 	BRect r = _CurrentFrameMarkerRect();
 	StrokeLine(r.LeftTop(), r.LeftBottom());
+
+	bigtime_t drawTime = system_time() - startTime;
+	fDrawCount++;
+	fDrawTime += drawTime;
+	if (drawTime > fMaxDrawTime)
+		fMaxDrawTime = drawTime;
 }
 
 // NothingClicked
@@ -286,6 +328,15 @@ TimelineView::_HandleKeyDown(const KeyEvent& event, BHandler* originalTarget)
 	bool handled = true;
 
 	switch (event.key) {
+#ifdef TIMELINE_BENCHMARK
+		case 'B':
+			if (isFocus)
+				_RunBenchmark();
+			else
+				handled = false;
+			break;
+#endif
+
 		case 'x':
 			if (isFocus)
 				CutSelectedItems();
@@ -477,7 +528,7 @@ TimelineView::ItemAdded(::Playlist* playlist, PlaylistItem* item, int32 index)
 			print_error("TimelineView::_MakeManipulators() - "
 				"unable to add manipulator\n");
 		} else {
-			Invalidate(manipulator->Bounds());
+			InvalidateContent(manipulator->Bounds());
 		}
 	}
 
@@ -497,7 +548,7 @@ TimelineView::ItemRemoved(::Playlist* playlist, PlaylistItem* item)
 			(PlaylistItemManipulator*)fDefaultState->ManipulatorAtFast(i);
 		if (manipulator->Item() == item
 			&& fDefaultState->RemoveManipulator(i) == manipulator) {
-			Invalidate(manipulator->Bounds());
+			InvalidateContent(manipulator->Bounds());
 			delete manipulator;
 			break;
 		}
@@ -603,10 +654,20 @@ TimelineView::VisibleSizeChanged(float oldWidth, float oldHeight,
 		int64 lastFrame = FrameForPos(Bounds().right);
 		fDisplayRange->SetLastFrame(lastFrame);
 	}
+	fTileCache.SetVisibleSize(newWidth, newHeight);
 }
 
 // #pragma mark -
 
+// InvalidateContent
+void
+TimelineView::InvalidateContent(BRect rect)
+{
+	// invalidate the cached tiles even if they are not visible
+	fTileCache.Invalidate(rect);
+	Invalidate(rect);
+}
+
 // StateForDragMessage
 ViewState*
 TimelineView::StateForDragMessage(const BMessage* dragMessage)
@@ -669,7 +730,7 @@ TimelineView::SetCurrentFrame(::CurrentFrame* frame)
 
 // SetDisplayRange
 void
-TimelineView::SetDisplayRange(DisplayRange* range)
+TimelineView::SetDisplayRange(::DisplayRange* range)
 {
 	if (fDisplayRange != range) {
 		if (fDisplayRange)
@@ -1060,7 +1121,7 @@ TimelineView::_MakeManipulators()
 {
 	_DeleteManipulators();
 
-	Invalidate();
+	_InvalidateAllContent();
 
 	if (!fPlaylist | !fTool)
 		return;
@@ -1102,9 +1163,101 @@ TimelineView::_InvalidateManipulators()
 	if (fLocker)
 		fLocker->ReadUnlock();
 
+	_InvalidateAllContent();
+}
+
+// _InvalidateAllContent
+void
+TimelineView::_InvalidateAllContent()
+{
+	fTileCache.MakeEmpty();
 	Invalidate();
 }
 
+// _DrawContent
+//
+// Draws the items from the tile cache, rendering the tiles which are
+// missing or have been invalidated.
+void
+TimelineView::_DrawContent(BRect updateRect)
+{
+	SetDrawingMode(B_OP_COPY);
+
+	if (fLocker && !fLocker->ReadLock()) {
+		FillRect(updateRect, B_SOLID_LOW);
+		return;
+	}
+
+	fTileCache.SetZoomLevel(fZoomLevel);
+
+	int32 firstColumn;
+	int32 firstRow;
+	int32 lastColumn;
+	int32 lastRow;
+	fTileCache.GetTileRange(updateRect, &firstColumn, &firstRow,
+		&lastColumn, &lastRow);
+
+	for (int32 row = firstRow; row <= lastRow; row++) {
+		for (int32 column = firstColumn; column <= lastColumn; column++) {
+			BRect frame = fTileCache.TileFrame(column, row);
+			BRect dirty = frame & updateRect;
+
+			bool valid;
+			BBitmap* bitmap = fTileCache.TileAt(column, row, &valid);
+			if (!bitmap) {
+				// no memory for the tile, draw directly
+				PushState();
+				FillRect(dirty, B_SOLID_LOW);
+				if (fCurrentState)
+					fCurrentState->Draw(this, dirty);
+				PopState();
+				continue;
+			}
+
+			if (!valid) {
+				_RenderTile(bitmap, frame);
+				fTileCache.SetTileValid(column, row);
+			}
+
+			DrawBitmap(bitmap, dirty.OffsetByCopy(-frame.left, -frame.top),
+				dirty);
+		}
+	}
+
+	if (fLocker)
+		fLocker->ReadUnlock();
+}
+
+// _RenderTile
+void
+TimelineView::_RenderTile(BBitmap* bitmap, BRect frame)
+{
+	if (!bitmap->Lock())
+		return;
+
+	BView* view = bitmap->ChildAt(0);
+
+	BFont font;
+	GetFont(&font);
+	view->SetFont(&font);
+
+	view->PushState();
+
+	// the tile is at the frame in our coordinate system
+	view->SetOrigin(-frame.left, -frame.top);
+	view->SetDrawingMode(B_OP_COPY);
+	view->SetLowColor(LowColor());
+	view->FillRect(frame, B_SOLID_LOW);
+
+	if (fCurrentState)
+		fCurrentState->Draw(view, frame);
+
+	view->PopState();
+	view->Sync();
+
+	bitmap->Unlock();
+}
+
 // _CurrentFrameMarkerRect
 BRect
 TimelineView::_CurrentFrameMarkerRect() const
@@ -1217,6 +1370,155 @@ TimelineView::_NetZoomInLevel(double zoom) const
 	return 0.075;
 }
 
+#ifdef TIMELINE_BENCHMARK
+
+static const int32 kBenchmarkItemCount = 10000;
+static const uint32 kBenchmarkTrackCount = 4;
+static const uint64 kBenchmarkItemDuration = 250;
+static const int32 kBenchmarkZoomSteps = 8;
+
+// BenchmarkTimes
+struct BenchmarkTimes {
+	BenchmarkTimes()
+		: count(0)
+		, total(0)
+		, max(0)
+	{
+	}
+
+	void Add(bigtime_t time)
+	{
+		count++;
+		total += time;
+		if (time > max)
+			max = time;
+	}
+
+	void Print(const char* name) const
+	{
+		if (count > 0) {
+			printf("  %-12s %4ld frames, average %6lld us, max %6lld us\n",
+				name, count, total / count, max);
+		}
+	}
+
+	int32		count;
+	bigtime_t	total;
+	bigtime_t	max;
+};
+
+// _RunBenchmark
+//
+// Temporarily shows a playlist of 10000 items using the clip of the first
+// item of the current playlist. It is scrolled through in steps of a
+// quarter of the view width, forth and back, then zoomed in and out in
+// steps. Each step is drawn synchronously and timed, so the times include
+// blitting the tiles as well as rendering the newly exposed ones.
+void
+TimelineView::_RunBenchmark()
+{
+	ClipPlaylistItem* firstItem = fPlaylist && fPlaylist->CountItems() > 0
+		? dynamic_cast<ClipPlaylistItem*>(fPlaylist->ItemAtFast(0)) : NULL;
+	if (!firstItem || !firstItem->Clip()) {
+		printf("TimelineView::_RunBenchmark() - the playlist needs to start "
+			"with a clip item\n");
+		return;
+	}
+
+	::Playlist* playlist = new (nothrow) ::Playlist();
+	if (!playlist)
+		return;
+	for (int32 i = 0; i < kBenchmarkItemCount; i++) {
+		ClipPlaylistItem* item = new (nothrow) ClipPlaylistItem(
+			firstItem->Clip(), (i / kBenchmarkTrackCount)
+				* kBenchmarkItemDuration, i % kBenchmarkTrackCount);
+		if (!item || !playlist->AddItem(item)) {
+			delete item;
+			playlist->Release();
+			return;
+		}
+		item->SetDuration(kBenchmarkItemDuration);
+	}
+
+	::Playlist* oldPlaylist = fPlaylist;
+	oldPlaylist->Acquire();
+	double oldZoomLevel = fZoomLevel;
+	BPoint oldScrollOffset = ScrollOffset();
+	if (fSelection)
+		fSelection->DeselectAll();
+
+	int64 oldDrawCount = fDrawCount;
+	int64 oldRenderedTiles;
+	int64 oldReusedTiles;
+	fTileCache.GetStatistics(&oldRenderedTiles, &oldReusedTiles);
+
+	SetPlaylist(playlist);
+	SetScrollOffset(BPoint(0, oldScrollOffset.y));
+	Window()->UpdateIfNeeded();
+
+	BenchmarkTimes scrollForward;
+	BenchmarkTimes scrollBackward;
+	BenchmarkTimes zoomIn;
+	BenchmarkTimes zoomOut;
+
+	float step = max_c(1.0, floorf(Bounds().Width() / 4));
+	float right = DataRect().right - Bounds().Width();
+	for (float x = step; x <= right; x += step) {
+		bigtime_t startTime = system_time();
+		SetScrollOffset(BPoint(x, ScrollOffset().y));
+		Window()->UpdateIfNeeded();
+		Sync();
+		scrollForward.Add(system_time() - startTime);
+	}
+	for (float x = ScrollOffset().x - step; x >= 0; x -= step) {
+		bigtime_t startTime = system_time();
+		SetScrollOffset(BPoint(x, ScrollOffset().y));
+		Window()->UpdateIfNeeded();
+		Sync();
+		scrollBackward.Add(system_time() - startTime);
+	}
+
+	SetScrollOffset(BPoint(floorf(right / 2), ScrollOffset().y));
+	Window()->UpdateIfNeeded();
+	for (int32 i = 0; i < kBenchmarkZoomSteps; i++) {
+		bigtime_t startTime = system_time();
+		_SetZoom(_NetZoomInLevel(fZoomLevel));
+		Window()->UpdateIfNeeded();
+		Sync();
+		zoomIn.Add(system_time() - startTime);
+	}
+	for (int32 i = 0; i < 2 * kBenchmarkZoomSteps; i++) {
+		bigtime_t startTime = system_time();
+		_SetZoom(_NetZoomOutLevel(fZoomLevel));
+		Window()->UpdateIfNeeded();
+		Sync();
+		zoomOut.Add(system_time() - startTime);
+	}
+
+	int64 renderedTiles;
+	int64 reusedTiles;
+	fTileCache.GetStatistics(&renderedTiles, &reusedTiles);
+
+	printf("TimelineView: %ld items on %lu tracks, %.0fx%.0f pixels\n",
+		kBenchmarkItemCount, kBenchmarkTrackCount, Bounds().Width() + 1,
+		Bounds().Height() + 1);
+	scrollForward.Print("scroll right");
+	scrollBackward.Print("scroll left");
+	zoomIn.Print("zoom in");
+	zoomOut.Print("zoom out");
+	printf("  %lld draws, %lld tiles rendered, %lld reused\n",
+		fDrawCount - oldDrawCount, renderedTiles - oldRenderedTiles,
+		reusedTiles - oldReusedTiles);
+
+	SetPlaylist(oldPlaylist);
+	_SetZoom(oldZoomLevel);
+	SetScrollOffset(oldScrollOffset);
+	oldPlaylist->Release();
+	playlist->Release();
+}
+
+#endif // TIMELINE_BENCHMARK
+
 // _SetZoom
 void
 TimelineView::_SetZoom(float zoomLevel)
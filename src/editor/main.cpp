@@ -5,16 +5,27 @@
  */
 
 //#include <cryptlib.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 //#include "AllocationChecker.h"
 //#include "common_constants.h"
 //#include "common_logging.h"
+#include "ContentHasher.h"
+#include "DecodedAudioCache.h"
+#include "DecodedImageCache.h"
 #include "EditorApp.h"
 #include "EventQueue.h"
 #include "FontManager.h"
+#include "LoudnessAnalyzer.h"
+#include "Observable.h"
+#include "RenderedFrameCache.h"
+#include "ThumbnailCache.h"
+#include "WaveformCache.h"
 //#include "XMLSupport.h"
 
+#define PRINT_STATISTICS 0
+
 // main
 int
 main(int argc, char** argv)
@@ -24,6 +35,13 @@ main(int argc, char** argv)
 //	AllocationChecker::CreateDefault(true);
 	EventQueue::CreateDefault();
 	FontManager::CreateDefault();
+	WaveformCache::CreateDefault();
+	ThumbnailCache::CreateDefault();
+	DecodedImageCache::CreateDefault();
+	DecodedAudioCache::CreateDefault();
+	RenderedFrameCache::CreateDefault();
+	LoudnessAnalyzer::CreateDefault();
+	ContentHasher::CreateDefault();
 
 	// init cryptlib
 //	if (cryptInit() != CRYPT_OK) {
@@ -43,7 +61,21 @@ main(int argc, char** argv)
 
 //	cryptEnd();
 
+	ContentHasher::DeleteDefault();
+	LoudnessAnalyzer::DeleteDefault();
+	RenderedFrameCache::DeleteDefault();
+	DecodedAudioCache::DeleteDefault();
+	DecodedImageCache::DeleteDefault();
+	ThumbnailCache::DeleteDefault();
+	WaveformCache::DeleteDefault();
 	FontManager::DeleteDefault();
+#if PRINT_STATISTICS
+	int64 delivered;
+	int64 coalesced;
+	Observable::GetNotificationStatistics(&delivered, &coalesced);
+	printf("Observable: %lld notifications delivered, %lld coalesced\n",
+		delivered, coalesced);
+#endif
 	EventQueue::DeleteDefault();
 //	AllocationChecker::DeleteDefault();
 
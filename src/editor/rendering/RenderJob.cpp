@@ -5,6 +5,7 @@
 
 #include "RenderJob.h"
 
+#include <new>
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
@@ -28,10 +29,13 @@
 #include "Playlist.h"
 #include "PlaylistAudioReader.h"
 #include "PlaylistRenderer.h"
+#include "RenderPipeline.h"
 #include "RenderPreset.h"
 #include "RenderWindow.h"
 #include "TimeCodeOverlay.h"
 
+using std::nothrow;
+
 // debugging
 #include "Debug.h"
 #define ldebug debug
@@ -70,6 +74,7 @@ RenderJob::RenderJob(BWindow* window, const char* docName,
 	BLooper("RenderJob", 8),
 	fPlaylist(playlist),
 	fRenderer(NULL),
+	fPipeline(NULL),
 	fAudioReader(NULL),
 	fTCOverlay(NULL),
 	fWidth(preset->LineWidth()),
@@ -94,6 +99,8 @@ RenderJob::RenderJob(BWindow* window, const char* docName,
 	fEndFrame(endFrame),
 	fCurrentVideoFrame(fStartFrame),
 	fVideoFrameForAudioPos(fStartFrame),
+	fFramesPassedThrough(0),
+	fFramesEncoded(0),
 	fAudioPos(0),
 	fStartTime(system_time()),
 	fPauseStartTime(0),
@@ -195,7 +202,18 @@ RenderJob::RenderJob(BWindow* window, const char* docName,
 					fprintf(stderr, "video codec not found! (%s)\n",
 						preset->VideoCodec().String());
 				}
-				if (videoError != B_OK) {
+				if (videoError == B_OK) {
+					// render the frames ahead on all CPUs, while this
+					// thread encodes and writes them
+					fPipeline = new (nothrow) RenderPipeline(fPlaylist,
+						(uint32)fWidth, (uint32)fHeight, fColorSpace);
+					if (fPipeline && fPipeline->InitCheck() != B_OK) {
+						fprintf(stderr, "error creating render pipeline, "
+							"rendering frames one by one\n");
+						delete fPipeline;
+						fPipeline = NULL;
+					}
+				} else {
 					BString errorMessage("Error creating video track of media "
 						"file:\n\n");
 					errorMessage << strerror(videoError);
@@ -306,6 +324,7 @@ RenderJob::~RenderJob()
 		fRenderWindow->Quit();
 	}
 	delete[] fAudioBuffer;
+	delete fPipeline;
 	delete fRenderer;
 	delete fAudioReader;
 	delete fPlaylist;
@@ -317,6 +336,18 @@ void RenderJob::MessageReceived(BMessage *msg)
 	switch (msg->what) {
 		case MSG_RENDERJOB_GO:
 			fStartTime = system_time();
+			if (fPipeline) {
+				// frames which may be copied from a clip are left
+				// to this thread
+				status_t ret = fPipeline->Start(fCurrentVideoFrame, fEndFrame,
+					fTCOverlay ? NULL : &fVideoCodecInfo);
+				if (ret != B_OK) {
+					fprintf(stderr, "error starting render pipeline: %s\n",
+						strerror(ret));
+					delete fPipeline;
+					fPipeline = NULL;
+				}
+			}
 			PostMessage(MSG_WRITE_FRAME, this);
 			break;
 
@@ -371,6 +402,16 @@ void RenderJob::MessageReceived(BMessage *msg)
 bool
 RenderJob::QuitRequested()
 {
+	int32 videoFrames = fFramesPassedThrough + fFramesEncoded;
+	if (videoFrames > 0) {
+		printf("RenderJob - %ld video frames, %ld copied from clips, "
+			"%ld encoded (%.1f%% copied)\n", videoFrames,
+			fFramesPassedThrough, fFramesEncoded,
+			100.0 * fFramesPassedThrough / videoFrames);
+	}
+	if (fPipeline)
+		fPipeline->PrintStatistics();
+
 	// close the file
 	status_t closeErr = _CloseFile();
 	if (closeErr != B_OK)
@@ -491,24 +532,39 @@ RenderJob::_WriteVideo()
 	if (fCurrentVideoFrame > fEndFrame)
 		return B_OK;
 
-	status_t err;
-	if (fTCOverlay) {
-		bool wasCached;
-		err = fRenderer->RenderFrame(fCurrentVideoFrame, wasCached);
+	status_t err = B_OK;
+	const BBitmap* bitmap = NULL;
+	bool wasCached = false;
+	bool passedThrough = false;
+	if (fPipeline) {
+		// the frame has been rendered ahead, unless
+		// it could be copied from a clip
+		err = fPipeline->GetFrame(fCurrentVideoFrame, &bitmap, &wasCached);
+		if (err == B_NOT_SUPPORTED) {
+			bitmap = NULL;
+			err = B_OK;
+		}
+	}
+
+	if (err == B_OK && fTCOverlay) {
+		if (!bitmap) {
+			err = fRenderer->RenderFrame(fCurrentVideoFrame, wasCached);
+			bitmap = fRenderer->Bitmap();
+		}
 		if (err == B_OK) {
-			BBitmap temp(fRenderer->Bitmap(), B_BITMAP_NO_SERVER_LINK);
+			BBitmap temp(bitmap, B_BITMAP_NO_SERVER_LINK);
 			fTCOverlay->DrawTimeCode(&temp, fCurrentVideoFrame, fFPS);
 			err = _WriteVideo(&temp, false);
 			_UpdateRenderWindow(&temp);
 		}
-	} else {
+	} else if (err == B_OK) {
 		const void* chunkBuffer;
 		size_t chunkSize;
 		bool chunksComplete;
 		int32 chunksWritten = 0;
-		while ((err = fRenderer->GetNextVideoChunk(fCurrentVideoFrame,
-				chunkBuffer, chunkSize, chunksComplete, fVideoCodecInfo))
-				== B_OK) {
+		while (!bitmap && (err = fRenderer->GetNextVideoChunk(
+				fCurrentVideoFrame, chunkBuffer, chunkSize, chunksComplete,
+				fVideoCodecInfo)) == B_OK) {
 			if (chunksComplete) {
 printf("frame %ld - chunks written: %ld\n", fCurrentVideoFrame, chunksWritten);
 				break;
@@ -523,18 +579,19 @@ printf("frame %ld - chunks written: %ld\n", fCurrentVideoFrame, chunksWritten);
 			// TODO: Find a way to update the render window when not
 			// reencoding.
 		}
+		passedThrough = chunksWritten > 0;
 		if (chunksWritten == 0) {
+			if (!bitmap) {
 printf("frame %ld - re-encoded\n", fCurrentVideoFrame);
-			// No chunks could be written non-destructively,
-			// we need to re-encode the video.
-			bool wasCached;
-			err = fRenderer->RenderFrame(fCurrentVideoFrame,
-				wasCached);
-			if (err == B_OK) {
-				err = _WriteVideo(fRenderer->Bitmap(),
-					!wasCached);
+				// No chunks could be written non-destructively,
+				// we need to re-encode the video.
+				err = fRenderer->RenderFrame(fCurrentVideoFrame,
+					wasCached);
+				bitmap = fRenderer->Bitmap();
 			}
-			_UpdateRenderWindow(fRenderer->Bitmap());
+			if (err == B_OK)
+				err = _WriteVideo(bitmap, !wasCached);
+			_UpdateRenderWindow(bitmap);
 		}
 	}
 
@@ -547,12 +604,18 @@ printf("frame %ld - re-encoded\n", fCurrentVideoFrame);
 			B_WIDTH_AS_USUAL, B_EVEN_SPACING,
 			B_STOP_ALERT))->Go();
 		if (ret == 0) {
-			// Try again next time
-			fCurrentVideoFrame--;
-			err = B_OK;
+			// Try again next time, the pipeline keeps
+			// the frame until it is recycled
+			return B_OK;
 		}
 	}
 
+	if (fPipeline)
+		fPipeline->RecycleFrame(fCurrentVideoFrame);
+	if (passedThrough)
+		fFramesPassedThrough++;
+	else
+		fFramesEncoded++;
 	fCurrentVideoFrame++;
 
 	return err;
@@ -21,6 +21,7 @@ class BWindow;
 class Playlist;
 class PlaylistAudioReader;
 class PlaylistRenderer;
+class RenderPipeline;
 class RenderWindow;
 class RenderPreset;
 class TimeCodeOverlay;
@@ -79,6 +80,7 @@ private:
 private:
 			Playlist*			fPlaylist;
 			PlaylistRenderer*	fRenderer;
+			RenderPipeline*		fPipeline;
 			PlaylistAudioReader* fAudioReader;
 			TimeCodeOverlay*	fTCOverlay;
 			float				fWidth;
@@ -108,6 +110,8 @@ private:
 			int32				fEndFrame;
 			int32				fCurrentVideoFrame;
 			int32				fVideoFrameForAudioPos;
+			int32				fFramesPassedThrough;
+			int32				fFramesEncoded;
 			int64				fAudioPos;
 			int64				fAudioEndPos;
 			bigtime_t			fStartTime;
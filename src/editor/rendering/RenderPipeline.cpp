@@ -0,0 +1,337 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+#include "RenderPipeline.h"
+
+#include <new>
+#include <stdio.h>
+#include <string.h>
+
+#include <Bitmap.h>
+
+#include "ClipPlaylistItem.h"
+#include "Playlist.h"
+#include "PlaylistRenderer.h"
+#include "ScrollingTextClip.h"
+
+using std::nothrow;
+
+enum {
+	MAX_NESTING_LEVEL	= 16
+};
+
+// uses_scrolling_text
+static bool
+uses_scrolling_text(const Playlist* playlist, int32 level)
+{
+	if (level > MAX_NESTING_LEVEL)
+		return false;
+
+	int32 count = playlist->CountItems();
+	for (int32 i = 0; i < count; i++) {
+		ClipPlaylistItem* item
+			= dynamic_cast<ClipPlaylistItem*>(playlist->ItemAtFast(i));
+		if (!item || !item->Clip())
+			continue;
+		if (dynamic_cast<ScrollingTextClip*>(item->Clip()))
+			return true;
+		if (Playlist* subPlaylist = dynamic_cast<Playlist*>(item->Clip())) {
+			if (uses_scrolling_text(subPlaylist, level + 1))
+				return true;
+		}
+	}
+	return false;
+}
+
+// constructor
+RenderPipeline::RenderPipeline(const Playlist* playlist, uint32 width,
+		uint32 height, color_space format, int32 workerCount)
+	:
+	fWorkers(NULL),
+	fWorkerCount(0),
+	fSlots(NULL),
+	fSlotCount(0),
+	fFreeSlots(-1),
+	fNextFrame(0),
+	fEndFrame(-1),
+	fFetchedFrame(-1),
+	fPassThrough(false),
+	fQuitting(false),
+	fRenderedFrames(0),
+	fRenderTime(0),
+	fStartTime(0),
+	fFinishTime(0),
+	fStatus(B_NO_INIT)
+{
+	if (workerCount <= 0) {
+		system_info info;
+		get_system_info(&info);
+		workerCount = info.cpu_count;
+	}
+
+	// A scrolling text continues where the renderer of the previous
+	// item of the same clip left off, which is only defined when
+	// the frames are rendered in order.
+	if (uses_scrolling_text(playlist, 0))
+		workerCount = 1;
+
+	// each worker renders its own copy of the playlist
+	fWorkers = new (nothrow) Worker[workerCount];
+	if (!fWorkers) {
+		fStatus = B_NO_MEMORY;
+		return;
+	}
+	for (int32 i = 0; i < workerCount; i++) {
+		Worker& worker = fWorkers[i];
+		worker.pipeline = this;
+		worker.thread = -1;
+		worker.renderer = NULL;
+		worker.playlist = new (nothrow) Playlist(*playlist, true);
+		if (worker.playlist) {
+			worker.playlist->StopObservingClips();
+			worker.renderer = new (nothrow) PlaylistRenderer(worker.playlist,
+				width, height, 0, format);
+		}
+		fWorkerCount++;
+		if (!worker.renderer || !worker.renderer->IsValid()) {
+			fStatus = B_NO_MEMORY;
+			return;
+		}
+	}
+
+	// enough slots that the workers don't need to wait for
+	// each other when one frame takes longer to render
+	int32 slotCount = workerCount * 2;
+	fSlots = new (nothrow) Slot[slotCount];
+	if (!fSlots) {
+		fStatus = B_NO_MEMORY;
+		return;
+	}
+	for (int32 i = 0; i < slotCount; i++) {
+		Slot& slot = fSlots[i];
+		slot.ready = -1;
+		slot.status = B_NO_INIT;
+		slot.wasCached = false;
+		slot.bitmap = new (nothrow) BBitmap(BRect(0, 0, width - 1,
+			height - 1), format);
+		fSlotCount++;
+		if (!slot.bitmap || !slot.bitmap->IsValid()) {
+			fStatus = B_NO_MEMORY;
+			return;
+		}
+	}
+
+	fStatus = B_OK;
+}
+
+// destructor
+RenderPipeline::~RenderPipeline()
+{
+	Stop();
+
+	for (int32 i = 0; i < fWorkerCount; i++) {
+		delete fWorkers[i].renderer;
+		if (fWorkers[i].playlist)
+			fWorkers[i].playlist->Release();
+	}
+	delete[] fWorkers;
+
+	for (int32 i = 0; i < fSlotCount; i++)
+		delete fSlots[i].bitmap;
+	delete[] fSlots;
+}
+
+// InitCheck
+status_t
+RenderPipeline::InitCheck() const
+{
+	return fStatus;
+}
+
+// Start
+status_t
+RenderPipeline::Start(int32 startFrame, int32 endFrame,
+	const media_codec_info* passThroughCodec)
+{
+	if (fStatus < B_OK)
+		return fStatus;
+
+	Stop();
+
+	fNextFrame = startFrame;
+	fEndFrame = endFrame;
+	fFetchedFrame = -1;
+	fPassThrough = passThroughCodec != NULL;
+	if (passThroughCodec)
+		fPassThroughCodec = *passThroughCodec;
+	fQuitting = false;
+
+	fRenderedFrames = 0;
+	fRenderTime = 0;
+	fStartTime = system_time();
+	fFinishTime = 0;
+
+	fFreeSlots = create_sem(fSlotCount, "render pipeline free slots");
+	if (fFreeSlots < B_OK)
+		return fFreeSlots;
+	for (int32 i = 0; i < fSlotCount; i++) {
+		fSlots[i].ready = create_sem(0, "render pipeline frame ready");
+		if (fSlots[i].ready < B_OK) {
+			status_t ret = fSlots[i].ready;
+			Stop();
+			return ret;
+		}
+	}
+
+	for (int32 i = 0; i < fWorkerCount; i++) {
+		fWorkers[i].thread = spawn_thread(_WorkerEntry, "render worker",
+			B_NORMAL_PRIORITY, &fWorkers[i]);
+		if (fWorkers[i].thread < B_OK) {
+			status_t ret = fWorkers[i].thread;
+			Stop();
+			return ret;
+		}
+		resume_thread(fWorkers[i].thread);
+	}
+
+	return B_OK;
+}
+
+// Stop
+void
+RenderPipeline::Stop()
+{
+	// deleting the semaphores wakes up the workers
+	fQuitting = true;
+	if (fFreeSlots >= B_OK)
+		delete_sem(fFreeSlots);
+	fFreeSlots = -1;
+
+	for (int32 i = 0; i < fWorkerCount; i++) {
+		if (fWorkers[i].thread >= B_OK) {
+			status_t dummy;
+			wait_for_thread(fWorkers[i].thread, &dummy);
+		}
+		fWorkers[i].thread = -1;
+	}
+
+	for (int32 i = 0; i < fSlotCount; i++) {
+		if (fSlots[i].ready >= B_OK)
+			delete_sem(fSlots[i].ready);
+		fSlots[i].ready = -1;
+	}
+}
+
+// GetFrame
+status_t
+RenderPipeline::GetFrame(int32 frame, const BBitmap** bitmap,
+	bool* wasCached)
+{
+	if (fFreeSlots < B_OK)
+		return B_NO_INIT;
+
+	Slot* slot = _SlotFor(frame);
+	if (fFetchedFrame != frame) {
+		if (fFetchedFrame >= 0 || frame > fEndFrame)
+			return B_BAD_VALUE;
+
+		status_t ret;
+		do {
+			ret = acquire_sem(slot->ready);
+		} while (ret == B_INTERRUPTED);
+		if (ret < B_OK)
+			return ret;
+
+		fFetchedFrame = frame;
+		if (frame == fEndFrame)
+			fFinishTime = system_time();
+	}
+
+	*bitmap = slot->bitmap;
+	*wasCached = slot->wasCached;
+	return slot->status;
+}
+
+// RecycleFrame
+void
+RenderPipeline::RecycleFrame(int32 frame)
+{
+	if (fFetchedFrame != frame)
+		return;
+
+	fFetchedFrame = -1;
+	release_sem(fFreeSlots);
+}
+
+// PrintStatistics
+void
+RenderPipeline::PrintStatistics() const
+{
+	if (fRenderedFrames == 0 || fFinishTime <= fStartTime)
+		return;
+
+	// the time all workers spent rendering, compared to how long it
+	// took until the last frame was done, is how much faster rendering
+	// was than on a single thread
+	bigtime_t elapsed = fFinishTime - fStartTime;
+	printf("RenderPipeline - %ld workers rendered %ld frames in %lld ms, "
+		"%lld ms of rendering (%.2fx the speed of one worker)\n",
+		fWorkerCount, fRenderedFrames, elapsed / 1000, fRenderTime / 1000,
+		(double)fRenderTime / elapsed);
+}
+
+// #pragma mark -
+
+// _WorkerEntry
+int32
+RenderPipeline::_WorkerEntry(void* cookie)
+{
+	Worker* worker = (Worker*)cookie;
+	return worker->pipeline->_Render(worker);
+}
+
+// _Render
+int32
+RenderPipeline::_Render(Worker* worker)
+{
+	while (!fQuitting) {
+		status_t ret = acquire_sem(fFreeSlots);
+		if (ret == B_INTERRUPTED)
+			continue;
+		if (ret < B_OK)
+			break;
+
+		// Since no more frames are taken than there are free slots, the
+		// slot of the frame has been recycled by the time it is taken.
+		int32 frame = atomic_add(&fNextFrame, 1);
+		if (frame > fEndFrame) {
+			release_sem(fFreeSlots);
+			break;
+		}
+
+		Slot* slot = _SlotFor(frame);
+		PlaylistRenderer* renderer = worker->renderer;
+		if (fPassThrough && renderer->CanPassThrough(frame,
+				fPassThroughCodec)) {
+			slot->status = B_NOT_SUPPORTED;
+			slot->wasCached = false;
+		} else {
+			bool wasCached;
+			bigtime_t startTime = system_time();
+			slot->status = renderer->RenderFrame(frame, wasCached);
+			atomic_add64(&fRenderTime, system_time() - startTime);
+			atomic_add(&fRenderedFrames, 1);
+			slot->wasCached = wasCached;
+			if (slot->status == B_OK) {
+				memcpy(slot->bitmap->Bits(), renderer->Bitmap()->Bits(),
+					slot->bitmap->BitsLength());
+			}
+		}
+
+		release_sem(slot->ready);
+	}
+
+	return B_OK;
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+#ifndef RENDER_PIPELINE_H
+#define RENDER_PIPELINE_H
+
+#include <GraphicsDefs.h>
+#include <MediaDefs.h>
+#include <MediaFormats.h>
+#include <OS.h>
+
+class BBitmap;
+class Playlist;
+class PlaylistRenderer;
+
+// RenderPipeline
+//
+// Renders the frames of an export ahead of the thread which encodes and
+// writes them. Each worker renders its own copy of the playlist and takes
+// the next frame as soon as it is done with the previous one, so frames
+// are finished out of order. They are put into a ring of slots indexed by
+// the frame number, from which they are fetched in order. No more frames
+// are rendered ahead than there are slots. Playlists with scrolling text
+// are rendered by a single worker.
+class RenderPipeline {
+public:
+								RenderPipeline(const Playlist* playlist,
+									uint32 width, uint32 height,
+									color_space format,
+									int32 workerCount = 0);
+	virtual						~RenderPipeline();
+
+			status_t			InitCheck() const;
+
+								// If a codec is given, frames which could be
+								// copied from a clip are not rendered.
+			status_t			Start(int32 startFrame, int32 endFrame,
+									const media_codec_info* passThroughCodec
+										= NULL);
+			void				Stop();
+
+								// Blocks until the frame is rendered, frames
+								// need to be fetched in order. The same frame
+								// can be fetched again until it is recycled.
+								// Returns B_NOT_SUPPORTED for a frame which
+								// has been left for passing through.
+			status_t			GetFrame(int32 frame,
+									const BBitmap** bitmap,
+									bool* wasCached);
+			void				RecycleFrame(int32 frame);
+
+			int32				CountWorkers() const
+									{ return fWorkerCount; }
+			void				PrintStatistics() const;
+
+private:
+			struct Slot {
+				BBitmap*		bitmap;
+				sem_id			ready;
+				status_t		status;
+				bool			wasCached;
+			};
+
+			struct Worker {
+				RenderPipeline*	pipeline;
+				Playlist*		playlist;
+				PlaylistRenderer* renderer;
+				thread_id		thread;
+			};
+
+	static	int32				_WorkerEntry(void* cookie);
+			int32				_Render(Worker* worker);
+
+			Slot*				_SlotFor(int32 frame) const
+									{ return &fSlots[frame % fSlotCount]; }
+
+			Worker*				fWorkers;
+			int32				fWorkerCount;
+
+			Slot*				fSlots;
+			int32				fSlotCount;
+			sem_id				fFreeSlots;
+
+			vint32				fNextFrame;
+			int32				fEndFrame;
+			int32				fFetchedFrame;
+			bool				fPassThrough;
+			media_codec_info	fPassThroughCodec;
+	volatile bool				fQuitting;
+
+			// statistics
+			vint32				fRenderedFrames;
+			vint64				fRenderTime;
+				// summed up over all workers
+			bigtime_t			fStartTime;
+			bigtime_t			fFinishTime;
+
+			status_t			fStatus;
+};
+
+#endif // RENDER_PIPELINE_H
@@ -85,7 +85,7 @@ DeleteManipulator::_SetMouseInside(bool inside)
 {
 	if (fMouseInsideItem != inside) {
 		fMouseInsideItem = inside;
-		fView->Invalidate(fItemFrame);
+		fView->InvalidateContent(fItemFrame);
 	}
 }
 
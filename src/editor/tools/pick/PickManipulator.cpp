@@ -173,7 +173,8 @@ PickManipulator::_SetTracking(uint32 mode, int64 startDragFrame)
 			fCommand = NULL;
 		}
 		fSnapFrames.CollectSnapFrames(fView->Playlist(),
-									  fItem->Duration());
+									  fItem->Duration(),
+									  fView->DisplayRange());
 		fSnapFrames.AddSnapFrame(0, fItem->Duration());
 		if (fView->IsPaused())
 			fSnapFrames.AddSnapFrame(fView->CurrentFrame(), fItem->Duration());
@@ -192,6 +193,6 @@ PickManipulator::_SetTracking(uint32 mode, int64 startDragFrame)
 				break;
 		}
 
-		fView->Invalidate(fItemFrame);
+		fView->InvalidateContent(fItemFrame);
 	}
 }
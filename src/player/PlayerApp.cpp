@@ -15,6 +15,7 @@
 
 #include "common.h"
 
+#include "AttributeServerObjectManager.h"
 #include "AutoDeleter.h"
 #include "Clip.h"
 #include "ClipObjectFactory.h"
@@ -36,6 +37,10 @@ using std::nothrow;
 
 static const bigtime_t kMonitorPulseRate = 6000000;
 
+// the objects which are not needed by the current schedule are
+// unloaded again once the loaded objects use more memory than this
+static const size_t kResidentObjectMemoryLimit = 128 * 1024 * 1024;
+
 static const char* kMediaServerSig = "application/x-vnd.Be.media-server";
 static const char* kMediaServerAddOnSig = "application/x-vnd.Be.addon-host";
 
@@ -342,7 +347,14 @@ PlayerApp::ReadyToRun()
 
 	print_info("player started\n");
 
-	fObjectLibrary = new ServerObjectManager();
+	// the objects are only loaded when the schedule needs them, the player
+	// never writes to the library
+	AttributeServerObjectManager* library = new AttributeServerObjectManager();
+	library->SetLazyLoading(true);
+	library->SetObjectFactory(fObjectFactory);
+	library->SetIgnoreStateChanges(true);
+	library->SetResidentMemoryLimit(kResidentObjectMemoryLimit);
+	fObjectLibrary = library;
 	fObjectLibrary->SetLocker(fDocument);
 
 	// the navigator needs the library to find playlists for navigation
@@ -544,11 +556,23 @@ PlayerApp::_UpdateLibrary()
 		// error resolving dependencies
 	}
 
+	// load the schedule and the playlists it depends on, so
+	// that their layouts are validated below
+	if (fScheduleID.Length() > 0) {
+		AutoReadLocker locker(fDocument);
+		fObjectLibrary->FindObject(fScheduleID);
+	}
+
 	// post process objects
 	_SyncDisplaySettings();
 	_ValidatePlaylistAndScheduleLayouts();
 
 	OpenSchedule(fScheduleID);
+
+	// unload the objects which the schedule no longer uses
+	AutoWriteLocker locker(fDocument);
+	if (locker.IsLocked())
+		fObjectLibrary->TrimResidentObjects();
 }
 
 // _SyncDisplaySettings
@@ -567,6 +591,7 @@ return;
 	}
 
 	// search for a "DisplaySettings" object
+	fObjectLibrary->LoadObjectsOfType("DisplaySettings");
 	int32 count = fObjectLibrary->CountObjects();
 	DisplaySettings* settings = NULL;
 	for (int32 i = 0; i < count; i++) {
@@ -27,6 +27,7 @@
 #include "PlaybackListener.h"
 #include "Playlist.h"
 #include "PlaylistAudioSupplier.h"
+#include "PlaylistSnapshot.h"
 #include "RenderPlaylist.h"
 #include "RWLocker.h"
 #include "TimeSource.h"
@@ -36,6 +37,8 @@
 //#define ldebug	debug
 #define ldebug	nodebug
 
+static const bigtime_t kAudioReadAheadTime = 500000;
+
 
 SimplePlaybackManager::Connection::Connection()
 	: connected(false)
@@ -104,6 +107,7 @@ clear_bitmap(BBitmap* bitmap, BRect area)
 SimplePlaybackManager::SimplePlaybackManager()
 	: fPlaylist(NULL),
 	  fPainter(),
+	  fSnapshot(NULL),
 	  fAudioProducer(NULL),
 	  fAudioSupplier(NULL),
 	  
@@ -153,6 +157,7 @@ SimplePlaybackManager::SimplePlaybackManager()
 SimplePlaybackManager::~SimplePlaybackManager()
 {
 	SetPlaylist(NULL, 0);
+	PlaylistSnapshot::ReleaseSnapshot(&fSnapshot, fLocker);
 
 	// print performance
 	if (fFrameCount == 0)
@@ -600,6 +605,9 @@ SimplePlaybackManager::_InitAudio()
 	float videoFPS = VideoFramesPerSecond();
 	fAudioSupplier = new PlaylistAudioSupplier(fPlaylist, fLocker, this,
 		videoFPS);
+	// the player doesn't seek much, so keep a slow clip from
+	// stalling the audio output
+	fAudioSupplier->SetReadAheadTime(kAudioReadAheadTime);
 	fAudioProducer = new AudioProducer("Clockwerk Audio Out", fAudioSupplier,
 		false);
 
@@ -896,22 +904,20 @@ SimplePlaybackManager::_FrameGenerator()
 			// have the read lock already!
 			_CurrentFrameChanged(fCurrentFrame);
 
-			if (!fLocker->ReadLock()) {
-				// this is probably dumb... if the lock
-				// failed, we might as well exit
-				previousBuffer = currentBuffer;
-				currentBuffer++;
-				if (currentBuffer == fBufferCount)
-					currentBuffer = 0;
-				snooze(9000);
-				continue;
-			}
+			// take a new snapshot of the playlist only if it has been
+			// changed, and don't wait for a writer to finish, but render
+			// from the previous snapshot instead
+			bool locked = fLocker->ReadLockWithTimeout(0) == B_OK;
+			if (locked)
+				PlaylistSnapshot::Update(&fSnapshot, fPlaylist, fLocker);
 
-			// copy the playlist while holding the lock
-			RenderPlaylist renderPlaylist(*fPlaylist, fCurrentFrame,
-				fOverlayBitmap[currentBuffer]->ColorSpace(), &fRendererCache);
+			// the renderers can only be synced while holding the lock
+			RenderPlaylist renderPlaylist(fSnapshot, fCurrentFrame,
+				fOverlayBitmap[currentBuffer]->ColorSpace(), &fRendererCache,
+				locked);
 
-			fLocker->ReadUnlock();
+			if (locked)
+				fLocker->ReadUnlock();
 
 			if (!fHurryUp) {
 				// clear the buffer only where needed
@@ -22,6 +22,7 @@ class BBitmap;
 class BView;
 class Playlist;
 class PlaylistAudioSupplier;
+class PlaylistSnapshot;
 class PlaybackListener;
 class RWLocker;
 class TimeSource;
@@ -112,6 +113,7 @@ class SimplePlaybackManager : public PlaybackManagerInterface {
 			::Playlist*			fPlaylist;
 			Painter				fPainter;
 			ClipRendererCache	fRendererCache;
+			PlaylistSnapshot*	fSnapshot;
 			AudioProducer*		fAudioProducer;
 			Connection			fAudioConnection;
 			PlaylistAudioSupplier* fAudioSupplier;
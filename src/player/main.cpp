@@ -12,9 +12,13 @@
 #endif
 //#include "common_constants.h"
 //#include "common_logging.h"
+#include "DecodedAudioCache.h"
+#include "DecodedImageCache.h"
 #include "EventQueue.h"
 #include "FontManager.h"
+#include "LoudnessAnalyzer.h"
 #include "PlayerApp.h"
+#include "PlaylistProxyCache.h"
 //#include "XMLSupport.h"
 
 using std::nothrow;
@@ -31,6 +35,10 @@ main(int argc, char** argv)
 
 	EventQueue::CreateDefault();
 	FontManager::CreateDefault();
+	DecodedImageCache::CreateDefault();
+	DecodedAudioCache::CreateDefault();
+	LoudnessAnalyzer::CreateDefault();
+	PlaylistProxyCache::CreateDefault();
 //	init_xml();
 
 	srand(time(NULL));
@@ -42,6 +50,10 @@ main(int argc, char** argv)
 	}
 
 //	uninit_xml();
+	PlaylistProxyCache::DeleteDefault();
+	LoudnessAnalyzer::DeleteDefault();
+	DecodedAudioCache::DeleteDefault();
+	DecodedImageCache::DeleteDefault();
 	FontManager::DeleteDefault();
 	EventQueue::DeleteDefault();
 
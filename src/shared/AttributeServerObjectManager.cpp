@@ -7,6 +7,7 @@
 #include "AttributeServerObjectManager.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -33,6 +34,7 @@
 AttributeServerObjectManager::AttributeServerObjectManager()
 	: ServerObjectManager()
 	, fIngoreStateChanges(false)
+	, fFactory(NULL)
 {
 }
 
@@ -57,6 +59,9 @@ AttributeServerObjectManager::Init(const char* directory,
 
 	SetDirectory(directory);
 
+	// in lazy mode, objects are instantiated on demand later on
+	fFactory = factory;
+
 	// lock the directory
 	BDirectory dir;
 	while (dir.SetTo(directory) == B_BUSY) {
@@ -109,7 +114,10 @@ AttributeServerObjectManager::Init(const char* directory,
 		entry.GetName(name);
 		BString serverID(name);
 
-		ret = _CreateObjectFromNode(node, serverID, factory);
+		if (LazyLoading())
+			ret = _IndexObjectFromNode(node, serverID);
+		else
+			ret = _CreateObjectFromNode(node, serverID, factory);
 		if (ret < B_OK)
 			break;
 
@@ -130,6 +138,16 @@ AttributeServerObjectManager::Init(const char* directory,
 	RETURN_ERROR(ret);
 }
 
+// SetObjectFactory
+//
+// Sets the factory for instantiating objects in lazy mode,
+// if they have been indexed by another library.
+void
+AttributeServerObjectManager::SetObjectFactory(ServerObjectFactory* factory)
+{
+	fFactory = factory;
+}
+
 // StateChanged
 void
 AttributeServerObjectManager::StateChanged()
@@ -228,6 +246,34 @@ AttributeServerObjectManager::GetRef(const ServerObject* object, entry_ref& ref)
 
 // #pragma mark -
 
+// InstantiateIndexedObject
+ServerObject*
+AttributeServerObjectManager::InstantiateIndexedObject(const BString& id,
+	const BString& type)
+{
+	if (!fFactory)
+		return NULL;
+
+	BPath path;
+	if (_GetPath(id, path) < B_OK)
+		return NULL;
+
+	BNode node(path.Path());
+	if (node.InitCheck() < B_OK)
+		return NULL;
+
+	BString typeString(type);
+	ServerObject* object = _InstantiateObjectFromNode(node, id, typeString,
+		fFactory);
+	if (object) {
+		// this object is up to date
+		object->SetMetaDataSaved(true);
+	}
+	return object;
+}
+
+// #pragma mark -
+
 // _GetPath
 status_t
 AttributeServerObjectManager::_GetPath(const BString& id, BPath& path)
@@ -244,35 +290,97 @@ AttributeServerObjectManager::_CreateObjectFromNode(BNode& node,
 {
 	// NOTE: only fail in case of B_NO_MEMORY
 
-	attr_info info;
-	if (node.GetAttrInfo(kTypeAttr, &info) < B_OK)
+	BString type;
+	if (_ReadTypeAttribute(node, serverID, type) < B_OK)
 		return B_OK;
 
-	char type[info.size + 1];
-	if (node.ReadAttr(kTypeAttr, info.type, 0, type, info.size) < B_OK) {
-		printf("failed to read type attribute from object \"%s\"\n",
-			   serverID.String());
-		return B_OK;
+	ServerObject* object = _InstantiateObjectFromNode(node, serverID, type,
+		factory);
+	if (!object || !AddObject(object)) {
+		delete object;
+		return B_NO_MEMORY;
 	}
 
-	type[info.size] = 0;
-	BString typeString(type);
+	// this object is up to date
+	object->SetMetaDataSaved(true);
 
+	return B_OK;
+}
+
+// _IndexObjectFromNode
+status_t
+AttributeServerObjectManager::_IndexObjectFromNode(BNode& node,
+	const BString& serverID)
+{
+	// NOTE: only fail in case of B_NO_MEMORY
+
+	BString type;
+	if (_ReadTypeAttribute(node, serverID, type) < B_OK)
+		return B_OK;
+
+	unsigned id = B_HOST_TO_BENDIAN_INT32(PROPERTY_VERSION);
+	char idString[5];
+	sprintf(idString, "%.4s", (const char*)&id);
+	idString[4] = 0;
+
+	BString attrName(kAttrPrefix);
+	attrName << idString;
+
+	int32 version = -1;
+	BString versionString;
+	if (node.ReadAttrString(attrName.String(), &versionString) == B_OK)
+		version = atol(versionString.String());
+
+	// the size of the data file is a good enough estimate for the memory
+	// an object will use once it is instantiated
+	off_t dataSize = 0;
+	if (node.GetSize(&dataSize) < B_OK)
+		dataSize = 0;
+
+	status_t ret = AddIndexEntry(serverID, type, version, (size_t)dataSize);
+	if (ret == B_NO_MEMORY)
+		return ret;
+	return B_OK;
+}
+
+// _InstantiateObjectFromNode
+ServerObject*
+AttributeServerObjectManager::_InstantiateObjectFromNode(BNode& node,
+	const BString& serverID, BString& type, ServerObjectFactory* factory)
+{
 	// have the factory instantiate the object for the type
-	ServerObject* object = factory->Instantiate(typeString, serverID,
-												this);
+	ServerObject* object = factory->Instantiate(type, serverID, this);
 	if (!object)
-		return B_NO_MEMORY;
+		return NULL;
 
-	// restore object properties and add to list
-	if (_RestorePropertiesFromNode(node, object) < B_OK ||
-		!AddObject(object)) {
+	// restore object properties
+	if (_RestorePropertiesFromNode(node, object) < B_OK) {
 		delete object;
-		return B_NO_MEMORY;
+		return NULL;
 	}
 
-	// this object is up to date
-	object->SetMetaDataSaved(true);
+	return object;
+}
+
+// _ReadTypeAttribute
+status_t
+AttributeServerObjectManager::_ReadTypeAttribute(BNode& node,
+	const BString& serverID, BString& type) const
+{
+	attr_info info;
+	status_t ret = node.GetAttrInfo(kTypeAttr, &info);
+	if (ret < B_OK)
+		return ret;
+
+	char buffer[info.size + 1];
+	if (node.ReadAttr(kTypeAttr, info.type, 0, buffer, info.size) < B_OK) {
+		printf("failed to read type attribute from object \"%s\"\n",
+			   serverID.String());
+		return B_ERROR;
+	}
+
+	buffer[info.size] = 0;
+	type = buffer;
 
 	return B_OK;
 }
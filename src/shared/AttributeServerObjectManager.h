@@ -26,6 +26,9 @@ class AttributeServerObjectManager : public ServerObjectManager {
 									bool resolveDependencies = true,
 									ProgressReporter* reporter = NULL);
 
+			void				SetObjectFactory(
+									ServerObjectFactory* factory);
+
 	virtual	void				StateChanged();
 	virtual void				SetIgnoreStateChanges(bool ignore);
 	virtual	bool				IsStateSaved() const;
@@ -33,11 +36,24 @@ class AttributeServerObjectManager : public ServerObjectManager {
 	virtual	status_t			GetRef(const BString& id, entry_ref& ref);
 	virtual status_t			GetRef(const ServerObject* object, entry_ref& ref);
 
+ protected:
+	virtual	ServerObject*		InstantiateIndexedObject(const BString& id,
+									const BString& type);
+
  private:
  			status_t			_GetPath(const BString& id, BPath& path);
 			status_t			_CreateObjectFromNode(BNode& node,
 									const BString& serverID,
 									ServerObjectFactory* factory);
+			status_t			_IndexObjectFromNode(BNode& node,
+									const BString& serverID);
+			ServerObject*		_InstantiateObjectFromNode(BNode& node,
+									const BString& serverID,
+									BString& type,
+									ServerObjectFactory* factory);
+			status_t			_ReadTypeAttribute(BNode& node,
+									const BString& serverID,
+									BString& type) const;
 			status_t			_CreateNodeFromObject(
 									BDirectory& directory,
 									const ServerObject* object) const;
@@ -48,6 +64,7 @@ class AttributeServerObjectManager : public ServerObjectManager {
 									const ServerObject* object) const;
 
 			bool				fIngoreStateChanges;
+			ServerObjectFactory* fFactory;
 };
 
 #endif // ATTRIBUTE_SERVER_OBJECT_MANAGER_H
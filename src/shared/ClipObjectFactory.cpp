@@ -18,12 +18,14 @@
 #include <Path.h>
 
 #include "common.h"
+#include "common_constants.h"
 
 #include "ClockClip.h"
 #include "CollectablePlaylist.h"
 #include "CollectingPlaylist.h"
 #include "ColorClip.h"
 #include "CommonPropertyIDs.h"
+#include "ContentHasher.h"
 #include "FileBasedClip.h"
 #include "Playlist.h"
 #include "ScrollingTextClip.h"
@@ -41,6 +43,52 @@
 
 using std::nothrow;
 
+// has_same_content
+static bool
+has_same_content(const entry_ref& ref, const entry_ref& otherRef)
+{
+	ContentHasher* hasher = ContentHasher::Default();
+	if (!hasher)
+		return false;
+
+	ContentDigest* digest;
+	if (hasher->HashFileSync(ref, &digest) < B_OK)
+		return false;
+	// the file is a temporary one, there is no point in caching its digest
+	hasher->Forget(ref);
+
+	bool sameContent = false;
+	ContentDigest* otherDigest;
+	if (hasher->HashFileSync(otherRef, &otherDigest) == B_OK) {
+		sameContent = digest->HasSameContent(*otherDigest);
+		otherDigest->Release();
+	}
+	digest->Release();
+
+	return sameContent;
+}
+
+// store_digest
+static void
+store_digest(const entry_ref& ref)
+{
+	ContentHasher* hasher = ContentHasher::Default();
+	if (!hasher)
+		return;
+
+	ContentDigest* digest;
+	if (hasher->HashFileSync(ref, &digest) < B_OK)
+		return;
+
+	BString digestString;
+	digest->GetFileDigestAsString(digestString);
+	digest->Release();
+
+	BNode node(&ref);
+	node.WriteAttr(kSHA256Attr, B_STRING_TYPE, 0, digestString.String(),
+		digestString.Length() + 1);
+}
+
 // constructor
 ClipObjectFactory::ClipObjectFactory(bool allowLazyLoading)
 	: fAllowLazyLoading(allowLazyLoading)
@@ -459,6 +507,13 @@ ClipObjectFactory::StoreObject(ServerObject* object,
 		entry.Remove();
 	}
 
+	if (ret >= B_OK && ref != docRef && has_same_content(*ref, *docRef)) {
+		// keep the previous document file, so that unchanged data
+		// does not look modified and is not transferred again
+		entry.Remove();
+		ref = docRef;
+	}
+
 	if (ret >= B_OK && ref != docRef) {
 		// move temp file overwriting actual document file
 		BEntry docEntry(docRef, true);
@@ -504,6 +559,9 @@ ClipObjectFactory::StoreObject(ServerObject* object,
 			nodeInfo.SetType(fileMIME);
 	}
 
+	if (ret >= B_OK)
+		store_digest(*docRef);
+
 	object->SetDataSaved(true);
 
 	return ret;
@@ -21,6 +21,8 @@
 #include "AttributeServerObjectManager.h"
 #include "CommonPropertyIDs.h"
 #include "Document.h"
+#include "LoudnessAnalyzer.h"
+#include "MediaClip.h"
 #include "Playlist.h"
 #include "ClipObjectFactory.h"
 #include "XMLImporter.h"
@@ -44,6 +46,35 @@ ClockwerkApp::~ClockwerkApp()
 	delete fObjectLibrary;
 }
 
+// MessageReceived
+void
+ClockwerkApp::MessageReceived(BMessage* message)
+{
+	switch (message->what) {
+		case MSG_AUDIO_LOUDNESS_MEASURED: {
+			// the message holds a reference to the clip
+			MediaClip* clip;
+			if (message->FindPointer("clip", (void**)&clip) < B_OK)
+				break;
+			float peak;
+			float loudness;
+			int32 changeToken;
+			if (message->FindFloat("peak", &peak) == B_OK
+				&& message->FindFloat("loudness", &loudness) == B_OK
+				&& message->FindInt32("change token", &changeToken) == B_OK) {
+				AutoReadLocker locker(fDocument);
+				if (locker.IsLocked())
+					clip->SetAudioLoudness(peak, loudness, changeToken);
+			}
+			clip->Release();
+			break;
+		}
+		default:
+			BApplication::MessageReceived(message);
+			break;
+	}
+}
+
 // ArgvReceived
 void
 ClockwerkApp::ArgvReceived(int32 argc, char** argv)
@@ -71,6 +102,8 @@ ClockwerkApp::_ReInitClipsFromDisk(bool lockEntireOperation,
 
 	AttributeServerObjectManager objectManager;
 	objectManager.SetLoadRemovedObjects(loadRemovedObjects);
+	// if the objects are loaded on demand, it is enough to index them
+	objectManager.SetLazyLoading(fObjectLibrary->LazyLoading());
 	status_t ret = objectManager.Init(directory, fObjectFactory, false);
 
 	if (ret == B_ENTRY_NOT_FOUND)
@@ -82,6 +115,18 @@ ClockwerkApp::_ReInitClipsFromDisk(bool lockEntireOperation,
 	if (lockEntireOperation && !fDocument->WriteLock())
 		return B_ERROR;
 
+	if (fObjectLibrary->LazyLoading()) {
+		if (ret >= B_OK) {
+			AutoWriteLocker locker(fDocument);
+			ret = fObjectLibrary->SyncIndex(objectManager);
+			if (ret >= B_OK)
+				ret = fObjectLibrary->ResolveDependencies();
+		}
+		if (lockEntireOperation)
+			fDocument->WriteUnlock();
+		return ret;
+	}
+
 	print_info("updating object instances\n");
 
 	// remove no longer needed clips
@@ -19,6 +19,7 @@ class ClockwerkApp : public BApplication {
 	virtual						~ClockwerkApp();
 
 	// BApplication interface
+	virtual	void				MessageReceived(BMessage* message);
 	virtual	void				ArgvReceived(int32 argc, char** argv);
 
 	// ClockwerkApp
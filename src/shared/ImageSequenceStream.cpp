@@ -6,35 +6,246 @@
 #include "ImageSequenceStream.h"
 
 #include <new>
+#include <setjmp.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <Bitmap.h>
-#include <Entry.h>
 #include <File.h>
-#include <String.h>
 
-//#include "common.h"
+#include "common.h"
 
 #include <jpeglib.h>
-#include <be_jpeg_interface.h>
-
-#include "VideoClip.h"
+#include <jerror.h>
 
 using std::nothrow;
 
-ImageSequenceStream::stream_header::stream_header()
-	: width(0)
-	, height(0)
-	, format(NO_FORMAT)
-	, frameCount(0)
+static const uint32 kStreamMagic = 'isq2';
+static const uint32 kMaxWidth = 1920;
+static const uint32 kMaxHeight = 1080;
+
+enum {
+	JPEG_INITIAL_BUFFER_SIZE	= 65536
+};
+
+// image_slice
+//
+// A horizontal strip of a frame, which is compressed as a JPEG of its
+// own. The planar buffers and the buffer for the compressed data are
+// kept from frame to frame.
+struct image_slice {
+	// the chunky YCbCr422 pixels
+	uint8*			bits;
+	uint32			firstLine;
+	uint32			width;
+	uint32			height;
+	uint32			bytesPerRow;
+
+	// the compressed data, when decoding it points into the frame data
+	const uint8*	data;
+	size_t			size;
+
+	// the buffer of the encoder
+	uint8*			buffer;
+	size_t			capacity;
+
+	// the planar buffers used by libjpeg
+	JSAMPIMAGE		imageData;
+	int32			imageDataWidth;
+
+	status_t		status;
+};
+
+// #pragma mark - libjpeg support
+
+// error_manager
+struct error_manager {
+	struct jpeg_error_mgr	pub;
+	jmp_buf					jump;
+};
+
+// error_exit
+//
+// Replaces the libjpeg default, which would exit the application.
+static void
+error_exit(j_common_ptr cinfo)
+{
+	char message[JMSG_LENGTH_MAX];
+	(*cinfo->err->format_message)(cinfo, message);
+	print_error("ImageSequenceStream - JPEG error: %s\n", message);
+
+	longjmp(((error_manager*)cinfo->err)->jump, 1);
+}
+
+// memory_destination
+struct memory_destination {
+	struct jpeg_destination_mgr	pub;
+	image_slice*				slice;
+};
+
+// init_destination
+static void
+init_destination(j_compress_ptr cinfo)
 {
+	image_slice* slice = ((memory_destination*)cinfo->dest)->slice;
+	if (slice->capacity == 0) {
+		slice->buffer = (uint8*)malloc(JPEG_INITIAL_BUFFER_SIZE);
+		if (!slice->buffer)
+			ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 0);
+		slice->capacity = JPEG_INITIAL_BUFFER_SIZE;
+	}
+	cinfo->dest->next_output_byte = slice->buffer;
+	cinfo->dest->free_in_buffer = slice->capacity;
 }
 
-ImageSequenceStream::stream_header::stream_header(uint32 width,
-		uint32 height, pixel_format format)
-	: width(width)
-	, height(height)
-	, format(format)
+// empty_output_buffer
+static boolean
+empty_output_buffer(j_compress_ptr cinfo)
+{
+	// the whole buffer is full, grow it
+	image_slice* slice = ((memory_destination*)cinfo->dest)->slice;
+	size_t used = slice->capacity;
+	uint8* buffer = (uint8*)realloc(slice->buffer, used * 2);
+	if (!buffer)
+		ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 0);
+	slice->buffer = buffer;
+	slice->capacity = used * 2;
+
+	cinfo->dest->next_output_byte = slice->buffer + used;
+	cinfo->dest->free_in_buffer = slice->capacity - used;
+	return TRUE;
+}
+
+// term_destination
+static void
+term_destination(j_compress_ptr cinfo)
+{
+	image_slice* slice = ((memory_destination*)cinfo->dest)->slice;
+	slice->data = slice->buffer;
+	slice->size = slice->capacity - cinfo->dest->free_in_buffer;
+}
+
+// init_source
+static void
+init_source(j_decompress_ptr cinfo)
+{
+}
+
+// fill_input_buffer
+static boolean
+fill_input_buffer(j_decompress_ptr cinfo)
+{
+	// all data has been given to libjpeg at once, the slice
+	// is truncated, insert a fake end of image marker
+	static const JOCTET kEndOfImage[2] = { (JOCTET)0xff, (JOCTET)JPEG_EOI };
+
+	WARNMS(cinfo, JWRN_JPEG_EOF);
+	cinfo->src->next_input_byte = kEndOfImage;
+	cinfo->src->bytes_in_buffer = 2;
+	return TRUE;
+}
+
+// skip_input_data
+static void
+skip_input_data(j_decompress_ptr cinfo, long count)
+{
+	if (count <= 0)
+		return;
+
+	if (count > (long)cinfo->src->bytes_in_buffer) {
+		fill_input_buffer(cinfo);
+		return;
+	}
+	cinfo->src->next_input_byte += count;
+	cinfo->src->bytes_in_buffer -= count;
+}
+
+// term_source
+static void
+term_source(j_decompress_ptr cinfo)
+{
+}
+
+// delete_planar_image_buffer
+static void
+delete_planar_image_buffer(JSAMPIMAGE imageData)
+{
+	if (!imageData)
+		return;
+
+	delete[] imageData[0][0];
+	delete[] imageData[1][0];
+	delete[] imageData[2][0];
+
+	delete[] imageData[0];
+	delete[] imageData[1];
+	delete[] imageData[2];
+
+	delete[] imageData;
+}
+
+// create_planar_image_buffer
+template<typename jpeg_info>
+static JSAMPIMAGE
+create_planar_image_buffer(jpeg_info& cinfo)
+{
+	int32 ySamplesPerRow = cinfo.comp_info[0].width_in_data_units * DCTSIZE;
+	int32 cSamplesPerRow = cinfo.comp_info[1].width_in_data_units * DCTSIZE;
+	int32 rowsPerWriteCall = cinfo.max_v_samp_factor * DCTSIZE;
+
+	// use jpeglib terminology for sample, row and image
+	int32 yBufferSize = rowsPerWriteCall * ySamplesPerRow;
+	int32 cBufferSize = rowsPerWriteCall * cSamplesPerRow;
+	JSAMPROW yBuffer = new JSAMPLE[yBufferSize];
+	JSAMPROW cbBuffer = new JSAMPLE[cBufferSize];
+	JSAMPROW crBuffer = new JSAMPLE[cBufferSize];
+
+	JSAMPARRAY yPlane = new JSAMPROW[cinfo.comp_info[0].v_samp_factor * DCTSIZE];
+	JSAMPARRAY cbPlane = new JSAMPROW[cinfo.comp_info[1].v_samp_factor * DCTSIZE];
+	JSAMPARRAY crPlane = new JSAMPROW[cinfo.comp_info[2].v_samp_factor * DCTSIZE];
+
+	// assign pointers
+	for (int32 row = 0; row < rowsPerWriteCall; row++) {
+		yPlane[row] = yBuffer + row * ySamplesPerRow;
+		cbPlane[row] = cbBuffer + row * cSamplesPerRow;
+		crPlane[row] = crBuffer + row * cSamplesPerRow;
+	}
+
+	JSAMPIMAGE imageData = new JSAMPARRAY[3];
+	imageData[0] = yPlane;
+	imageData[1] = cbPlane;
+	imageData[2] = crPlane;
+
+	return imageData;
+}
+
+// get_planar_image_buffer
+//
+// Returns the planar buffers of the slice, they are only
+// allocated again if the image width has changed.
+template<typename jpeg_info>
+static JSAMPIMAGE
+get_planar_image_buffer(image_slice* slice, jpeg_info& cinfo)
+{
+	int32 width = cinfo.comp_info[0].width_in_data_units;
+	if (!slice->imageData || slice->imageDataWidth != width) {
+		delete_planar_image_buffer(slice->imageData);
+		slice->imageData = NULL;
+		slice->imageData = create_planar_image_buffer(cinfo);
+		slice->imageDataWidth = width;
+	}
+	return slice->imageData;
+}
+
+// #pragma mark -
+
+ImageSequenceStream::stream_header::stream_header()
+	: magic(kStreamMagic)
+	, width(0)
+	, height(0)
+	, format(NO_FORMAT)
+	, sliceCount(0)
 	, frameCount(0)
 {
 }
@@ -44,7 +255,17 @@ ImageSequenceStream::ImageSequenceStream()
 	: fHeader()
 	, fCurrentFrame(-1)
 	, fStream(NULL)
+	, fWriting(false)
 	, fFrameOffsetMap(NULL)
+	, fSlices(NULL)
+	, fFrameData(NULL)
+	, fFrameDataSize(0)
+	, fWorkers(NULL)
+	, fWorkerCount(0)
+	, fJobSem(-1)
+	, fDoneSem(-1)
+	, fNextSlice(0)
+	, fEncoding(false)
 	, fDecodedBitmap(NULL)
 {
 }
@@ -52,25 +273,22 @@ ImageSequenceStream::ImageSequenceStream()
 // destructor
 ImageSequenceStream::~ImageSequenceStream()
 {
+	_StopWorkers();
 	_MakeEmpty();
 }
 
 // Init
 status_t
-ImageSequenceStream::Init(const BString& id)
+ImageSequenceStream::Init(const char* path)
 {
 	// clear
 	_MakeEmpty();
 
-	// construct filename and get entry_ref
-	entry_ref ref;
-	status_t ret = _GetRefForID(id, &ref);
-	if (ret < B_OK)
-		return ret;
-
 	// open file
-	fStream = new BFile(&ref, B_READ_ONLY);
-	ret = fStream->InitCheck();
+	fStream = new (nothrow) BFile(path, B_READ_ONLY);
+	if (!fStream)
+		return B_NO_MEMORY;
+	status_t ret = fStream->InitCheck();
 	if (ret < B_OK) {
 		_MakeEmpty();
 		return ret;
@@ -82,86 +300,144 @@ ImageSequenceStream::Init(const BString& id)
 		return B_IO_ERROR;
 	}
 
-	if (fHeader.width == 0 || fHeader.width > 1920
-		|| fHeader.height == 0 || fHeader.height > 1080
-		|| fHeader.format != YCbCr422) {
+	// an unfinished stream has no frames
+	if (fHeader.magic != kStreamMagic
+		|| fHeader.width == 0 || fHeader.width > kMaxWidth
+		|| fHeader.height == 0 || fHeader.height > kMaxHeight
+		|| fHeader.format != YCbCr422 || fHeader.frameCount <= 0
+		|| fHeader.sliceCount <= 0 || fHeader.sliceCount > MAX_SLICE_COUNT) {
 		_MakeEmpty();
 		return B_ERROR;
 	}
 
-	fFormat.u.raw_video.display.line_width = header.width;
-	fFormat.u.raw_video.display.line_count = header.height;
-	fFormat.u.raw_video.display.format = header.format;
-
-	fFormat.u.raw_video.display.bytes_per_row = 2 * header.width;
-	fFormat.u.raw_video.display.bytes_per_row += (2 * header.width) % 4;
-
 	// init frame->offset map
-	fFrameOffsetMap = new (nothrow) off_t[fHeader.frameCount];
+	fFrameOffsetMap = new (nothrow) off_t[fHeader.frameCount + 1];
 	if (!fFrameOffsetMap) {
 		_MakeEmpty();
 		return B_NO_MEMORY;
 	}
 
 	// read frame->offset map from file
-	ssize_t mapSize = sizeof(off_t) * fHeader.frameCount;
+	ssize_t mapSize = sizeof(off_t) * (fHeader.frameCount + 1);
 	if (fStream->Read(fFrameOffsetMap, mapSize) != mapSize) {
 		_MakeEmpty();
 		return B_IO_ERROR;
 	}
 
-	return ret;
+	ret = _InitSlices(fHeader.sliceCount);
+	if (ret < B_OK) {
+		_MakeEmpty();
+		return ret;
+	}
+
+	fCurrentFrame = 0;
+
+	return B_OK;
 }
 
 // Init
 status_t
-ImageSequenceStream::Init(uint32 width, uint32 height, pixel_format format
-	int64 frameCount, const BString& id)
+ImageSequenceStream::Init(const char* path, uint32 width, uint32 height,
+	pixel_format format, int64 frameCount, int32 sliceCount)
 {
 	// clear
 	_MakeEmpty();
 
-	// construct filename and get entry_ref
-	entry_ref ref;
-	status_t ret = _GetRefForID(id, &ref);
-	if (ret < B_OK)
+	if (width == 0 || width > kMaxWidth || height == 0 || height > kMaxHeight
+		|| format != YCbCr422 || frameCount <= 0
+		|| sliceCount <= 0 || sliceCount > MAX_SLICE_COUNT) {
+		return B_BAD_VALUE;
+	}
+
+	fHeader.width = width;
+	fHeader.height = height;
+	fHeader.format = format;
+
+	status_t ret = _InitSlices(sliceCount);
+	if (ret < B_OK) {
+		_MakeEmpty();
 		return ret;
+	}
 
 	// open file
-	fStream = new BFile(&ref, B_WRITE_ONLY);
+	fStream = new (nothrow) BFile(path,
+		B_CREATE_FILE | B_ERASE_FILE | B_WRITE_ONLY);
+	if (!fStream) {
+		_MakeEmpty();
+		return B_NO_MEMORY;
+	}
 	ret = fStream->InitCheck();
 	if (ret < B_OK) {
 		_MakeEmpty();
 		return ret;
 	}
 
-	// write stream header (format, frame count)
-	fHeader.width = width;
-	fHeader.height = height;
-	fHeader.format = format;
-	fHeader.frameCount = frameCount;
-
-	if (fHeader.width == 0 || fHeader.width > 1920
-		|| fHeader.height == 0 || fHeader.height > 1080
-		|| fHeader.format != B_YCbCr422) {
+	fFrameOffsetMap = new (nothrow) off_t[frameCount + 1];
+	if (!fFrameOffsetMap) {
 		_MakeEmpty();
-		return B_ERROR;
+		return B_NO_MEMORY;
 	}
+	memset(fFrameOffsetMap, 0, sizeof(off_t) * (frameCount + 1));
 
+	// write stream header, without any frames until the
+	// stream is finalized, and reserve the space of the
+	// frame->offset map
 	if (fStream->Write(&fHeader, sizeof(fHeader)) != sizeof(fHeader)) {
 		_MakeEmpty();
 		return B_IO_ERROR;
 	}
 
-	fFrameOffsetMap = new (nothrow) off_t[fHeader.frameCount]
-	if (!fFrameOffsetMap) {
+	ssize_t mapSize = sizeof(off_t) * (frameCount + 1);
+	if (fStream->Write(fFrameOffsetMap, mapSize) != mapSize) {
 		_MakeEmpty();
+		return B_IO_ERROR;
+	}
+
+	fHeader.frameCount = frameCount;
+	fCurrentFrame = 0;
+	fWriting = true;
+
+	return B_OK;
+}
+
+// SetWorkerCount
+status_t
+ImageSequenceStream::SetWorkerCount(int32 count)
+{
+	_StopWorkers();
+
+	if (count <= 0)
+		return B_OK;
+
+	fWorkers = new (nothrow) thread_id[count];
+	if (!fWorkers)
 		return B_NO_MEMORY;
+
+	fJobSem = create_sem(0, "image sequence jobs");
+	fDoneSem = create_sem(0, "image sequence slices done");
+	if (fJobSem < B_OK || fDoneSem < B_OK) {
+		status_t ret = fJobSem < B_OK ? fJobSem : fDoneSem;
+		_StopWorkers();
+		return ret;
 	}
 
-	if (fStream->Write(fFrameOffsetMap, fHeader.frameCount) != fHeader.frameCount) {
-		_MakeEmpty();
-		return B_IO_ERROR;
+	// the workers do what the calling thread would do otherwise,
+	// so they run at its priority
+	thread_info info;
+	get_thread_info(find_thread(NULL), &info);
+
+	for (int32 i = 0; i < count; i++) {
+		thread_id worker = spawn_thread(_WorkerEntry, "image sequence worker",
+			info.priority, this);
+		if (worker < B_OK)
+			break;
+		fWorkers[fWorkerCount++] = worker;
+		resume_thread(worker);
+	}
+
+	if (fWorkerCount == 0) {
+		_StopWorkers();
+		return B_NO_MORE_THREADS;
 	}
 
 	return B_OK;
@@ -174,14 +450,13 @@ ImageSequenceStream::GetFormat(uint32* width, uint32* height,
 {
 	if (!fStream || !fFrameOffsetMap)
 		return B_NO_INIT;
-	if (!format)
+	if (!width || !height || !format || !bytesPerRow)
 		return B_BAD_VALUE;
 
 	*width = fHeader.width;
 	*height = fHeader.height;
 	*format = fHeader.format;
-	*bytesPerRow = 2 * fHeader.width;
-	*bytesPerRow += (2 * fHeader.width) % 4;
+	*bytesPerRow = _BytesPerRow();
 
 	return B_OK;
 }
@@ -190,15 +465,11 @@ ImageSequenceStream::GetFormat(uint32* width, uint32* height,
 status_t
 ImageSequenceStream::SeekToFrame(int64 frame)
 {
-	if (!fStream || !fFrameOffsetMap)
+	if (!fStream || !fFrameOffsetMap || fWriting)
 		return B_NO_INIT;
 	if (frame < 0 || frame >= fHeader.frameCount)
 		return B_BAD_VALUE;
 
- 	off_t offset = fFrameOffsetMap[(int32)frame];
-	if (fStream->Seek(offset, SEEK_SET) != offset)
-		return B_IO_ERROR;
-
 	fCurrentFrame = frame;
 
 	return B_OK;
@@ -212,57 +483,42 @@ ImageSequenceStream::ReadFrame(uint8* buffer)
 {
 	if (!buffer)
 		return B_BAD_VALUE;
-	if (!fStream || !fFrameOffsetMap)
-		return B_NO_INIT;
-	if (fCurrentFrame < 0 || fCurrentFrame >= fHeader.frameCount)
-		return B_ERROR;
-
-	_CheckStreamPosition();
 
-	// ready to read next frame
-	fCurrentFrame++;
-
-	// decode into provided frameBuffer
-	return _DecodeBuffer(buffer, fFormat.u.raw_video.display.line_width,
-		fFormat.u.raw_video.display.line_count,
-		fFormat.u.raw_video.display.bytes_per_row, *fStream);
+	return _ReadFrame(buffer, _BytesPerRow());
 }
 
 // ReadFrame
 const BBitmap*
 ImageSequenceStream::ReadFrame()
 {
-	if (!fStream || !fFrameOffsetMap) {
-		printf("ImageSequenceStream::ReadFrame() - no init\n");
+	if (!fStream || !fFrameOffsetMap || fWriting) {
+		print_error("ImageSequenceStream::ReadFrame() - no init\n");
 		return NULL;
 	}
 
 	if (fCurrentFrame < 0 || fCurrentFrame >= fHeader.frameCount)
 		fCurrentFrame = 0;
 
-	_CheckStreamPosition();
-
 	// create bitmap if necessary
 	if (!fDecodedBitmap) {
-		fDecodedBitmap = new BBitmap(BRect(0, 0,
-			fFormat.u.raw_video.display.line_width - 1,
-			fFormat.u.raw_video.display.line_count - 1), 0, B_YCbCr422);
-		if (fDecodedBitmap->InitCheck() < B_OK) {
-			printf("ImageSequenceStream::ReadFrame() - creating bitmap failed!\n");
+		fDecodedBitmap = new (nothrow) BBitmap(BRect(0, 0,
+			fHeader.width - 1, fHeader.height - 1), 0, B_YCbCr422);
+		if (!fDecodedBitmap || fDecodedBitmap->InitCheck() < B_OK) {
+			print_error("ImageSequenceStream::ReadFrame() - "
+				"creating bitmap failed!\n");
 			delete fDecodedBitmap;
 			fDecodedBitmap = NULL;
 			return NULL;
 		}
 	}
 
-	status_t ret = _DecodeBitmap(fDecodedBitmap, *fStream);
+	status_t ret = _ReadFrame((uint8*)fDecodedBitmap->Bits(),
+		fDecodedBitmap->BytesPerRow());
 	if (ret < B_OK) {
-		printf("ImageSequenceStream::ReadFrame() - decoding: %s\n", strerror(ret));
+		print_error("ImageSequenceStream::ReadFrame() - decoding: %s\n",
+			strerror(ret));
 	}
 
-	// ready to read next frame
-	fCurrentFrame++;
-
 	return fDecodedBitmap;
 }
 
@@ -270,231 +526,297 @@ ImageSequenceStream::ReadFrame()
 
 // WriteFrame
 status_t
-ImageSequenceStream::WriteFrame(const BBitmap* bitmap)
+ImageSequenceStream::WriteFrame(const uint8* buffer)
 {
-	if (!bitmap)
+	if (!buffer)
 		return B_BAD_VALUE;
-	if (!fStream || !fFrameOffsetMap)
+	if (!fStream || !fFrameOffsetMap || !fWriting)
 		return B_NO_INIT;
-
-	size_t neededSize = fHeader.frameCount + 1;
-	if (needesSize > fHeader.frameCount)
+	if (fCurrentFrame >= fHeader.frameCount)
 		return B_ERROR;
 
-	fHeader.frameCount++;
-	fFrameOffsetMap[fCurrentFrame] = fStream->Position();
-	fCurrentFrame++;
-
-	return _EncodeBitmap(const BBitmap* bitmap, *fStream);
-}
-
-// Finalize
-status_t
-ImageSequenceStream::Finalize()
-{
-	fStream->
-}
-
-// #pragma mark -
-
-#define TIMING 1
-
-// CreateStream
-/*static*/ status_t
-ImageSequenceStream::CreateStream(const BString& serverID,
-	VideoClip* renderer)
-{
-	#if TIMING
-		bigtime_t startTime = system_time();
-	#endif
-
-	// open/create output file
-	entry_ref ref;
-	status_t ret = _GetRefForID(serverID, &ref);
-	if (ret < B_OK)
-		return ret;
-
-	BFile file(&ref, B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
-	ret = file.InitCheck();
-	if (ret < B_OK)
-		return ret;
-
-	// seek to clip start
-	int64 frame = 0;
-	ret = renderer->SeekToFrame(&frame);
-	if (ret < B_OK)
-		return ret;
+	uint32 bytesPerRow = _BytesPerRow();
+	for (int32 i = 0; i < fHeader.sliceCount; i++) {
+		fSlices[i].bits = (uint8*)buffer + fSlices[i].firstLine * bytesPerRow;
+		fSlices[i].bytesPerRow = bytesPerRow;
+	}
 
-	// write stream header
-	media_format format;
-	ret = renderer->GetFormat(&format);
+	status_t ret = _ProcessSlices(true);
 	if (ret < B_OK)
 		return ret;
 
-	stream_header header;
-	header.width = format.u.raw_video.display.line_width;
-	header.height = format.u.raw_video.display.line_count;
-	header.format = format.u.raw_video.display.format;
-	header.frameCount = renderer->CountFrames();
+	// each frame starts with the sizes of its slices
+	uint32 sizes[MAX_SLICE_COUNT];
+	for (int32 i = 0; i < fHeader.sliceCount; i++)
+		sizes[i] = fSlices[i].size;
 
-	ssize_t written = file.Write(&header, sizeof(header));
-	if (written != (ssize_t)sizeof(header)) {
-		if (written < 0)
-			return (status_t)written;
-		return B_IO_ERROR;
-	}
+	fFrameOffsetMap[fCurrentFrame] = fStream->Position();
 
-	// zero out frame->offset map area
-	off_t frameOffsetMap[header.frameCount];
-	memset(&frameOffsetMap, 0, sizeof(frameOffsetMap));
-	written = file.Write(frameOffsetMap, sizeof(frameOffsetMap));
-	if (written != (ssize_t)sizeof(frameOffsetMap)) {
-		if (written < 0)
-			return (status_t)written;
+	ssize_t sizesSize = sizeof(uint32) * fHeader.sliceCount;
+	if (fStream->Write(sizes, sizesSize) != sizesSize)
 		return B_IO_ERROR;
+	for (int32 i = 0; i < fHeader.sliceCount; i++) {
+		if (fStream->Write(fSlices[i].data, fSlices[i].size)
+				!= (ssize_t)fSlices[i].size) {
+			return B_IO_ERROR;
+		}
 	}
 
-	#if TIMING
-		bigtime_t decodingTime = 0;
-		bigtime_t encodingTime = 0;
-		bigtime_t decodingStart = system_time();
-	#endif
-
-	// write stream data
-	for (frame = 0; frame < header.frameCount; frame++) {
-		const BBitmap* bitmap = renderer->ReadFrame();
-		if (!bitmap)
-			return B_ERROR;
-
-		#if TIMING
-			bigtime_t decodingEnd = system_time();
-		#endif
-
-		frameOffsetMap[(int32)frame] = file.Position();
-//		if (frame == 0) {
-//			BFile test("/boot/home/Desktop/test.jpg",
-//				B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
-//			ret = _EncodeBitmap(bitmap, test);
-//		}
-		ret = _EncodeBitmap(bitmap, file);
-		if (ret < B_OK)
-			return ret;
+	fCurrentFrame++;
 
-		#if TIMING
-			decodingTime += decodingEnd - decodingStart;
-			decodingStart = system_time();
-			encodingTime += decodingStart - decodingEnd;
-		#endif
-	}
+	return B_OK;
+}
 
-	#if TIMING
-		printf("decoding time: %lld µs/frame\n", decodingTime / header.frameCount);
-		printf("encoding time: %lld µs/frame\n", encodingTime / header.frameCount);
-	#endif
+// Finalize
+status_t
+ImageSequenceStream::Finalize()
+{
+	if (!fStream || !fFrameOffsetMap || !fWriting)
+		return B_NO_INIT;
 
-	// seek to position after header, write frame->offset map
-	if (file.Seek(sizeof(stream_header), SEEK_SET) != sizeof(stream_header))
-		return B_IO_ERROR;
-	written = file.Write(frameOffsetMap, sizeof(frameOffsetMap));
-	if (written != (ssize_t)sizeof(frameOffsetMap)) {
-		if (written < 0)
-			return (status_t)written;
-		return B_IO_ERROR;
+	// the stream contains only the frames which have been written
+	fFrameOffsetMap[fCurrentFrame] = fStream->Position();
+	fHeader.frameCount = fCurrentFrame;
+
+	status_t ret = B_OK;
+	ssize_t mapSize = sizeof(off_t) * (fCurrentFrame + 1);
+	if (fStream->Seek(0, SEEK_SET) != 0
+		|| fStream->Write(&fHeader, sizeof(fHeader)) != sizeof(fHeader)
+		|| fStream->Write(fFrameOffsetMap, mapSize) != mapSize) {
+		ret = B_IO_ERROR;
 	}
+	if (ret == B_OK)
+		ret = fStream->Sync();
 
-	#if TIMING
-		printf("total time: %lld µs for %lld frames\n",
-			system_time() - startTime, header.frameCount);
-	#endif
+	_MakeEmpty();
 
-	return B_OK;
+	return ret;
 }
 
 // #pragma mark -
 
+// _MakeEmpty
 void
 ImageSequenceStream::_MakeEmpty()
 {
-	fHeader.width = 0;
-	fHeader.height = 0;
-	fHeader.format = NO_FORMAT;
-	fHeader.frameCount = 0;
+	if (fSlices) {
+		for (int32 i = 0; i < fHeader.sliceCount; i++) {
+			delete_planar_image_buffer(fSlices[i].imageData);
+			free(fSlices[i].buffer);
+		}
+		delete[] fSlices;
+		fSlices = NULL;
+	}
+
+	free(fFrameData);
+	fFrameData = NULL;
+	fFrameDataSize = 0;
+
+	fHeader = stream_header();
 
 	fCurrentFrame = -1;
 
 	delete fStream;
 	fStream = NULL;
+	fWriting = false;
 
 	delete[] fFrameOffsetMap;
 	fFrameOffsetMap = NULL;
-	fFrameOffsetMapSize = 0;
 
 	delete fDecodedBitmap;
 	fDecodedBitmap = NULL;
 }
 
-// _GetRefForID
-/*static*/ status_t
-ImageSequenceStream::_GetRefForID(const BString& serverID, entry_ref* ref)
+// _BytesPerRow
+uint32
+ImageSequenceStream::_BytesPerRow() const
 {
-	BString filename(serverID);
-	filename << "_preview_stream";
+	return ((fHeader.width * 2 + 3) / 4) * 4;
+}
 
-//	return = get_ref_for_id(filename, ref);
-	return get_ref_for_path(filename.String(), ref);
+// _InitSlices
+//
+// Divides the frame into slices of whole MCU rows (16 lines), there may
+// be fewer slices than requested for small frames.
+status_t
+ImageSequenceStream::_InitSlices(int32 count)
+{
+	uint32 sliceHeight = (fHeader.height + count - 1) / count;
+	sliceHeight = (sliceHeight + 15) / 16 * 16;
+	count = (fHeader.height + sliceHeight - 1) / sliceHeight;
+
+	fSlices = new (nothrow) image_slice[count];
+	if (!fSlices)
+		return B_NO_MEMORY;
+	memset(fSlices, 0, sizeof(image_slice) * count);
+	fHeader.sliceCount = count;
+
+	for (int32 i = 0; i < count; i++) {
+		fSlices[i].firstLine = i * sliceHeight;
+		fSlices[i].width = fHeader.width;
+		fSlices[i].height = min_c(sliceHeight,
+			fHeader.height - fSlices[i].firstLine);
+	}
+
+	return B_OK;
 }
 
-// create_planar_image_buffer
-template<typename jpeg_info>
-static JSAMPIMAGE
-create_planar_image_buffer(jpeg_info& cinfo)
+// _ReadFrame
+status_t
+ImageSequenceStream::_ReadFrame(uint8* buffer, uint32 bytesPerRow)
 {
-	int32 ySamplesPerRow = cinfo.comp_info[0].width_in_data_units * DCTSIZE;
-	int32 cSamplesPerRow = cinfo.comp_info[1].width_in_data_units * DCTSIZE;
-	int32 rowsPerWriteCall = cinfo.max_v_samp_factor * DCTSIZE;
+	if (!fStream || !fFrameOffsetMap || fWriting)
+		return B_NO_INIT;
+	if (fCurrentFrame < 0 || fCurrentFrame >= fHeader.frameCount)
+		return B_ERROR;
 
-	// use jpeglib terminology for sample, row and image
-	int32 yBufferSize = rowsPerWriteCall * ySamplesPerRow;
-	int32 cBufferSize = rowsPerWriteCall * cSamplesPerRow;
-	JSAMPROW yBuffer = new JSAMPLE[yBufferSize];
-	JSAMPROW cbBuffer = new JSAMPLE[cBufferSize];
-	JSAMPROW crBuffer = new JSAMPLE[cBufferSize];
+	off_t offset = fFrameOffsetMap[fCurrentFrame];
+	size_t size = fFrameOffsetMap[fCurrentFrame + 1] - offset;
 
-	JSAMPARRAY yPlane = new JSAMPROW[cinfo.comp_info[0].v_samp_factor * DCTSIZE];
-	JSAMPARRAY cbPlane = new JSAMPROW[cinfo.comp_info[1].v_samp_factor * DCTSIZE];
-	JSAMPARRAY crPlane = new JSAMPROW[cinfo.comp_info[2].v_samp_factor * DCTSIZE];
+	// ready to read next frame
+	fCurrentFrame++;
 
-	// assign pointers
-	for (int32 row = 0; row < rowsPerWriteCall; row++) {
-		yPlane[row] = yBuffer + row * ySamplesPerRow;
-		cbPlane[row] = cbBuffer + row * cSamplesPerRow;
-		crPlane[row] = crBuffer + row * cSamplesPerRow;
+	// read the whole frame at once, the slices are decoded from memory
+	if (size > fFrameDataSize) {
+		uint8* frameData = (uint8*)realloc(fFrameData, size);
+		if (!frameData)
+			return B_NO_MEMORY;
+		fFrameData = frameData;
+		fFrameDataSize = size;
+	}
+	ssize_t read = fStream->ReadAt(offset, fFrameData, size);
+	if (read != (ssize_t)size)
+		return read < 0 ? (status_t)read : B_IO_ERROR;
+
+	size_t sizesSize = sizeof(uint32) * fHeader.sliceCount;
+	if (size < sizesSize)
+		return B_BAD_DATA;
+
+	const uint32* sizes = (const uint32*)fFrameData;
+	const uint8* data = fFrameData + sizesSize;
+	size -= sizesSize;
+	for (int32 i = 0; i < fHeader.sliceCount; i++) {
+		if (sizes[i] > size)
+			return B_BAD_DATA;
+		image_slice& slice = fSlices[i];
+		slice.data = data;
+		slice.size = sizes[i];
+		slice.bits = buffer + slice.firstLine * bytesPerRow;
+		slice.bytesPerRow = bytesPerRow;
+		data += sizes[i];
+		size -= sizes[i];
 	}
 
-	JSAMPIMAGE imageData = new JSAMPARRAY[3];
-	imageData[0] = yPlane;
-	imageData[1] = cbPlane;
-	imageData[2] = crPlane;
+	return _ProcessSlices(false);
+}
 
-	return imageData;
+// _ProcessSlices
+status_t
+ImageSequenceStream::_ProcessSlices(bool encode)
+{
+	int32 count = fHeader.sliceCount;
+	if (fWorkerCount == 0 || count == 1) {
+		for (int32 i = 0; i < count; i++) {
+			fSlices[i].status = encode ? _EncodeSlice(&fSlices[i])
+				: _DecodeSlice(&fSlices[i]);
+		}
+	} else {
+		// each job token makes a worker process exactly one slice
+		fEncoding = encode;
+		atomic_set(&fNextSlice, 0);
+		release_sem_etc(fJobSem, count, 0);
+
+		status_t ret;
+		do {
+			ret = acquire_sem_etc(fDoneSem, count, 0, 0);
+		} while (ret == B_INTERRUPTED);
+		if (ret < B_OK)
+			return ret;
+	}
+
+	for (int32 i = 0; i < count; i++) {
+		if (fSlices[i].status < B_OK)
+			return fSlices[i].status;
+	}
+	return B_OK;
+}
+
+// _StopWorkers
+void
+ImageSequenceStream::_StopWorkers()
+{
+	// deleting the semaphore makes the workers quit
+	if (fJobSem >= B_OK)
+		delete_sem(fJobSem);
+	for (int32 i = 0; i < fWorkerCount; i++) {
+		status_t dummy;
+		wait_for_thread(fWorkers[i], &dummy);
+	}
+	if (fDoneSem >= B_OK)
+		delete_sem(fDoneSem);
+
+	delete[] fWorkers;
+	fWorkers = NULL;
+	fWorkerCount = 0;
+	fJobSem = -1;
+	fDoneSem = -1;
+}
+
+// _WorkerEntry
+int32
+ImageSequenceStream::_WorkerEntry(void* cookie)
+{
+	return ((ImageSequenceStream*)cookie)->_Worker();
 }
 
-// _EncodeBitmap
+// _Worker
+int32
+ImageSequenceStream::_Worker()
+{
+	while (true) {
+		status_t ret = acquire_sem(fJobSem);
+		if (ret == B_INTERRUPTED)
+			continue;
+		if (ret < B_OK)
+			break;
+
+		image_slice* slice = &fSlices[atomic_add(&fNextSlice, 1)];
+		slice->status = fEncoding ? _EncodeSlice(slice) : _DecodeSlice(slice);
+
+		release_sem(fDoneSem);
+	}
+
+	return B_OK;
+}
+
+// _EncodeSlice
 /*static*/ status_t
-ImageSequenceStream::_EncodeBitmap(const BBitmap* bitmap, BFile& file)
+ImageSequenceStream::_EncodeSlice(image_slice* slice)
 {
-#if 1
-	uint8* bits = (uint8*)bitmap->Bits();
-	int32 width = bitmap->Bounds().IntegerWidth() + 1;
-	int32 height = bitmap->Bounds().IntegerHeight() + 1;
-	int32 srcBPR = bitmap->BytesPerRow();
+	const uint8* bits = slice->bits;
+	uint32 width = slice->width;
+	uint32 height = slice->height;
+	uint32 srcBPR = slice->bytesPerRow;
 
 	// init jpeg writing
 	struct jpeg_compress_struct cinfo;
-	struct jpeg_error_mgr jerr;
-	cinfo.err = be_jpeg_std_error(&jerr);
+	error_manager error;
+	cinfo.err = jpeg_std_error(&error.pub);
+	error.pub.error_exit = error_exit;
+
+	if (setjmp(error.jump)) {
+		jpeg_destroy_compress(&cinfo);
+		return B_ERROR;
+	}
+
 	jpeg_create_compress(&cinfo);
-	be_jpeg_stdio_dest(&cinfo, &file);
+
+	memory_destination destination;
+	destination.pub.init_destination = init_destination;
+	destination.pub.empty_output_buffer = empty_output_buffer;
+	destination.pub.term_destination = term_destination;
+	destination.slice = slice;
+	cinfo.dest = &destination.pub;
 
 	// basic setup
 	cinfo.image_width = width;
@@ -532,49 +854,22 @@ ImageSequenceStream::_EncodeBitmap(const BBitmap* bitmap, BFile& file)
 	jpeg_start_compress(&cinfo, true);
 
 	int32 rowsPerWriteCall = cinfo.max_v_samp_factor * DCTSIZE;
-
-/*	int32 ySamplesPerRow = cinfo.comp_info[0].width_in_data_units * DCTSIZE;
-	int32 cSamplesPerRow = cinfo.comp_info[1].width_in_data_units * DCTSIZE;
-	int32 rowsPerWriteCall = cinfo.max_v_samp_factor * DCTSIZE;
-
-	// use jpeglib terminology for sample, row and image
-	int32 yBufferSize = rowsPerWriteCall * ySamplesPerRow;
-	int32 cBufferSize = rowsPerWriteCall * cSamplesPerRow;
-	JSAMPROW yBuffer = new JSAMPLE[yBufferSize];
-	JSAMPROW cbBuffer = new JSAMPLE[cBufferSize];
-	JSAMPROW crBuffer = new JSAMPLE[cBufferSize];
-
-	JSAMPARRAY yPlane = new JSAMPROW[cinfo.comp_info[0].v_samp_factor * DCTSIZE];
-	JSAMPARRAY cbPlane = new JSAMPROW[cinfo.comp_info[1].v_samp_factor * DCTSIZE];
-	JSAMPARRAY crPlane = new JSAMPROW[cinfo.comp_info[2].v_samp_factor * DCTSIZE];
-
-	// assign pointers
-	for (int32 row = 0; row < rowsPerWriteCall; row++) {
-		yPlane[row] = yBuffer + row * ySamplesPerRow;
-		cbPlane[row] = cbBuffer + row * cSamplesPerRow;
-		crPlane[row] = crBuffer + row * cSamplesPerRow;
-	}
-
-	JSAMPIMAGE imageData = new JSAMPARRAY[3];
-	imageData[0] = yPlane;
-	imageData[1] = cbPlane;
-	imageData[2] = crPlane;*/
-	JSAMPIMAGE imageData = create_planar_image_buffer(cinfo);
+	JSAMPIMAGE imageData = get_planar_image_buffer(slice, cinfo);
 
 	// iterate over scanlines and compress
 	while (cinfo.next_scanline < cinfo.image_height) {
 		// convert chunky YCbCr into planar YCbCr
 		for (int32 row = 0; row < rowsPerWriteCall; row++) {
 			// don't read more data than available
-			if ((int32)cinfo.next_scanline + row >= height)
+			if (cinfo.next_scanline + row >= height)
 				break;
 			// pointers to source and dest buffers
-			uint8* src = bits + row * srcBPR;
+			const uint8* src = bits + row * srcBPR;
 			uint8* yDest = imageData[0][row];
 			uint8* cbDest = imageData[1][row];
 			uint8* crDest = imageData[2][row];
 			// handle 2 pixels at a time
-			for (int32 x = 0; x < width / 2; x++) {
+			for (uint32 x = 0; x < width / 2; x++) {
 				yDest[0] = src[0];
 				cbDest[0] = src[1];
 				yDest[1] = src[2];
@@ -601,52 +896,40 @@ ImageSequenceStream::_EncodeBitmap(const BBitmap* bitmap, BFile& file)
 	jpeg_finish_compress(&cinfo);
 	jpeg_destroy_compress(&cinfo);
 
-	// delete buffers
-	// TODO: keep these around
-	delete[] imageData[0][0];
-	delete[] imageData[1][0];
-	delete[] imageData[2][0];
-
-	delete[] imageData[0];
-	delete[] imageData[1];
-	delete[] imageData[2];
-
-	delete[] imageData;
-
-#else
-	ssize_t written = file.Write(bitmap->Bits(), bitmap->BitsLength());
-	if (written != bitmap->BitsLength()) {
-		if (written < 0)
-			return (status_t)written;
-		return B_IO_ERROR;
-	}
-#endif
-
 	return B_OK;
 }
 
-// _DecodeBitmap
-status_t
-ImageSequenceStream::_DecodeBitmap(const BBitmap* bitmap, BFile& file)
+// _DecodeSlice
+/*static*/ status_t
+ImageSequenceStream::_DecodeSlice(image_slice* slice)
 {
-	uint8* bits = (uint8*)bitmap->Bits();
-	uint32 width = bitmap->Bounds().IntegerWidth() + 1;
-	uint32 height = bitmap->Bounds().IntegerHeight() + 1;
-	int32 dstBPR = bitmap->BytesPerRow();
-	return _DecodeBuffer(bits, width, height, dstBPR, file);
-}
+	uint8* bits = slice->bits;
+	uint32 width = slice->width;
+	uint32 height = slice->height;
+	uint32 dstBPR = slice->bytesPerRow;
 
-// _DecodeBuffer
-status_t
-ImageSequenceStream::_DecodeBuffer(uint8* bits,
-	uint32 width, uint32 height, uint32 dstBPR, BFile& file)
-{
 	// init jpeg reading
 	struct jpeg_decompress_struct cinfo;
-	struct jpeg_error_mgr jerr;
-	cinfo.err = be_jpeg_std_error(&jerr);
+	error_manager error;
+	cinfo.err = jpeg_std_error(&error.pub);
+	error.pub.error_exit = error_exit;
+
+	if (setjmp(error.jump)) {
+		jpeg_destroy_decompress(&cinfo);
+		return B_ERROR;
+	}
+
 	jpeg_create_decompress(&cinfo);
-	be_jpeg_stdio_src(&cinfo, &file);
+
+	struct jpeg_source_mgr source;
+	source.init_source = init_source;
+	source.fill_input_buffer = fill_input_buffer;
+	source.skip_input_data = skip_input_data;
+	source.resync_to_restart = jpeg_resync_to_restart;
+	source.term_source = term_source;
+	source.next_input_byte = slice->data;
+	source.bytes_in_buffer = slice->size;
+	cinfo.src = &source;
 
 	// read info about image
 	jpeg_read_header(&cinfo, true);
@@ -663,9 +946,9 @@ ImageSequenceStream::_DecodeBuffer(uint8* bits,
 
 	// check if this frame has correct settings
 	if (cinfo.output_height != height || cinfo.output_width != width) {
-		printf("JPEG frame and stream header incompatible (image size)\n");
-		printf("  width: %ld/%d\n", width, cinfo.output_width);
-		printf("  height: %ld/%d\n", height, cinfo.output_height);
+		print_error("JPEG frame and stream header incompatible (image size)\n");
+		print_error("  width: %ld/%d\n", width, cinfo.output_width);
+		print_error("  height: %ld/%d\n", height, cinfo.output_height);
 		jpeg_destroy_decompress(&cinfo);
 		return B_MISMATCHED_VALUES;
 	}
@@ -676,12 +959,12 @@ ImageSequenceStream::_DecodeBuffer(uint8* bits,
 		|| cinfo.comp_info[1].v_samp_factor != 2
 		|| cinfo.comp_info[2].h_samp_factor != 1
 		|| cinfo.comp_info[2].v_samp_factor != 2) {
-		printf("JPEG color space incompatible\n");
+		print_error("JPEG color space incompatible\n");
 		jpeg_destroy_decompress(&cinfo);
 		return B_MISMATCHED_VALUES;
 	}
 
-	JSAMPIMAGE imageData = create_planar_image_buffer(cinfo);
+	JSAMPIMAGE imageData = get_planar_image_buffer(slice, cinfo);
 	int32 rowsPerReadCall = cinfo.max_v_samp_factor * DCTSIZE;
 	uint32 rowsRead = 0;
 
@@ -690,7 +973,7 @@ ImageSequenceStream::_DecodeBuffer(uint8* bits,
 		// processes one "MCU row" per call
 		jpeg_read_raw_data(&cinfo, imageData, rowsPerReadCall);
 
-		// convert planaer YCbCr into chunky YCbCr
+		// convert planar YCbCr into chunky YCbCr
 		for (int32 row = 0; row < rowsPerReadCall; row++, rowsRead++) {
 			// don't write more data than available
 			if (rowsRead >= height)
@@ -725,27 +1008,5 @@ ImageSequenceStream::_DecodeBuffer(uint8* bits,
 	jpeg_finish_decompress(&cinfo);
 	jpeg_destroy_decompress(&cinfo);
 
-	// delete buffers
-	// TODO: keep these around
-	delete[] imageData[0][0];
-	delete[] imageData[1][0];
-	delete[] imageData[2][0];
-
-	delete[] imageData[0];
-	delete[] imageData[1];
-	delete[] imageData[2];
-
-	delete[] imageData;
-
 	return B_OK;
 }
-
-// _CheckStreamPosition
-void
-ImageSequenceStream::_CheckStreamPosition()
-{
-	off_t position = fFrameOffsetMap[(int32)fCurrentFrame];
-	if (fStream->Position() != position) {
-		SeekToFrame(fCurrentFrame);
-	}
-}
@@ -6,26 +6,52 @@
 #ifndef IMAGE_SEQUENCE_STREAM_H
 #define IMAGE_SEQUENCE_STREAM_H
 
+#include <OS.h>
+
 #include "RenderingBuffer.h"
 
 class BBitmap;
 class BFile;
-class VideoClip;
-
+struct image_slice;
+
+// ImageSequenceStream
+//
+// A file of YCbCr422 frames, each compressed as a JPEG from the raw
+// YCbCr data, so that neither encoding nor decoding needs a colorspace
+// conversion. The frames are preceded by a header and a map of the frame
+// offsets, which allows seeking to any frame. Each frame can be split
+// into horizontal slices, which are independent JPEGs, so that they can
+// be encoded and decoded concurrently by a pool of worker threads.
 class ImageSequenceStream {
  public:
+	enum {
+		MAX_SLICE_COUNT			= 16
+	};
+
 								ImageSequenceStream();
 	virtual						~ImageSequenceStream();
 
-			status_t			Init(const BString& id);
-			status_t			Init(uint32 width, uint32 height,
-									pixel_format format, int64 frameCount,
-									const BString& id);
+			// opens an existing stream for reading
+			status_t			Init(const char* path);
+			// creates a new stream for writing /frameCount/ frames
+			status_t			Init(const char* path, uint32 width,
+									uint32 height, pixel_format format,
+									int64 frameCount, int32 sliceCount = 1);
+
+			// the slices of each frame are processed by this many
+			// threads, 0 means by the calling thread only
+			status_t			SetWorkerCount(int32 count);
+			int32				CountWorkers() const
+									{ return fWorkerCount; }
 
 			status_t			GetFormat(uint32* width,
 									uint32* height,
 									pixel_format* format,
 									uint32* bytesPerRow) const;
+			int64				CountFrames() const
+									{ return fHeader.frameCount; }
+			int32				CountSlices() const
+									{ return fHeader.sliceCount; }
 
 			status_t			SeekToFrame(int64 frame);
 			int64				CurrentFrame() const
@@ -34,41 +60,56 @@ class ImageSequenceStream {
 			status_t			ReadFrame(uint8* buffer);
 			const BBitmap*		ReadFrame();
 
-			status_t			WriteFrame(uint8* buffer);
+			status_t			WriteFrame(const uint8* buffer);
+			// writes the frame offsets, the stream cannot be
+			// written to anymore afterwards
 			status_t			Finalize();
 
-	static	status_t			CreateStream(const BString& id,
-									VideoClip* renderer);
-
  private:
 			struct stream_header {
 								stream_header();
-								stream_header(uint32 width, uint32 height,
-									pixel_format format);
+				uint32			magic;
 				uint32			width;
 				uint32			height;
 				pixel_format	format;
+				int32			sliceCount;
 				int64			frameCount;
 			};
 
 			void				_MakeEmpty();
-	static	status_t			_GetRefForID(const BString& serverID,
-									entry_ref* ref);
-	static	status_t			_EncodeBitmap(const BBitmap* bitmap,
-									BFile& file);
-			status_t			_DecodeBitmap(const BBitmap* bitmap,
-									BFile& file);
-			status_t			_DecodeBuffer(uint8* buffer,
-									uint32 width, uint32 height, uint32 bpr,
-									BFile& file);
-			void				_CheckStreamPosition();
+			uint32				_BytesPerRow() const;
+			status_t			_InitSlices(int32 count);
+			status_t			_ReadFrame(uint8* buffer, uint32 bytesPerRow);
+			status_t			_ProcessSlices(bool encode);
+			void				_StopWorkers();
+
+	static	int32				_WorkerEntry(void* cookie);
+			int32				_Worker();
+
+	static	status_t			_EncodeSlice(image_slice* slice);
+	static	status_t			_DecodeSlice(image_slice* slice);
 
 			stream_header		fHeader;
 			int64				fCurrentFrame;
 
 			BFile*				fStream;
+			bool				fWriting;
 
 			off_t*				fFrameOffsetMap;
+				// one more entry than frames,
+				// the last one is the end of the stream
+
+			image_slice*		fSlices;
+			uint8*				fFrameData;
+			size_t				fFrameDataSize;
+				// the compressed frame which is being decoded
+
+			thread_id*			fWorkers;
+			int32				fWorkerCount;
+			sem_id				fJobSem;
+			sem_id				fDoneSem;
+			vint32				fNextSlice;
+			bool				fEncoding;
 
 			BBitmap*			fDecodedBitmap;
 };
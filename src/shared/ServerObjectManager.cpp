@@ -6,6 +6,7 @@
 
 #include "ServerObjectManager.h"
 
+#include <new>
 #include <stdio.h>
 #include <string.h>
 
@@ -15,16 +16,23 @@
 
 #include "common.h"
 
+#include "AutoLocker.h"
 #include "CommonPropertyIDs.h"
 #include "OptionProperty.h"
 #include "ProgressReporter.h"
 #include "ServerObject.h"
 #include "ServerObjectFactory.h"
 
+using std::nothrow;
+
 int64	ServerObjectManager::sBaseID(real_time_clock_usecs());
 int32	ServerObjectManager::sNextID(0);
 BString ServerObjectManager::sClientID("client0001");
 
+// rough estimate of what one instantiated Property costs in memory,
+// used for accounting the resident size of lazily loaded objects
+static const size_t kEstimatedPropertySize = 64;
+
 
 // constructor
 SOMListener::SOMListener()
@@ -80,6 +88,13 @@ ServerObjectManager::ServerObjectManager()
 	, fObjects(128)
 	, fIDObjectMap()
 	, fListeners(16)
+	, fIndexLock("object index lock")
+	, fMaterializeLock("object materialize lock")
+	, fIndex()
+	, fLazyLoading(false)
+	, fResidentMemoryLimit(0)
+	, fResidentMemoryUsage(0)
+	, fAccessCounter(0)
 	, fStateNeedsSaving(false)
 	, fLoadRemovedObjects(true)
 {
@@ -94,6 +109,7 @@ ServerObjectManager::~ServerObjectManager()
 				 "listeners attached\n");
 	}
 	_MakeEmpty();
+	_MakeIndexEmpty();
 }
 
 //	#pragma mark -
@@ -205,6 +221,7 @@ ServerObjectManager::RemoveObject(ServerObject* object)
 	if (success) {
 		object->DetachedFromManager();
 		fIDObjectMap.Remove(object->ID().String());
+		_RemoveIndexEntry(object);
 		_NotifyObjectRemoved(object);
 // NOTE only needed for xml based object manager, deprecated
 //		_StateChanged();
@@ -221,6 +238,7 @@ ServerObjectManager::RemoveObject(int32 index)
 	if (object) {
 		object->DetachedFromManager();
 		fIDObjectMap.Remove(object->ID().String());
+		_RemoveIndexEntry(object);
 		_NotifyObjectRemoved(object);
 // NOTE only needed for xml based object manager, deprecated
 //		_StateChanged();
@@ -235,6 +253,9 @@ ServerObjectManager::RemoveObject(int32 index)
 int32
 ServerObjectManager::CountObjects() const
 {
+	// NOTE: in lazy mode, FindObject() appends to the object list while
+	// other threads may only hold the read lock
+	AutoLocker<BLocker> indexLocker(fLazyLoading ? &fIndexLock : NULL);
 	return fObjects.CountItems();
 }
 
@@ -244,6 +265,7 @@ ServerObjectManager::HasObject(ServerObject* object) const
 {
 	if (!object)
 		return false;
+	AutoLocker<BLocker> indexLocker(fLazyLoading ? &fIndexLock : NULL);
 //	return fObjects.HasItem((void*)object);
 	return fIDObjectMap.ContainsKey(object->ID().String());
 }
@@ -252,6 +274,7 @@ ServerObjectManager::HasObject(ServerObject* object) const
 int32
 ServerObjectManager::IndexOf(ServerObject* object) const
 {
+	AutoLocker<BLocker> indexLocker(fLazyLoading ? &fIndexLock : NULL);
 	return fObjects.IndexOf((void*)object);
 }
 
@@ -262,6 +285,7 @@ void
 ServerObjectManager::MakeEmpty()
 {
 	_MakeEmpty();
+	_MakeIndexEmpty();
 	_StateChanged();
 }
 
@@ -271,6 +295,7 @@ ServerObjectManager::MakeEmpty()
 ServerObject*
 ServerObjectManager::ObjectAt(int32 index) const
 {
+	AutoLocker<BLocker> indexLocker(fLazyLoading ? &fIndexLock : NULL);
 	return (ServerObject*)fObjects.ItemAt(index);
 }
 
@@ -278,6 +303,7 @@ ServerObjectManager::ObjectAt(int32 index) const
 ServerObject*
 ServerObjectManager::ObjectAtFast(int32 index) const
 {
+	AutoLocker<BLocker> indexLocker(fLazyLoading ? &fIndexLock : NULL);
 	return (ServerObject*)fObjects.ItemAtFast(index);
 }
 
@@ -287,6 +313,77 @@ ServerObjectManager::ObjectAtFast(int32 index) const
 ServerObject*
 ServerObjectManager::FindObject(const BString& serverID) const
 {
+	if (fLazyLoading) {
+		{
+			AutoLocker<BLocker> indexLocker(fIndexLock);
+
+			IndexEntry* entry = fIndex.Get(serverID.String());
+			if (!entry) {
+				if (!fIDObjectMap.ContainsKey(serverID.String()))
+					return NULL;
+				return fIDObjectMap.Get(serverID.String()).value;
+			}
+
+			entry->lastAccess = ++fAccessCounter;
+			if (entry->published)
+				return entry->object;
+		}
+
+		// Objects are materialized one at a time and only published in
+		// the object list once their dependencies are resolved, so other
+		// threads never get to see a half initialized object. The lock
+		// is recursive, resolving the dependencies of an object may
+		// materialize other objects, and in case of a cycle finds the
+		// still unpublished object itself.
+		AutoLocker<BLocker> materializeLocker(fMaterializeLock);
+
+		ServerObject* object;
+		{
+			AutoLocker<BLocker> indexLocker(fIndexLock);
+
+			IndexEntry* entry = fIndex.Get(serverID.String());
+			if (!entry)
+				return NULL;
+			if (entry->object)
+				return entry->object;
+
+			object = _MaterializeObject(serverID, entry);
+			if (!object)
+				return NULL;
+		}
+
+		// the object has been reached only now, so it did not take part
+		// in any previous ResolveDependencies() run. The index lock is not
+		// held, since resolving may find (and materialize) other objects.
+		status_t ret = object->ResolveDependencies(this);
+		object->SetDependenciesResolved(ret == B_OK);
+
+		int32 index;
+		{
+			AutoLocker<BLocker> indexLocker(fIndexLock);
+
+			IndexEntry* entry = fIndex.Get(serverID.String());
+			index = entry && entry->object == object
+				? _PublishObject(serverID, entry) : -1;
+			if (index < 0) {
+				if (entry && entry->object == object) {
+					fResidentMemoryUsage -= entry->residentSize;
+					entry->residentSize = 0;
+					entry->object = NULL;
+				}
+				object->Release();
+				return NULL;
+			}
+		}
+		materializeLocker.Unlock();
+
+		// the listeners may lock the document, so they are notified
+		// without holding any of the locks
+		_NotifyObjectAdded(object, index);
+
+		return object;
+	}
+
 	if (!fIDObjectMap.ContainsKey(serverID.String()))
 		return NULL;
 
@@ -312,6 +409,16 @@ ServerObjectManager::IDChanged(ServerObject* object,
 {
 printf("ServerObjectManager::IDChanged(%s)\n", object->Name().String());
 	fIDObjectMap.Remove(oldID.String());
+
+	if (fLazyLoading) {
+		AutoLocker<BLocker> indexLocker(fIndexLock);
+		IndexEntry* entry = fIndex.Remove(oldID.String());
+		if (entry && fIndex.Put(object->ID().String(), entry) < B_OK) {
+			fResidentMemoryUsage -= entry->residentSize;
+			delete entry;
+		}
+	}
+
 	return fIDObjectMap.Put(object->ID().String(), object);
 }
 
@@ -331,6 +438,9 @@ ServerObjectManager::ResolveDependencies(ProgressReporter* reporter) const
 	// now resolve the dependencies, but due to it's
 	// sometimes being recursive, we can check if an object
 	// is already valid
+	// NOTE: in lazy mode, only the resident objects are resolved here,
+	// any object that is materialized on the way resolves it's own
+	// dependencies
 	int32 progressStep = max_c(1, count / 500);
 	for (int32 i = 0; i < count; i++) {
 		if (reporter && i % progressStep == 0)
@@ -349,16 +459,12 @@ ServerObjectManager::ResolveDependencies(ProgressReporter* reporter) const
 void
 ServerObjectManager::UpdateVersion(const BString& serverID, int32 version)
 {
-	int32 count = CountObjects();
-	for (int32 i = 0; i < count; i++) {
-		ServerObject* object = ObjectAtFast(i);
-		if (object->ID() == serverID) {
+	ServerObject* object = FindObject(serverID);
+	if (object) {
 printf("found object %s, setting published (version: %ld)\n",
 serverID.String(), version);
-			object->SetPublished(version);
-			_StateChanged();
-			break;
-		}
+		object->SetPublished(version);
+		_StateChanged();
 	}
 }
 
@@ -478,6 +584,269 @@ ServerObjectManager::GetRef(const ServerObject* object, entry_ref& ref)
 
 // #pragma mark -
 
+// SetLazyLoading
+void
+ServerObjectManager::SetLazyLoading(bool lazy)
+{
+	if (lazy == fLazyLoading)
+		return;
+
+	if (CountObjects() > 0 || fIndex.Size() > 0) {
+		print_error("ServerObjectManager::SetLazyLoading() - "
+			"cannot switch loading mode of a populated library, ignoring!\n");
+		return;
+	}
+	fLazyLoading = lazy;
+}
+
+// SetResidentMemoryLimit
+void
+ServerObjectManager::SetResidentMemoryLimit(size_t bytes)
+{
+	fResidentMemoryLimit = bytes;
+	TrimResidentObjects();
+}
+
+// TrimResidentObjects
+void
+ServerObjectManager::TrimResidentObjects()
+{
+	// NOTE: the library is supposed to be write locked, since evicted
+	// objects are removed from the object list. Objects are not evicted
+	// from within FindObject(), since the caller may not yet have had the
+	// chance to acquire a reference to previously found objects.
+	if (!fLazyLoading || fResidentMemoryLimit == 0)
+		return;
+
+	// evicting an object may release the last reference to objects it
+	// depends on, so keep going as long as there is progress
+	bool evicted = true;
+	while (evicted && fResidentMemoryUsage > fResidentMemoryLimit) {
+		// the evicted objects replace their entries in the candidates
+		BList candidates(fIndex.Size());
+		int32 evictedCount = 0;
+		{
+			AutoLocker<BLocker> indexLocker(fIndexLock);
+
+			// collect the evictable objects, which are those only
+			// referenced by the library and which don't contain unsaved
+			// changes
+			IDIndexMap::Iterator iterator = fIndex.GetIterator();
+			while (iterator.HasNext()) {
+				IndexEntry* entry = iterator.Next().value;
+				ServerObject* object = entry->object;
+				if (!object || object->CountReferences() > 1
+					|| !object->IsMetaDataSaved()
+					|| (!object->IsMetaDataOnly() && !object->IsDataSaved())) {
+					continue;
+				}
+				if (!candidates.AddItem((void*)entry))
+					break;
+			}
+
+			// evict the least recently used ones first
+			candidates.SortItems(_CompareLastAccess);
+
+			int32 count = candidates.CountItems();
+			for (int32 i = 0; i < count
+					&& fResidentMemoryUsage > fResidentMemoryLimit; i++) {
+				IndexEntry* entry = (IndexEntry*)candidates.ItemAtFast(i);
+				ServerObject* object = _EvictObject(entry);
+				if (object)
+					candidates.ReplaceItem(evictedCount++, (void*)object);
+			}
+		}
+
+		// notify the listeners without holding the index lock
+		for (int32 i = 0; i < evictedCount; i++) {
+			ServerObject* object = (ServerObject*)candidates.ItemAtFast(i);
+			_NotifyObjectRemoved(object);
+			object->Release();
+		}
+		evicted = evictedCount > 0;
+	}
+}
+
+// LoadObjectsOfType
+void
+ServerObjectManager::LoadObjectsOfType(const char* type) const
+{
+	if (!fLazyLoading)
+		return;
+
+	BList ids;
+	{
+		AutoLocker<BLocker> indexLocker(fIndexLock);
+
+		IDIndexMap::Iterator iterator = fIndex.GetIterator();
+		while (iterator.HasNext()) {
+			IDIndexMap::Entry entry = iterator.Next();
+			if (entry.value->object || entry.value->type != type)
+				continue;
+			BString* id = new (nothrow) BString(entry.key.GetString());
+			if (!id || !ids.AddItem((void*)id)) {
+				delete id;
+				break;
+			}
+		}
+	}
+
+	int32 count = ids.CountItems();
+	for (int32 i = 0; i < count; i++) {
+		BString* id = (BString*)ids.ItemAtFast(i);
+		FindObject(*id);
+		delete id;
+	}
+}
+
+// SyncIndex
+status_t
+ServerObjectManager::SyncIndex(const ServerObjectManager& source)
+{
+	// NOTE: the library is supposed to be write locked
+	if (!fLazyLoading || !source.fLazyLoading)
+		return B_BAD_VALUE;
+
+	// the resident objects which no longer exist or which changed
+	// are collected, since they are removed or reloaded without
+	// holding the index lock
+	BList removedObjects;
+	BList changedObjects;
+	status_t ret = B_OK;
+	{
+		AutoLocker<BLocker> indexLocker(fIndexLock);
+		AutoLocker<BLocker> sourceLocker(source.fIndexLock);
+
+		BList removedIDs;
+		IDIndexMap::Iterator iterator = fIndex.GetIterator();
+		while (iterator.HasNext()) {
+			IDIndexMap::Entry entry = iterator.Next();
+			if (source.fIndex.ContainsKey(entry.key))
+				continue;
+			if (entry.value->object) {
+				if (removedObjects.AddItem((void*)entry.value->object))
+					entry.value->object->Acquire();
+			} else {
+				BString* id = new (nothrow) BString(entry.key.GetString());
+				if (!id || !removedIDs.AddItem((void*)id))
+					delete id;
+			}
+		}
+		int32 count = removedIDs.CountItems();
+		for (int32 i = 0; i < count; i++) {
+			BString* id = (BString*)removedIDs.ItemAtFast(i);
+			delete fIndex.Remove(id->String());
+			delete id;
+		}
+
+		iterator = source.fIndex.GetIterator();
+		while (iterator.HasNext() && ret == B_OK) {
+			IDIndexMap::Entry sourceEntry = iterator.Next();
+			IndexEntry* entry = fIndex.Get(sourceEntry.key);
+			if (!entry) {
+				// objects added at runtime are not indexed
+				if (!fIDObjectMap.ContainsKey(sourceEntry.key))
+					ret = _AddIndexEntry(sourceEntry.key, *sourceEntry.value);
+				continue;
+			}
+			if (entry->version == sourceEntry.value->version)
+				continue;
+
+			entry->type = sourceEntry.value->type;
+			entry->version = sourceEntry.value->version;
+			entry->dataSize = sourceEntry.value->dataSize;
+			if (entry->object
+				&& changedObjects.AddItem((void*)entry->object)) {
+				entry->object->Acquire();
+			}
+		}
+	}
+
+	int32 count = removedObjects.CountItems();
+	for (int32 i = 0; i < count; i++) {
+		ServerObject* object = (ServerObject*)removedObjects.ItemAtFast(i);
+		if (RemoveObject(object))
+			object->Release();
+		object->Release();
+	}
+
+	// the changed objects are synced to a fresh instance, so that the
+	// objects referencing them don't need to be updated
+	count = changedObjects.CountItems();
+	for (int32 i = 0; i < count; i++) {
+		ServerObject* object = (ServerObject*)changedObjects.ItemAtFast(i);
+		ServerObject* newObject = InstantiateIndexedObject(object->ID(),
+			object->Type());
+		if (newObject) {
+			status_t error = object->SetTo(newObject);
+			if (error == B_NO_MEMORY && ret == B_OK)
+				ret = error;
+			newObject->Release();
+		}
+		object->Release();
+	}
+
+	return ret;
+}
+
+// AddIndexEntry
+status_t
+ServerObjectManager::AddIndexEntry(const BString& id, const BString& type,
+	int32 version, size_t dataSize)
+{
+	if (!fLazyLoading || id.Length() == 0)
+		return B_BAD_VALUE;
+
+	AutoLocker<BLocker> indexLocker(fIndexLock);
+
+	IndexEntry entry;
+	entry.type = type;
+	entry.version = version;
+	entry.dataSize = dataSize;
+	return _AddIndexEntry(id.String(), entry);
+}
+
+// IsIndexed
+bool
+ServerObjectManager::IsIndexed(const BString& id) const
+{
+	AutoLocker<BLocker> indexLocker(fIndexLock);
+	return fIndex.ContainsKey(id.String());
+}
+
+// CountIndexedObjects
+int32
+ServerObjectManager::CountIndexedObjects() const
+{
+	AutoLocker<BLocker> indexLocker(fIndexLock);
+	return fIndex.Size();
+}
+
+// CountResidentObjects
+int32
+ServerObjectManager::CountResidentObjects() const
+{
+	return CountObjects();
+}
+
+// ResidentMemoryUsage
+size_t
+ServerObjectManager::ResidentMemoryUsage() const
+{
+	return fResidentMemoryUsage;
+}
+
+// InstantiateIndexedObject
+ServerObject*
+ServerObjectManager::InstantiateIndexedObject(const BString& id,
+	const BString& type)
+{
+	// the base class doesn't know where objects are stored
+	return NULL;
+}
+
+// #pragma mark -
+
 // SetLoadRemovedObjects
 void
 ServerObjectManager::SetLoadRemovedObjects(bool load)
@@ -541,6 +910,156 @@ ServerObjectManager::_MakeEmpty()
 	fObjects.MakeEmpty();
 }
 
+// _MaterializeObject
+ServerObject*
+ServerObjectManager::_MaterializeObject(const BString& id,
+	IndexEntry* entry) const
+{
+	// NOTE: fIndexLock and fMaterializeLock are held, the object is
+	// not yet in the object list
+	ServerObjectManager* self = const_cast<ServerObjectManager*>(this);
+
+	ServerObject* object = self->InstantiateIndexedObject(id, entry->type);
+	if (!object) {
+		print_error("ServerObjectManager::_MaterializeObject() - "
+			"failed to instantiate object %s (%s)\n", id.String(),
+			entry->type.String());
+		return NULL;
+	}
+
+	entry->object = object;
+	entry->version = object->Version();
+	entry->residentSize = sizeof(ServerObject)
+		+ object->CountProperties() * kEstimatedPropertySize;
+	if (!object->IsExternalData())
+		entry->residentSize += entry->dataSize;
+	fResidentMemoryUsage += entry->residentSize;
+
+	return object;
+}
+
+// _PublishObject
+int32
+ServerObjectManager::_PublishObject(const BString& id,
+	IndexEntry* entry) const
+{
+	// NOTE: fIndexLock and fMaterializeLock are held
+	ServerObjectManager* self = const_cast<ServerObjectManager*>(this);
+	ServerObject* object = entry->object;
+
+	// NOTE: AddObject() is not used, since materializing an object is
+	// not a change in state of the library
+	if (self->fIDObjectMap.Put(id.String(), object) < B_OK)
+		return -1;
+	if (!self->fObjects.AddItem((void*)object)) {
+		self->fIDObjectMap.Remove(id.String());
+		return -1;
+	}
+
+	object->AttachedToManager(self);
+	entry->published = true;
+
+	return self->fObjects.CountItems() - 1;
+}
+
+// _EvictObject
+ServerObject*
+ServerObjectManager::_EvictObject(IndexEntry* entry)
+{
+	// NOTE: fIndexLock is held, the caller notifies the listeners
+	// and releases the object
+	ServerObject* object = entry->object;
+	if (!object || !fObjects.RemoveItem((void*)object))
+		return NULL;
+
+	fIDObjectMap.Remove(object->ID().String());
+	object->DetachedFromManager();
+
+	fResidentMemoryUsage -= entry->residentSize;
+	entry->residentSize = 0;
+	entry->object = NULL;
+	entry->published = false;
+
+	return object;
+}
+
+// _AddIndexEntry
+status_t
+ServerObjectManager::_AddIndexEntry(const HashString& id,
+	const IndexEntry& source)
+{
+	// NOTE: fIndexLock is held
+	if (fIndex.ContainsKey(id) || fIDObjectMap.ContainsKey(id))
+		return B_OK;
+
+	IndexEntry* entry = new (nothrow) IndexEntry;
+	if (!entry)
+		return B_NO_MEMORY;
+
+	entry->type = source.type;
+	entry->version = source.version;
+	entry->dataSize = source.dataSize;
+	entry->residentSize = 0;
+	entry->lastAccess = 0;
+	entry->object = NULL;
+	entry->published = false;
+
+	if (fIndex.Put(id, entry) < B_OK) {
+		delete entry;
+		return B_NO_MEMORY;
+	}
+
+	return B_OK;
+}
+
+// _RemoveIndexEntry
+void
+ServerObjectManager::_RemoveIndexEntry(ServerObject* object)
+{
+	if (!fLazyLoading)
+		return;
+
+	AutoLocker<BLocker> indexLocker(fIndexLock);
+
+	BString id = object->ID();
+	IndexEntry* entry = fIndex.Get(id.String());
+	if (!entry || entry->object != object)
+		return;
+
+	fIndex.Remove(id.String());
+	fResidentMemoryUsage -= entry->residentSize;
+	delete entry;
+}
+
+// _CompareLastAccess
+/*static*/ int
+ServerObjectManager::_CompareLastAccess(const void* _a, const void* _b)
+{
+	const IndexEntry* a = *(const IndexEntry**)_a;
+	const IndexEntry* b = *(const IndexEntry**)_b;
+	if (a->lastAccess < b->lastAccess)
+		return -1;
+	if (a->lastAccess > b->lastAccess)
+		return 1;
+	return 0;
+}
+
+// _MakeIndexEmpty
+void
+ServerObjectManager::_MakeIndexEmpty()
+{
+	// NOTE: the resident objects have already been released
+	// by _MakeEmpty()
+	AutoLocker<BLocker> indexLocker(fIndexLock);
+
+	IDIndexMap::Iterator iterator = fIndex.GetIterator();
+	while (iterator.HasNext())
+		delete iterator.Next().value;
+	fIndex.Clear();
+
+	fResidentMemoryUsage = 0;
+}
+
 // #pragma mark -
 
 // _NotifyObjectAdded
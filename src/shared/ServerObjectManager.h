@@ -8,6 +8,7 @@
 #define SERVER_OBJECT_MANAGER_H
 
 #include <List.h>
+#include <Locker.h>
 #include <String.h>
 
 #include "AbstractLOAdapter.h"
@@ -118,7 +119,67 @@ class ServerObjectManager {
 	virtual	status_t			GetRef(const BString& id, entry_ref& ref);
 	virtual status_t			GetRef(const ServerObject* object, entry_ref& ref);
 
+	// lazy loading
+	// NOTE: In lazy mode, objects are only indexed by ID, type and version
+	// when the library is loaded. The full object is instantiated the first
+	// time it is reached via FindObject() (which includes dependency
+	// resolution). Only resident objects are in the object list, so code
+	// which iterates over the objects to find all of a certain type needs
+	// to call LoadObjectsOfType() first. Since FindObject() may append to
+	// the object list while only the read lock is held, the list accessors
+	// serialize with it via the index lock in lazy mode.
+			void				SetLazyLoading(bool lazy);
+			bool				LazyLoading() const
+									{ return fLazyLoading; }
+
+			void				SetResidentMemoryLimit(size_t bytes);
+			size_t				ResidentMemoryLimit() const
+									{ return fResidentMemoryLimit; }
+			void				TrimResidentObjects();
+			void				LoadObjectsOfType(const char* type) const;
+
+								// Updates the index from a library which
+								// has just been indexed from disk. Objects
+								// which no longer exist are removed, the
+								// resident ones which changed are reloaded.
+			status_t			SyncIndex(
+									const ServerObjectManager& source);
+
+			status_t			AddIndexEntry(const BString& id,
+									const BString& type, int32 version,
+									size_t dataSize);
+			bool				IsIndexed(const BString& id) const;
+			int32				CountIndexedObjects() const;
+			int32				CountResidentObjects() const;
+			size_t				ResidentMemoryUsage() const;
+
+ protected:
+	virtual	ServerObject*		InstantiateIndexedObject(const BString& id,
+									const BString& type);
+
  private:
+			struct IndexEntry {
+				BString			type;
+				int32			version;
+				size_t			dataSize;
+				size_t			residentSize;
+				uint32			lastAccess;
+				ServerObject*	object;
+				bool			published;
+			};
+
+			ServerObject*		_MaterializeObject(const BString& id,
+									IndexEntry* entry) const;
+			int32				_PublishObject(const BString& id,
+									IndexEntry* entry) const;
+			ServerObject*		_EvictObject(IndexEntry* entry);
+			status_t			_AddIndexEntry(const HashString& id,
+									const IndexEntry& source);
+			void				_RemoveIndexEntry(ServerObject* object);
+	static	int					_CompareLastAccess(const void* a,
+									const void* b);
+			void				_MakeIndexEmpty();
+
 			void				_StateChanged();
 			void				_MakeEmpty();
 
@@ -130,6 +191,7 @@ class ServerObjectManager {
 			RWLocker*			fLocker;
 
 	typedef HashMap<HashString, HashKey32<ServerObject*> > IDObjectMap;
+	typedef HashMap<HashString, IndexEntry*> IDIndexMap;
 
 			BString				fDirectory;
 
@@ -138,6 +200,14 @@ class ServerObjectManager {
 
 			BList				fListeners;
 
+	mutable	BLocker				fIndexLock;
+	mutable	BLocker				fMaterializeLock;
+			IDIndexMap			fIndex;
+			bool				fLazyLoading;
+			size_t				fResidentMemoryLimit;
+	mutable	size_t				fResidentMemoryUsage;
+	mutable	uint32				fAccessCounter;
+
 	static	int64				sBaseID;
 	static	int32				sNextID;
 	static	BString				sClientID;
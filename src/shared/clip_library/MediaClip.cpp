@@ -18,13 +18,23 @@
 #include "AudioTrackReader.h"
 #include "AutoDeleter.h"
 #include "CommonPropertyIDs.h"
+#include "DecodedAudioCache.h"
 #include "Icons.h"
+#include "LoudnessAnalyzer.h"
 #include "MediaRenderingBuffer.h"
 #include "Painter.h"
+#include "ThumbnailCache.h"
 #include "ToneProducerReader.h"
+#include "WaveformCache.h"
 
 using std::nothrow;
 
+enum {
+	LOUDNESS_UNKNOWN	= 0,
+	LOUDNESS_PENDING	= 1,
+	LOUDNESS_KNOWN		= 2
+};
+
 #define DEBUG_DECODED_FRAME 0
 #if DEBUG_DECODED_FRAME
 #  include <Bitmap.h>
@@ -45,7 +55,10 @@ MediaClip::MediaClip(const entry_ref* ref,
 	  fVideoFrameCount(0),
 	  fAudioFrameCount(0),
 	  fVideoFPS(0.0),
-	  fAudioFPS(0.0)
+	  fAudioFPS(0.0),
+	  fAudioPeak(1.0),
+	  fAudioLoudness(0.0),
+	  fAudioLoudnessState(LOUDNESS_UNKNOWN)
 {
 	if (videoTrack) {
 		media_format format;
@@ -92,7 +105,10 @@ MediaClip::MediaClip(const entry_ref* ref, const BMessage& archive)
 	  fVideoFrameCount(0),
 	  fAudioFrameCount(0),
 	  fVideoFPS(0.0),
-	  fAudioFPS(0.0)
+	  fAudioFPS(0.0),
+	  fAudioPeak(1.0),
+	  fAudioLoudness(0.0),
+	  fAudioLoudnessState(LOUDNESS_UNKNOWN)
 {
 	if (archive.FindInt64("video frames", (int64*)&fVideoFrameCount) == B_OK
 		&& archive.FindFloat("video fps", &fVideoFPS) == B_OK
@@ -103,6 +119,10 @@ MediaClip::MediaClip(const entry_ref* ref, const BMessage& archive)
 		&& archive.FindFloat("audio fps", &fAudioFPS) == B_OK)
 		fHasAudioTrack = true;
 
+	if (archive.FindFloat("audio peak", &fAudioPeak) == B_OK
+		&& archive.FindFloat("audio loudness", &fAudioLoudness) == B_OK)
+		fAudioLoudnessState = LOUDNESS_KNOWN;
+
 	SetValue(PROPERTY_WIDTH, fBounds.Width() + 1);
 	SetValue(PROPERTY_HEIGHT, fBounds.Height() + 1);
 }
@@ -175,10 +195,16 @@ MediaClip::CreateAudioReader()
 		media_format format;
 		format.type = B_MEDIA_RAW_AUDIO;
 		format.u.raw_audio = media_raw_audio_format::wildcard;
-		AudioReader* reader
+		AudioTrackReader* reader
 			= new (nothrow) AudioTrackReader(mediaFile, audioTrack, format);
-		if (reader)
+		if (reader) {
 			fileDeleter.Detach();
+			if (DecodedAudioCache* cache = DecodedAudioCache::Default()) {
+				BString key(ID());
+				key << "-" << Version() << "-" << ChangeToken();
+				reader->SetBlockCache(cache, key.String());
+			}
+		}
 		return reader;
 	}
 	return NULL;
@@ -196,6 +222,18 @@ MediaClip::Bounds(BRect canvasBounds)
 bool
 MediaClip::GetIcon(BBitmap* icon)
 {
+	// use a thumbnail of the video if it has already been decoded,
+	// this never blocks on the decoder
+	ThumbnailCache* cache = ThumbnailCache::Default();
+	if (cache) {
+		ThumbnailStrip* thumbnails = cache->CachedThumbnails(this);
+		if (thumbnails) {
+			bool success = thumbnails->GetIcon(icon);
+			thumbnails->Release();
+			if (success)
+				return true;
+		}
+	}
 	return GetBuiltInIcon(icon, kMovieIcon);
 }
 
@@ -218,6 +256,58 @@ MediaClip::HandleReload()
 	// NOTE: I think there is nothing to be done here, since
 	// the Clip baseclass already increments a change counter which
 	// in turn will cause the renderer to be newly instantiated
+
+	// the file may have changed without a new version
+	if (ThumbnailCache* cache = ThumbnailCache::Default())
+		cache->Forget(this);
+	if (WaveformCache* cache = WaveformCache::Default())
+		cache->Forget(this);
+	// the loudness needs to be measured again
+	if (atomic_set(&fAudioLoudnessState, LOUDNESS_UNKNOWN) == LOUDNESS_KNOWN)
+		_StoreArchive();
+}
+
+// GetAudioLoudness
+bool
+MediaClip::GetAudioLoudness(float* _peak, float* _loudness)
+{
+	// the token is taken before the state, so that a reload in between
+	// makes the result of the analysis stale rather than the state
+	uint32 changeToken = ChangeToken();
+	int32 state = atomic_test_and_set(&fAudioLoudnessState, LOUDNESS_PENDING,
+		LOUDNESS_UNKNOWN);
+	if (state == LOUDNESS_KNOWN) {
+		*_peak = fAudioPeak;
+		*_loudness = fAudioLoudness;
+		return true;
+	}
+
+	if (state == LOUDNESS_UNKNOWN) {
+		// we are the first to ask, if the analysis can not be started
+		// or fails, the state stays pending until the clip is reloaded
+		LoudnessAnalyzer* analyzer = LoudnessAnalyzer::Default();
+		if (analyzer)
+			analyzer->Analyze(this, changeToken);
+	}
+	return false;
+}
+
+// SetAudioLoudness
+void
+MediaClip::SetAudioLoudness(float peak, float loudness, uint32 changeToken)
+{
+	// NOTE: Reload() is only called with the document write locked, so
+	// the token can not change while the result is stored
+	if (changeToken != ChangeToken()) {
+		// the measured file has since been replaced
+		return;
+	}
+
+	fAudioPeak = peak;
+	fAudioLoudness = loudness;
+	atomic_set(&fAudioLoudnessState, LOUDNESS_KNOWN);
+
+	_StoreArchive();
 }
 
 //	#pragma mark -
@@ -242,6 +332,12 @@ MediaClip::_StoreArchive()
 			status = archive.AddFloat("audio fps", fAudioFPS);
 		if (status == B_OK)
 			status = archive.AddInt64("audio frames", fAudioFrameCount);
+		if (status == B_OK
+			&& atomic_get(&fAudioLoudnessState) == LOUDNESS_KNOWN) {
+			status = archive.AddFloat("audio peak", fAudioPeak);
+			if (status == B_OK)
+				status = archive.AddFloat("audio loudness", fAudioLoudness);
+		}
 	}
 
 	if (status == B_OK)
@@ -51,6 +51,22 @@ public:
 
 	static	BRect				VideoBounds(const media_format& format);
 
+			float				VideoFrameRate() const
+									{ return fVideoFPS; }
+			uint64				AudioFrameCount() const
+									{ return fAudioFrameCount; }
+			float				AudioFrameRate() const
+									{ return fAudioFPS; }
+
+			// returns false and has the audio analyzed in the background
+			// if the loudness is not known yet
+			bool				GetAudioLoudness(float* _peak,
+									float* _loudness);
+			// the document needs to be locked, the result is ignored if
+			// the clip has been reloaded since /changeToken/
+			void				SetAudioLoudness(float peak,
+									float loudness, uint32 changeToken);
+
 protected:
 	virtual	void				HandleReload();
 
@@ -69,6 +85,10 @@ private:
 			uint64				fAudioFrameCount;
 			float				fVideoFPS;
 			float				fAudioFPS;
+
+			float				fAudioPeak;
+			float				fAudioLoudness;
+			vint32				fAudioLoudnessState;
 };
 
 #endif // MEDIA_CLIP_H
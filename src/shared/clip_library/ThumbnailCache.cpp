@@ -0,0 +1,694 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+#include "ThumbnailCache.h"
+
+#include <new>
+#include <stdio.h>
+#include <string.h>
+
+#include <Bitmap.h>
+#include <Directory.h>
+#include <Entry.h>
+#include <File.h>
+#include <MediaFile.h>
+#include <MediaTrack.h>
+#include <Message.h>
+#include <Path.h>
+
+#include "common.h"
+#include "common_constants.h"
+
+#include "AutoDeleter.h"
+#include "AutoLocker.h"
+#include "BBitmapBuffer.h"
+#include "MediaClip.h"
+#include "MediaRenderingBuffer.h"
+#include "Painter.h"
+
+using std::nothrow;
+
+static const uint32 kThumbnailMagic = 'thmb';
+static const uint32 kThumbnailVersion = 1;
+static const int32 kMaxThumbnailWidth = 16 * ThumbnailCache::THUMBNAIL_HEIGHT;
+
+// constructor
+ThumbnailStrip::ThumbnailStrip(int32 count, int32 width, int32 height)
+	: Referencable()
+	, fCount(count)
+	, fWidth(width)
+	, fHeight(height)
+	, fBitmap(NULL)
+	, fFrames(NULL)
+{
+	if (fCount <= 0 || fWidth <= 0 || fHeight <= 0)
+		return;
+
+	fBitmap = new (nothrow) BBitmap(BRect(0, 0, fCount * fWidth - 1,
+		fHeight - 1), 0, B_RGB32);
+	fFrames = new (nothrow) int64[fCount];
+	if (fFrames)
+		memset(fFrames, 0, fCount * sizeof(int64));
+}
+
+// destructor
+ThumbnailStrip::~ThumbnailStrip()
+{
+	delete fBitmap;
+	delete[] fFrames;
+}
+
+// InitCheck
+status_t
+ThumbnailStrip::InitCheck() const
+{
+	if (fCount <= 0 || fWidth <= 0 || fHeight <= 0)
+		return B_BAD_VALUE;
+	if (!fBitmap || !fFrames)
+		return B_NO_MEMORY;
+	return fBitmap->InitCheck();
+}
+
+// ThumbnailFrame
+BRect
+ThumbnailStrip::ThumbnailFrame(int32 index) const
+{
+	return BRect(index * fWidth, 0, (index + 1) * fWidth - 1, fHeight - 1);
+}
+
+// FrameAt
+int64
+ThumbnailStrip::FrameAt(int32 index) const
+{
+	if (index < 0 || index >= fCount)
+		return -1;
+	return fFrames[index];
+}
+
+// IndexForFrame
+int32
+ThumbnailStrip::IndexForFrame(int64 frame) const
+{
+	// the thumbnail showing the closest frame before the given frame
+	int32 index = 0;
+	for (int32 i = 1; i < fCount; i++) {
+		if (fFrames[i] > frame)
+			break;
+		index = i;
+	}
+	return index;
+}
+
+// GetIcon
+bool
+ThumbnailStrip::GetIcon(BBitmap* icon) const
+{
+	if (InitCheck() < B_OK || !icon)
+		return false;
+
+	// use a thumbnail from the first part of the clip, but not
+	// the very first one, which is often black
+	BRect thumbnail = ThumbnailFrame(min_c(fCount - 1, fCount / 4));
+
+	// fit the thumbnail into the icon, keeping the aspect ratio
+	BRect iconBounds = icon->Bounds();
+	BRect dest = iconBounds;
+	float scale = min_c((iconBounds.Width() + 1) / fWidth,
+		(iconBounds.Height() + 1) / fHeight);
+	dest.right = dest.left + floorf(fWidth * scale) - 1;
+	dest.bottom = dest.top + floorf(fHeight * scale) - 1;
+	dest.OffsetBy(floorf((iconBounds.Width() - dest.Width()) / 2),
+		floorf((iconBounds.Height() - dest.Height()) / 2));
+
+	BBitmapBuffer srcBuffer(fBitmap);
+	BBitmapBuffer dstBuffer(icon);
+
+	Painter painter;
+	if (!painter.AttachToBuffer(&dstBuffer))
+		return false;
+	painter.ClearBuffer();
+	painter.DrawBitmap(&srcBuffer, thumbnail, dest);
+	painter.FlushCaches();
+
+	return true;
+}
+
+// MemoryUsage
+size_t
+ThumbnailStrip::MemoryUsage() const
+{
+	size_t usage = sizeof(ThumbnailStrip) + fCount * sizeof(int64);
+	if (fBitmap)
+		usage += fBitmap->BitsLength();
+	return usage;
+}
+
+// Archive
+status_t
+ThumbnailStrip::Archive(BPositionIO* stream) const
+{
+	// NOTE: the file is a local cache, so it is stored in host endianess
+	int32 header[5] = { kThumbnailMagic, kThumbnailVersion, fCount, fWidth,
+		fHeight };
+	ssize_t written = stream->Write(header, sizeof(header));
+	if (written == (ssize_t)sizeof(header))
+		written = stream->Write(fFrames, fCount * sizeof(int64));
+	if (written != (ssize_t)(fCount * sizeof(int64)))
+		return written < 0 ? (status_t)written : B_IO_ERROR;
+
+	// write the rows without the padding of the bitmap
+	const uint8* bits = (const uint8*)fBitmap->Bits();
+	uint32 bpr = fBitmap->BytesPerRow();
+	size_t rowSize = fCount * fWidth * 4;
+	for (int32 y = 0; y < fHeight; y++) {
+		written = stream->Write(bits, rowSize);
+		if (written != (ssize_t)rowSize)
+			return written < 0 ? (status_t)written : B_IO_ERROR;
+		bits += bpr;
+	}
+
+	return B_OK;
+}
+
+// Unarchive
+/*static*/ ThumbnailStrip*
+ThumbnailStrip::Unarchive(BPositionIO* stream)
+{
+	int32 header[5];
+	if (stream->Read(header, sizeof(header)) != (ssize_t)sizeof(header)
+		|| header[0] != (int32)kThumbnailMagic
+		|| header[1] != (int32)kThumbnailVersion) {
+		return NULL;
+	}
+
+	// don't trust the file with the size of the allocation
+	if (header[2] != ThumbnailCache::THUMBNAIL_COUNT
+		|| header[4] != ThumbnailCache::THUMBNAIL_HEIGHT
+		|| header[3] <= 0 || header[3] > kMaxThumbnailWidth) {
+		return NULL;
+	}
+
+	ThumbnailStrip* strip = new (nothrow) ThumbnailStrip(header[2],
+		header[3], header[4]);
+	if (!strip)
+		return NULL;
+	Reference reference(strip, true);
+
+	if (strip->InitCheck() < B_OK)
+		return NULL;
+
+	size_t size = strip->fCount * sizeof(int64);
+	if (stream->Read(strip->fFrames, size) != (ssize_t)size)
+		return NULL;
+
+	uint8* bits = (uint8*)strip->fBitmap->Bits();
+	uint32 bpr = strip->fBitmap->BytesPerRow();
+	size_t rowSize = strip->fCount * strip->fWidth * 4;
+	for (int32 y = 0; y < strip->fHeight; y++) {
+		if (stream->Read(bits, rowSize) != (ssize_t)rowSize)
+			return NULL;
+		bits += bpr;
+	}
+
+	return (ThumbnailStrip*)reference.Detach();
+}
+
+// #pragma mark -
+
+// constructor
+ThumbnailCache::ThumbnailCache(int32 workerCount, size_t memoryLimit)
+	: fJobs("thumbnail jobs")
+	, fWorkers(NULL)
+	, fWorkerCount(0)
+	, fLock("thumbnail cache")
+	, fEntries()
+	, fLRU()
+	, fPending()
+	, fMemoryUsage(0)
+	, fMemoryLimit(memoryLimit)
+	, fStatus(B_NO_INIT)
+{
+	if (workerCount <= 0) {
+		// decoders are heavy weight, more than two of them would
+		// only compete with the playback for the disk
+		system_info info;
+		get_system_info(&info);
+		workerCount = min_c(2, info.cpu_count);
+	}
+
+	fStatus = fJobs.InitCheck();
+	if (fStatus == B_OK)
+		fStatus = fEntries.InitCheck();
+	if (fStatus < B_OK)
+		return;
+
+	fWorkers = new (nothrow) thread_id[workerCount];
+	if (!fWorkers) {
+		fStatus = B_NO_MEMORY;
+		return;
+	}
+
+	for (int32 i = 0; i < workerCount; i++) {
+		thread_id worker = spawn_thread(_WorkerEntry, "thumbnail decoder",
+			B_LOW_PRIORITY, this);
+		if (worker < B_OK)
+			break;
+		fWorkers[fWorkerCount++] = worker;
+		resume_thread(worker);
+	}
+
+	if (fWorkerCount == 0)
+		fStatus = B_NO_MORE_THREADS;
+}
+
+// destructor
+ThumbnailCache::~ThumbnailCache()
+{
+	// closing the queue makes the workers quit
+	const Vector<Job*>* jobs = NULL;
+	if (fJobs.Close(false, &jobs) == B_OK && jobs) {
+		int32 count = jobs->Count();
+		for (int32 i = 0; i < count; i++) {
+			Job* job = jobs->ElementAt(i);
+			job->clip->Release();
+			delete job;
+		}
+	}
+	for (int32 i = 0; i < fWorkerCount; i++) {
+		status_t dummy;
+		wait_for_thread(fWorkers[i], &dummy);
+	}
+	delete[] fWorkers;
+
+	while (Entry* entry = fLRU.GetFirst())
+		_RemoveEntry(entry);
+}
+
+// InitCheck
+status_t
+ThumbnailCache::InitCheck() const
+{
+	return fStatus;
+}
+
+// CreateDefault
+ThumbnailCache*
+ThumbnailCache::CreateDefault()
+{
+	if (!sDefaultCache) {
+		sDefaultCache = new (nothrow) ThumbnailCache();
+		if (sDefaultCache && sDefaultCache->InitCheck() != B_OK)
+			DeleteDefault();
+	}
+	return sDefaultCache;
+}
+
+// DeleteDefault
+void
+ThumbnailCache::DeleteDefault()
+{
+	delete sDefaultCache;
+	sDefaultCache = NULL;
+}
+
+// Default
+ThumbnailCache*
+ThumbnailCache::Default()
+{
+	return sDefaultCache;
+}
+
+// GetThumbnails
+ThumbnailStrip*
+ThumbnailCache::GetThumbnails(MediaClip* clip, const BMessenger& target)
+{
+	if (!clip || !clip->HasVideo())
+		return NULL;
+
+	BString key = _KeyFor(clip);
+
+	AutoLocker<BLocker> locker(fLock);
+
+	ThumbnailStrip* strip = _Lookup(key);
+	if (strip)
+		return strip;
+
+	if (fPending.ContainsKey(key.String()))
+		return NULL;
+
+	// decode the clip in the background, the target is notified
+	// when the thumbnails are available
+	Job* job = new (nothrow) Job;
+	if (!job)
+		return NULL;
+
+	job->clip = clip;
+	job->key = key;
+	job->target = target;
+
+	clip->Acquire();
+	if (fPending.Put(key.String(), 1) < B_OK || fJobs.Push(job) < B_OK) {
+		fPending.Remove(key.String());
+		clip->Release();
+		delete job;
+	}
+
+	return NULL;
+}
+
+// CachedThumbnails
+ThumbnailStrip*
+ThumbnailCache::CachedThumbnails(MediaClip* clip)
+{
+	if (!clip || !clip->HasVideo())
+		return NULL;
+
+	AutoLocker<BLocker> locker(fLock);
+	return _Lookup(_KeyFor(clip));
+}
+
+// Forget
+void
+ThumbnailCache::Forget(MediaClip* clip)
+{
+	BString key = _KeyFor(clip);
+
+	AutoLocker<BLocker> locker(fLock);
+
+	Entry* entry = fEntries.Get(key.String());
+	if (entry)
+		_RemoveEntry(entry);
+
+	// the file on disk is outdated as well
+	BString path;
+	if (_PathFor(key, path) == B_OK)
+		BEntry(path.String()).Remove();
+}
+
+// #pragma mark -
+
+// _KeyFor
+/*static*/ BString
+ThumbnailCache::_KeyFor(MediaClip* clip)
+{
+	BString key(clip->ID());
+	key << "-" << clip->Version();
+	return key;
+}
+
+// _PathFor
+status_t
+ThumbnailCache::_PathFor(const BString& key, BString& _path) const
+{
+	BPath path(kCachePath);
+	status_t ret = path.Append("thumbnails");
+	if (ret == B_OK)
+		ret = create_directory(path.Path(), 0777);
+	if (ret == B_OK)
+		ret = path.Append(key.String());
+	if (ret == B_OK)
+		_path = path.Path();
+	return ret;
+}
+
+// _WorkerEntry
+int32
+ThumbnailCache::_WorkerEntry(void* cookie)
+{
+	return ((ThumbnailCache*)cookie)->_Worker();
+}
+
+// _Worker
+int32
+ThumbnailCache::_Worker()
+{
+	while (true) {
+		Job* job;
+		status_t ret = fJobs.Pop(&job);
+		if (ret == B_INTERRUPTED)
+			continue;
+		if (ret < B_OK) {
+			// the queue has been closed
+			break;
+		}
+
+		ThumbnailStrip* strip = _Load(job->key);
+		if (!strip) {
+			strip = _Decode(job->clip);
+			if (strip)
+				_Store(job->key, strip);
+		}
+
+		fLock.Lock();
+		fPending.Remove(job->key.String());
+		if (strip)
+			_Insert(job->key, strip);
+		fLock.Unlock();
+
+		if (strip) {
+			strip->Release();
+
+			BMessage message(MSG_THUMBNAILS_READY);
+			message.AddPointer("clip", job->clip);
+			job->target.SendMessage(&message);
+		}
+
+		job->clip->Release();
+		delete job;
+	}
+
+	return B_OK;
+}
+
+// _Lookup
+ThumbnailStrip*
+ThumbnailCache::_Lookup(const BString& key)
+{
+	Entry* entry = fEntries.Get(key.String());
+	if (!entry)
+		return NULL;
+
+	// move the entry to the front of the LRU list
+	fLRU.Remove(entry);
+	fLRU.Insert(entry, false);
+
+	entry->strip->Acquire();
+	return entry->strip;
+}
+
+// _Insert
+void
+ThumbnailCache::_Insert(const BString& key, ThumbnailStrip* strip)
+{
+	Entry* entry = fEntries.Get(key.String());
+	if (entry)
+		_RemoveEntry(entry);
+
+	entry = new (nothrow) Entry;
+	if (!entry)
+		return;
+
+	entry->key = key;
+	entry->strip = strip;
+	if (fEntries.Put(key.String(), entry) < B_OK) {
+		delete entry;
+		return;
+	}
+
+	strip->Acquire();
+	fLRU.Insert(entry, false);
+	fMemoryUsage += strip->MemoryUsage();
+
+	_Trim();
+}
+
+// _RemoveEntry
+void
+ThumbnailCache::_RemoveEntry(Entry* entry)
+{
+	fEntries.Remove(entry->key.String());
+	fLRU.Remove(entry);
+	fMemoryUsage -= entry->strip->MemoryUsage();
+
+	// NOTE: strips which are still in use by someone else stay around
+	// until they are released
+	entry->strip->Release();
+	delete entry;
+}
+
+// _Trim
+void
+ThumbnailCache::_Trim()
+{
+	// always keep the most recently used strip
+	while (fMemoryUsage > fMemoryLimit && fLRU.GetLast() != fLRU.GetFirst())
+		_RemoveEntry(fLRU.GetLast());
+}
+
+// _Load
+ThumbnailStrip*
+ThumbnailCache::_Load(const BString& key)
+{
+	BString path;
+	if (_PathFor(key, path) < B_OK)
+		return NULL;
+
+	BFile file(path.String(), B_READ_ONLY);
+	if (file.InitCheck() < B_OK)
+		return NULL;
+
+	return ThumbnailStrip::Unarchive(&file);
+}
+
+// _Decode
+ThumbnailStrip*
+ThumbnailCache::_Decode(MediaClip* clip)
+{
+	BMediaFile mediaFile(clip->Ref());
+	status_t ret = mediaFile.InitCheck();
+	if (ret < B_OK)
+		return NULL;
+
+	// find the first video track
+	BMediaTrack* track = NULL;
+	media_format format;
+	int32 trackCount = mediaFile.CountTracks();
+	for (int32 i = 0; i < trackCount && !track; i++) {
+		BMediaTrack* candidate = mediaFile.TrackAt(i);
+		if (!candidate)
+			continue;
+		if (candidate->EncodedFormat(&format) == B_OK
+			&& (format.type == B_MEDIA_RAW_VIDEO
+				|| format.type == B_MEDIA_ENCODED_VIDEO)) {
+			track = candidate;
+		} else
+			mediaFile.ReleaseTrack(candidate);
+	}
+	if (!track)
+		return NULL;
+
+	uint32 width = format.u.encoded_video.output.display.line_width;
+	uint32 height = format.u.encoded_video.output.display.line_count;
+	BRect videoBounds = MediaClip::VideoBounds(format);
+
+	memset(&format, 0, sizeof(media_format));
+	format.u.raw_video.last_active = height - 1;
+	format.u.raw_video.display.format = B_RGB32;
+	format.u.raw_video.display.line_width = width;
+	format.u.raw_video.display.line_count = height;
+	format.u.raw_video.display.bytes_per_row = width * 4;
+
+	ret = track->DecodedFormat(&format);
+	if (ret < B_OK || format.u.raw_video.display.format != B_RGB32
+		|| width == 0 || height == 0) {
+		print_error("ThumbnailCache::_Decode() - unable to decode "
+			"'%s' to B_RGB32\n", clip->Name().String());
+		mediaFile.ReleaseTrack(track);
+		return NULL;
+	}
+	if (format.u.raw_video.display.bytes_per_row < width * 4)
+		format.u.raw_video.display.bytes_per_row = width * 4;
+
+	uint32 bufferSize = height * format.u.raw_video.display.bytes_per_row;
+	uint8* buffer = new (nothrow) uint8[bufferSize];
+	if (!buffer) {
+		mediaFile.ReleaseTrack(track);
+		return NULL;
+	}
+	ArrayDeleter<uint8> bufferDeleter(buffer);
+
+	// the thumbnails keep the display aspect ratio of the video
+	int32 thumbHeight = THUMBNAIL_HEIGHT;
+	int32 thumbWidth = max_c(1, (int32)roundf(THUMBNAIL_HEIGHT
+		* (videoBounds.Width() + 1) / (videoBounds.Height() + 1)));
+	thumbWidth = min_c(thumbWidth, kMaxThumbnailWidth);
+
+	ThumbnailStrip* strip = new (nothrow) ThumbnailStrip(THUMBNAIL_COUNT,
+		thumbWidth, thumbHeight);
+	if (!strip) {
+		mediaFile.ReleaseTrack(track);
+		return NULL;
+	}
+	Reference reference(strip, true);
+	if (strip->InitCheck() < B_OK) {
+		mediaFile.ReleaseTrack(track);
+		return NULL;
+	}
+
+	BBitmapBuffer stripBuffer(strip->fBitmap);
+	Painter painter;
+	if (!painter.AttachToBuffer(&stripBuffer)) {
+		mediaFile.ReleaseTrack(track);
+		return NULL;
+	}
+	painter.SetSubpixelPrecise(false);
+	painter.ClearBuffer();
+
+	MediaRenderingBuffer frameBuffer(buffer, &format);
+
+	int64 frameCount = track->CountFrames();
+	uint32 bytesPerRow = format.u.raw_video.display.bytes_per_row;
+	int32 decoded = 0;
+	for (int32 i = 0; i < THUMBNAIL_COUNT; i++) {
+		// only the key frame before each position is decoded,
+		// which is good enough for a thumbnail
+		int64 frame = (2 * i + 1) * frameCount / (2 * THUMBNAIL_COUNT);
+		if (track->SeekToFrame(&frame, B_MEDIA_SEEK_CLOSEST_BACKWARD) < B_OK)
+			continue;
+
+		int64 count = 1;
+		if (track->ReadFrames(buffer, &count) < B_OK)
+			continue;
+
+		// decoders leave the alpha channel undefined, the rows may
+		// be padded
+		uint8* row = buffer;
+		for (uint32 y = 0; y < height; y++) {
+			uint8* bits = row;
+			for (uint32 x = 0; x < width; x++) {
+				bits[3] = 255;
+				bits += 4;
+			}
+			row += bytesPerRow;
+		}
+
+		painter.DrawBitmap(&frameBuffer, frameBuffer.Bounds(),
+			strip->ThumbnailFrame(i));
+		strip->fFrames[i] = frame;
+		decoded++;
+	}
+	painter.FlushCaches();
+
+	mediaFile.ReleaseTrack(track);
+
+	if (decoded == 0)
+		return NULL;
+
+	return (ThumbnailStrip*)reference.Detach();
+}
+
+// _Store
+void
+ThumbnailCache::_Store(const BString& key, const ThumbnailStrip* strip)
+{
+	BString path;
+	if (_PathFor(key, path) < B_OK)
+		return;
+
+	BFile file(path.String(), B_CREATE_FILE | B_ERASE_FILE | B_WRITE_ONLY);
+	if (file.InitCheck() < B_OK)
+		return;
+
+	if (strip->Archive(&file) < B_OK) {
+		// don't leave a broken file around
+		file.Unset();
+		BEntry(path.String()).Remove();
+	}
+}
+
+// static variables
+
+// sDefaultCache
+ThumbnailCache* ThumbnailCache::sDefaultCache = NULL;
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+#ifndef THUMBNAIL_CACHE_H
+#define THUMBNAIL_CACHE_H
+
+#include <Locker.h>
+#include <Messenger.h>
+#include <Rect.h>
+#include <String.h>
+
+#include "BlockingQueue.h"
+#include "DLList.h"
+#include "HashMap.h"
+#include "HashString.h"
+#include "Referencable.h"
+
+class BBitmap;
+class BPositionIO;
+class MediaClip;
+
+enum {
+	MSG_THUMBNAILS_READY		= 'thrd',
+};
+
+// ThumbnailStrip
+//
+// A row of small frames taken at evenly spaced positions of the video
+// track of a clip. All thumbnails are kept in one bitmap next to each
+// other.
+class ThumbnailStrip : public Referencable {
+ public:
+								ThumbnailStrip(int32 count, int32 width,
+									int32 height);
+	virtual						~ThumbnailStrip();
+
+			status_t			InitCheck() const;
+
+			int32				CountThumbnails() const
+									{ return fCount; }
+			int32				Width() const
+									{ return fWidth; }
+			int32				Height() const
+									{ return fHeight; }
+
+			const BBitmap*		Bitmap() const
+									{ return fBitmap; }
+			BRect				ThumbnailFrame(int32 index) const;
+			int64				FrameAt(int32 index) const;
+			int32				IndexForFrame(int64 frame) const;
+
+			bool				GetIcon(BBitmap* icon) const;
+			size_t				MemoryUsage() const;
+
+			status_t			Archive(BPositionIO* stream) const;
+	static	ThumbnailStrip*		Unarchive(BPositionIO* stream);
+
+ private:
+	friend class ThumbnailCache;
+
+			int32				fCount;
+			int32				fWidth;
+			int32				fHeight;
+			BBitmap*			fBitmap;
+			int64*				fFrames;
+};
+
+// ThumbnailCache
+//
+// Decodes thumbnail strips of MediaClips on a pool of worker threads.
+// Strips are kept in a memory bounded LRU and in files below kCachePath,
+// so that a clip needs to be decoded only once.
+class ThumbnailCache {
+ public:
+	enum {
+		THUMBNAIL_COUNT			= 16,
+		THUMBNAIL_HEIGHT		= 48,
+		DEFAULT_MEMORY_LIMIT	= 16 * 1024 * 1024
+	};
+
+								ThumbnailCache(int32 workerCount = 0,
+									size_t memoryLimit
+										= DEFAULT_MEMORY_LIMIT);
+	virtual						~ThumbnailCache();
+
+			status_t			InitCheck() const;
+
+	static	ThumbnailCache*		CreateDefault();
+	static	void				DeleteDefault();
+	static	ThumbnailCache*		Default();
+
+			ThumbnailStrip*		GetThumbnails(MediaClip* clip,
+									const BMessenger& target);
+			ThumbnailStrip*		CachedThumbnails(MediaClip* clip);
+			void				Forget(MediaClip* clip);
+
+			size_t				MemoryUsage() const
+									{ return fMemoryUsage; }
+
+ private:
+			struct Job {
+				MediaClip*		clip;
+				BString			key;
+				BMessenger		target;
+			};
+
+			struct Entry : DLListLinkImpl<Entry> {
+				BString			key;
+				ThumbnailStrip*	strip;
+			};
+
+	typedef HashMap<HashString, Entry*> EntryMap;
+	typedef HashMap<HashString, int32> PendingMap;
+	typedef DLList<Entry> EntryList;
+
+	static	BString				_KeyFor(MediaClip* clip);
+			status_t			_PathFor(const BString& key,
+									BString& path) const;
+
+	static	int32				_WorkerEntry(void* cookie);
+			int32				_Worker();
+
+			ThumbnailStrip*		_Lookup(const BString& key);
+			void				_Insert(const BString& key,
+									ThumbnailStrip* strip);
+			void				_RemoveEntry(Entry* entry);
+			void				_Trim();
+
+			ThumbnailStrip*		_Load(const BString& key);
+			ThumbnailStrip*		_Decode(MediaClip* clip);
+			void				_Store(const BString& key,
+									const ThumbnailStrip* strip);
+
+			BlockingQueue<Job>	fJobs;
+			thread_id*			fWorkers;
+			int32				fWorkerCount;
+
+			BLocker				fLock;
+			EntryMap			fEntries;
+			EntryList			fLRU;
+				// most recently used first
+			PendingMap			fPending;
+			size_t				fMemoryUsage;
+			size_t				fMemoryLimit;
+
+			status_t			fStatus;
+
+	static	ThumbnailCache*		sDefaultCache;
+};
+
+#endif // THUMBNAIL_CACHE_H
@@ -20,6 +20,7 @@ const char* kClockwerkPath		= "/boot/Clockwerk";
 const char* kClockwerkInstallationsPath = "/boot";
 const char* kObjectLibraryPath	= "/boot/Clockwerk/object_library";
 const char* kObjectFilePath		= "/boot/home/clockwerk";
+const char* kCachePath			= "/boot/home/config/cache/Clockwerk";
 
 const char* kAttrPrefix			= "CLKW:";
 const char* kTypeAttr			= "CLKW:type";
@@ -23,6 +23,7 @@ extern const char* kClockwerkPath;
 extern const char* kClockwerkInstallationsPath;
 extern const char* kObjectLibraryPath;
 extern const char* kObjectFilePath;
+extern const char* kCachePath;
 
 extern const char* kAttrPrefix;
 extern const char* kTypeAttr;
@@ -13,6 +13,7 @@
 
 #include "CommonPropertyIDs.h"
 #include "KeyFrame.h"
+#include "Observable.h"
 #include "Property.h"
 #include "PropertyAnimator.h"
 #include "ServerObject.h"
@@ -39,6 +40,10 @@ import_objects(ServerObjectManager* manager,
 
 	status_t ret = xml.Load(*stream);
 
+	// notify the observers of each object only once, when everything
+	// has been restored
+	AutoNotificationBatch _;
+
 	// instantiate all objects
 	if (ret == B_OK)
 		ret = restore_objects(xml, manager, factory);
@@ -0,0 +1,516 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "ContentHasher.h"
+
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <File.h>
+
+#include "AutoDeleter.h"
+#include "AutoLocker.h"
+#include "SHA256.h"
+
+using std::nothrow;
+
+// constructor
+ContentHashListener::ContentHashListener()
+{
+}
+
+// destructor
+ContentHashListener::~ContentHashListener()
+{
+}
+
+// #pragma mark -
+
+// constructor
+ContentDigest::ContentDigest(const node_ref& node, off_t size,
+		time_t modified, size_t blockSize)
+	: Referencable()
+	, fNode(node)
+	, fSize(size)
+	, fModified(modified)
+	, fBlockSize(blockSize)
+	, fBlockDigests(NULL)
+	, fBlockCount(0)
+{
+	memset(fFileDigest, 0, sizeof(fFileDigest));
+
+	if (fBlockSize > 0) {
+		int32 blockCount = (fSize + fBlockSize - 1) / fBlockSize;
+		fBlockDigests = new (nothrow) uint8[
+			blockCount * SHA256_DIGEST_LENGTH];
+		if (fBlockDigests)
+			fBlockCount = blockCount;
+	}
+}
+
+// destructor
+ContentDigest::~ContentDigest()
+{
+	delete[] fBlockDigests;
+}
+
+// InitCheck
+status_t
+ContentDigest::InitCheck() const
+{
+	if (fBlockSize == 0)
+		return B_BAD_VALUE;
+	if (fSize > 0 && !fBlockDigests)
+		return B_NO_MEMORY;
+	return B_OK;
+}
+
+// GetFileDigestAsString
+void
+ContentDigest::GetFileDigestAsString(BString& string) const
+{
+	SHA256::DigestToString(fFileDigest, SHA256_DIGEST_LENGTH, string);
+}
+
+// BlockDigestAt
+const uint8*
+ContentDigest::BlockDigestAt(int32 index) const
+{
+	if (index < 0 || index >= fBlockCount)
+		return NULL;
+	return fBlockDigests + index * SHA256_DIGEST_LENGTH;
+}
+
+// IsUpToDate
+bool
+ContentDigest::IsUpToDate(off_t size, time_t modified) const
+{
+	return fSize == size && fModified == modified;
+}
+
+// HasSameContent
+bool
+ContentDigest::HasSameContent(const ContentDigest& other) const
+{
+	return fSize == other.fSize
+		&& memcmp(fFileDigest, other.fFileDigest, SHA256_DIGEST_LENGTH) == 0;
+}
+
+// CountChangedBlocks
+int32
+ContentDigest::CountChangedBlocks(const ContentDigest& other) const
+{
+	int32 changed = 0;
+	for (int32 i = 0; i < fBlockCount; i++) {
+		if (IsBlockChanged(i, other))
+			changed++;
+	}
+	return changed;
+}
+
+// IsBlockChanged
+bool
+ContentDigest::IsBlockChanged(int32 index, const ContentDigest& other) const
+{
+	// blocks can only be compared if they were hashed with the same
+	// block size, and blocks beyond the end of the other file are
+	// changed by definition
+	if (fBlockSize != other.fBlockSize)
+		return true;
+
+	const uint8* digest = BlockDigestAt(index);
+	const uint8* otherDigest = other.BlockDigestAt(index);
+	if (!digest || !otherDigest)
+		return true;
+
+	return memcmp(digest, otherDigest, SHA256_DIGEST_LENGTH) != 0;
+}
+
+// #pragma mark -
+
+// constructor
+ContentHasher::ContentHasher(int32 workerCount, size_t blockSize)
+	: fJobs("content hasher jobs")
+	, fJobLock("content hasher jobs")
+	, fPendingJobs(64)
+	, fNotifyLock("content hasher notification")
+	, fWorkers(NULL)
+	, fWorkerCount(0)
+	, fBlockSize(blockSize)
+	, fCacheLock("content hasher cache")
+	, fCache()
+	, fBytesHashed(0)
+	, fHashingTime(0)
+	, fCacheHits(0)
+	, fCacheMisses(0)
+	, fStatus(B_NO_INIT)
+{
+	if (workerCount <= 0) {
+		system_info info;
+		get_system_info(&info);
+		workerCount = info.cpu_count;
+	}
+
+	fStatus = fJobs.InitCheck();
+	if (fStatus == B_OK)
+		fStatus = fCache.InitCheck();
+	if (fStatus < B_OK)
+		return;
+
+	fWorkers = new (nothrow) thread_id[workerCount];
+	if (!fWorkers) {
+		fStatus = B_NO_MEMORY;
+		return;
+	}
+
+	for (int32 i = 0; i < workerCount; i++) {
+		thread_id worker = spawn_thread(_WorkerEntry, "content hasher",
+			B_LOW_PRIORITY, this);
+		if (worker < B_OK)
+			break;
+		fWorkers[fWorkerCount++] = worker;
+		resume_thread(worker);
+	}
+
+	if (fWorkerCount == 0)
+		fStatus = B_NO_MORE_THREADS;
+}
+
+// destructor
+ContentHasher::~ContentHasher()
+{
+	// closing the queue makes the workers quit
+	fJobs.Close(true);
+	for (int32 i = 0; i < fWorkerCount; i++) {
+		status_t dummy;
+		wait_for_thread(fWorkers[i], &dummy);
+	}
+	delete[] fWorkers;
+
+	DigestMap::Iterator iterator = fCache.GetIterator();
+	while (iterator.HasNext())
+		iterator.Next().value->Release();
+}
+
+// InitCheck
+status_t
+ContentHasher::InitCheck() const
+{
+	return fStatus;
+}
+
+// CreateDefault
+ContentHasher*
+ContentHasher::CreateDefault()
+{
+	if (!sDefaultHasher) {
+		sDefaultHasher = new (nothrow) ContentHasher();
+		if (sDefaultHasher && sDefaultHasher->InitCheck() != B_OK)
+			DeleteDefault();
+	}
+	return sDefaultHasher;
+}
+
+// DeleteDefault
+void
+ContentHasher::DeleteDefault()
+{
+	delete sDefaultHasher;
+	sDefaultHasher = NULL;
+}
+
+// Default
+ContentHasher*
+ContentHasher::Default()
+{
+	return sDefaultHasher;
+}
+
+// HashFile
+status_t
+ContentHasher::HashFile(const entry_ref& ref, ContentHashListener* listener)
+{
+	if (fStatus < B_OK)
+		return fStatus;
+
+	Job* job = new (nothrow) Job;
+	if (!job)
+		return B_NO_MEMORY;
+
+	job->ref = ref;
+	job->listener = listener;
+	job->canceled = false;
+
+	AutoLocker<BLocker> locker(fJobLock);
+	if (!fPendingJobs.AddItem(job)) {
+		delete job;
+		return B_NO_MEMORY;
+	}
+
+	status_t ret = fJobs.Push(job);
+	if (ret < B_OK) {
+		fPendingJobs.RemoveItem(job);
+		delete job;
+	}
+	return ret;
+}
+
+// CancelJobs
+void
+ContentHasher::CancelJobs(ContentHashListener* listener)
+{
+	// waits until a worker which is currently notifying a listener
+	// is done with it
+	AutoLocker<BLocker> notifyLocker(fNotifyLock);
+	AutoLocker<BLocker> locker(fJobLock);
+
+	// the jobs stay in the queue, the workers skip them
+	int32 count = fPendingJobs.CountItems();
+	for (int32 i = 0; i < count; i++) {
+		Job* job = (Job*)fPendingJobs.ItemAtFast(i);
+		if (job->listener == listener)
+			job->canceled = true;
+	}
+}
+
+// HashFileSync
+status_t
+ContentHasher::HashFileSync(const entry_ref& ref, ContentDigest** digest)
+{
+	uint8* buffer = new (nothrow) uint8[fBlockSize];
+	if (!buffer)
+		return B_NO_MEMORY;
+	ArrayDeleter<uint8> bufferDeleter(buffer);
+
+	return _Hash(ref, digest, buffer);
+}
+
+// CachedDigest
+ContentDigest*
+ContentHasher::CachedDigest(const entry_ref& ref)
+{
+	BNode node(&ref);
+	node_ref nodeRef;
+	off_t size;
+	time_t modified;
+	if (node.GetNodeRef(&nodeRef) < B_OK || node.GetSize(&size) < B_OK
+		|| node.GetModificationTime(&modified) < B_OK) {
+		return NULL;
+	}
+
+	return _CachedDigest(nodeRef, size, modified);
+}
+
+// Forget
+void
+ContentHasher::Forget(const entry_ref& ref)
+{
+	BNode node(&ref);
+	node_ref nodeRef;
+	if (node.GetNodeRef(&nodeRef) < B_OK)
+		return;
+
+	AutoLocker<BLocker> locker(fCacheLock);
+	ContentDigest* digest = fCache.Remove(NodeKey(nodeRef));
+	if (digest)
+		digest->Release();
+}
+
+// BytesHashed
+uint64
+ContentHasher::BytesHashed() const
+{
+	return fBytesHashed;
+}
+
+// HashingTime
+bigtime_t
+ContentHasher::HashingTime() const
+{
+	return fHashingTime;
+}
+
+// #pragma mark -
+
+// _WorkerEntry
+int32
+ContentHasher::_WorkerEntry(void* cookie)
+{
+	return ((ContentHasher*)cookie)->_Worker();
+}
+
+// _Worker
+int32
+ContentHasher::_Worker()
+{
+	uint8* buffer = new (nothrow) uint8[fBlockSize];
+	if (!buffer)
+		return B_NO_MEMORY;
+	ArrayDeleter<uint8> bufferDeleter(buffer);
+
+	while (true) {
+		Job* job;
+		status_t ret = fJobs.Pop(&job);
+		if (ret == B_INTERRUPTED)
+			continue;
+		if (ret < B_OK) {
+			// the queue has been closed
+			break;
+		}
+
+		ContentDigest* digest = NULL;
+		if (!_IsCanceled(job))
+			ret = _Hash(job->ref, &digest, buffer);
+
+		// the notification lock makes CancelJobs() wait for the listener
+		// to return
+		AutoLocker<BLocker> notifyLocker(fNotifyLock);
+		bool canceled = _IsCanceled(job);
+		fJobLock.Lock();
+		fPendingJobs.RemoveItem(job);
+		fJobLock.Unlock();
+
+		if (job->listener && !canceled)
+			job->listener->ContentHashed(job->ref, digest, ret);
+		notifyLocker.Unlock();
+
+		if (digest)
+			digest->Release();
+
+		delete job;
+	}
+
+	return B_OK;
+}
+
+// _IsCanceled
+bool
+ContentHasher::_IsCanceled(const Job* job)
+{
+	AutoLocker<BLocker> locker(fJobLock);
+	return job->canceled;
+}
+
+// _Hash
+status_t
+ContentHasher::_Hash(const entry_ref& ref, ContentDigest** _digest,
+	uint8* buffer)
+{
+	BFile file(&ref, B_READ_ONLY);
+	status_t ret = file.InitCheck();
+	if (ret < B_OK)
+		return ret;
+
+	node_ref nodeRef;
+	off_t size;
+	time_t modified;
+	if ((ret = file.GetNodeRef(&nodeRef)) < B_OK
+		|| (ret = file.GetSize(&size)) < B_OK
+		|| (ret = file.GetModificationTime(&modified)) < B_OK) {
+		return ret;
+	}
+
+	// the file is only read if it has changed since it was last hashed
+	ContentDigest* digest = _CachedDigest(nodeRef, size, modified);
+	if (digest) {
+		atomic_add(&fCacheHits, 1);
+		*_digest = digest;
+		return B_OK;
+	}
+	atomic_add(&fCacheMisses, 1);
+
+	digest = new (nothrow) ContentDigest(nodeRef, size, modified, fBlockSize);
+	if (!digest)
+		return B_NO_MEMORY;
+	ret = digest->InitCheck();
+	if (ret < B_OK) {
+		digest->Release();
+		return ret;
+	}
+
+	bigtime_t startTime = system_time();
+
+	// the whole file and each block are hashed in the same pass over
+	// the data
+	SHA256 fileHash;
+	off_t bytesHashed = 0;
+	for (int32 i = 0; i < digest->fBlockCount; i++) {
+		ssize_t read = file.ReadAt((off_t)i * fBlockSize, buffer, fBlockSize);
+		if (read < 0) {
+			ret = (status_t)read;
+			break;
+		}
+		if (read < (ssize_t)fBlockSize && i < digest->fBlockCount - 1) {
+			// the file has been truncated while we were reading it
+			ret = B_IO_ERROR;
+			break;
+		}
+
+		fileHash.Update(buffer, read);
+
+		SHA256 blockHash;
+		blockHash.Update(buffer, read);
+		memcpy(digest->fBlockDigests + i * SHA256_DIGEST_LENGTH,
+			blockHash.Digest(), SHA256_DIGEST_LENGTH);
+
+		bytesHashed += read;
+	}
+
+	atomic_add64(&fBytesHashed, bytesHashed);
+	atomic_add64(&fHashingTime, system_time() - startTime);
+
+	if (ret < B_OK) {
+		digest->Release();
+		return ret;
+	}
+
+	memcpy(digest->fFileDigest, fileHash.Digest(), SHA256_DIGEST_LENGTH);
+
+	_CacheDigest(digest);
+
+	*_digest = digest;
+	return B_OK;
+}
+
+// _CachedDigest
+ContentDigest*
+ContentHasher::_CachedDigest(const node_ref& node, off_t size,
+	time_t modified)
+{
+	AutoLocker<BLocker> locker(fCacheLock);
+
+	ContentDigest* digest = fCache.Get(NodeKey(node));
+	if (!digest || !digest->IsUpToDate(size, modified))
+		return NULL;
+
+	digest->Acquire();
+	return digest;
+}
+
+// _CacheDigest
+void
+ContentHasher::_CacheDigest(ContentDigest* digest)
+{
+	AutoLocker<BLocker> locker(fCacheLock);
+
+	NodeKey key(digest->Node());
+	ContentDigest* previous = fCache.Get(key);
+	if (previous == digest)
+		return;
+
+	if (fCache.Put(key, digest) < B_OK)
+		return;
+
+	digest->Acquire();
+	if (previous)
+		previous->Release();
+}
+
+// static variables
+
+// sDefaultHasher
+ContentHasher* ContentHasher::sDefaultHasher = NULL;
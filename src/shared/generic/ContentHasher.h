@@ -0,0 +1,201 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#ifndef CONTENT_HASHER_H
+#define CONTENT_HASHER_H
+
+#include <Entry.h>
+#include <List.h>
+#include <Locker.h>
+#include <Node.h>
+#include <OS.h>
+#include <String.h>
+
+#include "BlockingQueue.h"
+#include "HashMap.h"
+#include "Referencable.h"
+
+class ContentDigest;
+
+enum {
+	SHA256_DIGEST_LENGTH	= 32
+};
+
+// ContentHashListener
+class ContentHashListener {
+ public:
+								ContentHashListener();
+	virtual						~ContentHashListener();
+
+	// NOTE: called from one of the hasher threads, the listener
+	// does not own a reference to the digest unless it acquires one
+	virtual	void				ContentHashed(const entry_ref& ref,
+									ContentDigest* digest,
+									status_t status) = 0;
+};
+
+// ContentDigest
+//
+// The SHA-256 digest of a complete file (in the same representation the
+// server uses), plus the digests of each fixed size block of the file.
+// Comparing the block digests of two versions of a file tells which
+// parts have changed.
+class ContentDigest : public Referencable {
+ public:
+								ContentDigest(const node_ref& node,
+									off_t size, time_t modified,
+									size_t blockSize);
+	virtual						~ContentDigest();
+
+			status_t			InitCheck() const;
+
+			const node_ref&		Node() const
+									{ return fNode; }
+			off_t				Size() const
+									{ return fSize; }
+			time_t				Modified() const
+									{ return fModified; }
+			size_t				BlockSize() const
+									{ return fBlockSize; }
+
+			const uint8*		FileDigest() const
+									{ return fFileDigest; }
+			void				GetFileDigestAsString(BString& string) const;
+
+			int32				CountBlocks() const
+									{ return fBlockCount; }
+			const uint8*		BlockDigestAt(int32 index) const;
+
+			bool				IsUpToDate(off_t size, time_t modified) const;
+			bool				HasSameContent(
+									const ContentDigest& other) const;
+			int32				CountChangedBlocks(
+									const ContentDigest& other) const;
+			bool				IsBlockChanged(int32 index,
+									const ContentDigest& other) const;
+
+ private:
+	friend class ContentHasher;
+
+			node_ref			fNode;
+			off_t				fSize;
+			time_t				fModified;
+			size_t				fBlockSize;
+
+			uint8				fFileDigest[SHA256_DIGEST_LENGTH];
+			uint8*				fBlockDigests;
+			int32				fBlockCount;
+};
+
+// ContentHasher
+//
+// Hashes files on a pool of worker threads and caches the results keyed
+// by node, size and modification time, so that unchanged files never
+// have to be read again.
+class ContentHasher {
+ public:
+	enum {
+		DEFAULT_BLOCK_SIZE		= 1024 * 1024
+	};
+
+								ContentHasher(int32 workerCount = 0,
+									size_t blockSize = DEFAULT_BLOCK_SIZE);
+	virtual						~ContentHasher();
+
+			status_t			InitCheck() const;
+
+	static	ContentHasher*		CreateDefault();
+	static	void				DeleteDefault();
+	static	ContentHasher*		Default();
+
+			status_t			HashFile(const entry_ref& ref,
+									ContentHashListener* listener);
+			void				CancelJobs(ContentHashListener* listener);
+									// the listener is not called anymore
+									// once this returns, it has to be
+									// called before deleting the listener
+			status_t			HashFileSync(const entry_ref& ref,
+									ContentDigest** digest);
+			ContentDigest*		CachedDigest(const entry_ref& ref);
+			void				Forget(const entry_ref& ref);
+
+			int32				CountWorkers() const
+									{ return fWorkerCount; }
+			size_t				BlockSize() const
+									{ return fBlockSize; }
+
+	// statistics
+			uint64				BytesHashed() const;
+			bigtime_t			HashingTime() const;
+			int32				CacheHits() const
+									{ return fCacheHits; }
+			int32				CacheMisses() const
+									{ return fCacheMisses; }
+
+ private:
+			struct Job {
+				entry_ref				ref;
+				ContentHashListener*	listener;
+				bool					canceled;
+			};
+
+			struct NodeKey {
+				NodeKey()
+					: device(-1), node(-1) {}
+				NodeKey(const node_ref& ref)
+					: device(ref.device), node(ref.node) {}
+
+				uint32 GetHashCode() const
+				{
+					return (uint32)device ^ (uint32)(node >> 32)
+						^ (uint32)node;
+				}
+				bool operator==(const NodeKey& other) const
+				{
+					return device == other.device && node == other.node;
+				}
+				bool operator!=(const NodeKey& other) const
+				{
+					return !(*this == other);
+				}
+
+				dev_t	device;
+				ino_t	node;
+			};
+
+	typedef HashMap<NodeKey, ContentDigest*> DigestMap;
+
+	static	int32				_WorkerEntry(void* cookie);
+			int32				_Worker();
+			bool				_IsCanceled(const Job* job);
+
+			status_t			_Hash(const entry_ref& ref,
+									ContentDigest** digest, uint8* buffer);
+			ContentDigest*		_CachedDigest(const node_ref& node,
+									off_t size, time_t modified);
+			void				_CacheDigest(ContentDigest* digest);
+
+			BlockingQueue<Job>	fJobs;
+			BLocker				fJobLock;
+			BList				fPendingJobs;
+			BLocker				fNotifyLock;
+			thread_id*			fWorkers;
+			int32				fWorkerCount;
+			size_t				fBlockSize;
+
+			BLocker				fCacheLock;
+			DigestMap			fCache;
+
+			int64				fBytesHashed;
+			int64				fHashingTime;
+			int32				fCacheHits;
+			int32				fCacheMisses;
+
+			status_t			fStatus;
+
+	static	ContentHasher*		sDefaultHasher;
+};
+
+#endif // CONTENT_HASHER_H
@@ -1,45 +1,73 @@
 /*
  * Copyright 2002-2007, Ingo Weinhold <ingo_weinhold@gmx.de>
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
  * All rights reserved. Distributed under the terms of the MIT license.
  */
 
+#include "RWLocker.h"
+
+#include <new>
+#include <string.h>
+
 #include <String.h>
 
-#include "RWLocker.h"
+using std::nothrow;
 
-// info about a read lock owner
+// a reader slot, padded to a cache line, so that readers in different
+// slots don't slow each other down
+struct RWLocker::ReaderSlot {
+	vint32		thread;		// owner or -1
+	vint32		count;		// nested read locks of the owner
+	bigtime_t	lockTime;	// for the statistics, 0 if not collected
+	uint8		padding[48];
+};
+
+// info about a read lock owner without reader slot
 struct RWLocker::ReadLockInfo {
 	thread_id	reader;
 	int32		count;
+	bigtime_t	lockTime;
 };
 
 
 // constructor
 RWLocker::RWLocker()
-	: fLock(),
-	  fMutex(),
-	  fQueue(),
-	  fReaderCount(0),
-	  fWriterCount(0),
-	  fReadLockInfos(8),
+	: fSlots(new ReaderSlot[READER_SLOT_COUNT]),
+	  fWriterLock(),
+	  fWriterWaitSem(-1),
+	  fWriterPending(0),
 	  fWriter(B_ERROR),
 	  fWriterWriterCount(0),
-	  fWriterReaderCount(0)
+	  fWriterReaderCount(0),
+	  fOverflowLock(),
+	  fOverflowReaders(8),
+	  fOverflowCount(0),
+	  fWriteGeneration(0),
+	  fStatisticsEnabled(false),
+	  fStatisticsLock(),
+	  fActiveReaders(0),
+	  fWriteLockTime(0)
 {
 	_Init(NULL);
 }
 
 // constructor
 RWLocker::RWLocker(const char* name)
-	: fLock(name),
-	  fMutex(),
-	  fQueue(),
-	  fReaderCount(0),
-	  fWriterCount(0),
-	  fReadLockInfos(8),
+	: fSlots(new ReaderSlot[READER_SLOT_COUNT]),
+	  fWriterLock(name),
+	  fWriterWaitSem(-1),
+	  fWriterPending(0),
 	  fWriter(B_ERROR),
 	  fWriterWriterCount(0),
-	  fWriterReaderCount(0)
+	  fWriterReaderCount(0),
+	  fOverflowLock(),
+	  fOverflowReaders(8),
+	  fOverflowCount(0),
+	  fWriteGeneration(0),
+	  fStatisticsEnabled(false),
+	  fStatisticsLock(),
+	  fActiveReaders(0),
+	  fWriteLockTime(0)
 {
 	_Init(name);
 }
@@ -47,11 +75,13 @@ RWLocker::RWLocker(const char* name)
 // destructor
 RWLocker::~RWLocker()
 {
-	fLock.Lock();
-	delete_sem(fMutex.semaphore);
-	delete_sem(fQueue.semaphore);
-	for (int32 i = 0; ReadLockInfo* info = _ReadLockInfoAt(i); i++)
+	fWriterLock.Lock();
+	delete_sem(fWriterWaitSem);
+	for (int32 i = 0; ReadLockInfo* info
+			= (ReadLockInfo*)fOverflowReaders.ItemAt(i); i++) {
 		delete info;
+	}
+	delete[] fSlots;
 }
 
 // ReadLock
@@ -77,30 +107,56 @@ RWLocker::ReadLockWithTimeout(bigtime_t timeout)
 void
 RWLocker::ReadUnlock()
 {
-	if (fLock.Lock()) {
-		thread_id thread = find_thread(NULL);
-		if (thread == fWriter) {
-			// We (also) have a write lock.
-			if (fWriterReaderCount > 0)
-				fWriterReaderCount--;
-			// else: error: unmatched ReadUnlock()
-		} else {
-			int32 index = _IndexOf(thread);
-			if (ReadLockInfo* info = _ReadLockInfoAt(index)) {
-				fReaderCount--;
-				if (--info->count == 0) {
-					// The outer read lock bracket for the thread has been
-					// reached. Dispose the info.
-					_DeleteReadLockInfo(index);
-				}
-				if (fReaderCount == 0) {
-					// The last reader needs to unlock the mutex.
-					_ReleaseBenaphore(fMutex);
-				}
-			}	// else: error: caller has no read lock
+	thread_id thread = find_thread(NULL);
+	if (thread == fWriter) {
+		// We (also) have a write lock.
+		if (fWriterReaderCount > 0)
+			fWriterReaderCount--;
+		// else: error: unmatched ReadUnlock()
+		return;
+	}
+
+	ReaderSlot& slot = _SlotFor(thread);
+	if (slot.thread == thread) {
+		if (slot.count > 1) {
+			atomic_add(&slot.count, -1);
+			return;
 		}
-		fLock.Unlock();
-	}	// else: we are probably going to be destroyed
+		// The outer read lock bracket for the thread has been reached.
+		// The count needs to be cleared first, another thread could take
+		// over the slot otherwise.
+		bigtime_t lockTime = slot.lockTime;
+		atomic_add(&slot.count, -1);
+		atomic_test_and_set(&slot.thread, -1, thread);
+		_WakeUpWriter();
+		if (lockTime > 0)
+			_ReaderUnlocked(lockTime);
+		return;
+	}
+
+	if (fOverflowCount == 0) {
+		// error: caller has no read lock
+		return;
+	}
+
+	AutoLocker<BLocker> locker(fOverflowLock);
+	ReadLockInfo* info = _OverflowInfoFor(thread);
+	if (!info) {
+		// error: caller has no read lock
+		return;
+	}
+	if (--info->count > 0)
+		return;
+
+	bigtime_t lockTime = info->lockTime;
+	fOverflowReaders.RemoveItem(info);
+	delete info;
+	locker.Unlock();
+
+	atomic_add(&fOverflowCount, -1);
+	_WakeUpWriter();
+	if (lockTime > 0)
+		_ReaderUnlocked(lockTime);
 }
 
 // IsReadLocked
@@ -110,13 +166,8 @@ RWLocker::ReadUnlock()
 bool
 RWLocker::IsReadLocked() const
 {
-	bool result = false;
-	if (fLock.Lock()) {
-		thread_id thread = find_thread(NULL);
-		result = (thread == fWriter || _IndexOf(thread) >= 0);
-		fLock.Unlock();
-	}
-	return result;
+	thread_id thread = find_thread(NULL);
+	return thread == fWriter || _ReadLockCount(thread) > 0;
 }
 
 // WriteLock
@@ -142,32 +193,37 @@ RWLocker::WriteLockWithTimeout(bigtime_t timeout)
 void
 RWLocker::WriteUnlock()
 {
-	if (fLock.Lock()) {
-		thread_id thread = find_thread(NULL);
-		if (thread == fWriter) {
-			fWriterCount--;
-			if (--fWriterWriterCount == 0) {
-				// The outer write lock bracket for the thread has been
-				// reached.
-				fWriter = B_ERROR;
-				if (fWriterReaderCount > 0) {
-					// We still own read locks.
-					_NewReadLockInfo(thread, fWriterReaderCount);
-					// A reader that expects to be the first reader may wait
-					// at the mutex semaphore. We need to wake it up.
-					if (fReaderCount > 0)
-						_ReleaseBenaphore(fMutex);
-					fReaderCount += fWriterReaderCount;
-					fWriterReaderCount = 0;
-				} else {
-					// We don't own any read locks. So we have to release the
-					// mutex benaphore.
-					_ReleaseBenaphore(fMutex);
-				}
-			}
-		}	// else: error: unmatched WriteUnlock()
-		fLock.Unlock();
-	}	// else: We're probably going to die.
+	thread_id thread = find_thread(NULL);
+	if (thread != fWriter) {
+		// error: unmatched WriteUnlock()
+		return;
+	}
+
+	if (--fWriterWriterCount > 0)
+		return;
+
+	// The outer write lock bracket for the thread has been reached.
+	bigtime_t lockTime = fWriteLockTime;
+	fWriteLockTime = 0;
+	fWriter = B_ERROR;
+	if (fWriterReaderCount > 0) {
+		// We still own read locks. Since we still hold the writer lock, no
+		// other reader can get in between.
+		_AddReader(thread, fWriterReaderCount, 0);
+		fWriterReaderCount = 0;
+	}
+	// let readers know that the protected data may have changed
+	atomic_add(&fWriteGeneration, 1);
+	atomic_add(&fWriterPending, -1);
+	fWriterLock.Unlock();
+
+	if (lockTime > 0) {
+		bigtime_t holdTime = system_time() - lockTime;
+		AutoLocker<BLocker> locker(fStatisticsLock);
+		fStatistics.write_hold_time += holdTime;
+		if (holdTime > fStatistics.max_write_hold_time)
+			fStatistics.max_write_hold_time = holdTime;
+	}
 }
 
 // IsWriteLocked
@@ -179,20 +235,48 @@ RWLocker::IsWriteLocked() const
 	return (fWriter == find_thread(NULL));
 }
 
+// #pragma mark - statistics
+
+// SetStatisticsEnabled
+void
+RWLocker::SetStatisticsEnabled(bool enabled)
+{
+	fStatisticsEnabled = enabled;
+}
+
+// GetStatistics
+void
+RWLocker::GetStatistics(rw_locker_statistics& statistics) const
+{
+	AutoLocker<BLocker> locker(fStatisticsLock);
+	statistics = fStatistics;
+}
+
+// ResetStatistics
+void
+RWLocker::ResetStatistics()
+{
+	AutoLocker<BLocker> locker(fStatisticsLock);
+	memset(&fStatistics, 0, sizeof(rw_locker_statistics));
+}
+
+// #pragma mark - private
+
 // _Init
 void
 RWLocker::_Init(const char* name)
 {
-	// init the mutex benaphore
-	BString mutexName(name);
-	mutexName += "_RWLocker_mutex";
-	fMutex.semaphore = create_sem(0, mutexName.String());
-	fMutex.counter = 0;
-	// init the queueing benaphore
-	BString queueName(name);
-	queueName += "_RWLocker_queue";
-	fQueue.semaphore = create_sem(0, queueName.String());
-	fQueue.counter = 0;
+	for (int32 i = 0; i < READER_SLOT_COUNT; i++) {
+		fSlots[i].thread = -1;
+		fSlots[i].count = 0;
+		fSlots[i].lockTime = 0;
+	}
+
+	BString semName(name);
+	semName += "_RWLocker_writer";
+	fWriterWaitSem = create_sem(0, semName.String());
+
+	memset(&fStatistics, 0, sizeof(rw_locker_statistics));
 }
 
 // _ReadLock
@@ -201,68 +285,49 @@ RWLocker::_Init(const char* name)
 status_t
 RWLocker::_ReadLock(bigtime_t timeout)
 {
-	status_t error = B_OK;
 	thread_id thread = find_thread(NULL);
-	bool locked = false;
-	if (fLock.Lock()) {
-		// Check, if we already own a read (or write) lock. In this case we
-		// can skip the usual locking procedure.
-		if (thread == fWriter) {
-			// We already own a write lock.
-			fWriterReaderCount++;
-			locked = true;
-		} else if (ReadLockInfo* info = _ReadLockInfoAt(_IndexOf(thread))) {
-			// We already own a read lock.
-			info->count++;
-			fReaderCount++;
-			locked = true;
-		}
-		fLock.Unlock();
-	} else	// failed to lock the data
-		error = B_ERROR;
-	// Usual locking, i.e. we do not already own a read or write lock.
-	if (error == B_OK && !locked) {
-		error = _AcquireBenaphore(fQueue, timeout);
-		if (error == B_OK) {
-			if (fLock.Lock()) {
-				bool firstReader = false;
-				if (++fReaderCount == 1) {
-					// We are the first reader.
-					_NewReadLockInfo(thread);
-					firstReader = true;
-				} else
-					_NewReadLockInfo(thread);
-				fLock.Unlock();
-				// The first reader needs to lock the mutex.
-				if (firstReader) {
-					error = _AcquireBenaphore(fMutex, timeout);
-					switch (error) {
-						case B_OK:
-							// fine
-							break;
-						case B_TIMED_OUT: {
-							// clean up
-							if (fLock.Lock()) {
-								_DeleteReadLockInfo(_IndexOf(thread));
-								fReaderCount--;
-								fLock.Unlock();
-							}
-							break;
-						}
-						default:
-							// Probably we are going to be destroyed.
-							break;
-					}
-				}
-				// Let the next candidate enter the game.
-				_ReleaseBenaphore(fQueue);
-			} else {
-				// We couldn't lock the data, which can only happen, if
-				// we're going to be destroyed.
-				error = B_ERROR;
-			}
+	if (thread == fWriter) {
+		// We already own a write lock.
+		fWriterReaderCount++;
+		return B_OK;
+	}
+
+	// Check, if we already own a read lock. In this case we can skip the
+	// usual locking procedure.
+	if (_TryNestedReadLock(thread))
+		return B_OK;
+
+	bool collectStatistics = fStatisticsEnabled;
+	bigtime_t startTime = collectStatistics ? system_time() : 0;
+
+	// Fast path: take over our slot, unless another thread owns it.
+	ReaderSlot& slot = _SlotFor(thread);
+	if (atomic_test_and_set(&slot.thread, thread, -1) == -1) {
+		slot.lockTime = startTime;
+		atomic_add(&slot.count, 1);
+		if (fWriterPending == 0) {
+			if (collectStatistics)
+				_ReaderLocked(startTime, startTime, false);
+			return B_OK;
 		}
+		// A writer owns the lock or waits for it, don't overtake it.
+		atomic_add(&slot.count, -1);
+		atomic_test_and_set(&slot.thread, -1, thread);
+		_WakeUpWriter();
 	}
+
+	// Slow path: queue behind the writers. As long as we hold the writer
+	// lock, no writer can own the lock.
+	status_t error = _LockWriterLock(timeout);
+	if (error != B_OK)
+		return error;
+
+	bigtime_t lockTime = collectStatistics ? system_time() : 0;
+	error = _AddReader(thread, 1, lockTime);
+	fWriterLock.Unlock();
+
+	if (error == B_OK && collectStatistics)
+		_ReaderLocked(startTime, lockTime, true);
 	return error;
 }
 
@@ -272,197 +337,311 @@ RWLocker::_ReadLock(bigtime_t timeout)
 status_t
 RWLocker::_WriteLock(bigtime_t timeout)
 {
-	status_t error = B_ERROR;
-	if (fLock.Lock()) {
-		bool infiniteTimeout = (timeout == B_INFINITE_TIMEOUT);
-		bool locked = false;
-		int32 readerCount = 0;
-		thread_id thread = find_thread(NULL);
-		int32 index = _IndexOf(thread);
-		if (ReadLockInfo* info = _ReadLockInfoAt(index)) {
-			// We already own a read lock.
-			if (fWriterCount > 0) {
-				// There are writers before us.
-				if (infiniteTimeout) {
-					// Timeout is infinite and there are writers before us.
-					// Unregister the read locks and lock as usual.
-					readerCount = info->count;
-					fWriterCount++;
-					fReaderCount -= readerCount;
-					_DeleteReadLockInfo(index);
-					error = B_OK;
-				} else {
-					// The timeout is finite and there are readers before us:
-					// let the write lock request fail.
-					error = B_WOULD_BLOCK;
-				}
-			} else if (info->count == fReaderCount) {
-				// No writers before us.
-				// We are the only read lock owners. Just move the read lock
-				// info data to the special writer fields and then we are done.
-				// Note: At this point we may overtake readers that already
-				// have acquired the queueing benaphore, but have not yet
-				// locked the data. But that doesn't harm.
-				fWriter = thread;
-				fWriterCount++;
-				fWriterWriterCount = 1;
-				fWriterReaderCount = info->count;
-				fReaderCount -= fWriterReaderCount;
-				_DeleteReadLockInfo(index);
-				locked = true;
-				error = B_OK;
-			} else {
-				// No writers before us, but other readers.
-				// Note, we're quite restrictive here. If there are only
-				// readers before us, we could reinstall our readers, if
-				// our request times out. Unfortunately it is not easy
-				// to ensure, that no writer overtakes us between unlocking
-				// the data and acquiring the queuing benaphore.
-				if (infiniteTimeout) {
-					// Unregister the readers and lock as usual.
-					readerCount = info->count;
-					fWriterCount++;
-					fReaderCount -= readerCount;
-					_DeleteReadLockInfo(index);
-					error = B_OK;
-				} else
-					error = B_WOULD_BLOCK;
-			}
-		} else {
-			// We don't own a read lock.
-			if (fWriter == thread) {
-				// ... but a write lock.
-				fWriterCount++;
-				fWriterWriterCount++;
-				locked = true;
-				error = B_OK;
-			} else {
-				// We own neither read nor write locks.
-				// Lock as usual.
-				fWriterCount++;
-				error = B_OK;
-			}
-		}
-		fLock.Unlock();
-		// Usual locking...
-		// First step: acquire the queueing benaphore.
-		if (!locked && error == B_OK) {
-			error = _AcquireBenaphore(fQueue, timeout);
-			switch (error) {
-				case B_OK:
-					break;
-				case B_TIMED_OUT: {
-					// clean up
-					if (fLock.Lock()) {
-						fWriterCount--;
-						fLock.Unlock();
-					}	// else: failed to lock the data: we're probably going
-						// to die.
-					break;
-				}
-				default:
-					// Probably we're going to die.
-					break;
-			}
-		}
-		// Second step: acquire the mutex benaphore.
-		if (!locked && error == B_OK) {
-			error = _AcquireBenaphore(fMutex, timeout);
-			switch (error) {
-				case B_OK: {
-					// Yeah, we made it. Set the special writer fields.
-					fWriter = thread;
-					fWriterWriterCount = 1;
-					fWriterReaderCount = readerCount;
-					break;
-				}
-				case B_TIMED_OUT: {
-					// clean up
-					if (fLock.Lock()) {
-						fWriterCount--;
-						fLock.Unlock();
-					}	// else: failed to lock the data: we're probably going
-						// to die.
-					break;
-				}
-				default:
-					// Probably we're going to die.
-					break;
+	thread_id thread = find_thread(NULL);
+	if (thread == fWriter) {
+		// We already own a write lock.
+		fWriterWriterCount++;
+		return B_OK;
+	}
+
+	bool collectStatistics = fStatisticsEnabled;
+	bigtime_t startTime = collectStatistics ? system_time() : 0;
+
+	int32 readerCount = _ReadLockCount(thread);
+	if (readerCount > 0) {
+		// We already own a read lock.
+		if (timeout != B_INFINITE_TIMEOUT) {
+			// The timeout is finite, so we must not give up our read locks.
+			// We can only get the lock, if no one else owns or waits for it.
+			if (fWriterLock.LockWithTimeout(0) != B_OK)
+				return B_WOULD_BLOCK;
+			atomic_add(&fWriterPending, 1);
+			if (_HasReaders(thread)) {
+				atomic_add(&fWriterPending, -1);
+				fWriterLock.Unlock();
+				return B_WOULD_BLOCK;
 			}
-			// Whatever happened, we have to release the queueing benaphore.
-			_ReleaseBenaphore(fQueue);
+			// We are the only read lock owner. Just move our read locks
+			// to the special writer fields and then we are done.
+			_RemoveReader(thread);
+			fWriter = thread;
+			fWriterWriterCount = 1;
+			fWriterReaderCount = readerCount;
+			if (collectStatistics)
+				_WriterLocked(startTime, false);
+			return B_OK;
 		}
-	} else	// failed to lock the data
-		error = B_ERROR;
-	return error;
+		// Unregister the read locks and lock as usual.
+		_RemoveReader(thread);
+	}
+
+	// Usual locking...
+	// First step: wait for the writers before us.
+	bool contended = fWriterLock.IsLocked();
+	status_t error = _LockWriterLock(timeout);
+	if (error != B_OK)
+		return error;
+
+	// Second step: keep new readers out and wait for the current ones.
+	atomic_add(&fWriterPending, 1);
+	bool waited;
+	error = _WaitForReaders(timeout, waited);
+	if (error != B_OK) {
+		atomic_add(&fWriterPending, -1);
+		fWriterLock.Unlock();
+		return error;
+	}
+
+	// Yeah, we made it. Set the special writer fields.
+	fWriter = thread;
+	fWriterWriterCount = 1;
+	fWriterReaderCount = readerCount;
+	if (collectStatistics)
+		_WriterLocked(startTime, contended || waited);
+	return B_OK;
 }
 
-// _AddReadLockInfo
-int32
-RWLocker::_AddReadLockInfo(ReadLockInfo* info)
+// _SlotFor
+RWLocker::ReaderSlot&
+RWLocker::_SlotFor(thread_id thread) const
 {
-	int32 index = fReadLockInfos.CountItems();
-	fReadLockInfos.AddItem(info, index);
-	return index;
+	return fSlots[thread % READER_SLOT_COUNT];
 }
 
-// _NewReadLockInfo
+// _TryNestedReadLock
+bool
+RWLocker::_TryNestedReadLock(thread_id thread)
+{
+	ReaderSlot& slot = _SlotFor(thread);
+	if (slot.thread == thread) {
+		atomic_add(&slot.count, 1);
+		return true;
+	}
+
+	if (fOverflowCount == 0)
+		return false;
+
+	AutoLocker<BLocker> locker(fOverflowLock);
+	ReadLockInfo* info = _OverflowInfoFor(thread);
+	if (!info)
+		return false;
+	info->count++;
+	return true;
+}
+
+// _AddReader
 //
-// Create a new read lock info for the supplied thread and add it to the
-// list. Returns the index of the info.
-int32
-RWLocker::_NewReadLockInfo(thread_id thread, int32 count)
+// Registers /count/ read locks for the thread. The caller needs to hold
+// the writer lock.
+status_t
+RWLocker::_AddReader(thread_id thread, int32 count, bigtime_t lockTime)
 {
-	ReadLockInfo* info = new ReadLockInfo;
+	ReaderSlot& slot = _SlotFor(thread);
+	if (atomic_test_and_set(&slot.thread, thread, -1) == -1) {
+		slot.lockTime = lockTime;
+		atomic_add(&slot.count, count);
+		return B_OK;
+	}
+
+	// The slot is used by another thread.
+	ReadLockInfo* info = new (nothrow) ReadLockInfo;
+	if (!info)
+		return B_NO_MEMORY;
 	info->reader = thread;
 	info->count = count;
-	return _AddReadLockInfo(info);
+	info->lockTime = lockTime;
+
+	AutoLocker<BLocker> locker(fOverflowLock);
+	if (!fOverflowReaders.AddItem(info)) {
+		delete info;
+		return B_NO_MEMORY;
+	}
+	atomic_add(&fOverflowCount, 1);
+	return B_OK;
 }
 
-// _DeleteReadLockInfo
-void
-RWLocker::_DeleteReadLockInfo(int32 index)
+// _RemoveReader
+//
+// Removes all read locks of the thread, returns their number.
+int32
+RWLocker::_RemoveReader(thread_id thread)
 {
-	if (ReadLockInfo* info = (ReadLockInfo*)fReadLockInfos.RemoveItem(index))
+	int32 count = 0;
+	bigtime_t lockTime = 0;
+
+	ReaderSlot& slot = _SlotFor(thread);
+	if (slot.thread == thread) {
+		count = slot.count;
+		lockTime = slot.lockTime;
+		atomic_add(&slot.count, -count);
+		atomic_test_and_set(&slot.thread, -1, thread);
+	} else if (fOverflowCount > 0) {
+		AutoLocker<BLocker> locker(fOverflowLock);
+		ReadLockInfo* info = _OverflowInfoFor(thread);
+		if (!info)
+			return 0;
+		count = info->count;
+		lockTime = info->lockTime;
+		fOverflowReaders.RemoveItem(info);
 		delete info;
+		locker.Unlock();
+
+		atomic_add(&fOverflowCount, -1);
+	}
+
+	if (count > 0) {
+		_WakeUpWriter();
+		if (lockTime > 0)
+			_ReaderUnlocked(lockTime);
+	}
+	return count;
 }
 
-// _ReadLockInfoAt
-RWLocker::ReadLockInfo*
-RWLocker::_ReadLockInfoAt(int32 index) const
+// _ReadLockCount
+int32
+RWLocker::_ReadLockCount(thread_id thread) const
 {
-	return (ReadLockInfo*)fReadLockInfos.ItemAt(index);
+	ReaderSlot& slot = _SlotFor(thread);
+	if (slot.thread == thread)
+		return slot.count;
+
+	if (fOverflowCount == 0)
+		return 0;
+
+	AutoLocker<BLocker> locker(fOverflowLock);
+	ReadLockInfo* info = _OverflowInfoFor(thread);
+	return info ? info->count : 0;
 }
 
-// _IndexOf
-int32
-RWLocker::_IndexOf(thread_id thread) const
+// _HasReaders
+//
+// Returns whether any thread other than /except/ owns a read lock.
+bool
+RWLocker::_HasReaders(thread_id except) const
+{
+	for (int32 i = 0; i < READER_SLOT_COUNT; i++) {
+		if (fSlots[i].count > 0 && fSlots[i].thread != except)
+			return true;
+	}
+
+	if (fOverflowCount == 0)
+		return false;
+
+	AutoLocker<BLocker> locker(fOverflowLock);
+	int32 count = fOverflowReaders.CountItems();
+	if (except >= 0 && _OverflowInfoFor(except))
+		count--;
+	return count > 0;
+}
+
+// _WakeUpWriter
+void
+RWLocker::_WakeUpWriter()
 {
-	int32 count = fReadLockInfos.CountItems();
+	// The writer checks the readers again when woken up, so it doesn't
+	// matter if we wake it up although other readers are still there.
+	if (fWriterPending > 0)
+		release_sem_etc(fWriterWaitSem, 1, B_DO_NOT_RESCHEDULE);
+}
+
+// _OverflowInfoFor
+//
+// The caller needs to hold the overflow lock.
+RWLocker::ReadLockInfo*
+RWLocker::_OverflowInfoFor(thread_id thread) const
+{
+	int32 count = fOverflowReaders.CountItems();
 	for (int32 i = 0; i < count; i++) {
-		if (_ReadLockInfoAt(i)->reader == thread)
-			return i;
+		ReadLockInfo* info = (ReadLockInfo*)fOverflowReaders.ItemAtFast(i);
+		if (info->reader == thread)
+			return info;
 	}
-	return -1;
+	return NULL;
 }
 
-// _AcquireBenaphore
+// _LockWriterLock
+//
+// /timeout/ -- absolute timeout
 status_t
-RWLocker::_AcquireBenaphore(Benaphore& benaphore, bigtime_t timeout)
+RWLocker::_LockWriterLock(bigtime_t timeout)
 {
-	status_t error = B_OK;
-	if (atomic_add(&benaphore.counter, 1) > 0) {
-		error = acquire_sem_etc(benaphore.semaphore, 1, B_ABSOLUTE_TIMEOUT,
-								timeout);
+	if (timeout == B_INFINITE_TIMEOUT)
+		return fWriterLock.Lock() ? B_OK : B_ERROR;
+
+	bigtime_t relativeTimeout = timeout - system_time();
+	if (relativeTimeout < 0)
+		relativeTimeout = 0;
+	return fWriterLock.LockWithTimeout(relativeTimeout);
+}
+
+// _WaitForReaders
+//
+// /timeout/ -- absolute timeout
+status_t
+RWLocker::_WaitForReaders(bigtime_t timeout, bool& waited)
+{
+	waited = false;
+	while (_HasReaders()) {
+		waited = true;
+		status_t error = acquire_sem_etc(fWriterWaitSem, 1,
+			B_ABSOLUTE_TIMEOUT, timeout);
+		if (error != B_OK && error != B_INTERRUPTED)
+			return error;
 	}
-	return error;
+
+	// Readers may have woken us up more often than necessary, also while
+	// the previous writer owned the lock.
+	int32 count;
+	if (get_sem_count(fWriterWaitSem, &count) == B_OK && count > 0)
+		acquire_sem_etc(fWriterWaitSem, count, B_RELATIVE_TIMEOUT, 0);
+
+	return B_OK;
+}
+
+// _ReaderLocked
+void
+RWLocker::_ReaderLocked(bigtime_t startTime, bigtime_t lockTime,
+	bool contended)
+{
+	int32 readers = atomic_add(&fActiveReaders, 1) + 1;
+	bigtime_t waitTime = lockTime - startTime;
+
+	AutoLocker<BLocker> locker(fStatisticsLock);
+	fStatistics.read_locks++;
+	if (contended)
+		fStatistics.contended_read_locks++;
+	fStatistics.read_wait_time += waitTime;
+	if (waitTime > fStatistics.max_read_wait_time)
+		fStatistics.max_read_wait_time = waitTime;
+	if (readers > fStatistics.max_readers)
+		fStatistics.max_readers = readers;
 }
 
-// _ReleaseBenaphore
+// _ReaderUnlocked
 void
-RWLocker::_ReleaseBenaphore(Benaphore& benaphore)
+RWLocker::_ReaderUnlocked(bigtime_t lockTime)
 {
-	if (atomic_add(&benaphore.counter, -1) > 1)
-		release_sem(benaphore.semaphore);
+	atomic_add(&fActiveReaders, -1);
+	bigtime_t holdTime = system_time() - lockTime;
+
+	AutoLocker<BLocker> locker(fStatisticsLock);
+	fStatistics.read_hold_time += holdTime;
+	if (holdTime > fStatistics.max_read_hold_time)
+		fStatistics.max_read_hold_time = holdTime;
 }
 
+// _WriterLocked
+void
+RWLocker::_WriterLocked(bigtime_t startTime, bool contended)
+{
+	fWriteLockTime = system_time();
+	bigtime_t waitTime = fWriteLockTime - startTime;
+
+	AutoLocker<BLocker> locker(fStatisticsLock);
+	fStatistics.write_locks++;
+	if (contended)
+		fStatistics.contended_write_locks++;
+	fStatistics.write_wait_time += waitTime;
+	if (waitTime > fStatistics.max_write_wait_time)
+		fStatistics.max_write_wait_time = waitTime;
+}
@@ -1,5 +1,6 @@
 /*
  * Copyright 2002-2007, Ingo Weinhold <ingo_weinhold@gmx.de>
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
  * All rights reserved. Distributed under the terms of the MIT license.
  */
 
@@ -11,14 +12,12 @@
 //   the same thread has to call Unlock() later.
 // * Nested locking is supported: a number of XXXLock() calls needs to be
 //   bracketed by the same number of XXXUnlock() calls.
-// * The lock acquiration strategy is fair: a lock applicant needs to wait
-//   only for those threads that already own a lock or requested one before
-//   the current thread. No one can overtake. E.g. if a thread owns a read
-//   lock, another one is waiting for a write lock, then a third one
-//   requesting a read lock has to wait until the write locker is done.
-//   This does not hold for threads that already own a lock (nested locking).
-//   A read lock owner is immediately granted another read lock and a write
-//   lock owner another write or a read lock.
+// * Writers are queued in the order they requested the lock. Once a writer
+//   has requested the lock, new readers have to wait until it is done, so
+//   writers cannot be starved by a steady stream of readers. This does not
+//   hold for threads that already own a lock (nested locking). A read lock
+//   owner is immediately granted another read lock and a write lock owner
+//   another write or a read lock.
 // * A write lock owner is allowed to request a read lock and a read lock
 //   owner a write lock. While the first case is not problematic, the
 //   second one needs some further explanation: A read lock owner requesting
@@ -41,32 +40,40 @@
 // locker object.
 //
 // Implementation details:
-// A locker needs three semaphores (a BLocker and two semaphores): one
-// to protect the lockers data, one as a reader/writer mutex (to be
-// acquired by each writer and the first reader) and one for queueing
-// waiting readers and writers. The simplified locking/unlocking
-// algorithm is the following:
+// The document is read locked by the playback threads and the GUI many
+// times per frame, so taking a read lock must not involve any shared data.
+// Each reader registers in one of a fixed number of reader slots, chosen by
+// its thread ID. Each slot occupies its own cache line and is written only
+// by the thread which owns it. The simplified locking/unlocking algorithm
+// is the following:
 //
-//		writer				reader
-//	queue.acquire()		queue.acquire()
-//	mutex.acquire()		if (first reader) mutex.acquire()
-//	queue.release()		queue.release()
-//		 ...				 ...
-//	mutex.release()		if (last reader) mutex.release()
+//		writer							reader
+//	writerLock.Lock()				slot.count++
+//	writerPending++					if (writerPending) {
+//	wait until all slot counts			slot.count--
+//		are zero						writerLock.Lock()
+//										slot.count++
+//										writerLock.Unlock()
+//									}
+//		 ...							 ...
+//	writerPending--					slot.count--
+//	writerLock.Unlock()				if (writerPending) wake up writer
 //
-// One thread at maximum waits at the mutex, the others at the queueing
-// semaphore. Unfortunately features as nested locking and timeouts make
-// things more difficult. Therefore readers as well as writers need to check
-// whether they already own a lock before acquiring the queueing semaphore.
-// The data for the readers are stored in a list of ReadLockInfo structures;
-// the writer data are stored in some special fields. /fReaderCount/ and
-// /fWriterCount/ contain the total count of unbalanced Read/WriteLock()
-// calls, /fWriterReaderCount/ and /fWriterWriterCount/ only from those of
-// the current write lock owner (/fWriter/). To be a bit more precise:
-// /fWriterReaderCount/ is not contained in /fReaderCount/, but
-// /fWriterWriterCount/ is contained in /fWriterCount/. Therefore
-// /fReaderCount/ can be considered to be the count of true reader's read
-// locks.
+// The atomic operations on the slot count and the pending writer flag
+// order the accesses, so that either the reader sees the pending writer,
+// or the writer sees the slot count of the reader. Readers whose slot is
+// occupied by another thread are registered in a list protected by a
+// separate lock instead. /fWriterWriterCount/ and /fWriterReaderCount/
+// count the nested write and read locks of the current write lock owner
+// (/fWriter/).
+//
+// Every time the outer write lock bracket is left, the write generation is
+// incremented. Readers can compare it to the generation of data they copied
+// earlier, to find out whether their copy may be out of date.
+//
+// Optionally, the locker collects contention statistics: how long threads
+// had to wait for and held the lock and how many readers owned it at the
+// same time. Since this needs a shared counter, it is off by default.
 
 #ifndef RW_LOCKER_H
 #define RW_LOCKER_H
@@ -76,6 +83,24 @@
 
 #include "AutoLocker.h"
 
+struct rw_locker_statistics {
+	int64		read_locks;
+	int64		contended_read_locks;	// took the slow path
+	bigtime_t	read_wait_time;
+	bigtime_t	max_read_wait_time;
+	bigtime_t	read_hold_time;			// outer read lock brackets only
+	bigtime_t	max_read_hold_time;
+
+	int64		write_locks;
+	int64		contended_write_locks;	// had to wait for anyone
+	bigtime_t	write_wait_time;
+	bigtime_t	max_write_wait_time;
+	bigtime_t	write_hold_time;
+	bigtime_t	max_write_hold_time;
+
+	int32		max_readers;			// concurrent reader threads
+};
+
 class RWLocker {
  public:
 								RWLocker();
@@ -92,40 +117,70 @@ class RWLocker {
 			void				WriteUnlock();
 			bool				IsWriteLocked() const;
 
+			int32				WriteGeneration() const
+									{ return fWriteGeneration; }
+
+	// contention statistics
+			void				SetStatisticsEnabled(bool enabled);
+			bool				StatisticsEnabled() const
+									{ return fStatisticsEnabled; }
+			void				GetStatistics(
+									rw_locker_statistics& statistics) const;
+			void				ResetStatistics();
+
  private:
-	struct	ReadLockInfo;
-	struct	Benaphore {
-			sem_id	semaphore;
-			int32	counter;
+	enum {
+		READER_SLOT_COUNT		= 32
 	};
 
+	struct	ReaderSlot;
+	struct	ReadLockInfo;
+
  private:
 			void				_Init(const char* name);
 			status_t			_ReadLock(bigtime_t timeout);
 			status_t			_WriteLock(bigtime_t timeout);
 
-			int32				_AddReadLockInfo(ReadLockInfo* info);
-			int32				_NewReadLockInfo(thread_id thread,
-												 int32 count = 1);
-			void				_DeleteReadLockInfo(int32 index);
-			ReadLockInfo*		_ReadLockInfoAt(int32 index) const;
-			int32				_IndexOf(thread_id thread) const;
+			ReaderSlot&			_SlotFor(thread_id thread) const;
+			bool				_TryNestedReadLock(thread_id thread);
+			status_t			_AddReader(thread_id thread, int32 count,
+									bigtime_t lockTime);
+			int32				_RemoveReader(thread_id thread);
+			int32				_ReadLockCount(thread_id thread) const;
+			bool				_HasReaders(thread_id except = -1) const;
+			void				_WakeUpWriter();
 
-	static	status_t			_AcquireBenaphore(Benaphore& benaphore,
-												  bigtime_t timeout);
-	static	void				_ReleaseBenaphore(Benaphore& benaphore);
+			ReadLockInfo*		_OverflowInfoFor(thread_id thread) const;
+
+			status_t			_LockWriterLock(bigtime_t timeout);
+			status_t			_WaitForReaders(bigtime_t timeout,
+									bool& waited);
+
+			void				_ReaderLocked(bigtime_t startTime,
+									bigtime_t lockTime, bool contended);
+			void				_ReaderUnlocked(bigtime_t lockTime);
+			void				_WriterLocked(bigtime_t startTime,
+									bool contended);
 
  private:
-	mutable	BLocker				fLock;				// data lock
-			Benaphore			fMutex;				// critical code mutex
-			Benaphore			fQueue;				// queueing semaphore
-			int32				fReaderCount;		// total count...
-			int32				fWriterCount;		// total count...
-			BList				fReadLockInfos;
+			ReaderSlot*			fSlots;
+			BLocker				fWriterLock;		// writer mutex
+			sem_id				fWriterWaitSem;		// readers wake writer
+			vint32				fWriterPending;
 			thread_id			fWriter;			// current write lock owner
 			int32				fWriterWriterCount;	// write lock owner count
 			int32				fWriterReaderCount;	// writer read lock owner
 													// count
+	mutable	BLocker				fOverflowLock;
+			BList				fOverflowReaders;	// ReadLockInfos
+			vint32				fOverflowCount;
+			vint32				fWriteGeneration;	// outer write unlocks
+
+			bool				fStatisticsEnabled;
+	mutable	BLocker				fStatisticsLock;
+			rw_locker_statistics fStatistics;
+			vint32				fActiveReaders;
+			bigtime_t			fWriteLockTime;
 };
 
 typedef AutoLocker<RWLocker, AutoLockerReadLocking<RWLocker> > AutoReadLocker;
@@ -22,6 +22,8 @@ class Referencable {
 
 	inline	void				Acquire();
 	inline	bool				Release();
+			int32				CountReferences() const
+									{ return fReferenceCount; }
 
 			void				SetDebugRelease(bool debug);
 	static	int32				DebuggedReferencableCount();
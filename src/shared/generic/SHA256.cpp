@@ -121,11 +121,16 @@ SHA256::Digest()
 void
 SHA256::GetDigestAsString(BString& string)
 {
-	size_t digestLength = DigestLength();
-	const uint8* digest = Digest();
+	DigestToString(Digest(), DigestLength(), string);
+}
+
+// DigestToString
+void
+SHA256::DigestToString(const uint8* digest, size_t length, BString& string)
+{
 	char temp[16];
 	// NOTE: this is the same string representation that the server uses
-	for (size_t i = 0; i < digestLength; i++) {
+	for (size_t i = 0; i < length; i++) {
 		sprintf(temp, "%02x", digest[i]);
 		string << temp;
 	}
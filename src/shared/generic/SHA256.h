@@ -21,6 +21,9 @@ public:
 
 			void				GetDigestAsString(BString& string);
 
+	static	void				DigestToString(const uint8* digest,
+									size_t length, BString& string);
+
 private:
 			void				_ProcessChunk();
 
@@ -8,6 +8,8 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "Observable.h"
+
 // constructor
 CompoundCommand::CompoundCommand(Command** commands,
 								 int32 count,
@@ -43,6 +45,10 @@ CompoundCommand::Perform()
 {
 	status_t status = InitCheck();
 	if (status >= B_OK) {
+		// the observers of objects touched by several commands
+		// are notified only once
+		AutoNotificationBatch _;
+
 		int32 i = 0;
 		for (; i < fCount; i++) {
 			if (fCommands[i])
@@ -69,6 +75,8 @@ CompoundCommand::Undo()
 {
 	status_t status = InitCheck();
 	if (status >= B_OK) {
+		AutoNotificationBatch _;
+
 		int32 i = fCount - 1;
 		for (; i >= 0; i--) {
 			if (fCommands[i])
@@ -86,6 +94,8 @@ CompoundCommand::Redo()
 {
 	status_t status = InitCheck();
 	if (status >= B_OK) {
+		AutoNotificationBatch _;
+
 		int32 i = 0;
 		for (; i < fCount; i++) {
 			if (fCommands[i])
@@ -6,22 +6,41 @@
 
 #include <new>
 #include <stdio.h>
+#include <string.h>
 
 #include "Event.h"
 
 #include "EventQueue.h"
 
+#define PRINT_STATISTICS 0
+
+static const bigtime_t kLateEventThreshold = 1000;
+
 // constructor
 EventQueue::EventQueue()
 	: fEvents(100),
+	  fInboxTail(0),
+	  fInboxHead(0),
+	  fInboxCount(0),
+	  fInboxStalled(0),
+	  fExecutingEvent(NULL),
+	  fExecutionWaiters(0),
+	  fExecutionDone(-1),
 	  fEventExecutor(-1),
 	  fThreadControl(-1),
 	  fNextEventTime(0),
 	  fStatus(B_ERROR)
-	  
+
 {
+	for (int32 i = 0; i < INBOX_SIZE; i++)
+		fInbox[i] = NULL;
+	ResetStatistics();
+
+	fExecutionDone = create_sem(0, "event queue execution done");
 	fThreadControl = create_sem(0, "event queue control");
-	if (fThreadControl >= B_OK)
+	if (fExecutionDone < B_OK)
+		fStatus = fExecutionDone;
+	else if (fThreadControl >= B_OK)
 		fStatus = B_OK;
 	else
 		fStatus = fThreadControl;
@@ -41,6 +60,8 @@ EventQueue::~EventQueue()
 {
 	if (delete_sem(fThreadControl) == B_OK)
 		wait_for_thread(fEventExecutor, &fEventExecutor);
+	delete_sem(fExecutionDone);
+	_DrainInbox();
 	while (Event *event = (Event*)fEvents.RemoveItem((int32)0)) {
 		if (event->AutoDelete())
 			delete event;
@@ -71,6 +92,17 @@ void
 EventQueue::DeleteDefault()
 {
 	if (fDefaultQueue) {
+#if PRINT_STATISTICS
+		event_queue_statistics statistics;
+		fDefaultQueue->GetStatistics(statistics);
+		if (statistics.executed_events > 0) {
+			printf("EventQueue: %lld events, %lld late, lateness: "
+				"average %lld us, max %lld us\n", statistics.executed_events,
+				statistics.late_events,
+				statistics.lateness / statistics.executed_events,
+				statistics.max_lateness);
+		}
+#endif
 		delete fDefaultQueue;
 		fDefaultQueue = NULL;
 	}
@@ -87,20 +119,56 @@ EventQueue::Default()
 void
 EventQueue::AddEvent(Event* event)
 {
-	Lock();
-	_AddEvent(event);
-	_Reschedule();
-	Unlock();
+	if (atomic_add(&fInboxCount, 1) >= INBOX_SIZE) {
+		// the inbox is full, insert the event directly
+		atomic_add(&fInboxCount, -1);
+		Lock();
+		_AddEvent(event);
+		_Reschedule();
+		Unlock();
+		return;
+	}
+
+	int32 index = atomic_add(&fInboxTail, 1) & (INBOX_SIZE - 1);
+	fInbox[index] = event;
+
+	// Wake up the executor, if it found our slot still empty while
+	// draining the inbox, or if the event is due before the time it is
+	// going to wait for. The executor publishes that time before draining
+	// the inbox a last time, and the atomic operations order the accesses,
+	// so either it sees our event or we see its time.
+	bool stalled = atomic_test_and_set(&fInboxStalled, 0, 1) == 1;
+	if (stalled
+		|| event->Time() < atomic_get64((vint64*)&fNextEventTime)) {
+		release_sem(fThreadControl);
+	}
 }
 
 // RemoveEvent
 bool
 EventQueue::RemoveEvent(Event* event)
 {
-	bool result = false;
-	Lock();
-	if ((result = fEvents.RemoveItem(event)))
+	if (!Lock())
+		return false;
+
+	_DrainInbox();
+	int32 index = _IndexOf(event);
+	bool result = index >= 0;
+	if (result) {
+		_RemoveEventAt(index);
 		_Reschedule();
+	} else if (find_thread(NULL) != fEventExecutor) {
+		// the caller may want to delete the event, so wait until
+		// it is no longer executed
+		while (fExecutingEvent == event) {
+			fExecutionWaiters++;
+			Unlock();
+			acquire_sem(fExecutionDone);
+			if (!Lock())
+				return false;
+		}
+	}
+
 	Unlock();
 	return result;
 }
@@ -110,7 +178,10 @@ void
 EventQueue::ChangeEvent(Event* event, bigtime_t newTime)
 {
 	Lock();
-	if (fEvents.RemoveItem(event)) {
+	_DrainInbox();
+	int32 index = _IndexOf(event);
+	if (index >= 0) {
+		_RemoveEventAt(index);
 		event->SetTime(newTime);
 		_AddEvent(event);
 		_Reschedule();
@@ -118,24 +189,32 @@ EventQueue::ChangeEvent(Event* event, bigtime_t newTime)
 	Unlock();
 }
 
+// GetStatistics
+void
+EventQueue::GetStatistics(event_queue_statistics& statistics)
+{
+	Lock();
+	statistics = fStatistics;
+	Unlock();
+}
+
+// ResetStatistics
+void
+EventQueue::ResetStatistics()
+{
+	Lock();
+	memset(&fStatistics, 0, sizeof(fStatistics));
+	Unlock();
+}
+
 // _AddEvent
 //
 // PRE: The object must be locked.
 void
 EventQueue::_AddEvent(Event* event)
 {
-	// find the insertion index
-	int32 lower = 0;
-	int32 upper = fEvents.CountItems();
-	while (lower < upper) {
-		int32 mid = (lower + upper) / 2;
-		Event* midEvent = _EventAt(mid);
-		if (event->Time() < midEvent->Time())
-			upper = mid;
-		else
-			lower = mid + 1;
-	}
-	fEvents.AddItem(event, lower);
+	if (fEvents.AddItem(event))
+		_SiftUp(fEvents.CountItems() - 1);
 }
 
 // _EventAt
@@ -145,6 +224,98 @@ EventQueue::_EventAt(int32 index) const
 	return (Event*)fEvents.ItemAtFast(index);
 }
 
+// _IndexOf
+//
+// PRE: The object must be locked.
+int32
+EventQueue::_IndexOf(Event* event) const
+{
+	return fEvents.IndexOf(event);
+}
+
+// _RemoveEventAt
+//
+// PRE: The object must be locked.
+Event*
+EventQueue::_RemoveEventAt(int32 index)
+{
+	int32 last = fEvents.CountItems() - 1;
+	if (index != last)
+		fEvents.SwapItems(index, last);
+	Event* event = (Event*)fEvents.RemoveItem(last);
+	if (index < last) {
+		_SiftDown(index);
+		_SiftUp(index);
+	}
+	return event;
+}
+
+// _SiftUp
+//
+// PRE: The object must be locked.
+void
+EventQueue::_SiftUp(int32 index)
+{
+	while (index > 0) {
+		int32 parent = (index - 1) / 2;
+		if (_EventAt(parent)->Time() <= _EventAt(index)->Time())
+			break;
+		fEvents.SwapItems(parent, index);
+		index = parent;
+	}
+}
+
+// _SiftDown
+//
+// PRE: The object must be locked.
+void
+EventQueue::_SiftDown(int32 index)
+{
+	int32 count = fEvents.CountItems();
+	while (true) {
+		int32 child = 2 * index + 1;
+		if (child >= count)
+			break;
+		if (child + 1 < count
+			&& _EventAt(child + 1)->Time() < _EventAt(child)->Time()) {
+			child++;
+		}
+		if (_EventAt(index)->Time() <= _EventAt(child)->Time())
+			break;
+		fEvents.SwapItems(index, child);
+		index = child;
+	}
+}
+
+// _DrainInbox
+//
+// Moves the events added in the meantime into the heap. Returns whether
+// there were any.
+// PRE: The object must be locked.
+bool
+EventQueue::_DrainInbox()
+{
+	bool drained = false;
+	while (fInboxCount > 0) {
+		Event* event = fInbox[fInboxHead];
+		if (!event) {
+			// AddEvent() has reserved the slot but not yet written it,
+			// tell it to wake us up when it has
+			atomic_test_and_set(&fInboxStalled, 1, 0);
+			event = fInbox[fInboxHead];
+			if (!event)
+				break;
+		}
+		fInbox[fInboxHead] = NULL;
+		fInboxHead = (fInboxHead + 1) & (INBOX_SIZE - 1);
+		atomic_add(&fInboxCount, -1);
+
+		_AddEvent(event);
+		drained = true;
+	}
+	return drained;
+}
+
 // _execute_events_
 int32
 EventQueue::_execute_events_(void* cookie)
@@ -157,38 +328,60 @@ EventQueue::_execute_events_(void* cookie)
 int32
 EventQueue::_ExecuteEvents()
 {
-	bool running = true;
-	while (running) {
+	while (true) {
 		bigtime_t waitUntil = B_INFINITE_TIMEOUT;
 		if (Lock()) {
-			if (!fEvents.IsEmpty())
-				waitUntil = _EventAt(0)->Time();
-			fNextEventTime = waitUntil;
+			// publish the time we are going to wait for before checking
+			// the inbox a last time, see AddEvent()
+			_DrainInbox();
+			do {
+				waitUntil = fEvents.IsEmpty() ? B_INFINITE_TIMEOUT
+					: _EventAt(0)->Time();
+				_SetNextEventTime(waitUntil);
+			} while (_DrainInbox());
 			Unlock();
 		}
 		status_t err = acquire_sem_etc(fThreadControl, 1, B_ABSOLUTE_TIMEOUT,
 			waitUntil);
-		switch (err) {
-			case B_TIMED_OUT:
-				// execute events, that are supposed to go off
-				if (Lock()) {
-					while (!fEvents.IsEmpty()
-						   && system_time() >= _EventAt(0)->Time()) {
-						Event* event = (Event*)fEvents.RemoveItem((int32)0);
-						bool deleteEvent = event->AutoDelete();
-						event->Execute();
-						if (deleteEvent)
-							delete event;
-					}
-					Unlock();
-				}
-				break;
-			case B_BAD_SEM_ID:
-				running = false;
-				break;
-			case B_OK:
-			default:
+		if (err == B_BAD_SEM_ID)
+			break;
+
+		// execute events, that are supposed to go off, one at a time and
+		// without holding the lock
+		while (Lock()) {
+			_DrainInbox();
+			bigtime_t now = system_time();
+			if (fEvents.IsEmpty() || _EventAt(0)->Time() > now) {
+				Unlock();
 				break;
+			}
+
+			Event* event = _RemoveEventAt(0);
+			bool deleteEvent = event->AutoDelete();
+			fExecutingEvent = event;
+
+			bigtime_t lateness = now - event->Time();
+			fStatistics.executed_events++;
+			fStatistics.lateness += lateness;
+			if (lateness > fStatistics.max_lateness)
+				fStatistics.max_lateness = lateness;
+			if (lateness > kLateEventThreshold)
+				fStatistics.late_events++;
+
+			Unlock();
+
+			event->Execute();
+
+			if (Lock()) {
+				fExecutingEvent = NULL;
+				if (fExecutionWaiters > 0) {
+					release_sem_etc(fExecutionDone, fExecutionWaiters, 0);
+					fExecutionWaiters = 0;
+				}
+				Unlock();
+			}
+			if (deleteEvent)
+				delete event;
 		}
 	}
 	return 0;
@@ -206,8 +399,21 @@ EventQueue::_Reschedule()
 	}
 }
 
+// _SetNextEventTime
+//
+// PRE: The object must be locked.
+void
+EventQueue::_SetNextEventTime(bigtime_t time)
+{
+	// AddEvent() reads the time without holding the lock
+	int64 oldTime;
+	do {
+		oldTime = atomic_get64((vint64*)&fNextEventTime);
+	} while (atomic_test_and_set64((vint64*)&fNextEventTime, time, oldTime)
+		!= oldTime);
+}
+
 // static variables
 
 // fDefaultQueue
 EventQueue*	EventQueue::fDefaultQueue = NULL;
-
@@ -4,6 +4,20 @@
  * All rights reserved. Distributed under the terms of the MIT license.
  */
 
+// The EventQueue executes Events at their scheduled time in its own thread.
+//
+// AddEvent() is called from the playback threads, so it does not take the
+// queue lock. New events are put into an inbox (a ring of slots reserved
+// with an atomic counter), from which they are moved into the binary heap
+// of pending events by the thread that holds the lock next, usually the
+// executor. Only if the inbox is full, AddEvent() falls back to locking.
+// Events are executed without holding the lock, a handler may add, change
+// or remove events. RemoveEvent() waits until the event is no longer being
+// executed, unless it is called from the executor thread itself.
+//
+// The queue keeps track of how late the events are executed compared to
+// their scheduled time.
+
 #ifndef EVENT_QUEUE_H
 #define EVENT_QUEUE_H
 
@@ -13,6 +27,13 @@
 
 class Event;
 
+struct event_queue_statistics {
+	int64		executed_events;
+	int64		late_events;		// more than kLateEventThreshold
+	bigtime_t	lateness;
+	bigtime_t	max_lateness;
+};
+
 class EventQueue : public BLocker {
  public:
  								EventQueue();
@@ -29,19 +50,43 @@ class EventQueue : public BLocker {
 			void				ChangeEvent(Event* event,
 											bigtime_t newTime);
 
+			void				GetStatistics(
+									event_queue_statistics& statistics);
+			void				ResetStatistics();
+
  private:
+		enum {
+			INBOX_SIZE			= 256	// power of two
+		};
+
 			void				_AddEvent(Event* event);
 			Event*				_EventAt(int32 index) const;
+			int32				_IndexOf(Event* event) const;
+			Event*				_RemoveEventAt(int32 index);
+			void				_SiftUp(int32 index);
+			void				_SiftDown(int32 index);
+
+			bool				_DrainInbox();
 
 	static	int32				_execute_events_(void *cookie);
 			int32				_ExecuteEvents();
 			void				_Reschedule();
+			void				_SetNextEventTime(bigtime_t time);
 
-			BList				fEvents;
+			BList				fEvents;			// binary heap
+			Event* volatile		fInbox[INBOX_SIZE];
+			vint32				fInboxTail;			// reserved by AddEvent()
+			int32				fInboxHead;			// next slot to drain
+			vint32				fInboxCount;		// reserved, not drained
+			vint32				fInboxStalled;		// slot not yet written
+			Event*				fExecutingEvent;
+			int32				fExecutionWaiters;
+			sem_id				fExecutionDone;		// for RemoveEvent()
 			thread_id			fEventExecutor;
 			sem_id				fThreadControl;
 	volatile bigtime_t			fNextEventTime;
 			status_t			fStatus;
+			event_queue_statistics fStatistics;
 	static	EventQueue*			fDefaultQueue;
 };
 
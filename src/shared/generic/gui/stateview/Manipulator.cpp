@@ -176,7 +176,7 @@ void
 Manipulator::Invalidate(const BRect& frame)
 {
 	if (fView)
-		fView->Invalidate(frame);
+		fView->InvalidateContent(frame);
 }
 
 // TriggerUpdate
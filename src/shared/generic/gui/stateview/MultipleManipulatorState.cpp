@@ -233,7 +233,7 @@ MultipleManipulatorState::AddManipulator(Manipulator* manipulator)
 	if (fManipulators.AddItem((void*)manipulator)) {
 		manipulator->AttachToView(fView);
 		fView->ViewStateBoundsChanged();
-		fView->Invalidate(manipulator->Bounds());
+		fView->InvalidateContent(manipulator->Bounds());
 		return true;
 	}
 	return false;
@@ -246,7 +246,7 @@ MultipleManipulatorState::RemoveManipulator(int32 index)
 	Manipulator* manipulator = (Manipulator*)fManipulators.RemoveItem(index);
 	if (manipulator) {
 		fView->ViewStateBoundsChanged();
-		fView->Invalidate(manipulator->Bounds());
+		fView->InvalidateContent(manipulator->Bounds());
 		manipulator->DetachFromView(fView);
 	}
 
@@ -279,7 +279,7 @@ MultipleManipulatorState::DeleteManipulators()
 	fLastMouseMovedManipulator = NULL;
 
 	fView->ViewStateBoundsChanged();
-	fView->Invalidate(dirty);
+	fView->InvalidateContent(dirty);
 }
 
 // CountManipulators
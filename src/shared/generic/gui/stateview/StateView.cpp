@@ -457,6 +457,13 @@ StateView::ViewStateBoundsChanged()
 {
 }
 
+// InvalidateContent
+void
+StateView::InvalidateContent(BRect rect)
+{
+	Invalidate(rect);
+}
+
 // Draw
 void
 StateView::Draw(BView* into, BRect updateRect)
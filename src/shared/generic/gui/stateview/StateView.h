@@ -55,6 +55,9 @@ class StateView : public BView {
 	virtual	void				UpdateStateCursor();
 			BRect				ViewStateBounds();
 	virtual	void				ViewStateBoundsChanged();
+	virtual	void				InvalidateContent(BRect rect);
+									// invalidates what the current state
+									// draws, for views caching its drawing
 
 			void				Draw(BView* into, BRect updateRect);
 
@@ -0,0 +1,357 @@
+/*
+ * Copyright 2009, Ingo Weinhold <ingo_weinhold@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+#include "AsyncLogWriter.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <new>
+
+#include <TLS.h>
+
+#include "InternalLogger.h"
+#include "Logging.h"
+#include "LogMessageInfo.h"
+
+#include "AutoLocker.h"
+
+
+using std::nothrow;
+
+static const int32 kRingSize				= 512;
+	// must be a power of two, the writer is woken up when a ring is
+	// half full
+static const size_t kMaxMessageLength		= 480;
+static const bigtime_t kWriterInterval		= 50000;
+static const bigtime_t kDeadRingCheckInterval = 1000000;
+
+
+// Record
+struct AsyncLogWriter::Record {
+	InternalLogger*		logger;
+	struct timeval		time;
+	int32				level;
+	char				message[kMaxMessageLength];
+};
+
+
+// Ring
+//
+// A single producer, single consumer ring buffer. "head" is only written
+// by the thread owning the ring, "tail" and "drainHead" only by the writer
+// thread.
+struct AsyncLogWriter::Ring {
+	Ring()
+		: next(NULL),
+		  head(0),
+		  tail(0),
+		  drainHead(0),
+		  dropped(0)
+	{
+		thread.thread = find_thread(NULL);
+		if (get_thread_info(thread.thread, &thread) != B_OK) {
+			thread.team = 0;
+			strcpy(thread.name, "<unknown>");
+		}
+	}
+
+	Ring*				next;
+	thread_info			thread;
+	int32				head;
+	int32				tail;
+	int32				drainHead;
+	int32				dropped;
+	Record				records[kRingSize];
+};
+
+
+// constructor
+AsyncLogWriter::AsyncLogWriter()
+	: fLock("async log writer"),
+	  fRingLock("async log rings"),
+	  fRings(NULL),
+	  fTLSIndex(-1),
+	  fWakeUpSemaphore(-1),
+	  fWriterThread(-1),
+	  fTerminating(false),
+	  fDroppedMessages(0),
+	  fReportedDroppedMessages(0),
+	  fWrittenMessages(0)
+{
+}
+
+
+// destructor
+AsyncLogWriter::~AsyncLogWriter()
+{
+	if (fWriterThread >= 0) {
+		fTerminating = true;
+		release_sem(fWakeUpSemaphore);
+		status_t result;
+		wait_for_thread(fWriterThread, &result);
+	}
+
+	Flush();
+
+	if (fWakeUpSemaphore >= 0)
+		delete_sem(fWakeUpSemaphore);
+
+	// NOTE: TLS slots cannot be freed, so no other thread must log
+	// anymore at this point
+	while (Ring* ring = fRings) {
+		fRings = ring->next;
+		delete ring;
+	}
+}
+
+
+// Init
+status_t
+AsyncLogWriter::Init()
+{
+	if (fLock.Sem() < 0)
+		return fLock.Sem();
+	if (fRingLock.Sem() < 0)
+		return fRingLock.Sem();
+
+	fTLSIndex = tls_allocate();
+	if (fTLSIndex < 0)
+		return B_NO_MORE_SLOTS;
+
+	fWakeUpSemaphore = create_sem(0, "async log writer wake up");
+	if (fWakeUpSemaphore < 0)
+		return fWakeUpSemaphore;
+
+	fWriterThread = spawn_thread(&_WriterEntry, "log writer",
+		B_LOW_PRIORITY, this);
+	if (fWriterThread < 0)
+		return fWriterThread;
+
+	resume_thread(fWriterThread);
+
+	return B_OK;
+}
+
+
+// Log
+bool
+AsyncLogWriter::Log(InternalLogger* logger, int level, const char* format,
+	va_list args, bool formatted)
+{
+	Ring* ring = _RingForCurrentThread();
+	if (ring == NULL)
+		return false;
+
+	int32 head = ring->head;
+	int32 queued = head - atomic_add(&ring->tail, 0);
+	if (queued >= kRingSize) {
+		// the writer thread doesn't keep up -- rather drop the message
+		// than blocking the caller
+		atomic_add(&ring->dropped, 1);
+		return true;
+	}
+
+	Record& record = ring->records[head & (kRingSize - 1)];
+	record.logger = logger;
+	record.level = level;
+	gettimeofday(&record.time, NULL);
+	if (formatted)
+		vsnprintf(record.message, sizeof(record.message), format, args);
+	else
+		snprintf(record.message, sizeof(record.message), "%s", format);
+
+	// publish the record
+	atomic_add(&ring->head, 1);
+
+	// don't wait for the next interval, if the ring fills up
+	if (queued + 1 == kRingSize / 2)
+		release_sem(fWakeUpSemaphore);
+
+	return true;
+}
+
+
+// Flush
+void
+AsyncLogWriter::Flush()
+{
+	AutoLocker<BLocker> locker(fLock);
+
+	_Drain();
+}
+
+
+// CountDroppedMessages
+int64
+AsyncLogWriter::CountDroppedMessages() const
+{
+	AutoLocker<BLocker> locker(const_cast<BLocker&>(fLock));
+
+	int64 dropped = fDroppedMessages;
+
+	// add the ones the writer thread hasn't collected yet
+	AutoLocker<BLocker> ringLocker(const_cast<BLocker&>(fRingLock));
+	for (Ring* ring = fRings; ring != NULL; ring = ring->next)
+		dropped += atomic_add(&ring->dropped, 0);
+
+	return dropped;
+}
+
+
+// CountWrittenMessages
+int64
+AsyncLogWriter::CountWrittenMessages() const
+{
+	AutoLocker<BLocker> locker(const_cast<BLocker&>(fLock));
+
+	return fWrittenMessages;
+}
+
+
+// _WriterEntry
+int32
+AsyncLogWriter::_WriterEntry(void* cookie)
+{
+	return ((AsyncLogWriter*)cookie)->_Writer();
+}
+
+
+// _Writer
+int32
+AsyncLogWriter::_Writer()
+{
+	bigtime_t lastDeadRingCheck = system_time();
+
+	while (!fTerminating) {
+		acquire_sem_etc(fWakeUpSemaphore, 1, B_RELATIVE_TIMEOUT,
+			kWriterInterval);
+
+		AutoLocker<BLocker> locker(fLock);
+
+		_Drain();
+
+		if (system_time() - lastDeadRingCheck > kDeadRingCheckInterval) {
+			_RemoveDeadRings();
+			lastDeadRingCheck = system_time();
+		}
+	}
+
+	return B_OK;
+}
+
+
+// _RingForCurrentThread
+AsyncLogWriter::Ring*
+AsyncLogWriter::_RingForCurrentThread()
+{
+	Ring* ring = (Ring*)tls_get(fTLSIndex);
+	if (ring != NULL)
+		return ring;
+
+	// first message of this thread -- this is the only time it needs
+	// to take a lock
+	ring = new(nothrow) Ring;
+	if (ring == NULL)
+		return NULL;
+
+	AutoLocker<BLocker> locker(fRingLock);
+	ring->next = fRings;
+	fRings = ring;
+	locker.Unlock();
+
+	tls_set(fTLSIndex, ring);
+
+	return ring;
+}
+
+
+// _Drain
+int32
+AsyncLogWriter::_Drain()
+{
+	// new rings are only ever prepended and rings are only removed by
+	// us, so the list can be iterated without holding the ring lock
+	fRingLock.Lock();
+	Ring* rings = fRings;
+	fRingLock.Unlock();
+
+	// the records of each ring are in order, but the threads log
+	// concurrently, so the rings are merged by time
+	int32 written = 0;
+	for (Ring* ring = rings; ring != NULL; ring = ring->next) {
+		ring->drainHead = atomic_add(&ring->head, 0);
+		fDroppedMessages += atomic_and(&ring->dropped, 0);
+	}
+
+	while (true) {
+		Ring* oldest = NULL;
+		Record* oldestRecord = NULL;
+		for (Ring* ring = rings; ring != NULL; ring = ring->next) {
+			if (ring->tail == ring->drainHead)
+				continue;
+			Record* record = &ring->records[ring->tail & (kRingSize - 1)];
+			if (oldestRecord == NULL
+				|| timercmp(&record->time, &oldestRecord->time, <)) {
+				oldest = ring;
+				oldestRecord = record;
+			}
+		}
+		if (oldest == NULL)
+			break;
+
+		LogMessageInfo info(oldestRecord->logger->Name(), oldestRecord->level,
+			oldest->thread, oldestRecord->time);
+		oldestRecord->logger->AppendMessage(info, oldestRecord->message,
+			false);
+
+		// free the slot
+		atomic_add(&oldest->tail, 1);
+		written++;
+	}
+
+	fWrittenMessages += written;
+
+	if (fDroppedMessages != fReportedDroppedMessages) {
+		char message[128];
+		snprintf(message, sizeof(message), "Logging: dropped %lld messages, "
+			"since the writer thread didn't keep up.\n",
+			fDroppedMessages - fReportedDroppedMessages);
+		fReportedDroppedMessages = fDroppedMessages;
+
+		InternalLogger* rootLogger = Logging::Default()->LoggerFor(NULL);
+		if (rootLogger != NULL) {
+			LogMessageInfo info(rootLogger->Name(), LOG_LEVEL_WARN);
+			rootLogger->AppendMessage(info, message, false);
+			written++;
+		}
+	}
+
+	// write the batch
+	if (written > 0)
+		Logging::Default()->FlushAppenders();
+
+	return written;
+}
+
+
+// _RemoveDeadRings
+void
+AsyncLogWriter::_RemoveDeadRings()
+{
+	AutoLocker<BLocker> locker(fRingLock);
+
+	Ring** link = &fRings;
+	while (Ring* ring = *link) {
+		thread_info info;
+		if (ring->head == ring->tail
+			&& get_thread_info(ring->thread.thread, &info) != B_OK) {
+			// the thread is gone and all its messages are written
+			*link = ring->next;
+			delete ring;
+		} else
+			link = &ring->next;
+	}
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2009, Ingo Weinhold <ingo_weinhold@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+#ifndef ASYNC_LOG_WRITER_H
+#define ASYNC_LOG_WRITER_H
+
+#include <stdarg.h>
+#include <sys/time.h>
+
+#include <Locker.h>
+#include <OS.h>
+
+
+class InternalLogger;
+
+
+// AsyncLogWriter
+//
+// Decouples the logging threads from the appenders. Each thread writes
+// fixed size records into a ring buffer of its own without any locking.
+// A single writer thread collects the records of all rings and passes
+// them on to the appenders in batches. When a ring is full, the message
+// is dropped and counted instead of blocking the logging thread.
+class AsyncLogWriter {
+public:
+								AsyncLogWriter();
+								~AsyncLogWriter();
+
+			status_t			Init();
+
+			bool				Log(InternalLogger* logger, int level,
+									const char* format, va_list args,
+									bool formatted);
+									// returns false, if the message needs
+									// to be logged synchronously
+			void				Flush();
+
+			int64				CountDroppedMessages() const;
+			int64				CountWrittenMessages() const;
+
+private:
+			struct Record;
+			struct Ring;
+
+	static	int32				_WriterEntry(void* cookie);
+			int32				_Writer();
+
+			Ring*				_RingForCurrentThread();
+			int32				_Drain();
+									// fLock must be held
+			void				_RemoveDeadRings();
+									// fLock must be held
+
+private:
+			BLocker				fLock;
+									// serializes the consumers
+			BLocker				fRingLock;
+									// protects fRings
+			Ring*				fRings;
+			int32				fTLSIndex;
+			sem_id				fWakeUpSemaphore;
+			thread_id			fWriterThread;
+			volatile bool		fTerminating;
+
+			int64				fDroppedMessages;
+			int64				fReportedDroppedMessages;
+			int64				fWrittenMessages;
+};
+
+
+#endif	// ASYNC_LOG_WRITER_H
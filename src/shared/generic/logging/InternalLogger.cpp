@@ -7,6 +7,7 @@
 
 #include <stdio.h>
 
+#include "AsyncLogWriter.h"
 #include "LogAppender.h"
 #include "Logging.h"
 #include "LogMessageInfo.h"
@@ -98,22 +99,20 @@ InternalLogger::LogV(int level, const char* format, va_list args,
 	if (this == NULL)
 		return;
 
-	// reference appenders
-	AutoLocker<Logging> locker(Logging::Default());
+	// hand the message over to the writer thread, if logging
+	// asynchronously -- fatal messages are always written synchronously
+	if (level > LOG_LEVEL_FATAL) {
+		if (AsyncLogWriter* writer = Logging::Default()->AsyncWriter()) {
+			if (level > fEffectiveThreshold)
+				return;
+			if (writer->Log(this, level, format, args, formatted))
+				return;
+		}
+	}
 
-	if (level > fThreshold || fAppenders.IsEmpty())
+	if (level > fThreshold)
 		return;
 
-	BList appenders;
-	int32 count = fAppenders.CountItems();
-	for (int32 i = 0; i < count; i++) {
-		LogAppender* appender = (LogAppender*)fAppenders.ItemAt(i);
-		if (appenders.AddItem(appender))
-			appender->AddReference();
-	}
-	
-	locker.Unlock();
-
 	// format message
 	const char* buffer;
 	char stackBuffer[1024];
@@ -125,11 +124,36 @@ InternalLogger::LogV(int level, const char* format, va_list args,
 
 	LogMessageInfo info(fName, level);
 
+	AppendMessage(info, buffer);
+}
+
+
+// AppendMessage
+void
+InternalLogger::AppendMessage(LogMessageInfo& info, const char* message,
+	bool flush)
+{
+	// reference appenders
+	AutoLocker<Logging> locker(Logging::Default());
+
+	if (info.LogLevel() > fThreshold || fAppenders.IsEmpty())
+		return;
+
+	BList appenders;
+	int32 count = fAppenders.CountItems();
+	for (int32 i = 0; i < count; i++) {
+		LogAppender* appender = (LogAppender*)fAppenders.ItemAt(i);
+		if (appenders.AddItem(appender))
+			appender->AddReference();
+	}
+
+	locker.Unlock();
+
 	// append
 	count = appenders.CountItems();
 	for (int32 i = 0; i < count; i++) {
 		LogAppender* appender = (LogAppender*)appenders.ItemAt(i);
-		appender->AppendMessage(info, buffer);
+		appender->AppendMessage(info, message, flush);
 		appender->RemoveReference();
 	}
 }
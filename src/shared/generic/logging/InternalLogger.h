@@ -13,6 +13,8 @@
 #include "Logging.h"
 
 
+class LogMessageInfo;
+
 class InternalLogger {
 public:
 								InternalLogger(const char* name);
@@ -32,6 +34,8 @@ public:
 									 PRINTF_LIKE(3, 4);
 			void				LogV(int level, const char* format,
 									va_list args, bool formatted = true);
+			void				AppendMessage(LogMessageInfo& info,
+									const char* message, bool flush = true);
 
 private:
 			void				_Unset();
@@ -320,6 +320,7 @@ LogAppender::LogAppender(const char* name)
 	  fLock(name),
 	  fThreshold(LOG_LEVEL_INFO),
 	  fLogBuffer(NULL),
+	  fBufferedLogLevel(LOG_LEVEL_INFO),
 	  fLayout(NULL),
 	  fNewLinePrinted(false),
 	  fShutdown(false)
@@ -376,6 +377,10 @@ LogAppender::Uninit()
 	if (fShutdown)
 		return;
 
+	// write what is left from a batch
+	if (fLogBuffer != NULL && fLogBuffer->Size() > 0)
+		_FlushBuffer(fBufferedLogLevel);
+
 	Shutdown();
 	fShutdown = true;
 }
@@ -414,16 +419,28 @@ LogAppender::SetThreshold(int threshold)
 
 // AppendMessage
 void
-LogAppender::AppendMessage(LogMessageInfo& info, const char* message)
+LogAppender::AppendMessage(LogMessageInfo& info, const char* message,
+	bool flush)
 {
 	BAutolock _(fLock);
 
 	if (fShutdown || info.LogLevel() > fThreshold)
 		return;
 
+	// the buffer is put with a single log level, so flush it when the
+	// level changes
+	if (fLogBuffer->Size() > 0 && info.LogLevel() != fBufferedLogLevel)
+		_FlushBuffer(fBufferedLogLevel);
+	fBufferedLogLevel = info.LogLevel();
+
 	// fast path for no layout
 	if (fLayout == NULL) {
-		PutText(message, strlen(message), info.LogLevel());
+		if (flush) {
+			if (fLogBuffer->Size() > 0)
+				_FlushBuffer(info.LogLevel());
+			PutText(message, strlen(message), info.LogLevel());
+		} else
+			_AppendText(message, strlen(message), info.LogLevel());
 		return;
 	}
 
@@ -442,7 +459,19 @@ LogAppender::AppendMessage(LogMessageInfo& info, const char* message)
 	if (!fNewLinePrinted)
 		_AppendText("\n", 1, info.LogLevel());
 
-	_FlushBuffer(info.LogLevel());
+	if (flush)
+		_FlushBuffer(info.LogLevel());
+}
+
+
+// Flush
+void
+LogAppender::Flush()
+{
+	BAutolock _(fLock);
+
+	if (fLogBuffer != NULL && fLogBuffer->Size() > 0)
+		_FlushBuffer(fBufferedLogLevel);
 }
 
 
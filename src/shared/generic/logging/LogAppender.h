@@ -34,7 +34,8 @@ public:
 			int					Threshold() const	{ return fThreshold; } 
 
 	virtual	void				AppendMessage(LogMessageInfo& info,
-									const char* message);
+									const char* message, bool flush = true);
+			void				Flush();
 
 protected:
 			void				_AppendText(const char* text, size_t len,
@@ -53,6 +54,7 @@ protected:
 			BLocker				fLock;
 			int					fThreshold;
 			LogBuffer*			fLogBuffer;
+			int					fBufferedLogLevel;
 			MessageLayout*		fLayout;
 			bool				fNewLinePrinted;
 			bool				fShutdown;
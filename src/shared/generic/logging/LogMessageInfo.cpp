@@ -17,10 +17,18 @@ LogMessageInfo::LogMessageInfo(const char* name, int logLevel)
 	struct timeval time;
 	gettimeofday(&time, NULL);
 
-	time_t timeInSecs = time.tv_sec;
-	fTimeMicros = time.tv_usec;
+	_SetTime(time);
+}
 
-	localtime_r(&timeInSecs, &fTime);
+
+// constructor
+LogMessageInfo::LogMessageInfo(const char* name, int logLevel,
+		const thread_info& threadInfo, const struct timeval& time)
+	: fName(name),
+	  fLogLevel(logLevel),
+	  fThreadInfo(threadInfo)
+{
+	_SetTime(time);
 }
 
 // ThreadName
@@ -33,3 +41,13 @@ LogMessageInfo::ThreadName()
 	return fThreadInfo.name;
 }
 
+
+// _SetTime
+void
+LogMessageInfo::_SetTime(const struct timeval& time)
+{
+	time_t timeInSecs = time.tv_sec;
+	fTimeMicros = time.tv_usec;
+
+	localtime_r(&timeInSecs, &fTime);
+}
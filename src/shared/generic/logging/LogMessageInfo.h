@@ -15,6 +15,9 @@
 class LogMessageInfo {
 public:
 								LogMessageInfo(const char* name, int logLevel);
+								LogMessageInfo(const char* name, int logLevel,
+									const thread_info& threadInfo,
+									const struct timeval& time);
 
 	inline	const char*			Name()			{ return fName; }
 	inline	int					LogLevel()		{ return fLogLevel; }
@@ -23,6 +26,9 @@ public:
 	inline	const struct tm*	Time()			{ return &fTime; }
 	inline	int32				TimeMicros() 	{ return fTimeMicros; }
 
+private:
+			void				_SetTime(const struct timeval& time);
+
 private:
 			const char*			fName;
 			int					fLogLevel;
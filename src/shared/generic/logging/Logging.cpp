@@ -7,6 +7,8 @@
 
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <new>
 
@@ -14,11 +16,13 @@
 #include <Message.h>
 #include <NodeMonitor.h>
 
+#include "AsyncLogWriter.h"
 #include "ConsoleLogAppender.h"
 #include "HashMap.h"
 #include "HashString.h"
 #include "InternalLogger.h"
 #include "JavaProperties.h"
+#include "LogAppender.h"
 #include "PathMonitor.h"
 #include "RollingFileLogAppender.h"
 #include "StringTokenizer.h"
@@ -48,6 +52,8 @@ Logging::Logging()
 	  fLoggers(NULL),
 	  fAppenders(),
 	  fRootLogger(NULL),
+	  fAsyncWriter(NULL),
+	  fAsynchronous(false),
 	  fInitialized(false),
 	  fReloadConfigPending(false)
 {
@@ -217,6 +223,58 @@ Logging::LoggerFor(const char* name)
 }
 
 
+// SetAsynchronous
+status_t
+Logging::SetAsynchronous(bool asynchronous)
+{
+	BAutolock _(fLock);
+
+	return _SetAsynchronous(asynchronous);
+}
+
+
+// Flush
+void
+Logging::Flush()
+{
+	fLock.Lock();
+	AsyncLogWriter* writer = fAsyncWriter;
+	fLock.Unlock();
+
+	// the writer would need our lock, while we hold its lock
+	if (writer != NULL)
+		writer->Flush();
+}
+
+
+// FlushAppenders
+void
+Logging::FlushAppenders()
+{
+	BAutolock _(fLock);
+
+	int32 count = fAppenders.CountItems();
+	for (int32 i = 0; i < count; i++)
+		((LogAppender*)fAppenders.ItemAt(i))->Flush();
+}
+
+
+// Shutdown
+void
+Logging::Shutdown()
+{
+	fLock.Lock();
+	AsyncLogWriter* writer = fAsyncWriter;
+	fAsyncWriter = NULL;
+	fAsynchronous = false;
+	fLock.Unlock();
+
+	// the destructor stops the writer thread and writes what is left,
+	// which needs our lock
+	delete writer;
+}
+
+
 // LogLevelFor
 int
 Logging::LogLevelFor(const char* _level, int defaultLevel)
@@ -320,6 +378,12 @@ Logging::_LoadConfigFile(const char* fileName)
 	// init root logger
 	fRootLogger->SetTo(rootLogThreshold, fAppenders);
 
+	// asynchronous mode
+	const char* asynchronous
+		= fConfiguration->GetProperty("log.asynchronous");
+	_SetAsynchronous(asynchronous != NULL
+		&& strcasecmp(asynchronous, "true") == 0);
+
 	// re-init other loggers
 	LoggerMap::Iterator it = fLoggers->GetIterator();
 	while (it.HasNext()) {
@@ -341,6 +405,51 @@ Logging::_ReloadConfigFile()
 }
 
 
+// _SetAsynchronous
+status_t
+Logging::_SetAsynchronous(bool asynchronous)
+{
+	// NOTE: When switching back to synchronous mode, the writer thread
+	// keeps running and writes the messages that are still queued.
+	if (asynchronous && fAsyncWriter == NULL) {
+		AsyncLogWriter* writer = new(nothrow) AsyncLogWriter;
+		if (writer == NULL)
+			return B_NO_MEMORY;
+
+		status_t error = writer->Init();
+		if (error != B_OK) {
+			fprintf(stderr, "Logging: Failed to init asynchronous writer: "
+				"%s\n", strerror(error));
+			delete writer;
+			return error;
+		}
+
+		// the queued messages must not get lost when the application
+		// quits
+		static bool sShutdownRegistered = false;
+		if (!sShutdownRegistered) {
+			atexit(&_ShutdownAtExit);
+			sShutdownRegistered = true;
+		}
+
+		fAsyncWriter = writer;
+	}
+
+	fAsynchronous = asynchronous;
+
+	return B_OK;
+}
+
+
+// _ShutdownAtExit
+void
+Logging::_ShutdownAtExit()
+{
+	if (sLogging != NULL)
+		sLogging->Shutdown();
+}
+
+
 // _InitAppender
 status_t
 Logging::_InitAppender(const char* name)
@@ -31,6 +31,7 @@ enum {
 #endif
 
 
+class AsyncLogWriter;
 class InternalLogger;
 class JavaProperties;
 
@@ -52,6 +53,19 @@ public:
 			InternalLogger*		LoggerFor(const char* name);
 									// name must persist!
 
+			status_t			SetAsynchronous(bool asynchronous);
+			bool				IsAsynchronous() const
+									{ return fAsynchronous; }
+	inline	AsyncLogWriter*		AsyncWriter() const;
+									// NULL, if not asynchronous
+			void				Flush();
+									// Logging lock must not be held
+			void				FlushAppenders();
+			void				Shutdown();
+									// writes the queued messages and
+									// deletes the asynchronous writer,
+									// called at exit
+
 	static	int					LogLevelFor(const char* level,
 									int defaultLevel);
 
@@ -66,6 +80,9 @@ private:
 			void				_LoadConfigFile(const char* fileName);
 			void				_ReloadConfigFile();
 
+			status_t			_SetAsynchronous(bool asynchronous);
+	static	void				_ShutdownAtExit();
+
 			status_t			_InitAppender(const char* name);
 			void				_UninitAppenders();
 
@@ -83,9 +100,21 @@ private:
 			LoggerMap*			fLoggers;
 			BList				fAppenders;
 			InternalLogger*		fRootLogger;
+			AsyncLogWriter*		fAsyncWriter;
+			bool				fAsynchronous;
 			bool				fInitialized;
 			bool				fReloadConfigPending;
 };
 
 
+// AsyncWriter
+inline AsyncLogWriter*
+Logging::AsyncWriter() const
+{
+	// NOTE: deliberately not locked, this is called for every message.
+	// Once created, the writer is only deleted by Shutdown().
+	return fAsynchronous ? fAsyncWriter : NULL;
+}
+
+
 #endif	// LOGGING_H
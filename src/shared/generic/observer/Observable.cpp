@@ -5,22 +5,55 @@
 
 #include "Observable.h"
 
+#include <new>
 #include <stdio.h>
 #include <string.h>
 #include <typeinfo>
 
 #include <Autolock.h>
+#include <TLS.h>
 
 #include "Observer.h"
 
+using std::nothrow;
+
+// The objects that notified while the thread had a batch open. An object
+// is in at most one batch, removed objects are replaced by NULL.
+struct NotificationBatch {
+	NotificationBatch()
+		: nesting(0)
+		, delivering(false)
+		, objects(64)
+	{
+	}
+
+	int32	nesting;
+	bool	delivering;
+	BList	objects;
+};
+
+static const int32 kMaxStackObservers = 8;
+
+static int32 sBatchTLSIndex = tls_allocate();
+
+BLocker
+Observable::sObserverListLocks[OBSERVER_LIST_LOCK_COUNT];
+
 BLocker
-Observable::sObserverListLock("observer list");
+Observable::sBatchLock("notification batch");
+
+vint64
+Observable::sDeliveredNotifications = 0;
+
+vint64
+Observable::sCoalescedNotifications = 0;
 
 // constructor
 Observable::Observable()
 	: fObservers(4),
 	  fSuspended(0),
-	  fPendingNotifications(false),
+	  fNotificationPending(false),
+	  fBatch(NULL),
 	  fDebugNotify(false)
 {
 }
@@ -28,6 +61,17 @@ Observable::Observable()
 // destructor
 Observable::~Observable()
 {
+	if (fBatch) {
+		// we were changed in a batch that is still open
+		BAutolock _(sBatchLock);
+		if (fBatch) {
+			int32 index = fBatch->objects.IndexOf((void*)this);
+			if (index >= 0)
+				fBatch->objects.ReplaceItem(index, NULL);
+			fBatch = NULL;
+		}
+	}
+
 	_NotifyDeleted();
 
 	if (fObservers.CountItems() > 0) {
@@ -43,7 +87,7 @@ Observable::~Observable()
 bool
 Observable::AddObserver(Observer* observer)
 {
-	BAutolock _(sObserverListLock);
+	BAutolock _(_ObserverListLock());
 
 	if (observer && !fObservers.HasItem((void*)observer)) {
 //printf("%p->AddObserver(%p/%s)\n", this, observer, typeid(*observer).name());
@@ -56,43 +100,54 @@ Observable::AddObserver(Observer* observer)
 bool
 Observable::RemoveObserver(Observer* observer)
 {
-	BAutolock _(sObserverListLock);
+	BAutolock _(_ObserverListLock());
 
 //printf("%p->RemoveObserver(%p/%s)\n", this, observer, typeid(*observer).name());
 	return fObservers.RemoveItem((void*)observer);
 }
 
 // Notify
+//
+// Notifications which are not delivered immediately, because they are
+// suspended or the thread has a batch open, are combined into one.
 void
 Observable::Notify() const
 {
-	if (!fSuspended) {
-		BList observers;
-		_AcquireObservers(observers);
+	NotificationBatch* batch = (NotificationBatch*)tls_get(sBatchTLSIndex);
+	if (batch)
+		sBatchLock.Lock();
 
-		int32 count = observers.CountItems();
-		if (fDebugNotify && count > 0) {
-			printf("%ld observers\n", count);
-		}
-		for (int32 i = 0; i < count; i++) {
-			Observer* observer = (Observer*)observers.ItemAtFast(i);
-			if (fDebugNotify) {
-				printf("  %p: %p/%s->Notify()\n", this, observer,
-					   typeid(*observer).name());
-			}
-			observer->ObjectChanged(this);
-			observer->Release();
-		}
-		fPendingNotifications = false;
-	} else {
-		fPendingNotifications = true;
-	}
+	BLocker& lock = _ObserverListLock();
+	lock.Lock();
+
+	bool deliver = false;
+	bool coalesced = false;
+	if (fSuspended > 0 || fBatch) {
+		coalesced = fNotificationPending;
+		fNotificationPending = true;
+	} else if (batch && batch->objects.AddItem((void*)this)) {
+		fNotificationPending = true;
+		fBatch = batch;
+	} else
+		deliver = true;
+
+	lock.Unlock();
+	if (batch)
+		sBatchLock.Unlock();
+
+	if (deliver)
+		_Deliver();
+	else if (coalesced)
+		atomic_add64(&sCoalescedNotifications, 1);
 }
 
 // SuspendNotifications
 void
 Observable::SuspendNotifications(bool suspend)
 {
+	BLocker& lock = _ObserverListLock();
+	lock.Lock();
+
 	if (suspend)
 		fSuspended++;
 	else
@@ -104,10 +159,84 @@ Observable::SuspendNotifications(bool suspend)
 		fSuspended = 0;
 	}
 
-	if (!fSuspended && fPendingNotifications)
+	bool notify = false;
+	if (!fSuspended && !fBatch) {
+		notify = fNotificationPending;
+		fNotificationPending = false;
+	}
+
+	lock.Unlock();
+
+	if (notify)
 		Notify();
 }
 
+// BeginNotificationBatch
+void
+Observable::BeginNotificationBatch()
+{
+	NotificationBatch* batch = (NotificationBatch*)tls_get(sBatchTLSIndex);
+	if (!batch) {
+		batch = new (nothrow) NotificationBatch;
+		if (!batch) {
+			// notifications will simply be delivered immediately
+			return;
+		}
+		tls_set(sBatchTLSIndex, batch);
+	}
+	batch->nesting++;
+}
+
+// EndNotificationBatch
+void
+Observable::EndNotificationBatch()
+{
+	NotificationBatch* batch = (NotificationBatch*)tls_get(sBatchTLSIndex);
+	if (!batch)
+		return;
+	if (--batch->nesting > 0 || batch->delivering)
+		return;
+
+	// Deliver the collected notifications. Objects which are changed by the
+	// observers are appended to the batch and notify in turn.
+	batch->delivering = true;
+	for (int32 i = 0; ; i++) {
+		sBatchLock.Lock();
+		if (i >= batch->objects.CountItems()) {
+			sBatchLock.Unlock();
+			break;
+		}
+		const Observable* object
+			= (const Observable*)batch->objects.ItemAtFast(i);
+		bool deliver = false;
+		if (object) {
+			BLocker& lock = object->_ObserverListLock();
+			lock.Lock();
+			object->fBatch = NULL;
+			if (object->fSuspended == 0) {
+				deliver = object->fNotificationPending;
+				object->fNotificationPending = false;
+			}
+			lock.Unlock();
+		}
+		sBatchLock.Unlock();
+
+		if (deliver)
+			object->_Deliver();
+	}
+
+	tls_set(sBatchTLSIndex, NULL);
+	delete batch;
+}
+
+// GetNotificationStatistics
+void
+Observable::GetNotificationStatistics(int64* delivered, int64* coalesced)
+{
+	*delivered = atomic_get64(&sDeliveredNotifications);
+	*coalesced = atomic_get64(&sCoalescedNotifications);
+}
+
 // SetDebugNotify
 void
 Observable::SetDebugNotify(bool debug)
@@ -135,7 +264,7 @@ void
 Observable::_AcquireObservers(BList& observers) const
 {
 	// clone observer list and acquire a reference to each observer
-	BAutolock _(sObserverListLock);
+	BAutolock _(_ObserverListLock());
 
 	observers.AddList(const_cast<BList*>(&fObservers));
 	int32 count = observers.CountItems();
@@ -143,6 +272,49 @@ Observable::_AcquireObservers(BList& observers) const
 		((Observer*)observers.ItemAtFast(i))->Acquire();
 }
 
+// _Deliver
+void
+Observable::_Deliver() const
+{
+	atomic_add64(&sDeliveredNotifications, 1);
+
+	// copy the observers and acquire a reference to each, most objects
+	// have only a few, so try to avoid the allocation
+	Observer* stackObservers[kMaxStackObservers];
+	Observer** observers = stackObservers;
+	int32 count;
+	{
+		BAutolock _(_ObserverListLock());
+
+		count = fObservers.CountItems();
+		if (count > kMaxStackObservers) {
+			observers = new (nothrow) Observer*[count];
+			if (!observers)
+				return;
+		}
+		for (int32 i = 0; i < count; i++) {
+			observers[i] = (Observer*)fObservers.ItemAtFast(i);
+			observers[i]->Acquire();
+		}
+	}
+
+	if (fDebugNotify && count > 0) {
+		printf("%ld observers\n", count);
+	}
+	for (int32 i = 0; i < count; i++) {
+		Observer* observer = observers[i];
+		if (fDebugNotify) {
+			printf("  %p: %p/%s->Notify()\n", this, observer,
+				   typeid(*observer).name());
+		}
+		observer->ObjectChanged(this);
+		observer->Release();
+	}
+
+	if (observers != stackObservers)
+		delete[] observers;
+}
+
 // _NotifyDeleted
 void
 Observable::_NotifyDeleted() const
@@ -158,3 +330,9 @@ Observable::_NotifyDeleted() const
 	}
 }
 
+// _ObserverListLock
+BLocker&
+Observable::_ObserverListLock() const
+{
+	return sObserverListLocks[((addr_t)this >> 4) % OBSERVER_LIST_LOCK_COUNT];
+}
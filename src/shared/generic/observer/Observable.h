@@ -10,6 +10,7 @@
 #include <Locker.h>
 
 class Observer;
+struct NotificationBatch;
 
 class Observable {
  public:
@@ -23,24 +24,44 @@ class Observable {
 
 			void				SuspendNotifications(bool suspend);
 
+	// While the calling thread has a notification batch open, the
+	// notifications of all objects are collected and each object notifies
+	// its observers once when the outermost batch is closed.
+	static	void				BeginNotificationBatch();
+	static	void				EndNotificationBatch();
+
+	static	void				GetNotificationStatistics(int64* delivered,
+									int64* coalesced);
+
 			void				SetDebugNotify(bool debug);
 			void				PrintObservers() const;
 
  private:
 	 		void				_AcquireObservers(BList& observers) const;
+	 		void				_Deliver() const;
 	 		void				_NotifyDeleted() const;
 
+			BLocker&			_ObserverListLock() const;
+
  private:
 			BList				fObservers;
 
 			int32				fSuspended;
-	mutable	bool				fPendingNotifications;
+	mutable	bool				fNotificationPending;
+	mutable	NotificationBatch*	fBatch;
 
 			bool				fDebugNotify;
 
-	static	BLocker				sObserverListLock;
-		// TODO: change this to a lock that has one
-		// semaphore per thread and is not static
+		enum {
+			OBSERVER_LIST_LOCK_COUNT	= 32
+		};
+
+	static	BLocker				sObserverListLocks[OBSERVER_LIST_LOCK_COUNT];
+		// the observers of an object are protected by one of these,
+		// chosen by the object's address
+	static	BLocker				sBatchLock;
+	static	vint64				sDeliveredNotifications;
+	static	vint64				sCoalescedNotifications;
 };
 
 class AutoNotificationSuspender {
@@ -59,4 +80,17 @@ class AutoNotificationSuspender {
 			Observable*			fObject;
 };
 
+class AutoNotificationBatch {
+ public:
+								AutoNotificationBatch()
+								{
+									Observable::BeginNotificationBatch();
+								}
+
+								~AutoNotificationBatch()
+								{
+									Observable::EndNotificationBatch();
+								}
+};
+
 #endif // OBSERVABLE_H
@@ -5,12 +5,17 @@
 
 #include "PropertyObject.h"
 
+#include <new>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <ByteOrder.h>
+#include <Locker.h>
 #include <Message.h>
 #include <OS.h>
 
+#include "AutoLocker.h"
 #include "Int64Property.h"
 #include "Property.h"
 #include "PropertyAnimator.h"
@@ -19,9 +24,180 @@
 #	define DEBUG 0
 #endif
 
+using std::nothrow;
+
+// PropertyLayout
+//
+// The IDs of the properties of a PropertyObject in the order they have
+// been added, plus a hash table for looking up the index of a property
+// by its ID. All objects which have added the same properties in the same
+// order share one layout, since each layout remembers the layouts it has
+// been extended to. Layouts are never deleted, there are only as many as
+// there are different kinds of objects.
+class PropertyLayout {
+ public:
+								PropertyLayout();
+								~PropertyLayout();
+
+	static	const PropertyLayout* Root();
+
+	static	const PropertyLayout* Add(const PropertyLayout* layout,
+									uint32 propertyID);
+
+	inline	int32				IndexOf(uint32 propertyID) const;
+
+ private:
+			struct slot {
+				uint32			id;
+				int32			index;
+			};
+
+	static	inline uint32		_Hash(uint32 propertyID);
+
+			bool				_Init(const PropertyLayout* parent,
+									uint32 propertyID);
+
+			uint32*				fIDs;
+			int32				fCount;
+
+			slot*				fSlots;
+			uint32				fSlotMask;
+
+			BList				fChildren;
+
+	static	BLocker				sLock;
+	static	PropertyLayout		sRoot;
+};
+
+// constructor
+PropertyLayout::PropertyLayout()
+	: fIDs(NULL)
+	, fCount(0)
+	, fSlots(NULL)
+	, fSlotMask(0)
+	, fChildren(4)
+{
+}
+
+// destructor
+PropertyLayout::~PropertyLayout()
+{
+	int32 count = fChildren.CountItems();
+	for (int32 i = 0; i < count; i++)
+		delete (PropertyLayout*)fChildren.ItemAtFast(i);
+	free(fIDs);
+	free(fSlots);
+}
+
+// Root
+/*static*/ const PropertyLayout*
+PropertyLayout::Root()
+{
+	return &sRoot;
+}
+
+// Add
+//
+// Returns the layout with /propertyID/ added to /layout/, or NULL
+// if there is no memory for it.
+/*static*/ const PropertyLayout*
+PropertyLayout::Add(const PropertyLayout* _layout, uint32 propertyID)
+{
+	PropertyLayout* layout = const_cast<PropertyLayout*>(_layout);
+
+	AutoLocker<BLocker> locker(sLock);
+
+	int32 count = layout->fChildren.CountItems();
+	for (int32 i = 0; i < count; i++) {
+		PropertyLayout* child
+			= (PropertyLayout*)layout->fChildren.ItemAtFast(i);
+		if (child->fIDs[child->fCount - 1] == propertyID)
+			return child;
+	}
+
+	PropertyLayout* child = new (nothrow) PropertyLayout();
+	if (!child || !child->_Init(layout, propertyID)
+		|| !layout->fChildren.AddItem(child)) {
+		delete child;
+		return NULL;
+	}
+	return child;
+}
+
+// IndexOf
+inline int32
+PropertyLayout::IndexOf(uint32 propertyID) const
+{
+	if (!fSlots)
+		return -1;
+
+	uint32 i = _Hash(propertyID) & fSlotMask;
+	while (fSlots[i].index >= 0) {
+		if (fSlots[i].id == propertyID)
+			return fSlots[i].index;
+		i = (i + 1) & fSlotMask;
+	}
+	return -1;
+}
+
+// _Hash
+/*static*/ inline uint32
+PropertyLayout::_Hash(uint32 propertyID)
+{
+	// the IDs are four character codes, which
+	// need to be mixed to spread the low bits
+	propertyID *= 0x9e3779b1;
+	return propertyID ^ (propertyID >> 16);
+}
+
+// _Init
+bool
+PropertyLayout::_Init(const PropertyLayout* parent, uint32 propertyID)
+{
+	fCount = parent->fCount + 1;
+	fIDs = (uint32*)malloc(fCount * sizeof(uint32));
+	if (!fIDs)
+		return false;
+	memcpy(fIDs, parent->fIDs, parent->fCount * sizeof(uint32));
+	fIDs[fCount - 1] = propertyID;
+
+	// keep the table at most half full
+	uint32 slotCount = 4;
+	while (slotCount < (uint32)fCount * 2)
+		slotCount *= 2;
+	fSlots = (slot*)malloc(slotCount * sizeof(slot));
+	if (!fSlots)
+		return false;
+	fSlotMask = slotCount - 1;
+	for (uint32 i = 0; i < slotCount; i++)
+		fSlots[i].index = -1;
+
+	// if an ID is used twice, the property which
+	// has been added first is found
+	for (int32 index = 0; index < fCount; index++) {
+		uint32 id = fIDs[index];
+		uint32 i = _Hash(id) & fSlotMask;
+		while (fSlots[i].index >= 0 && fSlots[i].id != id)
+			i = (i + 1) & fSlotMask;
+		if (fSlots[i].index < 0) {
+			fSlots[i].id = id;
+			fSlots[i].index = index;
+		}
+	}
+
+	return true;
+}
+
+// static variables
+BLocker PropertyLayout::sLock("property layouts");
+PropertyLayout PropertyLayout::sRoot;
+
+// #pragma mark - PropertyObject
+
 // constructor
 PropertyObject::PropertyObject()
 	: fProperties(16)
+	, fLayout(PropertyLayout::Root())
 {
 }
 
@@ -29,6 +205,7 @@ PropertyObject::PropertyObject()
 PropertyObject::PropertyObject(const PropertyObject& other,
 							   bool deep)
 	: fProperties(16)
+	, fLayout(PropertyLayout::Root())
 {
 	Assign(other, deep);
 }
@@ -148,6 +325,8 @@ PropertyObject::AddProperty(Property* property)
 #endif
 
 	if (fProperties.AddItem((void*)property)) {
+		if (fLayout)
+			fLayout = PropertyLayout::Add(fLayout, property->Identifier());
 		Notify();
 		return true;
 	}
@@ -182,6 +361,12 @@ PropertyObject::CountProperties() const
 Property*
 PropertyObject::FindProperty(uint32 propertyID) const
 {
+	if (fLayout) {
+		int32 index = fLayout->IndexOf(propertyID);
+		return index >= 0 ? (Property*)fProperties.ItemAtFast(index) : NULL;
+	}
+
+	// there was no memory for the layout
 	int32 count = fProperties.CountItems();
 	for (int32 i = 0; i < count; i++) {
 		Property* p = (Property*)fProperties.ItemAtFast(i);
@@ -247,6 +432,7 @@ PropertyObject::DeleteProperties()
 	for (int32 i = 0; i < count; i++)
 		delete (Property*)fProperties.ItemAtFast(i);
 	fProperties.MakeEmpty();
+	fLayout = PropertyLayout::Root();
 	Notify();
 }
 
@@ -259,6 +445,7 @@ PropertyObject::DeleteProperty(uint32 propertyID)
 		Property* p = (Property*)fProperties.ItemAtFast(i);
 		if (p->Identifier() == propertyID) {
 			if (fProperties.RemoveItem(i)) {
+				_UpdateLayout();
 				Notify();
 				delete p;
 				return true;
@@ -276,6 +463,19 @@ PropertyObject::ValueChanged(Property* property)
 	Notify();
 }
 
+// _UpdateLayout
+void
+PropertyObject::_UpdateLayout()
+{
+	fLayout = PropertyLayout::Root();
+
+	int32 count = fProperties.CountItems();
+	for (int32 i = 0; i < count && fLayout; i++) {
+		Property* p = (Property*)fProperties.ItemAtFast(i);
+		fLayout = PropertyLayout::Add(fLayout, p->Identifier());
+	}
+}
+
 // #pragma mark -
 
 // SetValue
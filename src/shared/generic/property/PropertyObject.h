@@ -12,6 +12,7 @@ class BMessage;
 class BString;
 class FloatProperty;
 class Property;
+class PropertyLayout;
 
 class PropertyObject : public Observable {
  public:
@@ -79,7 +80,12 @@ class PropertyObject : public Observable {
 	virtual	void				ConvertFrameToLocal(int64& frame) const;
 
  private:
+			void				_UpdateLayout();
+
 			BList				fProperties;
+			const PropertyLayout* fLayout;
+				// the index of the properties by ID, shared by the
+				// objects which have the same properties
 };
 
 #endif // PROPERTY_OBJECT_H
@@ -0,0 +1,495 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "BitmapResampler.h"
+
+#include <math.h>
+#include <new>
+#include <string.h>
+
+#if defined(__SSE2__)
+#	include <emmintrin.h>
+#endif
+
+#include "AutoDeleter.h"
+
+using std::nothrow;
+
+// the weights are fixed point numbers with this many bits
+// for the fraction, the intermediate rows keep 6 bits of
+// the fraction to preserve the precision for the second pass
+static const int32 kWeightShift = 14;
+static const int32 kWeightOne = 1 << kWeightShift;
+static const int32 kIntermediateShift = 8;
+static const int32 kResultShift = 2 * kWeightShift - kIntermediateShift;
+
+// filter kernels
+
+// bilinear_kernel
+static double
+bilinear_kernel(double x)
+{
+	x = fabs(x);
+	return x < 1.0 ? 1.0 - x : 0.0;
+}
+
+// bicubic_kernel
+static double
+bicubic_kernel(double x)
+{
+	// Catmull-Rom spline (a = -0.5)
+	x = fabs(x);
+	if (x < 1.0)
+		return (1.5 * x - 2.5) * x * x + 1.0;
+	if (x < 2.0)
+		return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+	return 0.0;
+}
+
+// lanczos_kernel
+static double
+lanczos_kernel(double x)
+{
+	x = fabs(x);
+	if (x < 1e-8)
+		return 1.0;
+	if (x >= 3.0)
+		return 0.0;
+	double px = M_PI * x;
+	return 3.0 * sin(px) * sin(px / 3.0) / (px * px);
+}
+
+// Contributions
+//
+// For each dest column or row the range of source pixels and their
+// weights.
+struct BitmapResampler::Contributions {
+	Contributions()
+		: first(NULL),
+		  count(NULL),
+		  weights(NULL),
+		  maxTaps(0),
+		  fixedTaps(false)
+	{
+	}
+
+	~Contributions()
+	{
+		delete[] first;
+		delete[] count;
+		delete[] weights;
+	}
+
+	int32*		first;
+	int32*		count;
+	int16*		weights;
+	int32		maxTaps;
+	bool		fixedTaps;
+		// all columns or rows use maxTaps taps
+};
+
+// filter_row
+//
+// Applies the column weights to one source row. If Taps is 0, the number
+// of taps varies per column.
+template<uint32 BytesPerPixel, int32 Taps>
+static void
+filter_row(const uint8* source, const BitmapResampler::Contributions& columns,
+	int16* row, int32 width)
+{
+	const int32 rounding = 1 << (kIntermediateShift - 1);
+	const int32 maxTaps = columns.maxTaps;
+
+	for (int32 x = 0; x < width; x++) {
+		const int16* weights = columns.weights + x * maxTaps;
+		int32 count = Taps > 0 ? Taps : columns.count[x];
+		const uint8* s = source + columns.first[x] * BytesPerPixel;
+
+		int32 c0 = rounding;
+		int32 c1 = rounding;
+		int32 c2 = rounding;
+		int32 c3 = rounding;
+		for (int32 k = 0; k < count; k++) {
+			int32 w = weights[k];
+			c0 += w * s[0];
+			c1 += w * s[1];
+			c2 += w * s[2];
+			if (BytesPerPixel == 4)
+				c3 += w * s[3];
+			else {
+				// the source is opaque, but the taps outside of it
+				// are transparent
+				c3 += w * 255;
+			}
+			s += BytesPerPixel;
+		}
+
+		row[0] = (int16)(c0 >> kIntermediateShift);
+		row[1] = (int16)(c1 >> kIntermediateShift);
+		row[2] = (int16)(c2 >> kIntermediateShift);
+		row[3] = (int16)(c3 >> kIntermediateShift);
+		row += 4;
+	}
+}
+
+// constructor
+BitmapResampler::BitmapResampler(bitmap_filter filter)
+	: fFilter(filter),
+	  fColumns(new (nothrow) Contributions),
+	  fRows(new (nothrow) Contributions)
+{
+}
+
+// destructor
+BitmapResampler::~BitmapResampler()
+{
+	delete fColumns;
+	delete fRows;
+}
+
+// Resample
+bool
+BitmapResampler::Resample(const agg::rendering_buffer& source,
+	uint32 sourceBytesPerPixel, double xScale, double yScale,
+	double xOffset, double yOffset, agg::rendering_buffer& dest,
+	uint32 destBytesPerPixel, int32 left, int32 top, int32 right,
+	int32 bottom, uint8 cover)
+{
+	if (!fColumns || !fRows)
+		return false;
+	if (left > right || top > bottom || cover == 0)
+		return true;
+
+	int32 width = right - left + 1;
+	int32 height = bottom - top + 1;
+
+	if (!_CalculateContributions(*fColumns, left, width, xScale, xOffset,
+			source.width())
+		|| !_CalculateContributions(*fRows, top, height, yScale, yOffset,
+			source.height())) {
+		return false;
+	}
+
+	// the horizontally filtered source rows are kept in a ring buffer,
+	// since the first source row of each dest row never decreases, the
+	// rows needed for one dest row never share a slot
+	int32 ringSize = fRows->maxTaps;
+	int32 rowLength = (width * 4 + 7) & ~7;
+		// padded for the SIMD version of _CombineRows()
+	int16* ring = new (nothrow) int16[ringSize * rowLength];
+	int32* ringRows = new (nothrow) int32[ringSize];
+	const int16** rows = new (nothrow) const int16*[ringSize];
+	uint8* result = new (nothrow) uint8[rowLength];
+	ArrayDeleter<int16> ringDeleter(ring);
+	ArrayDeleter<int32> ringRowsDeleter(ringRows);
+	ArrayDeleter<const int16*> rowsDeleter(rows);
+	ArrayDeleter<uint8> resultDeleter(result);
+	if (!ring || !ringRows || !rows || !result)
+		return false;
+
+	memset(ring, 0, ringSize * rowLength * sizeof(int16));
+	for (int32 i = 0; i < ringSize; i++)
+		ringRows[i] = -1;
+
+	for (int32 y = 0; y < height; y++) {
+		int32 first = fRows->first[y];
+		int32 count = fRows->count[y];
+		if (count == 0)
+			continue;
+
+		for (int32 i = 0; i < count; i++) {
+			int32 sourceRow = first + i;
+			int32 slot = sourceRow % ringSize;
+			int16* row = ring + slot * rowLength;
+			if (ringRows[slot] != sourceRow) {
+				_FilterRow(source.row_ptr(sourceRow), sourceBytesPerPixel,
+					row, width);
+				ringRows[slot] = sourceRow;
+			}
+			rows[i] = row;
+		}
+
+		_CombineRows(rows, fRows->weights + y * fRows->maxTaps, count,
+			result, rowLength);
+
+		_BlendRow(result, dest.row_ptr(top + y) + left * destBytesPerPixel,
+			destBytesPerPixel, width, cover);
+	}
+
+	return true;
+}
+
+// #pragma mark -
+
+// _CalculateContributions
+bool
+BitmapResampler::_CalculateContributions(Contributions& contributions,
+	int32 destStart, int32 destCount, double scale, double offset,
+	int32 sourceSize) const
+{
+	double (*kernel)(double);
+	double radius;
+	switch (fFilter) {
+		case BITMAP_FILTER_BICUBIC:
+			kernel = bicubic_kernel;
+			radius = 2.0;
+			break;
+		case BITMAP_FILTER_LANCZOS:
+			kernel = lanczos_kernel;
+			radius = 3.0;
+			break;
+		case BITMAP_FILTER_BILINEAR:
+		default:
+			kernel = bilinear_kernel;
+			radius = 1.0;
+			break;
+	}
+
+	// when scaling down, the higher quality filters are widened to
+	// cover all source pixels, the bilinear filter samples exactly
+	// like the AGG pipeline it replaces
+	double filterScale = 1.0;
+	if (fFilter != BITMAP_FILTER_BILINEAR && scale < 1.0)
+		filterScale = scale;
+	double support = radius / filterScale;
+
+	// all kernels are zero at their radius, so only the source pixels
+	// strictly inside the support need to be taken into account
+	int32 maxTaps = max_c((int32)ceil(2 * support), 1);
+
+	delete[] contributions.first;
+	delete[] contributions.count;
+	delete[] contributions.weights;
+	contributions.first = new (nothrow) int32[destCount];
+	contributions.count = new (nothrow) int32[destCount];
+	contributions.weights = new (nothrow) int16[destCount * maxTaps];
+	contributions.maxTaps = maxTaps;
+
+	double* raw = new (nothrow) double[maxTaps];
+	ArrayDeleter<double> rawDeleter(raw);
+
+	if (!contributions.first || !contributions.count
+		|| !contributions.weights || !raw) {
+		return false;
+	}
+
+	for (int32 i = 0; i < destCount; i++) {
+		// the pixel centers are used, just like AGG does
+		double center = (destStart + i + 0.5 - offset) / scale - 0.5;
+		int32 start = (int32)floor(center - support) + 1;
+		int32 taps = min_c((int32)ceil(center + support) - 1 - start + 1,
+			maxTaps);
+
+		double total = 0.0;
+		for (int32 k = 0; k < taps; k++) {
+			raw[k] = kernel((start + k - center) * filterScale);
+			total += raw[k];
+		}
+
+		// nothing of the source is covered unless found otherwise,
+		// the fixed length filter loops still use the weights
+		int16* weights = contributions.weights + i * maxTaps;
+		memset(weights, 0, maxTaps * sizeof(int16));
+		contributions.first[i] = 0;
+		contributions.count[i] = 0;
+		if (taps <= 0 || total == 0.0)
+			continue;
+
+		// normalize, including the taps outside the source, which
+		// contribute transparent pixels, and make sure the fixed point
+		// weights add up to exactly one
+		int32 sum = 0;
+		int32 largest = 0;
+		for (int32 k = 0; k < taps; k++) {
+			raw[k] = floor(raw[k] / total * kWeightOne + 0.5);
+			sum += (int32)raw[k];
+			if (fabs(raw[k]) > fabs(raw[largest]))
+				largest = k;
+		}
+		raw[largest] += kWeightOne - sum;
+
+		// keep only the taps inside the source
+		int32 first = max_c(start, 0);
+		int32 last = min_c(start + taps - 1, sourceSize - 1);
+		// skip zero weights at both ends
+		while (first <= last && raw[first - start] == 0.0)
+			first++;
+		while (last >= first && raw[last - start] == 0.0)
+			last--;
+		if (first > last)
+			continue;
+
+		// if possible, always use the maximum number of taps, so that the
+		// filter loops have a fixed length, the extra taps get no weight
+		int32 count = last - first + 1;
+		if (sourceSize >= maxTaps) {
+			first = min_c(first, sourceSize - maxTaps);
+			count = maxTaps;
+		}
+
+		contributions.first[i] = first;
+		contributions.count[i] = count;
+		for (int32 k = 0; k < count; k++) {
+			int32 index = first + k - start;
+			weights[k] = index >= 0 && index < taps && first + k <= last
+				? (int16)raw[index] : 0;
+		}
+	}
+
+	contributions.fixedTaps = sourceSize >= maxTaps;
+
+	return true;
+}
+
+// _FilterRow
+void
+BitmapResampler::_FilterRow(const uint8* source, uint32 sourceBytesPerPixel,
+	int16* row, int32 width) const
+{
+	// use a version with a constant number of taps for the common cases,
+	// the compiler can unroll those loops
+	int32 taps = fColumns->fixedTaps ? fColumns->maxTaps : 0;
+	if (sourceBytesPerPixel == 4) {
+		switch (taps) {
+			case 2:
+				filter_row<4, 2>(source, *fColumns, row, width);
+				break;
+			case 4:
+				filter_row<4, 4>(source, *fColumns, row, width);
+				break;
+			case 6:
+				filter_row<4, 6>(source, *fColumns, row, width);
+				break;
+			default:
+				filter_row<4, 0>(source, *fColumns, row, width);
+				break;
+		}
+	} else {
+		switch (taps) {
+			case 2:
+				filter_row<3, 2>(source, *fColumns, row, width);
+				break;
+			case 4:
+				filter_row<3, 4>(source, *fColumns, row, width);
+				break;
+			case 6:
+				filter_row<3, 6>(source, *fColumns, row, width);
+				break;
+			default:
+				filter_row<3, 0>(source, *fColumns, row, width);
+				break;
+		}
+	}
+}
+
+// _CombineRows
+void
+BitmapResampler::_CombineRows(const int16** rows, const int16* weights,
+	int32 count, uint8* dest, int32 length) const
+{
+#if defined(__SSE2__)
+	const __m128i rounding = _mm_set1_epi32(1 << (kResultShift - 1));
+	const __m128i zero = _mm_setzero_si128();
+
+	for (int32 i = 0; i < length; i += 8) {
+		__m128i low = rounding;
+		__m128i high = rounding;
+
+		// two rows at a time, the values of both are interleaved,
+		// so that each multiply-add combines one pixel of each row
+		int32 k = 0;
+		for (; k + 1 < count; k += 2) {
+			__m128i a = _mm_loadu_si128((const __m128i*)(rows[k] + i));
+			__m128i b = _mm_loadu_si128((const __m128i*)(rows[k + 1] + i));
+			__m128i w = _mm_set1_epi32(((int32)weights[k + 1] << 16)
+				| (uint16)weights[k]);
+			low = _mm_add_epi32(low, _mm_madd_epi16(_mm_unpacklo_epi16(a, b),
+				w));
+			high = _mm_add_epi32(high,
+				_mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+		}
+		if (k < count) {
+			__m128i a = _mm_loadu_si128((const __m128i*)(rows[k] + i));
+			__m128i w = _mm_set1_epi32((uint16)weights[k]);
+			low = _mm_add_epi32(low,
+				_mm_madd_epi16(_mm_unpacklo_epi16(a, zero), w));
+			high = _mm_add_epi32(high,
+				_mm_madd_epi16(_mm_unpackhi_epi16(a, zero), w));
+		}
+
+		low = _mm_srai_epi32(low, kResultShift);
+		high = _mm_srai_epi32(high, kResultShift);
+		// saturate to 0...255
+		__m128i result = _mm_packs_epi32(low, high);
+		result = _mm_packus_epi16(result, result);
+		_mm_storel_epi64((__m128i*)(dest + i), result);
+	}
+#else
+	const int32 rounding = 1 << (kResultShift - 1);
+
+	// blocks of eight values, the inner loops can be vectorized
+	// by the compiler
+	for (int32 i = 0; i < length; i += 8) {
+		int32 values[8];
+		for (int32 j = 0; j < 8; j++)
+			values[j] = rounding;
+		for (int32 k = 0; k < count; k++) {
+			int32 w = weights[k];
+			const int16* row = rows[k] + i;
+			for (int32 j = 0; j < 8; j++)
+				values[j] += w * row[j];
+		}
+		for (int32 j = 0; j < 8; j++) {
+			int32 value = values[j] >> kResultShift;
+			dest[i + j] = value < 0 ? 0 : (value > 255 ? 255 : value);
+		}
+	}
+#endif
+}
+
+// _BlendRow
+void
+BitmapResampler::_BlendRow(const uint8* source, uint8* dest,
+	uint32 destBytesPerPixel, int32 width, uint8 cover) const
+{
+	for (int32 x = 0; x < width; x++) {
+		uint32 alpha = source[3];
+		if (alpha > 0) {
+			// filters with negative lobes can overshoot, the colors
+			// need to stay pre-multiplied though
+			uint32 c0 = min_c(source[0], alpha);
+			uint32 c1 = min_c(source[1], alpha);
+			uint32 c2 = min_c(source[2], alpha);
+
+			// the same as the pre-multiplied AGG blenders
+			if (cover < 255)
+				alpha = (alpha * (cover + 1)) >> 8;
+			if (alpha == 255) {
+				dest[0] = c0;
+				dest[1] = c1;
+				dest[2] = c2;
+				if (destBytesPerPixel == 4)
+					dest[3] = 255;
+			} else if (cover < 255) {
+				uint32 inverse = 255 - alpha;
+				uint32 c = cover + 1;
+				dest[0] = (dest[0] * inverse + c0 * c) >> 8;
+				dest[1] = (dest[1] * inverse + c1 * c) >> 8;
+				dest[2] = (dest[2] * inverse + c2 * c) >> 8;
+				if (destBytesPerPixel == 4)
+					dest[3] = 255 - ((inverse * (255 - dest[3])) >> 8);
+			} else {
+				uint32 inverse = 255 - alpha;
+				dest[0] = ((dest[0] * inverse) >> 8) + c0;
+				dest[1] = ((dest[1] * inverse) >> 8) + c1;
+				dest[2] = ((dest[2] * inverse) >> 8) + c2;
+				if (destBytesPerPixel == 4)
+					dest[3] = 255 - ((inverse * (255 - dest[3])) >> 8);
+			}
+		}
+		source += 4;
+		dest += destBytesPerPixel;
+	}
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#ifndef BITMAP_RESAMPLER_H
+#define BITMAP_RESAMPLER_H
+
+#include <SupportDefs.h>
+
+#include <agg_rendering_buffer.h>
+
+enum bitmap_filter {
+	BITMAP_FILTER_BILINEAR = 0,
+	BITMAP_FILTER_BICUBIC,
+	BITMAP_FILTER_LANCZOS,
+};
+
+// BitmapResampler
+//
+// Scales a bitmap into a buffer with a separable filter, which is much
+// faster than the generic AGG pipeline, but works only if the bitmap is
+// neither rotated nor sheared. The weights for all columns and rows are
+// computed once, then each needed source row is filtered horizontally
+// and the results are combined vertically.
+//
+// The source pixels are expected to have 3 (no alpha) or 4 bytes with
+// the alpha in the last byte and pre-multiplied colors, the first three
+// channels are treated the same, so it works for BGRA32 and YCbCr
+// formats alike. The result is blended into the destination in the same
+// way the pre-multiplied AGG pixel formats blend, with 4 bytes per pixel
+// the destination alpha is updated as well.
+class BitmapResampler {
+ public:
+								BitmapResampler(bitmap_filter filter);
+	virtual						~BitmapResampler();
+
+			bool				Resample(const agg::rendering_buffer& source,
+									uint32 sourceBytesPerPixel,
+									double xScale, double yScale,
+									double xOffset, double yOffset,
+									agg::rendering_buffer& dest,
+									uint32 destBytesPerPixel,
+									int32 left, int32 top,
+									int32 right, int32 bottom,
+									uint8 cover);
+									// maps the source pixel x to
+									// x * xScale + xOffset in the dest,
+									// left, top, right and bottom are the
+									// (inclusive) dest pixels to generate,
+									// returns false if memory could not
+									// be allocated
+
+			struct Contributions;
+									// public for the filter functions
+
+ private:
+			bool				_CalculateContributions(
+									Contributions& contributions,
+									int32 destStart, int32 destCount,
+									double scale, double offset,
+									int32 sourceSize) const;
+
+			void				_FilterRow(const uint8* source,
+									uint32 sourceBytesPerPixel,
+									int16* row, int32 width) const;
+			void				_CombineRows(const int16** rows,
+									const int16* weights, int32 count,
+									uint8* dest, int32 length) const;
+			void				_BlendRow(const uint8* source, uint8* dest,
+									uint32 destBytesPerPixel, int32 width,
+									uint8 cover) const;
+
+			bitmap_filter		fFilter;
+			Contributions*		fColumns;
+			Contributions*		fRows;
+};
+
+#endif // BITMAP_RESAMPLER_H
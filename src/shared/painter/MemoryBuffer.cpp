@@ -7,6 +7,9 @@
 
 #include <new>
 
+#include <Autolock.h>
+#include <Locker.h>
+
 using std::nothrow;
 
 // constructor
@@ -17,7 +20,10 @@ MemoryBuffer::MemoryBuffer(uint32 width, uint32 height,
 	  fFormat(format),
 	  fWidth(width),
 	  fHeight(height),
-	  fBytesPerRow(bytesPerRow)
+	  fBytesPerRow(bytesPerRow),
+	  fMipMapsEnabled(false),
+	  fMipMapLock(NULL),
+	  fNextLevel(NULL)
 {
 	if (height * bytesPerRow > 0)
 		fBuffer = new (nothrow) uint8[height * bytesPerRow];
@@ -26,6 +32,8 @@ MemoryBuffer::MemoryBuffer(uint32 width, uint32 height,
 // destructor
 MemoryBuffer::~MemoryBuffer()
 {
+	delete fNextLevel;
+	delete fMipMapLock;
 	delete[] fBuffer;
 }
 
@@ -71,3 +79,98 @@ MemoryBuffer::Height() const
 	return fHeight;
 }
 
+// #pragma mark -
+
+// EnableMipMaps
+void
+MemoryBuffer::EnableMipMaps()
+{
+	if (fMipMapsEnabled)
+		return;
+
+	// NOTE: only buffers which are drawn scaled down get a lock, so
+	// there is not a semaphore for every buffer
+	fMipMapLock = new (nothrow) BLocker("mip map lock");
+	if (!fMipMapLock || fMipMapLock->Sem() < B_OK) {
+		delete fMipMapLock;
+		fMipMapLock = NULL;
+		return;
+	}
+	fMipMapsEnabled = true;
+}
+
+// MipLevel
+const MemoryBuffer*
+MemoryBuffer::MipLevel(int32 level) const
+{
+	const MemoryBuffer* buffer = this;
+	for (; level > 0 && buffer; level--) {
+		if (!buffer->fMipMapsEnabled)
+			return NULL;
+		// the buffer may be shared by several threads, the lock is
+		// always taken, so that the next level is completely
+		// constructed once another thread sees it
+		BAutolock _(buffer->fMipMapLock);
+		if (!buffer->fNextLevel)
+			buffer->fNextLevel = buffer->_CreateHalfSize();
+		buffer = buffer->fNextLevel;
+	}
+	return buffer;
+}
+
+// _CreateHalfSize
+MemoryBuffer*
+MemoryBuffer::_CreateHalfSize() const
+{
+	uint32 bytesPerPixel;
+	switch (fFormat) {
+		case BGR32:
+		case BGRA32:
+		case YCbCrA:
+			bytesPerPixel = 4;
+			break;
+		case YCbCr444:
+			bytesPerPixel = 3;
+			break;
+		default:
+			// YCbCr422 shares the chroma between two pixels,
+			// which a simple box filter doesn't handle
+			return NULL;
+	}
+
+	if (!fBuffer || (fWidth < 2 && fHeight < 2))
+		return NULL;
+
+	uint32 width = (fWidth + 1) / 2;
+	uint32 height = (fHeight + 1) / 2;
+	uint32 bpr = ((width * bytesPerPixel + 3) / 4) * 4;
+
+	MemoryBuffer* level = new (nothrow) MemoryBuffer(width, height,
+		fFormat, bpr);
+	if (!level || level->InitCheck() < B_OK) {
+		delete level;
+		return NULL;
+	}
+
+	// box filter, the last row and column are repeated for odd sizes,
+	// since all formats carry premultiplied alpha, all channels
+	// can be averaged the same way
+	for (uint32 y = 0; y < height; y++) {
+		const uint8* s1 = fBuffer + 2 * y * fBytesPerRow;
+		const uint8* s2 = 2 * y + 1 < fHeight ? s1 + fBytesPerRow : s1;
+		uint8* d = level->fBuffer + y * bpr;
+		for (uint32 x = 0; x < width; x++) {
+			uint32 right = 2 * x + 1 < fWidth ? bytesPerPixel : 0;
+			for (uint32 i = 0; i < bytesPerPixel; i++) {
+				d[i] = (s1[i] + s1[i + right] + s2[i] + s2[i + right] + 2)
+					>> 2;
+			}
+			s1 += 2 * bytesPerPixel;
+			s2 += 2 * bytesPerPixel;
+			d += bytesPerPixel;
+		}
+	}
+
+	level->EnableMipMaps();
+	return level;
+}
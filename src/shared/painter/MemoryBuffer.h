@@ -8,6 +8,8 @@
 
 #include "RenderingBuffer.h"
 
+class BLocker;
+
 class MemoryBuffer : public RenderingBuffer {
  public:
 								MemoryBuffer(uint32 width, uint32 height,
@@ -23,12 +25,32 @@ class MemoryBuffer : public RenderingBuffer {
 	virtual	uint32				Width() const;
 	virtual	uint32				Height() const;
 
+	// mip mapping
+			void				EnableMipMaps();
+									// the contents must not change
+									// anymore after this call
+			bool				MipMapsEnabled() const
+									{ return fMipMapsEnabled; }
+			const MemoryBuffer*	MipLevel(int32 level) const;
+									// level 0 is the buffer itself, each
+									// further level has half the size of
+									// the previous one, the levels are
+									// generated on demand, returns NULL
+									// if the level is not available
+
  private:
+			MemoryBuffer*		_CreateHalfSize() const;
+
 			uint8*				fBuffer;
 			pixel_format		fFormat;
 			uint32				fWidth;
 			uint32				fHeight;
 			uint32				fBytesPerRow;
+
+			bool				fMipMapsEnabled;
+			BLocker*			fMipMapLock;
+									// protects fNextLevel
+	mutable	MemoryBuffer*		fNextLevel;
 };
 
 #endif // MEMORY_BUFFER_H
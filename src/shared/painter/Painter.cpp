@@ -7,6 +7,7 @@
  *
  */
 
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -33,6 +34,7 @@
 #include "support.h"
 #include "support_ui.h"
 
+#include "MemoryBuffer.h"
 #include "ShapeConverter.h"
 #include "TextRenderer.h"
 
@@ -159,6 +161,8 @@ Painter::State::State()
 	  fGlobalAlpha(255),
 	  fAlpha(255),
 	  fSubpixelPrecise(false),
+	  fBitmapFilter(BITMAP_FILTER_BILINEAR),
+	  fSeparableScaling(true),
 	  fPenSize(1.0),
 	  fLineCapMode(B_BUTT_CAP),
 	  fLineJoinMode(B_MITER_JOIN),
@@ -174,6 +178,8 @@ Painter::State::State(State* previous)
 	  fGlobalAlpha(previous->fGlobalAlpha),
 	  fAlpha(255),
 	  fSubpixelPrecise(previous->fSubpixelPrecise),
+	  fBitmapFilter(previous->fBitmapFilter),
+	  fSeparableScaling(previous->fSeparableScaling),
 	  fPenSize(previous->fPenSize),
 	  fLineCapMode(previous->fLineCapMode),
 	  fLineJoinMode(previous->fLineJoinMode),
@@ -597,6 +603,20 @@ Painter::SetSubpixelPrecise(bool precise)
 	fState->fSubpixelPrecise = precise;
 }
 
+// SetBitmapFilter
+void
+Painter::SetBitmapFilter(bitmap_filter filter)
+{
+	fState->fBitmapFilter = filter;
+}
+
+// SetSeparableScaling
+void
+Painter::SetSeparableScaling(bool enabled)
+{
+	fState->fSeparableScaling = enabled;
+}
+
 // SetPenSize
 void
 Painter::SetPenSize(float size)
@@ -1193,7 +1213,8 @@ Painter::BoundingBox(const char* utf8String, uint32 length,
 	transform.TranslateBy(baseLine);
 	transform *= fState->fTransform;
 
-	static BRect dummy;
+	// not static, the painters of several threads render text
+	BRect dummy;
 	return fTextRenderer->RenderString(utf8String,
 									   length,
 									   fRenderer,
@@ -1227,6 +1248,13 @@ Painter::DrawBitmap(const RenderingBuffer* bitmap,
 	BRect touched = _Clipped(viewRect);
 
 	if (bitmap && bitmap->InitCheck() >= B_OK && touched.IsValid()) {
+		// when scaling down a lot, use a pre-filtered version of the bitmap
+		// if available, that's faster and doesn't alias
+		const MemoryBuffer* memoryBuffer
+			= dynamic_cast<const MemoryBuffer*>(bitmap);
+		if (memoryBuffer && memoryBuffer->MipMapsEnabled())
+			bitmap = _MipLevelFor(memoryBuffer, bitmapRect, viewRect);
+
 		// the native bitmap coordinate system
 		BRect actualBitmapRect(bitmap->Bounds());
 
@@ -1375,6 +1403,51 @@ Painter::_SetRendererColor(const rgb_color& color) const
 // #pragma mark -
 
 
+// _MipLevelFor
+const MemoryBuffer*
+Painter::_MipLevelFor(const MemoryBuffer* bitmap, BRect& bitmapRect,
+	const BRect& viewRect) const
+{
+	// the effective scale, including the one of the transformation
+	double xScale;
+	double yScale;
+	fState->fTransform.scaling_abs(&xScale, &yScale);
+	xScale *= (viewRect.Width() + 1) / (bitmapRect.Width() + 1);
+	yScale *= (viewRect.Height() + 1) / (bitmapRect.Height() + 1);
+
+	// use the smallest level that is still scaled down (or not at all)
+	// in both directions, the bilinear filter handles the rest
+	double width = bitmap->Width();
+	double height = bitmap->Height();
+	const MemoryBuffer* level = bitmap;
+	while (true) {
+		double nextXScale = xScale * level->Width()
+			/ ((level->Width() + 1) / 2);
+		double nextYScale = yScale * level->Height()
+			/ ((level->Height() + 1) / 2);
+		if (nextXScale > 1.0 || nextYScale > 1.0)
+			break;
+		const MemoryBuffer* next = level->MipLevel(1);
+		if (!next)
+			break;
+		level = next;
+		xScale = nextXScale;
+		yScale = nextYScale;
+	}
+
+	if (level != bitmap) {
+		// transfer the source rect into the coordinate system of the level
+		double xFactor = level->Width() / width;
+		double yFactor = level->Height() / height;
+		bitmapRect.left = bitmapRect.left * xFactor;
+		bitmapRect.top = bitmapRect.top * yFactor;
+		bitmapRect.right = (bitmapRect.right + 1) * xFactor - 1;
+		bitmapRect.bottom = (bitmapRect.bottom + 1) * yFactor - 1;
+	}
+
+	return level;
+}
+
 // _DrawBitmap
 void
 Painter::_DrawBitmap(agg::rendering_buffer& srcBuffer, pixel_format format,
@@ -1456,6 +1529,11 @@ Painter::_DrawBitmapToRGB32(agg::rendering_buffer& srcBuffer,
 				return;
 			}
 
+			if (_DrawBitmapSeparable(srcBuffer, format, xOffset, yOffset,
+					xScale, yScale, viewRect)) {
+				return;
+			}
+
 			_DrawBitmapGeneric32(srcBuffer, xOffset, yOffset,
 								 xScale, yScale, viewRect);
 			break;
@@ -1470,6 +1548,11 @@ Painter::_DrawBitmapToRGB32(agg::rendering_buffer& srcBuffer,
 //				return;
 //			}
 
+			if (_DrawBitmapSeparable(srcBuffer, format, xOffset, yOffset,
+					xScale, yScale, viewRect)) {
+				return;
+			}
+
 			_DrawBitmapGeneric32(srcBuffer, xOffset, yOffset,
 								 xScale, yScale, viewRect);
 			break;
@@ -1514,12 +1597,22 @@ Painter::_DrawBitmapToYCbCr(agg::rendering_buffer& srcBuffer,
 				return;
 			}
 
+			if (_DrawBitmapSeparable(srcBuffer, format, xOffset, yOffset,
+					xScale, yScale, viewRect)) {
+				return;
+			}
+
 			_DrawBitmapGenericYCbCr444(srcBuffer, xOffset, yOffset,
 									   xScale, yScale, viewRect);
 			break;
 		}
 
 		case YCbCrA: {
+			if (_DrawBitmapSeparable(srcBuffer, format, xOffset, yOffset,
+					xScale, yScale, viewRect)) {
+				return;
+			}
+
 			_DrawBitmapGenericYCbCrA(srcBuffer, xOffset, yOffset,
 									 xScale, yScale, viewRect);
 			break;
@@ -1534,6 +1627,63 @@ Painter::_DrawBitmapToYCbCr(agg::rendering_buffer& srcBuffer,
 	}
 }
 
+// _DrawBitmapSeparable
+bool
+Painter::_DrawBitmapSeparable(agg::rendering_buffer& srcBuffer,
+							  pixel_format format,
+							  double xOffset, double yOffset,
+							  double xScale, double yScale,
+							  BRect viewRect) const
+{
+	if (!fState->fSeparableScaling)
+		return false;
+
+#if !defined(__SSE2__)
+	// without SIMD, the separable bilinear filter is not faster than
+	// the AGG pipeline, it is only needed for the better filters
+	if (fState->fBitmapFilter == BITMAP_FILTER_BILINEAR)
+		return false;
+#endif
+
+	// only scaling and translation can be handled
+	const AffineTransform& transform = fState->fTransform;
+	if (transform.shx != 0.0 || transform.shy != 0.0
+		|| transform.sx <= 0.0 || transform.sy <= 0.0) {
+		return false;
+	}
+
+	// the edges of the destination need to be on pixel boundaries,
+	// otherwise they need to be anti-aliased by the rasterizer
+	double left = viewRect.left * transform.sx + transform.tx;
+	double top = viewRect.top * transform.sy + transform.ty;
+	double right = (viewRect.right + 1) * transform.sx + transform.tx;
+	double bottom = (viewRect.bottom + 1) * transform.sy + transform.ty;
+	if (fabs(left - floor(left + 0.5)) > 0.001
+		|| fabs(top - floor(top + 0.5)) > 0.001
+		|| fabs(right - floor(right + 0.5)) > 0.001
+		|| fabs(bottom - floor(bottom + 0.5)) > 0.001) {
+		return false;
+	}
+
+	uint32 srcBytesPerPixel = format == YCbCr444 ? 3 : 4;
+	agg::rendering_buffer* dstBuffer = fTempBuffer ? fTempBuffer : fBuffer;
+	uint32 dstBytesPerPixel = fTempBuffer ? 3 : 4;
+
+	// clip to the buffer
+	int32 x1 = max_c((int32)floor(left + 0.5), (int32)fBounds.left);
+	int32 y1 = max_c((int32)floor(top + 0.5), (int32)fBounds.top);
+	int32 x2 = min_c((int32)floor(right + 0.5) - 1, (int32)fBounds.right);
+	int32 y2 = min_c((int32)floor(bottom + 0.5) - 1, (int32)fBounds.bottom);
+
+	BitmapResampler resampler(fState->fBitmapFilter);
+	return resampler.Resample(srcBuffer, srcBytesPerPixel,
+		xScale * transform.sx, yScale * transform.sy,
+		xOffset * transform.sx + transform.tx,
+		yOffset * transform.sy + transform.ty,
+		*dstBuffer, dstBytesPerPixel, x1, y1, x2, y2,
+		fState->fGlobalAlpha);
+}
+
 // _DrawBitmapNoScale
 template <class F>
 void
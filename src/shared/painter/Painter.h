@@ -15,10 +15,12 @@
 #include "defines.h"
 
 #include "AffineTransform.h"
+#include "BitmapResampler.h"
 #include "Font.h"
 #include "RenderingBuffer.h"
 
 class BRegion;
+class MemoryBuffer;
 class TextRenderer;
 
 class Painter {
@@ -52,6 +54,13 @@ class Painter {
 			void				SetAlpha(uint8 alpha);
 
 			void				SetSubpixelPrecise(bool precise);
+			void				SetBitmapFilter(bitmap_filter filter);
+			void				SetSeparableScaling(bool enabled);
+									// bitmaps which are only scaled and
+									// translated are drawn with a faster
+									// separable filter, if enabled (the
+									// default), mostly useful to compare
+									// against the generic pipeline
 
 			void				SetPenSize(float size);
 			void				SetFont(const Font* font);
@@ -163,6 +172,9 @@ class Painter {
 			void				_SetRendererColor(const rgb_color& color) const;
 
 								// drawing functions stroke/fill
+			const MemoryBuffer*	_MipLevelFor(const MemoryBuffer* bitmap,
+									BRect& bitmapRect,
+									const BRect& viewRect) const;
 			void				_DrawBitmap(agg::rendering_buffer& srcBuffer,
 									pixel_format format, BRect actualBitmapRect,
 									BRect bitmapRect, BRect viewRect) const;
@@ -179,6 +191,12 @@ class Painter {
 									double yOffset, double xScale,
 									double yScale, BRect viewRect) const;
 
+			bool				_DrawBitmapSeparable(
+									agg::rendering_buffer& srcBuffer,
+									pixel_format format, double xOffset,
+									double yOffset, double xScale,
+									double yScale, BRect viewRect) const;
+
 			template <class F>
 			void				_DrawBitmapNoScale(
 									F copyRowFunction,
@@ -264,6 +282,8 @@ class Painter {
 		uint8					fAlpha;
 		// for internal coordinate rounding/transformation
 		bool					fSubpixelPrecise;
+		bitmap_filter			fBitmapFilter;
+		bool					fSeparableScaling;
 		float					fPenSize;
 		cap_mode				fLineCapMode;
 		join_mode				fLineJoinMode;
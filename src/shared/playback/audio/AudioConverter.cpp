@@ -4,6 +4,7 @@
  */
 
 #include <algorithm>
+#include <stdlib.h>
 
 #include <ByteOrder.h>
 
@@ -21,7 +22,9 @@
 AudioConverter::AudioConverter(AudioReader* source, uint32 format,
 							   uint32 byte_order)
 	: AudioReader(),
-	  fSource(NULL)
+	  fSource(NULL),
+	  fReformatBuffer(NULL),
+	  fReformatBufferSize(0)
 {
 	uint32 hostByteOrder
 		= (B_HOST_IS_BENDIAN) ? B_MEDIA_BIG_ENDIAN : B_MEDIA_LITTLE_ENDIAN;
@@ -47,6 +50,7 @@ AudioConverter::AudioConverter(AudioReader* source, uint32 format,
 // destructor
 AudioConverter::~AudioConverter()
 {
+	free(fReformatBuffer);
 }
 
 struct ReadFloat {
@@ -200,7 +204,6 @@ ldebug("AudioConverter::Read() done 2\n");
 	int32 channelCount = fFormat.u.raw_audio.channel_count;
 	int32 inFrameSize = inSampleSize * channelCount;
 	int32 outFrameSize = outSampleSize * channelCount;
-	char* reformatBuffer = NULL;
 	char* inBuffer = (char*)buffer;
 char formatString[256];
 string_for_format(fSource->Format(), formatString, 256);
@@ -212,8 +215,16 @@ ldebug("  out format: format: %lx, sample size: %ld, channels: %ld, byte order:
 fFormat.u.raw_audio.format, outSampleSize, channelCount,
 fFormat.u.raw_audio.byte_order);
 	if (inSampleSize != outSampleSize) {
-		reformatBuffer = new char[frames * inFrameSize];
-		inBuffer = reformatBuffer;
+		// the buffer is kept for the next Read() and only grows
+		size_t size = frames * inFrameSize;
+		if (size > fReformatBufferSize) {
+			char* reformatBuffer = (char*)realloc(fReformatBuffer, size);
+			if (!reformatBuffer)
+				return B_NO_MEMORY;
+			fReformatBuffer = reformatBuffer;
+			fReformatBufferSize = size;
+		}
+		inBuffer = fReformatBuffer;
 	}
 	error = fSource->Read(inBuffer, pos, frames);
 	// convert samples to host endianess
@@ -347,7 +358,6 @@ fFormat.u.raw_audio.byte_order);
 							   frames * outFrameSize);
 	}
 
-	delete[] reformatBuffer;
 ldebug("AudioConverter::Read() done\n");
 	return B_OK;
 }
@@ -27,6 +27,9 @@ class AudioConverter : public AudioReader {
 
  protected:
 			AudioReader*		fSource;
+
+			char*				fReformatBuffer;
+			size_t				fReformatBufferSize;
 };
 
 #endif	// AUDIO_CONVERTER_H
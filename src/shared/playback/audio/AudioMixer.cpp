@@ -4,9 +4,13 @@
  */
 
 #include <math.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include <ByteOrder.h>
+
 #include "AudioMixer.h"
+#include "SampleBuffer.h"
 
 // debugging
 #include "Debug.h"
@@ -51,11 +55,101 @@ f(float x)
 		return 1.0f;
 }
 
+//---------------------------------------------------------------
+// Utility functions for reading the sources
+//---------------------------------------------------------------
+
+// read_frame
+//
+// Reads the first two channels of a frame, the left channel is
+// duplicated for mono sources.
+template<typename Buffer>
+static inline void
+read_frame(void* data, int64 frame, uint32 channelCount, float* left,
+	float* right)
+{
+	Buffer buffer(data);
+	buffer += frame * channelCount;
+	*left = buffer.ReadSample();
+	if (channelCount > 1) {
+		buffer++;
+		*right = buffer.ReadSample();
+	} else
+		*right = *left;
+}
+
+// mix_source
+//
+// Converts the source samples to float, resamples them linearly if needed,
+// applies the gain ramp and adds them to the output buffer, all in one go.
+template<typename Buffer>
+static void
+mix_source(void* sourceData, uint32 channelCount, bool resample,
+	double sourceStep, float* outBuffer, uint32 outChannelCount,
+	int64 frames, float startGain, float endGain)
+{
+	float gainStep = (endGain - startGain) / frames;
+	for (int64 frame = 0; frame < frames; frame++) {
+		float left;
+		float right;
+		if (resample) {
+			// interpolate between the two closest source frames
+			double sourcePos = frame * sourceStep;
+			int64 sourceFrame = (int64)sourcePos;
+			float weight = (float)(sourcePos - sourceFrame);
+			float nextLeft;
+			float nextRight;
+			read_frame<Buffer>(sourceData, sourceFrame, channelCount,
+				&left, &right);
+			read_frame<Buffer>(sourceData, sourceFrame + 1, channelCount,
+				&nextLeft, &nextRight);
+			left += (nextLeft - left) * weight;
+			right += (nextRight - right) * weight;
+		} else
+			read_frame<Buffer>(sourceData, frame, channelCount, &left, &right);
+
+		float gain = startGain + gainStep * frame;
+		if (outChannelCount == 1) {
+			// consider the first two channels (left and right) only
+			if (channelCount == 1)
+				*outBuffer++ += left * gain;
+			else
+				*outBuffer++ += (left + right) / 2 * gain;
+		} else {
+			// a mono source is added to left and right
+			*outBuffer++ += left * gain;
+			*outBuffer++ += right * gain;
+		}
+	}
+}
+
+// swap_sample_byte_order
+static void
+swap_sample_byte_order(void* buffer, uint32 format, size_t length)
+{
+	type_code type = B_ANY_TYPE;
+	switch (format) {
+		case media_raw_audio_format::B_AUDIO_FLOAT:
+			type = B_FLOAT_TYPE;
+			break;
+		case media_raw_audio_format::B_AUDIO_INT:
+			type = B_INT32_TYPE;
+			break;
+		case media_raw_audio_format::B_AUDIO_SHORT:
+			type = B_INT16_TYPE;
+			break;
+	}
+	if (type != B_ANY_TYPE)
+		swap_data(type, buffer, length, B_SWAP_ALWAYS);
+}
+
 // constructor
 AudioMixer::AudioMixer(const media_format& format)
 	: AudioReader(format),
 	  fSources(10),
-	  fVolumeFactor(1.0)
+	  fVolumeFactor(1.0),
+	  fSourceBuffer(NULL),
+	  fSourceBufferSize(0)
 {
 	// adjust the format according to our needs
 	fFormat.type = B_MEDIA_RAW_AUDIO;
@@ -72,6 +166,7 @@ AudioMixer::AudioMixer(const media_format& format)
 // destructor
 AudioMixer::~AudioMixer()
 {
+	free(fSourceBuffer);
 }
 
 // Read
@@ -87,74 +182,13 @@ ldebug("AudioMixer::Read(%p, %Ld, %Ld)\n", buffer, pos, frames);
 ldebug("AudioMixer::Read() done\n");
 		return B_OK;
 	}
-	// find out what's the maximum number of channels of our sources
-	uint32 maxChannels = 1;
-	for (int32 i = 0; AudioReader* source = SourceAt(i); i++) {
-		if (source->Format().u.raw_audio.channel_count > maxChannels)
-			maxChannels = source->Format().u.raw_audio.channel_count;
-	}
-	// alloc a buffer large enough to store the data of the source with
-	// the most channels
-	float* sourceData = new float[frames * maxChannels];
 	// read each source and cummulate the sum in the output buffer
 	uint32 outChannelCount = fFormat.u.raw_audio.channel_count;
 	uint32 cummulatedChannels = 0;
 	for (int32 i = 0; AudioReader* source = SourceAt(i); i++) {
-		if (source->Read(sourceData, pos, frames) == B_OK) {
-			float* outBuffer = (float*)buffer;
-			float* sourceBuffer = sourceData;
-			uint32 channelCount = source->Format().u.raw_audio.channel_count;
-			if (outChannelCount == 1) {
-				if (channelCount == 1) {
-					// one channel (mono)
-					for (int64 frame = 0; frame < frames; frame++) {
-						// center
-						*outBuffer += *sourceBuffer;
-						outBuffer++;
-						sourceBuffer++;
-					}
-				} else {
-					// more than one channel (at least stereo) -- consider
-					// the first two channels (left and right) only.
-					for (int64 frame = 0; frame < frames; frame++) {
-						// left and right
-						*outBuffer += (sourceBuffer[0] + sourceBuffer[1]) / 2;
-						outBuffer++;
-						sourceBuffer += channelCount;
-					}
-				}
-			} else if (outChannelCount == 2) {
-				if (channelCount == 1) {
-					// one channel (mono) -- add it to left and right
-					for (int64 frame = 0; frame < frames; frame++) {
-						// left
-						*outBuffer += *sourceBuffer;
-						outBuffer++;
-						// right
-						*outBuffer += *sourceBuffer;
-						outBuffer++;
-						sourceBuffer++;
-					}
-				} else {
-					// more than one channel (at least stereo) -- consider
-					// the first two channels (left and right) only.
-					uint32 skipChannels = channelCount - 1;
-					for (int64 frame = 0; frame < frames; frame++) {
-						// left
-						*outBuffer += *sourceBuffer;
-						outBuffer++;
-						sourceBuffer++;
-						// right
-						*outBuffer += *sourceBuffer;
-						outBuffer++;
-						sourceBuffer += skipChannels;
-					}
-				}
-			} // else: can't happen
+		if (_MixSource(source, (float*)buffer, pos, frames) == B_OK)
 			cummulatedChannels++;
-		}
 	}
-	delete[] sourceData;
 	// normalize the cummulated data and apply volume factor
 	float* outBuffer = (float*)buffer;
 	int64 samples = frames * outChannelCount;
@@ -232,3 +266,87 @@ AudioMixer::SetVolume(float percent)
 	fVolumeFactor = percent / 100.0;
 }
 
+// #pragma mark -
+
+// _MixSource
+status_t
+AudioMixer::_MixSource(AudioReader* source, float* buffer, int64 pos,
+	int64 frames)
+{
+	const media_raw_audio_format& format = source->Format().u.raw_audio;
+	if (source->Format().type != B_MEDIA_RAW_AUDIO
+		|| format.channel_count == 0) {
+		return B_BAD_VALUE;
+	}
+
+	// calculate position and frames in the source data
+	double sourceStep = (double)format.frame_rate
+		/ (double)fFormat.u.raw_audio.frame_rate;
+	int64 sourcePos = (int64)(pos * sourceStep);
+	int64 sourceFrames = (int64)((pos + frames) * sourceStep) - sourcePos;
+	if (sourceFrames <= 0)
+		return B_OK;
+	bool resample = sourceFrames != frames;
+	if (resample) {
+		// we need at least two frames to interpolate
+		sourceFrames += 2;
+	}
+
+	// the buffer for the source data only grows
+	size_t sampleSize = format.format
+		& media_raw_audio_format::B_AUDIO_SIZE_MASK;
+	size_t size = sourceFrames * format.channel_count * sampleSize;
+	if (size > fSourceBufferSize) {
+		void* sourceBuffer = realloc(fSourceBuffer, size);
+		if (!sourceBuffer)
+			return B_NO_MEMORY;
+		fSourceBuffer = sourceBuffer;
+		fSourceBufferSize = size;
+	}
+
+	float startGain;
+	float endGain;
+	status_t ret = source->ReadUnscaled(fSourceBuffer, sourcePos,
+		sourceFrames, &startGain, &endGain);
+	if (ret != B_OK)
+		return ret;
+	if (startGain == 0.0 && endGain == 0.0)
+		return B_OK;
+
+	uint32 hostByteOrder
+		= (B_HOST_IS_BENDIAN) ? B_MEDIA_BIG_ENDIAN : B_MEDIA_LITTLE_ENDIAN;
+	if (format.byte_order != hostByteOrder)
+		swap_sample_byte_order(fSourceBuffer, format.format, size);
+
+	uint32 outChannelCount = fFormat.u.raw_audio.channel_count;
+	switch (format.format) {
+		case media_raw_audio_format::B_AUDIO_FLOAT:
+			mix_source< FloatSampleBuffer<float> >(fSourceBuffer,
+				format.channel_count, resample, sourceStep, buffer,
+				outChannelCount, frames, startGain, endGain);
+			break;
+		case media_raw_audio_format::B_AUDIO_INT:
+			mix_source< IntSampleBuffer<float> >(fSourceBuffer,
+				format.channel_count, resample, sourceStep, buffer,
+				outChannelCount, frames, startGain, endGain);
+			break;
+		case media_raw_audio_format::B_AUDIO_SHORT:
+			mix_source< ShortSampleBuffer<float> >(fSourceBuffer,
+				format.channel_count, resample, sourceStep, buffer,
+				outChannelCount, frames, startGain, endGain);
+			break;
+		case media_raw_audio_format::B_AUDIO_UCHAR:
+			mix_source< UCharSampleBuffer<float> >(fSourceBuffer,
+				format.channel_count, resample, sourceStep, buffer,
+				outChannelCount, frames, startGain, endGain);
+			break;
+		case media_raw_audio_format::B_AUDIO_CHAR:
+			mix_source< CharSampleBuffer<float> >(fSourceBuffer,
+				format.channel_count, resample, sourceStep, buffer,
+				outChannelCount, frames, startGain, endGain);
+			break;
+		default:
+			return B_BAD_VALUE;
+	}
+	return B_OK;
+}
@@ -3,6 +3,11 @@
  * All Rights Reserved. Distributed under the terms of the MIT license.
  */
 
+// The AudioMixer sums up the audio of its sources. The sources can be in
+// any raw audio format and frame rate, they are converted, resampled,
+// scaled by the gain they report from ReadUnscaled() and added to the
+// output in one pass. The sources are not owned by the mixer.
+
 #ifndef AUDIO_MIXER_H
 #define AUDIO_MIXER_H
 
@@ -28,8 +33,14 @@ class AudioMixer : public AudioReader {
 			void				SetVolume(float percent);
 
  protected:
+			status_t			_MixSource(AudioReader* source, float* buffer,
+									int64 pos, int64 frames);
+
 			BList				fSources;
 			float				fVolumeFactor;
+
+			void*				fSourceBuffer;
+			size_t				fSourceBufferSize;
 };
 
 #endif	// AUDIO_MIXER_H
@@ -40,6 +40,21 @@ AudioReader::Format() const
 	return fFormat;
 }
 
+// ReadUnscaled
+//
+// Reads the frames like Read(), but leaves it to the caller to apply the
+// gain, which ramps linearly from _startGain to _endGain over the frames.
+// This allows the caller to apply it together with other processing. The
+// default implementation has no gain to apply.
+status_t
+AudioReader::ReadUnscaled(void* buffer, int64 pos, int64 frames,
+	float* _startGain, float* _endGain)
+{
+	*_startGain = 1.0;
+	*_endGain = 1.0;
+	return Read(buffer, pos, frames);
+}
+
 // SetOutOffset
 void
 AudioReader::SetOutOffset(int64 offset)
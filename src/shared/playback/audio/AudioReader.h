@@ -20,6 +20,9 @@ class AudioReader {
 
 	virtual	status_t			Read(void* buffer, int64 pos,
 									 int64 frames) = 0;
+	virtual	status_t			ReadUnscaled(void* buffer, int64 pos,
+									int64 frames, float* _startGain,
+									float* _endGain);
 
 			void				SetOutOffset(int64 offset);
 			int64				OutOffset() const;
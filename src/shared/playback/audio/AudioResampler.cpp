@@ -4,6 +4,7 @@
  */
 
 #include <algorithm>
+#include <stdlib.h>
 
 #include "AudioResampler.h"
 #include "SampleBuffer.h"
@@ -20,7 +21,9 @@ AudioResampler::AudioResampler(AudioReader* source, float frameRate,
 	: AudioReader(),
 	  fSource(source),
 	  fTimeScale(timeScale),
-	  fInOffset(0)
+	  fInOffset(0),
+	  fInBuffer(NULL),
+	  fInBufferSize(0)
 {
 	uint32 hostByteOrder
 		= (B_HOST_IS_BENDIAN) ? B_MEDIA_BIG_ENDIAN : B_MEDIA_LITTLE_ENDIAN;
@@ -35,6 +38,7 @@ AudioResampler::AudioResampler(AudioReader* source, float frameRate,
 // destructor
 AudioResampler::~AudioResampler()
 {
+	free(fInBuffer);
 }
 
 // Calculates the greatest common divider of /a/ and /b/.
@@ -121,9 +125,19 @@ ldebug("AudioResampler::Read() done3\n");
 
 	// we need at least two frames to interpolate
 	sourceFrames += 2;
-	int32 sampleSize = media_raw_audio_format::B_AUDIO_SIZE_MASK;
+	int32 sampleSize = fFormat.u.raw_audio.format
+		& media_raw_audio_format::B_AUDIO_SIZE_MASK;
 	uint32 channelCount = fFormat.u.raw_audio.channel_count;
-	char* inBuffer = new char[sourceFrames * channelCount * sampleSize];
+	// the buffer is kept for the next Read() and only grows
+	size_t size = sourceFrames * channelCount * sampleSize;
+	if (size > fInBufferSize) {
+		char* inBuffer = (char*)realloc(fInBuffer, size);
+		if (!inBuffer)
+			return B_NO_MEMORY;
+		fInBuffer = inBuffer;
+		fInBufferSize = size;
+	}
+	char* inBuffer = fInBuffer;
 	error = fSource->Read(inBuffer, sourcePos, sourceFrames);
 	if (error != B_OK)
 {
@@ -159,7 +173,6 @@ ldebug("AudioResampler::_ReadLinear() done4\n");
 	// reverse the frame order if reading backwards
 	if (backward)
 		ReverseFrames(buffer, frames);
-	delete[] inBuffer;
 ldebug("AudioResampler::Read() done\n");
 	return B_OK;
 }
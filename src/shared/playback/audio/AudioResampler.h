@@ -45,6 +45,9 @@ class AudioResampler : public AudioReader {
 			AudioReader*		fSource;
 			float				fTimeScale;	// speed
 			int64				fInOffset;
+
+			char*				fInBuffer;
+			size_t				fInBufferSize;
 };
 
 #endif	// AUDIO_RESAMPLER_H
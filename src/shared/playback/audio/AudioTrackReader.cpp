@@ -4,12 +4,14 @@
  */
 
 #include <algorithm>
+#include <new>
 #include <string.h>
 
 #include <MediaFile.h>
 #include <MediaTrack.h>
 
 #include "AudioTrackReader.h"
+#include "DecodedAudioCache.h"
 
 // debugging
 #include "Debug.h"
@@ -57,7 +59,10 @@ AudioTrackReader::AudioTrackReader(BMediaTrack* mediaTrack,
 	  fBuffers(10),
 	  fHasKeyFrames(false),
 	  fCountFrames(0),
-	  fReportSeekError(true)
+	  fReportSeekError(true),
+	  fBlockCache(NULL),
+	  fBlockCacheKey(),
+	  fBlock(NULL)
 {
 	_InitFromTrack();
 }
@@ -74,7 +79,10 @@ AudioTrackReader::AudioTrackReader(BMediaFile* mediaFile,
 	  fBuffers(10),
 	  fHasKeyFrames(false),
 	  fCountFrames(0),
-	  fReportSeekError(true)
+	  fReportSeekError(true),
+	  fBlockCache(NULL),
+	  fBlockCacheKey(),
+	  fBlock(NULL)
 {
 	_InitFromTrack();
 }
@@ -84,6 +92,7 @@ AudioTrackReader::~AudioTrackReader()
 {
 	_FreeBuffers();
 	delete[] fBuffer;
+	delete[] fBlock;
 
 	if (fMediaFile) {
 		// the track and file belong to us
@@ -115,6 +124,10 @@ ldebug("AudioTrackReader::Read() done\n");
 	}
 ldebug("  after eliminating the frames after the track end: %p, %Ld, %Ld\n",
 buffer, pos, frames);
+	if (fBlockCache && frames > 0) {
+		_ReadBlocks(buffer, pos, frames);
+		return B_OK;
+	}
 	// read the cached frames
 	bigtime_t time = system_time();
 	if (frames > 0)
@@ -218,6 +231,30 @@ AudioTrackReader::MediaTrack() const
 	return fMediaTrack;
 }
 
+// SetBlockCache
+void
+AudioTrackReader::SetBlockCache(DecodedAudioCache* cache, const char* key)
+{
+	if (cache && !fBlock && fMediaTrack) {
+		int64 sampleSize = fFormat.u.raw_audio.format
+			& media_raw_audio_format::B_AUDIO_SIZE_MASK;
+		int64 frameSize = sampleSize * fFormat.u.raw_audio.channel_count;
+		fBlock = new (std::nothrow) char[
+			DecodedAudioCache::BLOCK_FRAMES * frameSize];
+	}
+	if (!fBlock)
+		cache = NULL;
+
+	fBlockCache = cache;
+
+	// the decoded format is part of the key, it could be different
+	// for the same clip when decoded on another system
+	fBlockCacheKey = key;
+	fBlockCacheKey << "-" << fFormat.u.raw_audio.format
+		<< "-" << fFormat.u.raw_audio.channel_count
+		<< "-" << (int32)fFormat.u.raw_audio.frame_rate;
+}
+
 // #pragma mark -
 
 // _InitFromTrack
@@ -585,6 +622,51 @@ ldebug("  usable buffer found: %p\n", cacheBuffer);
 	return error;
 }
 
+// _ReadBlocks
+//
+// Reads the frames from the shared block cache. Blocks which are not
+// cached are decoded as a whole and added to the cache.
+void
+AudioTrackReader::_ReadBlocks(void* buffer, int64 position, int64 frames)
+{
+	int64 sampleSize = fFormat.u.raw_audio.format
+		& media_raw_audio_format::B_AUDIO_SIZE_MASK;
+	int64 frameSize = sampleSize * fFormat.u.raw_audio.channel_count;
+	int64 blockFrames = DecodedAudioCache::BLOCK_FRAMES;
+
+	while (frames > 0) {
+		int64 index = position / blockFrames;
+		int64 blockStart = index * blockFrames;
+		int64 blockSize = std::min(blockFrames, fCountFrames - blockStart);
+		int64 size = std::min(frames, blockStart + blockSize - position);
+		size_t offset = (position - blockStart) * frameSize;
+
+		if (!fBlockCache->ReadBlock(fBlockCacheKey.String(), index, buffer,
+				offset, size * frameSize)) {
+			void* block = fBlock;
+			int64 blockPosition = blockStart;
+			int64 blockFramesLeft = blockSize;
+			bigtime_t time = system_time();
+			_ReadCachedFrames(block, blockPosition, blockFramesLeft, time);
+			status_t error = B_OK;
+			if (blockFramesLeft > 0) {
+				error = _ReadUncachedFrames(block, blockPosition,
+					blockFramesLeft, time);
+			}
+			// don't share the silence of a failed read
+			if (error == B_OK) {
+				fBlockCache->AddBlock(fBlockCacheKey.String(), index, fBlock,
+					blockSize * frameSize);
+			}
+			memcpy(buffer, fBlock + offset, size * frameSize);
+		}
+
+		buffer = SkipFrames(buffer, size);
+		position += size;
+		frames -= size;
+	}
+}
+
 // _FindKeyFrameForward
 status_t
 AudioTrackReader::_FindKeyFrameForward(int64& position)
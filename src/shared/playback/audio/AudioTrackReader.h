@@ -6,11 +6,13 @@
 #define AUDIO_TRACK_READER_H
 
 #include <List.h>
+#include <String.h>
 
 #include "AudioReader.h"
 
 class BMediaFile;
 class BMediaTrack;
+class DecodedAudioCache;
 
 class AudioTrackReader : public AudioReader {
  public:
@@ -27,6 +29,11 @@ class AudioTrackReader : public AudioReader {
 
 			BMediaTrack*		MediaTrack() const;
 
+			// The decoded audio is shared through the cache with the other
+			// readers using the same key. Pass NULL to stop using it.
+			void				SetBlockCache(DecodedAudioCache* cache,
+									const char* key);
+
  private:
 			struct Buffer;
 			void				_InitFromTrack();
@@ -67,6 +74,9 @@ class AudioTrackReader : public AudioReader {
 									int64 position, int64 frames,
 									bigtime_t time);
 
+			void				_ReadBlocks(void* buffer, int64 position,
+									int64 frames);
+
 			status_t			_FindKeyFrameForward(int64& position);
 			status_t			_FindKeyFrameBackward(int64& position);
 			status_t			_SeekToKeyFrameForward(int64& position);
@@ -82,6 +92,10 @@ class AudioTrackReader : public AudioReader {
 			bool				fHasKeyFrames;
 			int64				fCountFrames;
 			bool				fReportSeekError;
+
+			DecodedAudioCache*	fBlockCache;
+			BString				fBlockCacheKey;
+			char*				fBlock;
 };
 
 #endif	// AUDIO_TRACK_READER_H
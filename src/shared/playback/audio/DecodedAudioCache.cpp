@@ -0,0 +1,177 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+#include "DecodedAudioCache.h"
+
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+
+#include "AutoLocker.h"
+
+using std::nothrow;
+
+DecodedAudioCache*
+DecodedAudioCache::sDefaultCache = NULL;
+
+// constructor
+DecodedAudioCache::DecodedAudioCache(size_t memoryLimit)
+	: fLock("decoded audio cache")
+	, fEntries()
+	, fLRU()
+	, fMemoryUsage(0)
+	, fMemoryLimit(memoryLimit)
+	, fHits(0)
+	, fMisses(0)
+{
+}
+
+// destructor
+DecodedAudioCache::~DecodedAudioCache()
+{
+	while (Entry* entry = fLRU.GetFirst())
+		_RemoveEntry(entry);
+}
+
+// InitCheck
+status_t
+DecodedAudioCache::InitCheck() const
+{
+	if (fLock.Sem() < B_OK)
+		return fLock.Sem();
+	return fEntries.InitCheck();
+}
+
+// CreateDefault
+DecodedAudioCache*
+DecodedAudioCache::CreateDefault()
+{
+	if (!sDefaultCache) {
+		sDefaultCache = new (nothrow) DecodedAudioCache();
+		if (sDefaultCache && sDefaultCache->InitCheck() != B_OK)
+			DeleteDefault();
+	}
+	return sDefaultCache;
+}
+
+// DeleteDefault
+void
+DecodedAudioCache::DeleteDefault()
+{
+	delete sDefaultCache;
+	sDefaultCache = NULL;
+}
+
+// Default
+DecodedAudioCache*
+DecodedAudioCache::Default()
+{
+	return sDefaultCache;
+}
+
+// ReadBlock
+bool
+DecodedAudioCache::ReadBlock(const char* key, int64 index, void* buffer,
+	size_t offset, size_t size)
+{
+	BString blockKey = _KeyFor(key, index);
+
+	AutoLocker<BLocker> locker(fLock);
+
+	Entry* entry = fEntries.Get(blockKey.String());
+	if (!entry || offset + size > entry->size) {
+		fMisses++;
+		return false;
+	}
+
+	// move the entry to the front of the LRU list
+	fLRU.Remove(entry);
+	fLRU.Insert(entry, false);
+
+	memcpy(buffer, (uint8*)entry->data + offset, size);
+	fHits++;
+	return true;
+}
+
+// AddBlock
+void
+DecodedAudioCache::AddBlock(const char* key, int64 index, const void* data,
+	size_t size)
+{
+	BString blockKey = _KeyFor(key, index);
+
+	void* copy = malloc(size);
+	if (!copy)
+		return;
+	memcpy(copy, data, size);
+
+	AutoLocker<BLocker> locker(fLock);
+
+	// another reader of the same clip may have been faster
+	if (fEntries.ContainsKey(blockKey.String())) {
+		free(copy);
+		return;
+	}
+
+	Entry* entry = new (nothrow) Entry;
+	if (!entry) {
+		free(copy);
+		return;
+	}
+
+	entry->key = blockKey;
+	entry->data = copy;
+	entry->size = size;
+	if (fEntries.Put(blockKey.String(), entry) < B_OK) {
+		free(copy);
+		delete entry;
+		return;
+	}
+
+	fLRU.Insert(entry, false);
+	fMemoryUsage += sizeof(Entry) + entry->key.Length() + size;
+
+	_Trim();
+}
+
+// GetStatistics
+void
+DecodedAudioCache::GetStatistics(int64* hits, int64* misses) const
+{
+	*hits = fHits;
+	*misses = fMisses;
+}
+
+// #pragma mark -
+
+// _KeyFor
+/*static*/ BString
+DecodedAudioCache::_KeyFor(const char* key, int64 index)
+{
+	BString blockKey(key);
+	blockKey << "-" << index;
+	return blockKey;
+}
+
+// _RemoveEntry
+void
+DecodedAudioCache::_RemoveEntry(Entry* entry)
+{
+	fEntries.Remove(entry->key.String());
+	fLRU.Remove(entry);
+	fMemoryUsage -= sizeof(Entry) + entry->key.Length() + entry->size;
+
+	free(entry->data);
+	delete entry;
+}
+
+// _Trim
+void
+DecodedAudioCache::_Trim()
+{
+	// always keep the most recently used block
+	while (fMemoryUsage > fMemoryLimit && fLRU.GetLast() != fLRU.GetFirst())
+		_RemoveEntry(fLRU.GetLast());
+}
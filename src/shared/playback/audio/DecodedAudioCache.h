@@ -0,0 +1,82 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+#ifndef DECODED_AUDIO_CACHE_H
+#define DECODED_AUDIO_CACHE_H
+
+#include <Locker.h>
+#include <String.h>
+
+#include "DLList.h"
+#include "HashMap.h"
+#include "HashString.h"
+
+// DecodedAudioCache
+//
+// Keeps blocks of decoded audio, so that clips which are used several times
+// in a playlist, or which are played again when scrubbing, don't need to be
+// decoded each time. The blocks are BLOCK_FRAMES long and aligned to
+// multiples of BLOCK_FRAMES, they are keyed by a string identifying the
+// clip and its decoded format, and the index of the block. The least
+// recently used blocks are dropped when the memory limit is exceeded.
+class DecodedAudioCache {
+ public:
+	enum {
+		DEFAULT_MEMORY_LIMIT	= 32 * 1024 * 1024,
+		BLOCK_FRAMES			= 8192
+	};
+
+								DecodedAudioCache(size_t memoryLimit
+									= DEFAULT_MEMORY_LIMIT);
+	virtual						~DecodedAudioCache();
+
+			status_t			InitCheck() const;
+
+	static	DecodedAudioCache*	CreateDefault();
+	static	void				DeleteDefault();
+	static	DecodedAudioCache*	Default();
+
+			// copies size bytes at offset within the block into buffer,
+			// returns false if the block is not cached
+			bool				ReadBlock(const char* key, int64 index,
+									void* buffer, size_t offset,
+									size_t size);
+			void				AddBlock(const char* key, int64 index,
+									const void* data, size_t size);
+
+			size_t				MemoryUsage() const
+									{ return fMemoryUsage; }
+			void				GetStatistics(int64* hits,
+									int64* misses) const;
+
+ private:
+			struct Entry : DLListLinkImpl<Entry> {
+				BString			key;
+				void*			data;
+				size_t			size;
+			};
+
+	typedef HashMap<HashString, Entry*> EntryMap;
+	typedef DLList<Entry> EntryList;
+
+	static	BString				_KeyFor(const char* key, int64 index);
+
+			void				_RemoveEntry(Entry* entry);
+			void				_Trim();
+
+			BLocker				fLock;
+			EntryMap			fEntries;
+			EntryList			fLRU;
+				// most recently used first
+			size_t				fMemoryUsage;
+			size_t				fMemoryLimit;
+
+			int64				fHits;
+			int64				fMisses;
+
+	static	DecodedAudioCache*	sDefaultCache;
+};
+
+#endif // DECODED_AUDIO_CACHE_H
@@ -0,0 +1,387 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+#include "LoudnessAnalyzer.h"
+
+#include <new>
+#include <math.h>
+#include <string.h>
+
+#include <Application.h>
+#include <Message.h>
+
+#include "common.h"
+
+#include "AudioConverter.h"
+#include "AudioReader.h"
+#include "AudioTrackReader.h"
+#include "AutoDeleter.h"
+#include "MediaClip.h"
+
+using std::nothrow;
+
+static const int64 kAnalyzeChunkFrames = 16384;
+
+// the mean square energy of a block at -70 LUFS
+static const double kAbsoluteGateEnergy = pow(10.0, (-70.0 + 0.691) / 10.0);
+// 10 LU below the loudness of the blocks above the absolute gate
+static const double kRelativeGateFactor = 0.1;
+
+const float LoudnessMeter::SILENCE = -70.0;
+
+// energy_to_loudness
+static inline float
+energy_to_loudness(double energy)
+{
+	return -0.691 + 10.0 * log10(energy);
+}
+
+// constructor
+LoudnessMeter::LoudnessMeter(float frameRate, uint32 channelCount)
+	: fChannelCount(channelCount)
+	, fShelfStates(NULL)
+	, fHighPassStates(NULL)
+	, fSubBlockFrames(max_c(1, (int32)(frameRate / 10)))
+	, fFramesInSubBlock(0)
+	, fSubBlockSum(0.0)
+	, fSubBlockEnergies(1024)
+	, fPeak(0.0)
+{
+	// The K-weighting filter of BS.1770, a high shelf modeling the
+	// acoustic effect of the head followed by a high pass. The
+	// coefficients are given for 48kHz in the recommendation, they are
+	// derived from the analog prototypes here to support any rate.
+	double k = tan(M_PI * 1681.974450955533 / frameRate);
+	double q = 0.7071752369554196;
+	double vh = pow(10.0, 3.999843853973347 / 20.0);
+	double vb = pow(vh, 0.4996667741545416);
+	double a0 = 1.0 + k / q + k * k;
+	fShelf.b0 = (vh + vb * k / q + k * k) / a0;
+	fShelf.b1 = 2.0 * (k * k - vh) / a0;
+	fShelf.b2 = (vh - vb * k / q + k * k) / a0;
+	fShelf.a1 = 2.0 * (k * k - 1.0) / a0;
+	fShelf.a2 = (1.0 - k / q + k * k) / a0;
+
+	k = tan(M_PI * 38.13547087602444 / frameRate);
+	q = 0.5003270373238773;
+	a0 = 1.0 + k / q + k * k;
+	fHighPass.b0 = 1.0;
+	fHighPass.b1 = -2.0;
+	fHighPass.b2 = 1.0;
+	fHighPass.a1 = 2.0 * (k * k - 1.0) / a0;
+	fHighPass.a2 = (1.0 - k / q + k * k) / a0;
+
+	fShelfStates = new (nothrow) FilterState[fChannelCount];
+	fHighPassStates = new (nothrow) FilterState[fChannelCount];
+	if (fShelfStates && fHighPassStates) {
+		memset(fShelfStates, 0, fChannelCount * sizeof(FilterState));
+		memset(fHighPassStates, 0, fChannelCount * sizeof(FilterState));
+	}
+}
+
+// destructor
+LoudnessMeter::~LoudnessMeter()
+{
+	delete[] fShelfStates;
+	delete[] fHighPassStates;
+}
+
+// InitCheck
+status_t
+LoudnessMeter::InitCheck() const
+{
+	if (fChannelCount == 0)
+		return B_BAD_VALUE;
+	if (!fShelfStates || !fHighPassStates)
+		return B_NO_MEMORY;
+	return B_OK;
+}
+
+// AddSamples
+void
+LoudnessMeter::AddSamples(const float* samples, int32 frames)
+{
+	for (int32 i = 0; i < frames; i++) {
+		for (uint32 c = 0; c < fChannelCount; c++) {
+			float sample = *samples++;
+			if (fabs(sample) > fPeak)
+				fPeak = fabs(sample);
+
+			double weighted = _Filter(fShelf, fShelfStates[c], sample);
+			weighted = _Filter(fHighPass, fHighPassStates[c], weighted);
+			fSubBlockSum += weighted * weighted;
+		}
+
+		if (++fFramesInSubBlock == fSubBlockFrames) {
+			// a partial sub-block at the end is ignored
+			fSubBlockEnergies.PushBack(fSubBlockSum / fSubBlockFrames);
+			fFramesInSubBlock = 0;
+			fSubBlockSum = 0.0;
+		}
+	}
+}
+
+// IntegratedLoudness
+float
+LoudnessMeter::IntegratedLoudness() const
+{
+	// each block consists of four sub-blocks of 100ms
+	int32 blockCount = fSubBlockEnergies.Count() - 3;
+	if (blockCount <= 0)
+		return SILENCE;
+
+	double* energies = new (nothrow) double[blockCount];
+	if (!energies)
+		return SILENCE;
+	ArrayDeleter<double> energiesDeleter(energies);
+
+	double sum = 0.0;
+	int32 count = 0;
+	for (int32 i = 0; i < blockCount; i++) {
+		energies[i] = (fSubBlockEnergies.ElementAt(i)
+			+ fSubBlockEnergies.ElementAt(i + 1)
+			+ fSubBlockEnergies.ElementAt(i + 2)
+			+ fSubBlockEnergies.ElementAt(i + 3)) / 4.0;
+		if (energies[i] > kAbsoluteGateEnergy) {
+			sum += energies[i];
+			count++;
+		}
+	}
+	if (count == 0)
+		return SILENCE;
+
+	double relativeGateEnergy = sum / count * kRelativeGateFactor;
+	double gateEnergy = max_c(kAbsoluteGateEnergy, relativeGateEnergy);
+
+	sum = 0.0;
+	count = 0;
+	for (int32 i = 0; i < blockCount; i++) {
+		if (energies[i] > gateEnergy) {
+			sum += energies[i];
+			count++;
+		}
+	}
+	if (count == 0)
+		return SILENCE;
+
+	return energy_to_loudness(sum / count);
+}
+
+// _Filter
+/*static*/ inline double
+LoudnessMeter::_Filter(const Biquad& biquad, FilterState& state,
+	double sample)
+{
+	double result = biquad.b0 * sample + biquad.b1 * state.x1
+		+ biquad.b2 * state.x2 - biquad.a1 * state.y1 - biquad.a2 * state.y2;
+	state.x2 = state.x1;
+	state.x1 = sample;
+	state.y2 = state.y1;
+	state.y1 = result;
+	return result;
+}
+
+// #pragma mark -
+
+// constructor
+LoudnessAnalyzer::LoudnessAnalyzer()
+	: fJobs("loudness jobs")
+	, fAnalyzer(-1)
+	, fStatus(B_NO_INIT)
+{
+	fStatus = fJobs.InitCheck();
+	if (fStatus < B_OK)
+		return;
+
+	fAnalyzer = spawn_thread(_AnalyzerEntry, "loudness analyzer",
+		B_LOW_PRIORITY, this);
+	if (fAnalyzer >= B_OK) {
+		fStatus = B_OK;
+		resume_thread(fAnalyzer);
+	} else
+		fStatus = fAnalyzer;
+}
+
+// destructor
+LoudnessAnalyzer::~LoudnessAnalyzer()
+{
+	const Vector<Job*>* jobs = NULL;
+	if (fJobs.Close(false, &jobs) == B_OK && jobs) {
+		int32 count = jobs->Count();
+		for (int32 i = 0; i < count; i++) {
+			Job* job = jobs->ElementAt(i);
+			job->clip->Release();
+			delete job;
+		}
+	}
+	if (fAnalyzer >= B_OK) {
+		status_t dummy;
+		wait_for_thread(fAnalyzer, &dummy);
+	}
+}
+
+// InitCheck
+status_t
+LoudnessAnalyzer::InitCheck() const
+{
+	return fStatus;
+}
+
+// CreateDefault
+LoudnessAnalyzer*
+LoudnessAnalyzer::CreateDefault()
+{
+	if (!sDefaultAnalyzer) {
+		sDefaultAnalyzer = new (nothrow) LoudnessAnalyzer();
+		if (sDefaultAnalyzer && sDefaultAnalyzer->InitCheck() != B_OK)
+			DeleteDefault();
+	}
+	return sDefaultAnalyzer;
+}
+
+// DeleteDefault
+void
+LoudnessAnalyzer::DeleteDefault()
+{
+	delete sDefaultAnalyzer;
+	sDefaultAnalyzer = NULL;
+}
+
+// Default
+LoudnessAnalyzer*
+LoudnessAnalyzer::Default()
+{
+	return sDefaultAnalyzer;
+}
+
+// Analyze
+status_t
+LoudnessAnalyzer::Analyze(MediaClip* clip, uint32 changeToken)
+{
+	if (!clip || !clip->HasAudio())
+		return B_BAD_VALUE;
+
+	Job* job = new (nothrow) Job;
+	if (!job)
+		return B_NO_MEMORY;
+	job->clip = clip;
+	job->changeToken = changeToken;
+
+	clip->Acquire();
+	status_t ret = fJobs.Push(job);
+	if (ret < B_OK) {
+		clip->Release();
+		delete job;
+	}
+	return ret;
+}
+
+// #pragma mark -
+
+// _AnalyzerEntry
+int32
+LoudnessAnalyzer::_AnalyzerEntry(void* cookie)
+{
+	return ((LoudnessAnalyzer*)cookie)->_Analyzer();
+}
+
+// _Analyzer
+int32
+LoudnessAnalyzer::_Analyzer()
+{
+	while (true) {
+		Job* job;
+		status_t ret = fJobs.Pop(&job);
+		if (ret == B_INTERRUPTED)
+			continue;
+		if (ret < B_OK) {
+			// the queue has been closed
+			break;
+		}
+
+		MediaClip* clip = job->clip;
+		uint32 changeToken = job->changeToken;
+		delete job;
+
+		// the result is not handed to the clip from this thread, since
+		// the clip may be reloaded meanwhile and storing it writes the
+		// attributes of the clip file, the message passes the reference
+		float peak;
+		float loudness;
+		if (_Measure(clip, &peak, &loudness) == B_OK && be_app) {
+			BMessage message(MSG_AUDIO_LOUDNESS_MEASURED);
+			if (message.AddPointer("clip", clip) == B_OK
+				&& message.AddFloat("peak", peak) == B_OK
+				&& message.AddFloat("loudness", loudness) == B_OK
+				&& message.AddInt32("change token", changeToken) == B_OK
+				&& be_app_messenger.SendMessage(&message) == B_OK) {
+				continue;
+			}
+		}
+
+		clip->Release();
+	}
+
+	return B_OK;
+}
+
+// _Measure
+/*static*/ status_t
+LoudnessAnalyzer::_Measure(MediaClip* clip, float* _peak, float* _loudness)
+{
+	AudioReader* reader = clip->CreateAudioReader();
+	if (!reader)
+		return B_NO_MEMORY;
+	ObjectDeleter<AudioReader> readerDeleter(reader);
+
+	// the whole clip is read only once, it would just push
+	// the blocks which are being played out of the cache
+	if (AudioTrackReader* trackReader = dynamic_cast<AudioTrackReader*>(reader))
+		trackReader->SetBlockCache(NULL, "");
+
+	uint32 hostByteOrder
+		= B_HOST_IS_BENDIAN ? B_MEDIA_BIG_ENDIAN : B_MEDIA_LITTLE_ENDIAN;
+	AudioConverter converter(reader, media_raw_audio_format::B_AUDIO_FLOAT,
+		hostByteOrder);
+	status_t ret = converter.InitCheck();
+	if (ret < B_OK)
+		return ret;
+
+	const media_raw_audio_format& format = converter.Format().u.raw_audio;
+	uint32 channels = max_c(1, format.channel_count);
+	int64 frameCount = clip->AudioFrameCount();
+
+	LoudnessMeter meter(format.frame_rate, channels);
+	ret = meter.InitCheck();
+	if (ret < B_OK)
+		return ret;
+
+	float* buffer = new (nothrow) float[kAnalyzeChunkFrames * channels];
+	if (!buffer)
+		return B_NO_MEMORY;
+	ArrayDeleter<float> bufferDeleter(buffer);
+
+	for (int64 frame = 0; frame < frameCount; frame += kAnalyzeChunkFrames) {
+		int64 frames = min_c(kAnalyzeChunkFrames, frameCount - frame);
+		ret = converter.Read(buffer, frame, frames);
+		if (ret < B_OK) {
+			// a partial measurement would be misleading
+			print_error("LoudnessAnalyzer::_Measure() - failed to read "
+				"frames of clip '%s', stopped at frame %lld\n",
+				clip->Name().String(), frame);
+			return ret;
+		}
+		meter.AddSamples(buffer, frames);
+	}
+
+	*_peak = meter.Peak();
+	*_loudness = meter.IntegratedLoudness();
+	return B_OK;
+}
+
+// static variables
+
+// sDefaultAnalyzer
+LoudnessAnalyzer* LoudnessAnalyzer::sDefaultAnalyzer = NULL;
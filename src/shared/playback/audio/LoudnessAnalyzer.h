@@ -0,0 +1,114 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+#ifndef LOUDNESS_ANALYZER_H
+#define LOUDNESS_ANALYZER_H
+
+#include <OS.h>
+
+#include "BlockingQueue.h"
+#include "Vector.h"
+
+class MediaClip;
+
+enum {
+	MSG_AUDIO_LOUDNESS_MEASURED	= 'alms'
+};
+
+// LoudnessMeter
+//
+// Measures the sample peak and the integrated loudness of audio in the
+// way of ITU-R BS.1770 and EBU R128: the samples are K-weighted, the mean
+// square is taken over blocks of 400ms overlapping by 300ms, and blocks
+// below -70 LUFS as well as blocks more than 10 LU below the loudness of
+// the remaining blocks are ignored. All channels are weighted equally.
+class LoudnessMeter {
+ public:
+								LoudnessMeter(float frameRate,
+									uint32 channelCount);
+	virtual						~LoudnessMeter();
+
+			status_t			InitCheck() const;
+
+			void				AddSamples(const float* samples,
+									int32 frames);
+
+			// the linear peak of all samples
+			float				Peak() const
+									{ return fPeak; }
+			// in LUFS, SILENCE if there is no block above the gates
+			float				IntegratedLoudness() const;
+
+	static	const float			SILENCE;
+
+ private:
+			struct Biquad {
+				double			b0, b1, b2;
+				double			a1, a2;
+			};
+			struct FilterState {
+				double			x1, x2;
+				double			y1, y2;
+			};
+
+	static	double				_Filter(const Biquad& biquad,
+									FilterState& state, double sample);
+
+			uint32				fChannelCount;
+			Biquad				fShelf;
+			Biquad				fHighPass;
+			FilterState*		fShelfStates;
+			FilterState*		fHighPassStates;
+
+			int32				fSubBlockFrames;
+			int32				fFramesInSubBlock;
+			double				fSubBlockSum;
+			Vector<double>		fSubBlockEnergies;
+
+			float				fPeak;
+};
+
+// LoudnessAnalyzer
+//
+// Measures the loudness of MediaClips on a background thread. The result
+// is posted to the application as a MSG_AUDIO_LOUDNESS_MEASURED message
+// ("clip" pointer holding a reference, "peak", "loudness" and the
+// "change token" of the clip when the job was queued), which hands it to
+// the clip with the document locked. The clip stores it with its
+// archive, so that every clip needs to be analyzed only once.
+class LoudnessAnalyzer {
+ public:
+								LoudnessAnalyzer();
+	virtual						~LoudnessAnalyzer();
+
+			status_t			InitCheck() const;
+
+	static	LoudnessAnalyzer*	CreateDefault();
+	static	void				DeleteDefault();
+	static	LoudnessAnalyzer*	Default();
+
+			status_t			Analyze(MediaClip* clip,
+									uint32 changeToken);
+
+ private:
+			struct Job {
+				MediaClip*		clip;
+				uint32			changeToken;
+			};
+
+	static	int32				_AnalyzerEntry(void* cookie);
+			int32				_Analyzer();
+
+	static	status_t			_Measure(MediaClip* clip, float* _peak,
+									float* _loudness);
+
+			BlockingQueue<Job>	fJobs;
+			thread_id			fAnalyzer;
+			status_t			fStatus;
+
+	static	LoudnessAnalyzer*	sDefaultAnalyzer;
+};
+
+#endif // LOUDNESS_ANALYZER_H
@@ -15,6 +15,8 @@
 #include "ClipPlaylistItem.h"
 #include "Observer.h"
 #include "Playlist.h"
+#include "PlaylistItemAudioReader.h"
+#include "PlaylistSnapshot.h"
 #include "RWLocker.h"
 
 // debugging
@@ -27,9 +29,12 @@
 
 // SoundItem
 
+// The item belongs to a PlaylistSnapshot, the key is the original item in
+// the document, which stays the same across snapshots.
+
 class SoundItem : public Observer {
  public:
-	SoundItem(PlaylistItem* item, int64 offset);
+	SoundItem(PlaylistItem* item, const PlaylistItem* key, int64 offset);
 	virtual ~SoundItem();
 
 	virtual void ObjectChanged(const Observable* object);
@@ -37,13 +42,13 @@ class SoundItem : public Observer {
 
 	inline bool operator==(const SoundItem& other) const
 	{
-		return (item == other.item && offset == other.offset);
+		return (key == other.key && offset == other.offset);
 	}
 
 	inline bool operator<(const SoundItem& other) const
 	{
-		return ((addr_t)item < (addr_t)other.item
-			|| ((addr_t)item == (addr_t)other.item && offset < other.offset));
+		return ((addr_t)key < (addr_t)other.key
+			|| ((addr_t)key == (addr_t)other.key && offset < other.offset));
 	}
 
 	inline bool operator>(const SoundItem& other) const
@@ -52,12 +57,14 @@ class SoundItem : public Observer {
 	}
 
 	PlaylistItem*		item;
+	const PlaylistItem*	key;
 	int64				offset;
 };
 
 
-SoundItem::SoundItem(PlaylistItem* item, int64 offset)
-	: item(item), offset(offset)
+SoundItem::SoundItem(PlaylistItem* item, const PlaylistItem* key,
+		int64 offset)
+	: item(item), key(key), offset(offset)
 {
 	if (item)
 		item->AddObserver(this);
@@ -105,6 +112,7 @@ PlaylistAudioReader::PlaylistAudioReader(Playlist* playlist,
 	: AudioReader(format),
 	  fPlaylist(playlist),
 	  fLocker(locker),
+	  fSnapshot(NULL),
 	  fVideoFrameRate(videoFrameRate),
 	  fSoundItems(10),
 	  fAudioReaders(10),
@@ -126,12 +134,7 @@ PlaylistAudioReader::PlaylistAudioReader(Playlist* playlist,
 PlaylistAudioReader::~PlaylistAudioReader()
 {
 	delete fAdapter;
-	// empty the audio mixer's sources list (delete the adapters)
-	if (fMixer) {
-		while (AudioReader* reader = fMixer->RemoveSource(0))
-			delete reader;
-		delete fMixer;
-	}
+	delete fMixer;
 	// delete SoundItems
 	for (int32 i = 0;
 		 SoundItem* item = (SoundItem*)fSoundItems.ItemAt(i);
@@ -144,6 +147,7 @@ PlaylistAudioReader::~PlaylistAudioReader()
 		 i++) {
 		delete reader;
 	}
+	PlaylistSnapshot::ReleaseSnapshot(&fSnapshot, fLocker);
 }
 
 // Read
@@ -164,11 +168,15 @@ ldebug("PlaylistAudioReader::Read() done\n");
 	int64 sampleSize = fFormat.u.raw_audio.format 
 		& media_raw_audio_format::B_AUDIO_SIZE_MASK;
 	int64 frameSize = sampleSize * fFormat.u.raw_audio.channel_count;
-	// read lock the document
-	AutoReadLocker locker(fLocker);
-	if (fLocker && !locker.IsLocked()) {
-		ldebug("PlaylistAudioReader: locking the RWLocker failed\n");
-		return B_ERROR;
+	// Take a new snapshot of the playlist, if the document has been changed.
+	// The lock is not needed for mixing from the snapshot, and the audio
+	// must not wait for a writer, so while the document is write locked,
+	// we simply keep using the previous snapshot.
+	if (!fLocker || fLocker->ReadLockWithTimeout(0) == B_OK) {
+		PlaylistSnapshot::Update(&fSnapshot, fPlaylist, fLocker,
+			MAX_RECURSION_LEVEL);
+		if (fLocker)
+			fLocker->ReadUnlock();
 	}
 	// get the video frame at which we have to start
 	int64 videoFrame = VideoFrameForAudioFrame(pos);
@@ -183,18 +191,17 @@ videoFrame, nextAudioFrame, framesToRead);
 		// Each video frame we create a new SoundItem list and compare
 		// it to the old one to find out which of the AudioTrackReaders
 		// can be reused.
-		// empty the audio mixer's sources list (delete the adapters)
-		while (AudioReader* reader = fMixer->RemoveSource(0))
-			delete reader;
+		// empty the audio mixer's sources list
+		while (fMixer->RemoveSource(0))
+			;
 		// get the Playlist's sound items at the current video frame
 		BList oldSoundItems(fSoundItems);
 		BList oldAudioReaders(fAudioReaders);
 		fSoundItems.MakeEmpty();
 		fAudioReaders.MakeEmpty();
 
-		// NOTE: maybe copy playlist in case this takes too long
-		if (fPlaylist)
-			_GetActiveItemsAtFrame(fPlaylist, videoFrame, 0, 0);
+		if (fPlaylist && fSnapshot)
+			_GetActiveItemsAtFrame(fSnapshot, videoFrame, 0, 0);
 
 		// sort the new list
 		fSoundItems.SortItems(&compare_sound_items);
@@ -223,18 +230,25 @@ reader->InitCheck());
 				}
 				k++;
 			} else {
-				// reuse the old reader
-ldebug("  reuse old reader: %p\n", oldAudioReaders.ItemAt(i));
-				fAudioReaders.AddItem(oldAudioReaders.ItemAt(i));
+				// reuse the old reader, the item may be from a newer
+				// snapshot now
+				AudioReader* reader = (AudioReader*)oldAudioReaders.ItemAt(i);
+ldebug("  reuse old reader: %p\n", reader);
+				if (PlaylistItemAudioReader* itemReader
+						= dynamic_cast<PlaylistItemAudioReader*>(reader)) {
+					itemReader->SetItem(newItem->item);
+				}
+				fAudioReaders.AddItem(reader);
 				oldItem->Release();
 				i++; k++;
 			}
 		}
-		// add the readers to the mixer's sources
+		// add the readers to the mixer's sources, the mixer converts
+		// their format and frame rate while mixing
 		for (int32 i = 0;
 			 AudioReader* reader = (AudioReader*)fAudioReaders.ItemAt(i);
 			 i++) {
-			fMixer->AddSource(new AudioAdapter(reader, fMixer->Format()));
+			fMixer->AddSource(reader);
 		}
 		// finally read from the mixer
 ldebug("  fAdapter->Read(%p, %Ld, %Ld)\n", buffer, pos, framesToRead);
@@ -301,12 +315,13 @@ PlaylistAudioReader::SetVolume(float percent)
 
 // _GetActiveItemsAtFrame
 void
-PlaylistAudioReader::_GetActiveItemsAtFrame(Playlist* playlist,
+PlaylistAudioReader::_GetActiveItemsAtFrame(PlaylistSnapshot* snapshot,
 	int64 videoFrame, int64 levelZeroOffset, int32 recursionLevel)
 {
 	if (recursionLevel > MAX_RECURSION_LEVEL)
 		return;
 
+	Playlist* playlist = snapshot->Playlist();
 	int32 count = playlist->CountItems();
 	for (int32 i = 0; i < count; i++) {
 		ClipPlaylistItem* item
@@ -317,26 +332,23 @@ PlaylistAudioReader::_GetActiveItemsAtFrame(Playlist* playlist,
 			|| !playlist->IsTrackEnabled(item->Track())
 			|| item->IsAudioMuted())
 			continue;
-		
-		Clip* clip = item->Clip();
-		clip->Acquire();
 
 		int64 startFrameWithOffset = item->StartFrame() - item->ClipOffset();
-		if (Playlist* subPlaylist = dynamic_cast<Playlist*>(clip)) {
+		if (PlaylistSnapshot* subPlaylist = snapshot->SubPlaylistAt(i)) {
 			// recurse into sub playlist
 			int64 subVideoFrame = videoFrame - startFrameWithOffset;
 			int64 subLevelOffset = levelZeroOffset + startFrameWithOffset;
 			_GetActiveItemsAtFrame(subPlaylist, subVideoFrame, subLevelOffset,
 				recursionLevel + 1);
-		} else if (item->HasAudio()) {
+		} else if (dynamic_cast<Playlist*>(item->Clip()) == NULL
+			&& item->HasAudio()) {
 			// add a sound item for this clip
 			int64 offset = AudioFrameForVideoFrame(
 				startFrameWithOffset + levelZeroOffset);
-			SoundItem* soundItem = new (std::nothrow) SoundItem(item, offset);
+			SoundItem* soundItem = new (std::nothrow) SoundItem(item,
+				snapshot->OriginalItemAt(i), offset);
 			if (soundItem)
 				fSoundItems.AddItem(soundItem);
 		}
-
-		clip->Release();
 	}
 }
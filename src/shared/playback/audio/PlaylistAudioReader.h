@@ -17,6 +17,7 @@ class AudioAdapter;
 class AudioMixer;
 class SoundRegistry;
 class Playlist;
+class PlaylistSnapshot;
 class RWLocker;
 
 class PlaylistAudioReader : public AudioReader {
@@ -40,12 +41,14 @@ class PlaylistAudioReader : public AudioReader {
 			void				SetVolume(float percent);
 
  protected:
-			void				_GetActiveItemsAtFrame(Playlist* playlist,
+			void				_GetActiveItemsAtFrame(
+									PlaylistSnapshot* snapshot,
 									int64 videoFrame, int64 levelZeroOffset,
 									int32 recursionLevel);
 
 			Playlist*			fPlaylist;
 			RWLocker*			fLocker;
+			PlaylistSnapshot*	fSnapshot;
 			float				fVideoFrameRate;
 			BList				fSoundItems;
 			BList				fAudioReaders;
@@ -13,6 +13,8 @@
 #include "PlaybackManagerInterface.h"
 #include "Playlist.h"
 #include "PlaylistAudioReader.h"
+#include "RWLocker.h"
+#include "ReadAheadAudioReader.h"
 
 // debugging
 #include "Debug.h"
@@ -46,7 +48,10 @@ PlaylistAudioSupplier::PlaylistAudioSupplier(Playlist* playlist,
 	  fLocker(locker),
 	  fPlaybackManager(playbackManager),
 	  fAudioReader(NULL),
+	  fReadAheadReader(NULL),
 	  fAudioResampler(NULL),
+	  fReadAheadTime(0),
+	  fWriteGeneration(0),
 	  fVideoFrameRate(videoFrameRate)
 {
 	SetPlaylist(playlist);
@@ -57,8 +62,9 @@ PlaylistAudioSupplier::~PlaylistAudioSupplier()
 {
 	SetPlaylist(NULL);
 
-	delete fAudioReader;
 	delete fAudioResampler;
+	delete fReadAheadReader;
+	delete fAudioReader;
 }
 
 // GetFrames
@@ -98,6 +104,14 @@ buffer, frameCount, startTime, endTime);
 		ldebug("  PlaylistAudioSupplier: LOCKING THE PLAYBACK MANAGER TIMED "
 			   "OUT!!!\n");
 	}
+	// Drop the audio decoded ahead if the playlist has been edited.
+	if (fReadAheadReader && fLocker) {
+		int32 writeGeneration = fLocker->WriteGeneration();
+		if (writeGeneration != fWriteGeneration) {
+			fWriteGeneration = writeGeneration;
+			fReadAheadReader->Invalidate();
+		}
+	}
 	// Retrieve the audio data for each interval.
 	int64 framesRead = 0;
 	while (!playingIntervals.IsEmpty()) {
@@ -154,11 +168,28 @@ ldebug("PlaylistAudioSupplier::GetFrames() done\n");
 void
 PlaylistAudioSupplier::SetFormat(const media_format& format)
 {
-	delete fAudioReader;
 	delete fAudioResampler;
+	delete fReadAheadReader;
+	delete fAudioReader;
+	fReadAheadReader = NULL;
 	fAudioReader = new (nothrow) PlaylistAudioReader(fPlaylist, fLocker,
 		format, fVideoFrameRate);
-	fAudioResampler = new (nothrow) AudioResampler(fAudioReader,
+
+	AudioReader* source = fAudioReader;
+	if (fAudioReader && fReadAheadTime > 0) {
+		fReadAheadReader = new (nothrow) ReadAheadAudioReader(fAudioReader,
+			fReadAheadTime);
+		if (fReadAheadReader && fReadAheadReader->InitCheck() == B_OK) {
+			source = fReadAheadReader;
+			if (fLocker)
+				fWriteGeneration = fLocker->WriteGeneration();
+		} else {
+			// fall back to reading synchronously
+			delete fReadAheadReader;
+			fReadAheadReader = NULL;
+		}
+	}
+	fAudioResampler = new (nothrow) AudioResampler(source,
 		format.u.raw_audio.frame_rate, 1.0);
 }
 
@@ -192,8 +223,15 @@ PlaylistAudioSupplier::SetPlaylist(Playlist* playlist)
 	if (fPlaylist)
 		fPlaylist->Acquire();
 
-	if (fAudioReader)
-		fAudioReader->SetPlaylist(fPlaylist);
+	if (fAudioReader) {
+		// the read ahead worker may be reading the playlist right now
+		if (fReadAheadReader && fReadAheadReader->LockSource()) {
+			fAudioReader->SetPlaylist(fPlaylist);
+			fReadAheadReader->UnlockSource();
+			fReadAheadReader->Invalidate();
+		} else
+			fAudioReader->SetPlaylist(fPlaylist);
+	}
 	if (oldList)
 		oldList->Release();
 }
@@ -202,7 +240,19 @@ PlaylistAudioSupplier::SetPlaylist(Playlist* playlist)
 void
 PlaylistAudioSupplier::SetVolume(float percent)
 {
-	fAudioReader->SetVolume(percent);
+	if (fReadAheadReader && fReadAheadReader->LockSource()) {
+		fAudioReader->SetVolume(percent);
+		fReadAheadReader->UnlockSource();
+		fReadAheadReader->Invalidate();
+	} else
+		fAudioReader->SetVolume(percent);
+}
+
+// SetReadAheadTime
+void
+PlaylistAudioSupplier::SetReadAheadTime(bigtime_t readAheadTime)
+{
+	fReadAheadTime = readAheadTime;
 }
 
 // AudioFrameForVideoFrame
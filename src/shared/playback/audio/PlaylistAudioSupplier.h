@@ -8,6 +8,7 @@
 #define PLAYLIST_AUDIO_SUPPLIER_H
 
 #include <List.h>
+#include <OS.h>
 
 #include "AudioSupplier.h"
 
@@ -15,6 +16,7 @@ class AudioResampler;
 class PlaybackManagerInterface;
 class PlaylistAudioReader;
 class Playlist;
+class ReadAheadAudioReader;
 class RWLocker;
 
 class PlaylistAudioSupplier : public AudioSupplier {
@@ -42,6 +44,10 @@ class PlaylistAudioSupplier : public AudioSupplier {
 
 			void				SetVolume(float percent);
 
+			// decodes the playlist audio this far ahead in a separate
+			// thread, 0 turns it off, takes effect with the next SetFormat()
+			void				SetReadAheadTime(bigtime_t readAheadTime);
+
  private:
 			void				_ReadSilence(void* buffer, int64 frames) const;
 
@@ -54,7 +60,10 @@ class PlaylistAudioSupplier : public AudioSupplier {
 			RWLocker*			fLocker;
 			PlaybackManagerInterface* fPlaybackManager;
 			PlaylistAudioReader* fAudioReader;
+			ReadAheadAudioReader* fReadAheadReader;
 			AudioResampler*		fAudioResampler;
+			bigtime_t			fReadAheadTime;
+			int32				fWriteGeneration;
 			float				fVideoFrameRate;
 };
 
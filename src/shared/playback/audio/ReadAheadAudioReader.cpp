@@ -0,0 +1,282 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+#include "ReadAheadAudioReader.h"
+
+#include <algorithm>
+#include <new>
+#include <string.h>
+
+using std::nothrow;
+
+// The ring is indexed by frame counts which are only ever increased, the
+// offset into the ring is the index modulo the capacity. The frames between
+// fReadIndex and fWriteIndex are ready to be read. When the consumer needs
+// the worker to start over at another position, it increases the requested
+// generation. The worker then drops what it has written so far and
+// publishes the new start index and position along with the generation.
+// The consumer only touches the ring while it is at the generation the
+// consumer requested last.
+
+static const bigtime_t kWorkerPollTimeout = 10000;
+
+// constructor
+ReadAheadAudioReader::ReadAheadAudioReader(AudioReader* source,
+		bigtime_t readAheadTime)
+	: AudioReader(),
+	  fSource(source),
+	  fSourceLock("read ahead source"),
+	  fRing(NULL),
+	  fCapacity(0),
+	  fChunkFrames(0),
+	  fFrameSize(0),
+
+	  fReadIndex(0),
+	  fRequestedGeneration(0),
+	  fRequestedPosition(0),
+	  fGeneration(0),
+
+	  fWriteIndex(0),
+	  fRingGeneration(-1),
+	  fStartIndex(0),
+	  fStartPosition(0),
+
+	  fInvalidated(0),
+	  fWorkerWaiting(0),
+	  fWakeUpSem(-1),
+	  fWorker(-1),
+	  fQuitting(false)
+{
+	memset(&fStatistics, 0, sizeof(read_ahead_statistics));
+
+	if (!fSource || fSource->InitCheck() < B_OK)
+		return;
+
+	fFormat = fSource->Format();
+	int32 sampleSize = fFormat.u.raw_audio.format
+		& media_raw_audio_format::B_AUDIO_SIZE_MASK;
+	fFrameSize = sampleSize * fFormat.u.raw_audio.channel_count;
+
+	// the worker reads the source in chunks of an eighth of the ring
+	fCapacity = std::max(FrameForTime(readAheadTime), (int64)8);
+	fChunkFrames = fCapacity / 8;
+
+	fRing = new (nothrow) char[fCapacity * fFrameSize];
+	if (!fRing)
+		return;
+
+	fWakeUpSem = create_sem(0, "read ahead wake up");
+	if (fWakeUpSem < B_OK)
+		return;
+
+	fWorker = spawn_thread(_WorkerEntry, "audio read ahead",
+		B_URGENT_DISPLAY_PRIORITY, this);
+	if (fWorker >= B_OK)
+		resume_thread(fWorker);
+}
+
+// destructor
+ReadAheadAudioReader::~ReadAheadAudioReader()
+{
+	fQuitting = true;
+	if (fWakeUpSem >= B_OK)
+		delete_sem(fWakeUpSem);
+	if (fWorker >= B_OK) {
+		status_t ret;
+		wait_for_thread(fWorker, &ret);
+	}
+	delete[] fRing;
+}
+
+// InitCheck
+status_t
+ReadAheadAudioReader::InitCheck() const
+{
+	status_t error = AudioReader::InitCheck();
+	if (error == B_OK && !fSource)
+		error = B_NO_INIT;
+	if (error == B_OK && !fRing)
+		error = B_NO_MEMORY;
+	if (error == B_OK && fWakeUpSem < B_OK)
+		error = fWakeUpSem;
+	if (error == B_OK && fWorker < B_OK)
+		error = fWorker;
+	return error;
+}
+
+// Read
+status_t
+ReadAheadAudioReader::Read(void* buffer, int64 pos, int64 frames)
+{
+	status_t error = InitCheck();
+	if (error != B_OK)
+		return error;
+
+	pos += fOutOffset;
+	fStatistics.reads++;
+
+	bool restart = atomic_test_and_set(&fInvalidated, 0, 1) == 1;
+
+	int64 readIndex = fReadIndex;
+	while (!restart && frames > 0
+		&& atomic_get(&fRingGeneration) == fGeneration) {
+		int64 position = fStartPosition + (readIndex - fStartIndex);
+		int64 available = atomic_get64(&fWriteIndex) - readIndex;
+
+		if (position > pos || pos - position > fCapacity) {
+			// the position has been changed
+			restart = true;
+			break;
+		}
+		if (available == 0)
+			break;
+
+		if (position < pos) {
+			// skip what should have been played while the worker
+			// was starting over
+			readIndex += std::min(pos - position, available);
+			continue;
+		}
+
+		int64 offset = readIndex % fCapacity;
+		int64 size = std::min(std::min(frames, available),
+			fCapacity - offset);
+		memcpy(buffer, fRing + offset * fFrameSize, size * fFrameSize);
+
+		buffer = SkipFrames(buffer, size);
+		readIndex += size;
+		pos += size;
+		frames -= size;
+	}
+
+	if (readIndex != fReadIndex) {
+		atomic_set64(&fReadIndex, readIndex);
+		_WakeUpWorker();
+	}
+
+	if (restart) {
+		// The ring has no audio for the new position yet, so the current
+		// request is read directly, the worker starts over behind it.
+		_Restart(pos + frames);
+		if (frames == 0)
+			return B_OK;
+		fStatistics.synchronous_reads++;
+		if (_ReadSource(buffer, pos, frames) == B_OK)
+			return B_OK;
+	}
+
+	if (frames == 0)
+		return B_OK;
+
+	// never wait for the worker
+	ReadSilence(buffer, frames);
+	fStatistics.underruns++;
+	fStatistics.underrun_frames += frames;
+
+	return B_OK;
+}
+
+// Invalidate
+void
+ReadAheadAudioReader::Invalidate()
+{
+	atomic_set(&fInvalidated, 1);
+}
+
+// GetStatistics
+void
+ReadAheadAudioReader::GetStatistics(read_ahead_statistics& statistics) const
+{
+	statistics = fStatistics;
+}
+
+// #pragma mark -
+
+// _WorkerEntry
+int32
+ReadAheadAudioReader::_WorkerEntry(void* cookie)
+{
+	((ReadAheadAudioReader*)cookie)->_Worker();
+	return 0;
+}
+
+// _Worker
+void
+ReadAheadAudioReader::_Worker()
+{
+	int32 generation = -1;
+	int64 writeIndex = 0;
+
+	while (!fQuitting) {
+		int32 requestedGeneration = atomic_get(&fRequestedGeneration);
+		if (requestedGeneration != generation) {
+			// start over where the consumer is now
+			generation = requestedGeneration;
+			writeIndex = atomic_get64(&fReadIndex);
+			fStartIndex = writeIndex;
+			fStartPosition = fRequestedPosition;
+			atomic_set64(&fWriteIndex, writeIndex);
+			atomic_set(&fRingGeneration, generation);
+		}
+
+		int64 freeFrames = fCapacity
+			- (writeIndex - atomic_get64(&fReadIndex));
+		if (freeFrames < fChunkFrames) {
+			// The consumer wakes us up after reading, if it sees that we
+			// are waiting. The timeout catches the case that it read just
+			// before we started to wait.
+			atomic_set(&fWorkerWaiting, 1);
+			status_t error = acquire_sem_etc(fWakeUpSem, 1,
+				B_RELATIVE_TIMEOUT, kWorkerPollTimeout);
+			atomic_set(&fWorkerWaiting, 0);
+			if (error == B_BAD_SEM_ID)
+				break;
+			continue;
+		}
+
+		int64 offset = writeIndex % fCapacity;
+		int64 frames = std::min(fChunkFrames, fCapacity - offset);
+		char* buffer = fRing + offset * fFrameSize;
+		int64 position = fStartPosition + (writeIndex - fStartIndex);
+		if (_ReadSource(buffer, position, frames) != B_OK)
+			ReadSilence(buffer, frames);
+
+		writeIndex += frames;
+		atomic_set64(&fWriteIndex, writeIndex);
+	}
+}
+
+// _Restart
+void
+ReadAheadAudioReader::_Restart(int64 position)
+{
+	fRequestedPosition = position;
+	fGeneration++;
+	atomic_set(&fRequestedGeneration, fGeneration);
+	fStatistics.restarts++;
+
+	_WakeUpWorker();
+}
+
+// _WakeUpWorker
+void
+ReadAheadAudioReader::_WakeUpWorker()
+{
+	if (atomic_test_and_set(&fWorkerWaiting, 0, 1) == 1)
+		release_sem_etc(fWakeUpSem, 1, B_DO_NOT_RESCHEDULE);
+}
+
+// _ReadSource
+status_t
+ReadAheadAudioReader::_ReadSource(void* buffer, int64 pos, int64 frames)
+{
+	if (!fSourceLock.Lock())
+		return B_ERROR;
+
+	status_t error = fSource->Read(buffer, pos, frames);
+
+	fSourceLock.Unlock();
+	return error;
+}
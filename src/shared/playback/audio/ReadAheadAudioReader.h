@@ -0,0 +1,96 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+// The ReadAheadAudioReader reads its source in a worker thread and keeps
+// the audio ahead of the current position in a ring buffer, so that a slow
+// codec or a stalled disk doesn't keep the consumer waiting. The ring is
+// written by the worker and read by the consumer without any locking. If
+// the audio at the requested position is not available yet, Read() returns
+// silence instead of waiting for it. Reading at a position which is not
+// ahead of the buffered audio, or calling Invalidate(), makes the worker
+// start over at the new position, the current request is then read from
+// the source directly.
+//
+// The source is only read while holding the source lock, the owner needs
+// to hold it as well while changing the source.
+
+#ifndef READ_AHEAD_AUDIO_READER_H
+#define READ_AHEAD_AUDIO_READER_H
+
+#include <Locker.h>
+#include <OS.h>
+
+#include "AudioReader.h"
+
+struct read_ahead_statistics {
+	int64		reads;
+	int64		underruns;
+	int64		underrun_frames;
+	int64		restarts;
+	int64		synchronous_reads;
+};
+
+class ReadAheadAudioReader : public AudioReader {
+ public:
+								ReadAheadAudioReader(AudioReader* source,
+									bigtime_t readAheadTime);
+	virtual						~ReadAheadAudioReader();
+
+	virtual	status_t			InitCheck() const;
+
+	// only one thread may call Read()
+	virtual	status_t			Read(void* buffer, int64 pos, int64 frames);
+
+			AudioReader*		Source() const
+									{ return fSource; }
+			bool				LockSource()
+									{ return fSourceLock.Lock(); }
+			void				UnlockSource()
+									{ fSourceLock.Unlock(); }
+
+			// drops the buffered audio, can be called from any thread
+			void				Invalidate();
+
+			void				GetStatistics(
+									read_ahead_statistics& statistics) const;
+
+ private:
+	static	int32				_WorkerEntry(void* cookie);
+			void				_Worker();
+
+			void				_Restart(int64 position);
+			void				_WakeUpWorker();
+			status_t			_ReadSource(void* buffer, int64 pos,
+									int64 frames);
+
+			AudioReader*		fSource;
+			BLocker				fSourceLock;
+			char*				fRing;
+			int64				fCapacity;
+			int64				fChunkFrames;
+			int32				fFrameSize;
+
+			// written by the consumer
+			vint64				fReadIndex;
+			vint32				fRequestedGeneration;
+			int64				fRequestedPosition;
+			int32				fGeneration;
+
+			// written by the worker
+			vint64				fWriteIndex;
+			vint32				fRingGeneration;
+			int64				fStartIndex;
+			int64				fStartPosition;
+
+			vint32				fInvalidated;
+			vint32				fWorkerWaiting;
+			sem_id				fWakeUpSem;
+			thread_id			fWorker;
+			volatile bool		fQuitting;
+
+			read_ahead_statistics fStatistics;
+};
+
+#endif // READ_AHEAD_AUDIO_READER_H
@@ -0,0 +1,644 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+#include "WaveformCache.h"
+
+#include <new>
+#include <stdio.h>
+#include <string.h>
+
+#include <Directory.h>
+#include <File.h>
+#include <Message.h>
+#include <Path.h>
+
+#include "common.h"
+#include "common_constants.h"
+
+#include "AudioConverter.h"
+#include "AudioReader.h"
+#include "AudioTrackReader.h"
+#include "AutoDeleter.h"
+#include "AutoLocker.h"
+#include "MediaClip.h"
+
+using std::nothrow;
+
+static const uint32 kWaveformMagic = 'wvfm';
+static const uint32 kWaveformVersion = 1;
+static const int64 kAnalyzeChunkFrames = 16384;
+
+
+// quantize_peak
+static inline int8
+quantize_peak(float value)
+{
+	if (value <= -1.0)
+		return -127;
+	if (value >= 1.0)
+		return 127;
+	return (int8)(value * 127.0 + (value < 0.0 ? -0.5 : 0.5));
+}
+
+// constructor
+Waveform::Waveform(float frameRate, int64 frameCount)
+	: Referencable()
+	, fFrameRate(frameRate)
+	, fFrameCount(frameCount)
+	, fBucket(0)
+	, fFramesInBucket(0)
+	, fMin(0.0)
+	, fMax(0.0)
+{
+	int64 bucketSize = BASE_BUCKET_SIZE;
+	for (int32 i = 0; i < LEVEL_COUNT; i++) {
+		fLevels[i].bucketSize = bucketSize;
+		fLevels[i].bucketCount = (fFrameCount + bucketSize - 1) / bucketSize;
+		fLevels[i].peaks = new (nothrow) int8[
+			max_c(1, fLevels[i].bucketCount) * 2];
+		bucketSize *= LEVEL_FACTOR;
+	}
+}
+
+// destructor
+Waveform::~Waveform()
+{
+	for (int32 i = 0; i < LEVEL_COUNT; i++)
+		delete[] fLevels[i].peaks;
+}
+
+// InitCheck
+status_t
+Waveform::InitCheck() const
+{
+	if (fFrameRate <= 0.0 || fFrameCount < 0)
+		return B_BAD_VALUE;
+	for (int32 i = 0; i < LEVEL_COUNT; i++) {
+		if (!fLevels[i].peaks)
+			return B_NO_MEMORY;
+	}
+	return B_OK;
+}
+
+// MemoryUsage
+size_t
+Waveform::MemoryUsage() const
+{
+	size_t usage = sizeof(Waveform);
+	for (int32 i = 0; i < LEVEL_COUNT; i++)
+		usage += max_c(1, fLevels[i].bucketCount) * 2;
+	return usage;
+}
+
+// GetPeaks
+int32
+Waveform::GetPeaks(int64 startFrame, double framesPerPixel, int32 count,
+	float* minima, float* maxima) const
+{
+	if (framesPerPixel <= 0.0 || count <= 0)
+		return 0;
+
+	// use the coarsest level which still has at least one
+	// bucket per pixel, so that at most LEVEL_FACTOR buckets
+	// need to be combined for each pixel
+	int32 levelIndex = 0;
+	for (int32 i = LEVEL_COUNT - 1; i > 0; i--) {
+		if (fLevels[i].bucketSize <= framesPerPixel) {
+			levelIndex = i;
+			break;
+		}
+	}
+	const Level& level = fLevels[levelIndex];
+
+	for (int32 i = 0; i < count; i++) {
+		int64 first = startFrame + (int64)(i * framesPerPixel);
+		int64 last = startFrame + (int64)((i + 1) * framesPerPixel);
+		if (first < 0 || first >= fFrameCount) {
+			minima[i] = 0.0;
+			maxima[i] = 0.0;
+			continue;
+		}
+
+		int64 firstBucket = first / level.bucketSize;
+		int64 lastBucket = max_c(firstBucket, (last - 1) / level.bucketSize);
+		lastBucket = min_c(lastBucket, level.bucketCount - 1);
+
+		int8 minPeak = 127;
+		int8 maxPeak = -127;
+		const int8* peaks = level.peaks + firstBucket * 2;
+		for (int64 bucket = firstBucket; bucket <= lastBucket; bucket++) {
+			if (peaks[0] < minPeak)
+				minPeak = peaks[0];
+			if (peaks[1] > maxPeak)
+				maxPeak = peaks[1];
+			peaks += 2;
+		}
+
+		minima[i] = minPeak / 127.0;
+		maxima[i] = maxPeak / 127.0;
+	}
+
+	return count;
+}
+
+// Archive
+status_t
+Waveform::Archive(BPositionIO* stream) const
+{
+	// NOTE: the file is a local cache, so it is stored in host endianess
+	uint32 header[2] = { kWaveformMagic, kWaveformVersion };
+	ssize_t written = stream->Write(header, sizeof(header));
+	if (written == (ssize_t)sizeof(header))
+		written = stream->Write(&fFrameRate, sizeof(fFrameRate));
+	if (written == (ssize_t)sizeof(fFrameRate))
+		written = stream->Write(&fFrameCount, sizeof(fFrameCount));
+	if (written != (ssize_t)sizeof(fFrameCount))
+		return written < 0 ? (status_t)written : B_IO_ERROR;
+
+	for (int32 i = 0; i < LEVEL_COUNT; i++) {
+		size_t size = fLevels[i].bucketCount * 2;
+		written = stream->Write(fLevels[i].peaks, size);
+		if (written != (ssize_t)size)
+			return written < 0 ? (status_t)written : B_IO_ERROR;
+	}
+
+	return B_OK;
+}
+
+// Unarchive
+/*static*/ Waveform*
+Waveform::Unarchive(BPositionIO* stream)
+{
+	uint32 header[2];
+	float frameRate;
+	int64 frameCount;
+	if (stream->Read(header, sizeof(header)) != (ssize_t)sizeof(header)
+		|| header[0] != kWaveformMagic || header[1] != kWaveformVersion
+		|| stream->Read(&frameRate, sizeof(frameRate))
+			!= (ssize_t)sizeof(frameRate)
+		|| stream->Read(&frameCount, sizeof(frameCount))
+			!= (ssize_t)sizeof(frameCount)) {
+		return NULL;
+	}
+
+	Waveform* waveform = new (nothrow) Waveform(frameRate, frameCount);
+	if (!waveform)
+		return NULL;
+	if (waveform->InitCheck() < B_OK) {
+		waveform->Release();
+		return NULL;
+	}
+
+	for (int32 i = 0; i < LEVEL_COUNT; i++) {
+		size_t size = waveform->fLevels[i].bucketCount * 2;
+		if (stream->Read(waveform->fLevels[i].peaks, size) != (ssize_t)size) {
+			waveform->Release();
+			return NULL;
+		}
+	}
+
+	return waveform;
+}
+
+// #pragma mark -
+
+// _AddSamples
+void
+Waveform::_AddSamples(const float* samples, int32 frames, uint32 channels)
+{
+	Level& level = fLevels[0];
+	for (int32 i = 0; i < frames; i++) {
+		// mix down the channels by using the extremes of all of them
+		for (uint32 c = 0; c < channels; c++) {
+			float sample = *samples++;
+			if (fFramesInBucket == 0 && c == 0) {
+				fMin = sample;
+				fMax = sample;
+			} else if (sample < fMin)
+				fMin = sample;
+			else if (sample > fMax)
+				fMax = sample;
+		}
+
+		if (++fFramesInBucket == level.bucketSize) {
+			if (fBucket < level.bucketCount) {
+				level.peaks[fBucket * 2] = quantize_peak(fMin);
+				level.peaks[fBucket * 2 + 1] = quantize_peak(fMax);
+			}
+			fBucket++;
+			fFramesInBucket = 0;
+		}
+	}
+}
+
+// _BuildLevels
+void
+Waveform::_BuildLevels()
+{
+	// flush the last partial bucket of the base level
+	Level& base = fLevels[0];
+	if (fFramesInBucket > 0 && fBucket < base.bucketCount) {
+		base.peaks[fBucket * 2] = quantize_peak(fMin);
+		base.peaks[fBucket * 2 + 1] = quantize_peak(fMax);
+		fBucket++;
+	}
+	// buckets that have never been reached are silent
+	for (; fBucket < base.bucketCount; fBucket++) {
+		base.peaks[fBucket * 2] = 0;
+		base.peaks[fBucket * 2 + 1] = 0;
+	}
+
+	for (int32 i = 1; i < LEVEL_COUNT; i++) {
+		const Level& source = fLevels[i - 1];
+		Level& level = fLevels[i];
+		for (int64 bucket = 0; bucket < level.bucketCount; bucket++) {
+			int64 first = bucket * LEVEL_FACTOR;
+			int64 last = min_c(first + LEVEL_FACTOR, source.bucketCount);
+			int8 minPeak = 127;
+			int8 maxPeak = -127;
+			for (int64 j = first; j < last; j++) {
+				minPeak = min_c(minPeak, source.peaks[j * 2]);
+				maxPeak = max_c(maxPeak, source.peaks[j * 2 + 1]);
+			}
+			level.peaks[bucket * 2] = minPeak;
+			level.peaks[bucket * 2 + 1] = maxPeak;
+		}
+	}
+}
+
+// #pragma mark -
+
+// constructor
+WaveformCache::WaveformCache(size_t memoryLimit)
+	: fJobs("waveform jobs")
+	, fAnalyzer(-1)
+	, fLock("waveform cache")
+	, fEntries()
+	, fLRU()
+	, fPending()
+	, fMemoryUsage(0)
+	, fMemoryLimit(memoryLimit)
+	, fStatus(B_NO_INIT)
+{
+	fStatus = fJobs.InitCheck();
+	if (fStatus == B_OK)
+		fStatus = fEntries.InitCheck();
+	if (fStatus < B_OK)
+		return;
+
+	fAnalyzer = spawn_thread(_AnalyzerEntry, "waveform analyzer",
+		B_LOW_PRIORITY, this);
+	if (fAnalyzer >= B_OK) {
+		fStatus = B_OK;
+		resume_thread(fAnalyzer);
+	} else
+		fStatus = fAnalyzer;
+}
+
+// destructor
+WaveformCache::~WaveformCache()
+{
+	const Vector<Job*>* jobs = NULL;
+	if (fJobs.Close(false, &jobs) == B_OK && jobs) {
+		int32 count = jobs->Count();
+		for (int32 i = 0; i < count; i++) {
+			Job* job = jobs->ElementAt(i);
+			job->clip->Release();
+			delete job;
+		}
+	}
+	if (fAnalyzer >= B_OK) {
+		status_t dummy;
+		wait_for_thread(fAnalyzer, &dummy);
+	}
+
+	while (Entry* entry = fLRU.GetFirst())
+		_RemoveEntry(entry);
+}
+
+// InitCheck
+status_t
+WaveformCache::InitCheck() const
+{
+	return fStatus;
+}
+
+// CreateDefault
+WaveformCache*
+WaveformCache::CreateDefault()
+{
+	if (!sDefaultCache) {
+		sDefaultCache = new (nothrow) WaveformCache();
+		if (sDefaultCache && sDefaultCache->InitCheck() != B_OK)
+			DeleteDefault();
+	}
+	return sDefaultCache;
+}
+
+// DeleteDefault
+void
+WaveformCache::DeleteDefault()
+{
+	delete sDefaultCache;
+	sDefaultCache = NULL;
+}
+
+// Default
+WaveformCache*
+WaveformCache::Default()
+{
+	return sDefaultCache;
+}
+
+// GetWaveform
+Waveform*
+WaveformCache::GetWaveform(MediaClip* clip, const BMessenger& target)
+{
+	if (!clip || !clip->HasAudio())
+		return NULL;
+
+	BString key = _KeyFor(clip);
+
+	AutoLocker<BLocker> locker(fLock);
+
+	Waveform* waveform = _Lookup(key);
+	if (waveform)
+		return waveform;
+
+	if (fPending.ContainsKey(key.String()))
+		return NULL;
+
+	// analyze the clip in the background, the target is notified
+	// when the waveform is available
+	Job* job = new (nothrow) Job;
+	if (!job)
+		return NULL;
+
+	job->clip = clip;
+	job->key = key;
+	job->target = target;
+
+	clip->Acquire();
+	if (fPending.Put(key.String(), 1) < B_OK || fJobs.Push(job) < B_OK) {
+		fPending.Remove(key.String());
+		clip->Release();
+		delete job;
+	}
+
+	return NULL;
+}
+
+// Forget
+void
+WaveformCache::Forget(MediaClip* clip)
+{
+	BString key = _KeyFor(clip);
+
+	AutoLocker<BLocker> locker(fLock);
+
+	Entry* entry = fEntries.Get(key.String());
+	if (entry)
+		_RemoveEntry(entry);
+
+	// the file on disk is outdated as well
+	BString path;
+	if (_PathFor(key, path) == B_OK)
+		BEntry(path.String()).Remove();
+}
+
+// #pragma mark -
+
+// _KeyFor
+/*static*/ BString
+WaveformCache::_KeyFor(MediaClip* clip)
+{
+	BString key(clip->ID());
+	key << "-" << clip->Version();
+	return key;
+}
+
+// _PathFor
+status_t
+WaveformCache::_PathFor(const BString& key, BString& _path) const
+{
+	BPath path(kCachePath);
+	status_t ret = path.Append("waveforms");
+	if (ret == B_OK)
+		ret = create_directory(path.Path(), 0777);
+	if (ret == B_OK)
+		ret = path.Append(key.String());
+	if (ret == B_OK)
+		_path = path.Path();
+	return ret;
+}
+
+// _AnalyzerEntry
+int32
+WaveformCache::_AnalyzerEntry(void* cookie)
+{
+	return ((WaveformCache*)cookie)->_Analyzer();
+}
+
+// _Analyzer
+int32
+WaveformCache::_Analyzer()
+{
+	while (true) {
+		Job* job;
+		status_t ret = fJobs.Pop(&job);
+		if (ret == B_INTERRUPTED)
+			continue;
+		if (ret < B_OK) {
+			// the queue has been closed
+			break;
+		}
+
+		Waveform* waveform = _Load(job->key);
+		if (!waveform) {
+			waveform = _Analyze(job->clip);
+			if (waveform)
+				_Store(job->key, waveform);
+		}
+
+		fLock.Lock();
+		fPending.Remove(job->key.String());
+		if (waveform)
+			_Insert(job->key, waveform);
+		fLock.Unlock();
+
+		if (waveform) {
+			waveform->Release();
+
+			BMessage message(MSG_WAVEFORM_READY);
+			message.AddPointer("clip", job->clip);
+			job->target.SendMessage(&message);
+		}
+
+		job->clip->Release();
+		delete job;
+	}
+
+	return B_OK;
+}
+
+// _Lookup
+Waveform*
+WaveformCache::_Lookup(const BString& key)
+{
+	Entry* entry = fEntries.Get(key.String());
+	if (!entry)
+		return NULL;
+
+	// move the entry to the front of the LRU list
+	fLRU.Remove(entry);
+	fLRU.Insert(entry, false);
+
+	entry->waveform->Acquire();
+	return entry->waveform;
+}
+
+// _Insert
+void
+WaveformCache::_Insert(const BString& key, Waveform* waveform)
+{
+	Entry* entry = fEntries.Get(key.String());
+	if (entry)
+		_RemoveEntry(entry);
+
+	entry = new (nothrow) Entry;
+	if (!entry)
+		return;
+
+	entry->key = key;
+	entry->waveform = waveform;
+	if (fEntries.Put(key.String(), entry) < B_OK) {
+		delete entry;
+		return;
+	}
+
+	waveform->Acquire();
+	fLRU.Insert(entry, false);
+	fMemoryUsage += waveform->MemoryUsage();
+
+	_Trim();
+}
+
+// _RemoveEntry
+void
+WaveformCache::_RemoveEntry(Entry* entry)
+{
+	fEntries.Remove(entry->key.String());
+	fLRU.Remove(entry);
+	fMemoryUsage -= entry->waveform->MemoryUsage();
+
+	// NOTE: waveforms which are still in use by someone else stay around
+	// until they are released
+	entry->waveform->Release();
+	delete entry;
+}
+
+// _Trim
+void
+WaveformCache::_Trim()
+{
+	// always keep the most recently used waveform
+	while (fMemoryUsage > fMemoryLimit && fLRU.GetLast() != fLRU.GetFirst())
+		_RemoveEntry(fLRU.GetLast());
+}
+
+// _Load
+Waveform*
+WaveformCache::_Load(const BString& key)
+{
+	BString path;
+	if (_PathFor(key, path) < B_OK)
+		return NULL;
+
+	BFile file(path.String(), B_READ_ONLY);
+	if (file.InitCheck() < B_OK)
+		return NULL;
+
+	return Waveform::Unarchive(&file);
+}
+
+// _Analyze
+Waveform*
+WaveformCache::_Analyze(MediaClip* clip)
+{
+	AudioReader* reader = clip->CreateAudioReader();
+	if (!reader)
+		return NULL;
+	ObjectDeleter<AudioReader> readerDeleter(reader);
+
+	// the whole clip is read only once, it would just push
+	// the blocks which are being played out of the cache
+	if (AudioTrackReader* trackReader = dynamic_cast<AudioTrackReader*>(reader))
+		trackReader->SetBlockCache(NULL, "");
+
+	uint32 hostByteOrder
+		= B_HOST_IS_BENDIAN ? B_MEDIA_BIG_ENDIAN : B_MEDIA_LITTLE_ENDIAN;
+	AudioConverter converter(reader, media_raw_audio_format::B_AUDIO_FLOAT,
+		hostByteOrder);
+	if (converter.InitCheck() < B_OK)
+		return NULL;
+
+	const media_raw_audio_format& format = converter.Format().u.raw_audio;
+	uint32 channels = max_c(1, format.channel_count);
+	int64 frameCount = clip->AudioFrameCount();
+
+	Waveform* waveform = new (nothrow) Waveform(format.frame_rate,
+		frameCount);
+	if (!waveform)
+		return NULL;
+	if (waveform->InitCheck() < B_OK) {
+		waveform->Release();
+		return NULL;
+	}
+
+	float* buffer = new (nothrow) float[kAnalyzeChunkFrames * channels];
+	if (!buffer) {
+		waveform->Release();
+		return NULL;
+	}
+	ArrayDeleter<float> bufferDeleter(buffer);
+
+	for (int64 frame = 0; frame < frameCount; frame += kAnalyzeChunkFrames) {
+		int64 frames = min_c(kAnalyzeChunkFrames, frameCount - frame);
+		if (converter.Read(buffer, frame, frames) < B_OK) {
+			print_error("WaveformCache::_Analyze() - failed to read "
+				"frames of clip '%s', stopped at frame %lld\n",
+				clip->Name().String(), frame);
+			break;
+		}
+		waveform->_AddSamples(buffer, frames, channels);
+	}
+	waveform->_BuildLevels();
+
+	return waveform;
+}
+
+// _Store
+void
+WaveformCache::_Store(const BString& key, const Waveform* waveform)
+{
+	BString path;
+	if (_PathFor(key, path) < B_OK)
+		return;
+
+	BFile file(path.String(), B_CREATE_FILE | B_ERASE_FILE | B_WRITE_ONLY);
+	if (file.InitCheck() < B_OK)
+		return;
+
+	if (waveform->Archive(&file) < B_OK) {
+		// don't leave a broken file around
+		file.Unset();
+		BEntry(path.String()).Remove();
+	}
+}
+
+// static variables
+
+// sDefaultCache
+WaveformCache* WaveformCache::sDefaultCache = NULL;
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+#ifndef WAVEFORM_CACHE_H
+#define WAVEFORM_CACHE_H
+
+#include <Locker.h>
+#include <Messenger.h>
+#include <String.h>
+
+#include "BlockingQueue.h"
+#include "DLList.h"
+#include "HashMap.h"
+#include "HashString.h"
+#include "Referencable.h"
+
+class BPositionIO;
+class MediaClip;
+
+enum {
+	MSG_WAVEFORM_READY			= 'wfrd',
+};
+
+// Waveform
+//
+// A min/max peak pyramid of the (mixed down) audio of a clip. Each
+// level combines the buckets of the previous level, so that peaks for
+// any zoom level can be obtained by looking at only a few buckets
+// per pixel.
+class Waveform : public Referencable {
+ public:
+	enum {
+		LEVEL_COUNT				= 3,
+		BASE_BUCKET_SIZE		= 256,
+		LEVEL_FACTOR			= 16
+	};
+
+								Waveform(float frameRate, int64 frameCount);
+	virtual						~Waveform();
+
+			status_t			InitCheck() const;
+
+			float				FrameRate() const
+									{ return fFrameRate; }
+			int64				CountFrames() const
+									{ return fFrameCount; }
+			size_t				MemoryUsage() const;
+
+			int32				GetPeaks(int64 startFrame,
+									double framesPerPixel, int32 count,
+									float* minima, float* maxima) const;
+
+			status_t			Archive(BPositionIO* stream) const;
+	static	Waveform*			Unarchive(BPositionIO* stream);
+
+ private:
+	friend class WaveformCache;
+
+			struct Level {
+				int64			bucketSize;
+				int64			bucketCount;
+				int8*			peaks;
+					// min/max pairs
+			};
+
+			void				_AddSamples(const float* samples,
+									int32 frames, uint32 channels);
+			void				_BuildLevels();
+
+			float				fFrameRate;
+			int64				fFrameCount;
+			Level				fLevels[LEVEL_COUNT];
+
+			// state while building the base level
+			int64				fBucket;
+			int32				fFramesInBucket;
+			float				fMin;
+			float				fMax;
+};
+
+// WaveformCache
+//
+// Analyzes the audio of MediaClips on a background thread and keeps the
+// resulting Waveforms in a memory bounded LRU and in sidecar files, so
+// that the decoder never needs to be touched for drawing waveforms.
+class WaveformCache {
+ public:
+	enum {
+		DEFAULT_MEMORY_LIMIT	= 8 * 1024 * 1024
+	};
+
+								WaveformCache(size_t memoryLimit
+									= DEFAULT_MEMORY_LIMIT);
+	virtual						~WaveformCache();
+
+			status_t			InitCheck() const;
+
+	static	WaveformCache*		CreateDefault();
+	static	void				DeleteDefault();
+	static	WaveformCache*		Default();
+
+			Waveform*			GetWaveform(MediaClip* clip,
+									const BMessenger& target);
+			void				Forget(MediaClip* clip);
+
+			size_t				MemoryUsage() const
+									{ return fMemoryUsage; }
+
+ private:
+			struct Job {
+				MediaClip*		clip;
+				BString			key;
+				BMessenger		target;
+			};
+
+			struct Entry : DLListLinkImpl<Entry> {
+				BString			key;
+				Waveform*		waveform;
+			};
+
+	typedef HashMap<HashString, Entry*> EntryMap;
+	typedef HashMap<HashString, int32> PendingMap;
+	typedef DLList<Entry> EntryList;
+
+	static	BString				_KeyFor(MediaClip* clip);
+			status_t			_PathFor(const BString& key,
+									BString& path) const;
+
+	static	int32				_AnalyzerEntry(void* cookie);
+			int32				_Analyzer();
+
+			Waveform*			_Lookup(const BString& key);
+			void				_Insert(const BString& key,
+									Waveform* waveform);
+			void				_RemoveEntry(Entry* entry);
+			void				_Trim();
+
+			Waveform*			_Load(const BString& key);
+			Waveform*			_Analyze(MediaClip* clip);
+			void				_Store(const BString& key,
+									const Waveform* waveform);
+
+			BlockingQueue<Job>	fJobs;
+			thread_id			fAnalyzer;
+
+			BLocker				fLock;
+			EntryMap			fEntries;
+			EntryList			fLRU;
+				// most recently used first
+			PendingMap			fPending;
+			size_t				fMemoryUsage;
+			size_t				fMemoryLimit;
+
+			status_t			fStatus;
+
+	static	WaveformCache*		sDefaultCache;
+};
+
+#endif // WAVEFORM_CACHE_H
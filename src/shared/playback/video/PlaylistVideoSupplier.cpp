@@ -12,6 +12,8 @@
 
 #include "MediaRenderingBuffer.h"
 #include "Painter.h"
+#include "Playlist.h"
+#include "PlaylistSnapshot.h"
 #include "RenderPlaylist.h"
 #include "RWLocker.h"
 
@@ -31,6 +33,7 @@ PlaylistVideoSupplier::PlaylistVideoSupplier(Playlist* list,
 	: fPlaylist(NULL)
 	, fPainter()
 	, fLocker(locker)
+	, fSnapshot(NULL)
 	, fRendererCache()
 {
 	SetPlaylist(list);
@@ -39,6 +42,7 @@ PlaylistVideoSupplier::PlaylistVideoSupplier(Playlist* list,
 // destructor
 PlaylistVideoSupplier::~PlaylistVideoSupplier()
 {
+	PlaylistSnapshot::ReleaseSnapshot(&fSnapshot, fLocker);
 	SetPlaylist(NULL);
 }
 
@@ -62,28 +66,30 @@ PlaylistVideoSupplier::FillBuffer(int64 frame, void* buffer,
 	// clear buffer
 	fPainter.ClearBuffer();
 
-	AutoReadLocker locker(fLocker);
-	if (fLocker && !locker.IsLocked()) {
-		printf("PlaylistVideoSupplier: - readlocking failed!\n");
-		return B_ERROR;
-	}
+	// Take a new snapshot of the playlist, if it has been changed since the
+	// last frame. Never wait for the document lock though, while it is
+	// write locked, keep rendering the previous version of the playlist,
+	// without synchronizing the renderers with their clips.
+	bool locked = !fLocker || fLocker->ReadLockWithTimeout(0) == B_OK;
+	if (locked)
+		PlaylistSnapshot::Update(&fSnapshot, fPlaylist, fLocker);
 
 	status_t ret = B_NO_INIT;
-	if (fPlaylist) {
-		// create a temporary clone of the playlist
-		// so that we can keep the time holding the
-		// read lock really short
-//bigtime_t _now = system_time();
-		RenderPlaylist temporaryList(*fPlaylist,
+	if (fPlaylist && fSnapshot) {
+		// create a temporary list of the items at the frame, the renderers
+		// can only be synced while we still hold the read lock
+		RenderPlaylist temporaryList(fSnapshot,
 			(double)frame, format->u.raw_video.display.format,
-			&fRendererCache);
-//printf("cloning playlist: %lldµsecs\n", system_time() - _now);
+			&fRendererCache, locked);
+
+		if (locked && fLocker)
+			fLocker->ReadUnlock();
 
 		// NOTE: assuming that VideoProducer is never interlaced
-		double playlistFrame = (double)frame * fPlaylist->VideoFrameRate()
+		double playlistFrame = (double)frame
+			* fSnapshot->Playlist()->VideoFrameRate()
 			/ format->u.raw_video.field_rate;
 
-		locker.Unlock();
 		// since we had to clear the buffer anyways,
 		// it doesn't matter wether the playlist is
 		// empty at the frame... so always return B_OK
@@ -94,6 +100,9 @@ PlaylistVideoSupplier::FillBuffer(int64 frame, void* buffer,
 
 		ret = B_OK;
 	} else {
+		if (locked && fLocker)
+			fLocker->ReadUnlock();
+
 		fPainter.ClearBuffer();
 		fPainter.FlushCaches();
 		ret = B_OK;
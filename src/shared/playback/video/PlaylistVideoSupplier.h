@@ -12,6 +12,7 @@
 #include "Painter.h"
 
 class Playlist;
+class PlaylistSnapshot;
 class RWLocker;
 
 class PlaylistVideoSupplier : public VideoSupplier {
@@ -34,6 +35,8 @@ class PlaylistVideoSupplier : public VideoSupplier {
 			// (optional) additional readlocking
 			// before accessing the playlist
 			RWLocker*			fLocker;
+			// the version of the playlist we render from
+			PlaylistSnapshot*	fSnapshot;
 
 			ClipRendererCache	fRendererCache;
 };
@@ -26,6 +26,7 @@ using std::nothrow;
 ClipPlaylistItem::ClipPlaylistItem(::Clip* clip, int64 startFrame, uint32 track)
 	: PlaylistItem(startFrame, 0, track)
 	, fClip(NULL)
+	, fObservingClip(true)
 {
 	SetClip(clip);
 
@@ -38,6 +39,7 @@ ClipPlaylistItem::ClipPlaylistItem(::Clip* clip, int64 startFrame, uint32 track)
 ClipPlaylistItem::ClipPlaylistItem(const ClipPlaylistItem& other, bool deep)
 	: PlaylistItem(other, deep)
 	, fClip(other.fClip)
+	, fObservingClip(true)
 {
 	if (fClip) {
 		fClip->Acquire();
@@ -49,6 +51,7 @@ ClipPlaylistItem::ClipPlaylistItem(const ClipPlaylistItem& other, bool deep)
 ClipPlaylistItem::ClipPlaylistItem(BMessage* archive)
 	: PlaylistItem(archive)
 	, fClip(NULL)
+	, fObservingClip(true)
 {
 	if (!archive)
 		return;
@@ -269,17 +272,17 @@ ClipPlaylistItem::SetClip(::Clip* clip)
 
 	AutoNotificationSuspender _(this);
 
-	if (fClip) {
-		fClip->RemoveObserver(this);
-		fClip->Release();
-			// NOTE: clip might have selfdestroyed now
-	}
+	// the old clip is kept until the playlist has been told
+	::Clip* oldClip = fClip;
+	if (oldClip && fObservingClip)
+		oldClip->RemoveObserver(this);
 
 	fClip = clip;
 
 	if (fClip) {
 		fClip->Acquire();
-		fClip->AddObserver(this);
+		if (fObservingClip)
+			fClip->AddObserver(this);
 
 		BRect canvas(0.0, 0.0, -1.0, -1.0);
 		BRect bounds = fClip->Bounds(canvas);
@@ -299,9 +302,26 @@ ClipPlaylistItem::SetClip(::Clip* clip)
 		DeleteProperty(PROPERTY_CLIP_ID);
 	}
 
+	if (Parent())
+		Parent()->ItemClipChanged(this, oldClip);
+
+	if (oldClip) {
+		oldClip->Release();
+			// NOTE: clip might have selfdestroyed now
+	}
+
 	Notify();
 }
 
+// StopObservingClip
+void
+ClipPlaylistItem::StopObservingClip()
+{
+	if (fClip && fObservingClip)
+		fClip->RemoveObserver(this);
+	fObservingClip = false;
+}
+
 // DefaultDuration
 uint64
 ClipPlaylistItem::DefaultDuration(uint64 duration)
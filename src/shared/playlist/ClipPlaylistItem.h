@@ -58,6 +58,9 @@ class ClipPlaylistItem : public PlaylistItem,
 			void				SetClip(::Clip* clip);
 			::Clip*				Clip() const
 									{ return fClip; }
+			void				StopObservingClip();
+									// for private copies, which must not
+									// be changed along with the clip
 
 	static	uint64				DefaultDuration(uint64 duration);
 
@@ -66,6 +69,7 @@ class ClipPlaylistItem : public PlaylistItem,
 									const ClipPlaylistItem& other);
 
  			::Clip*				fClip;
+			bool				fObservingClip;
 };
 
 #endif // CLIP_PLAYLIST_ITEM_H
@@ -77,6 +77,9 @@ CollectingPlaylist::ResolveDependencies(const ServerObjectManager* library)
 	//   transitionClip
 	BList collectables;
 
+	// in lazy mode, only the resident objects would be found
+	library->LoadObjectsOfType("CollectablePlaylist");
+
 	int32 count = library->CountObjects();
 	for (int32 i = 0; i < count; i++) {
 		ServerObject* object = library->ObjectAtFast(i);
@@ -14,6 +14,7 @@
 #include "common.h"
 #include "support_date.h"
 
+#include "ClipPlaylistItem.h"
 #include "CommonPropertyIDs.h"
 #include "DurationProperty.h"
 #include "Icons.h"
@@ -519,6 +520,10 @@ Playlist::AddItem(PlaylistItem* item, int32 index)
 	AutoNotificationSuspender _(this);
 
 	if (item && fItems.AddItem((void*)item, index)) {
+		if (fBoundaryIndex.AddItem(item) < B_OK) {
+			fItems.RemoveItem(index);
+			return false;
+		}
 		item->SetParent(this);
 		_ItemsChanged();
 		_NotifyItemAdded(item, index);
@@ -535,6 +540,8 @@ Playlist::RemoveItem(int32 index)
 
 	PlaylistItem* item = (PlaylistItem*)fItems.RemoveItem(index);
 	if (item) {
+		fBoundaryIndex.RemoveItem(item, item->StartFrame(), item->EndFrame(),
+			item->Track());
 		item->SetParent(NULL);
 		_ItemsChanged();
 		_NotifyItemRemoved(item);
@@ -549,6 +556,8 @@ Playlist::RemoveItem(PlaylistItem* item)
 	AutoNotificationSuspender _(this);
 
 	if (fItems.RemoveItem((void*)item)) {
+		fBoundaryIndex.RemoveItem(item, item->StartFrame(), item->EndFrame(),
+			item->Track());
 		item->SetParent(NULL);
 		_ItemsChanged();
 		_NotifyItemRemoved(item);
@@ -604,6 +613,7 @@ Playlist::MakeEmpty()
 		delete item;
 	}
 	fItems.MakeEmpty();
+	fBoundaryIndex.MakeEmpty();
 
 	// delete track properties
 	count = CountTrackProperties();
@@ -981,6 +991,38 @@ Playlist::ItemsChanged()
 	_ItemsChanged();
 }
 
+// ItemBoundsChanged
+void
+Playlist::ItemBoundsChanged(PlaylistItem* item, int64 oldStartFrame,
+	int64 oldEndFrame, uint32 oldTrack)
+{
+	fBoundaryIndex.RemoveItem(item, oldStartFrame, oldEndFrame, oldTrack);
+	if (fBoundaryIndex.AddItem(item) < B_OK) {
+		print_error("Playlist::ItemBoundsChanged() - "
+			"no memory to index item!\n");
+	}
+}
+
+// ItemClipChanged
+void
+Playlist::ItemClipChanged(PlaylistItem* item, Clip* oldClip)
+{
+	_NotifyItemClipChanged(item, oldClip);
+}
+
+// StopObservingClips
+void
+Playlist::StopObservingClips()
+{
+	int32 count = CountItems();
+	for (int32 i = 0; i < count; i++) {
+		ClipPlaylistItem* item
+			= dynamic_cast<ClipPlaylistItem*>(ItemAtFast(i));
+		if (item)
+			item->StopObservingClip();
+	}
+}
+
 // GetFrameBounds
 void
 Playlist::GetFrameBounds(int64* firstFrame, int64* lastFrame) const
@@ -1147,6 +1189,18 @@ Playlist::_NotifyItemRemoved(PlaylistItem* item)
 	}
 }
 
+// _NotifyItemClipChanged
+void
+Playlist::_NotifyItemClipChanged(PlaylistItem* item, Clip* oldClip)
+{
+	int32 count = fObservers.CountItems();
+	for (int32 i = 0; i < count; i++) {
+		PlaylistObserver* observer =
+			(PlaylistObserver*)fObservers.ItemAtFast(i);
+		observer->ItemClipChanged(this, item, oldClip);
+	}
+}
+
 // _NotifyTrackPropertiesChanged
 void
 Playlist::_NotifyTrackPropertiesChanged(uint32 track)
@@ -11,6 +11,7 @@
 #include <String.h>
 
 #include "Clip.h"
+#include "PlaylistBoundaryIndex.h"
 
 class DurationProperty;
 class PlaylistItem;
@@ -131,6 +132,21 @@ public:
 			uint32				MaxTrack() const;
 
 			void				ItemsChanged();
+			void				ItemBoundsChanged(PlaylistItem* item,
+									int64 oldStartFrame, int64 oldEndFrame,
+									uint32 oldTrack);
+									// called by the item when it has been
+									// moved or resized
+			void				ItemClipChanged(PlaylistItem* item,
+									Clip* oldClip);
+									// called by the item when it uses
+									// another clip
+			void				StopObservingClips();
+									// for private copies, which are used
+									// without holding the document lock
+
+			const PlaylistBoundaryIndex& BoundaryIndex() const
+									{ return fBoundaryIndex; }
 
 			void				GetFrameBounds(int64* firstFrame,
 											   int64* lastFrame) const;
@@ -158,6 +174,8 @@ public:
 			void				_NotifyItemAdded(PlaylistItem* item,
 												 int32 index);
 			void				_NotifyItemRemoved(PlaylistItem* item);
+			void				_NotifyItemClipChanged(PlaylistItem* item,
+									Clip* oldClip);
 			void				_NotifyDurationChanged(uint64 duration);
 			void				_NotifyMaxTrackChanged(uint32 maxTrack);
 			void				_NotifyNotificationBlockStarted();
@@ -169,6 +187,7 @@ public:
 			void				_NotifyNotificationBlockFinished();
 
  			BList				fItems;
+			PlaylistBoundaryIndex fBoundaryIndex;
 
 			BList				fTrackProperties;
 			int32				fSoloTrack;
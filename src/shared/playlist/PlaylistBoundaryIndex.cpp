@@ -0,0 +1,228 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+#include "PlaylistBoundaryIndex.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "PlaylistItem.h"
+
+// constructor
+PlaylistBoundaryIndex::PlaylistBoundaryIndex()
+	: fBoundaries(NULL)
+	, fCount(0)
+	, fCapacity(0)
+{
+}
+
+// destructor
+PlaylistBoundaryIndex::~PlaylistBoundaryIndex()
+{
+	free(fBoundaries);
+}
+
+// AddItem
+//
+// Adds the start frame of the item and the frame after its end.
+status_t
+PlaylistBoundaryIndex::AddItem(const PlaylistItem* item)
+{
+	status_t ret = AddBoundary(item->StartFrame(), item->Track(), item);
+	if (ret < B_OK)
+		return ret;
+	ret = AddBoundary(item->EndFrame() + 1, item->Track(), item);
+	if (ret < B_OK)
+		RemoveBoundary(item->StartFrame(), item->Track(), item);
+	return ret;
+}
+
+// RemoveItem
+//
+// Removes the boundaries of the item, which it had at the given frames and
+// track. These may be different from the current ones, if the item has
+// just been changed.
+void
+PlaylistBoundaryIndex::RemoveItem(const PlaylistItem* item, int64 startFrame,
+	int64 endFrame, uint32 track)
+{
+	RemoveBoundary(startFrame, track, item);
+	RemoveBoundary(endFrame + 1, track, item);
+}
+
+// AddBoundary
+status_t
+PlaylistBoundaryIndex::AddBoundary(int64 frame, int32 track,
+	const PlaylistItem* item)
+{
+	if (fCount == fCapacity) {
+		status_t ret = _Resize(fCapacity > 0 ? fCapacity * 2 : 64);
+		if (ret < B_OK)
+			return ret;
+	}
+
+	// insert after the boundaries at the same frame
+	int32 index = IndexFor(frame + 1);
+	if (index < fCount) {
+		memmove(fBoundaries + index + 1, fBoundaries + index,
+			(fCount - index) * sizeof(playlist_boundary));
+	}
+	fBoundaries[index].frame = frame;
+	fBoundaries[index].track = track;
+	fBoundaries[index].item = item;
+	fCount++;
+
+	return B_OK;
+}
+
+// RemoveBoundary
+bool
+PlaylistBoundaryIndex::RemoveBoundary(int64 frame, int32 track,
+	const PlaylistItem* item)
+{
+	for (int32 i = IndexFor(frame); i < fCount; i++) {
+		playlist_boundary& boundary = fBoundaries[i];
+		if (boundary.frame != frame)
+			break;
+		if (boundary.track != track || boundary.item != item)
+			continue;
+
+		if (i < fCount - 1) {
+			memmove(fBoundaries + i, fBoundaries + i + 1,
+				(fCount - i - 1) * sizeof(playlist_boundary));
+		}
+		fCount--;
+		return true;
+	}
+	return false;
+}
+
+// MakeEmpty
+void
+PlaylistBoundaryIndex::MakeEmpty()
+{
+	fCount = 0;
+}
+
+// SetTo
+status_t
+PlaylistBoundaryIndex::SetTo(const PlaylistBoundaryIndex& other,
+	int64 firstFrame, int64 lastFrame)
+{
+	if (&other == this)
+		return B_BAD_VALUE;
+
+	int32 first = other.IndexFor(firstFrame);
+	int32 count = other.IndexFor(lastFrame + 1) - first;
+	if (count < 0)
+		count = 0;
+
+	fCount = 0;
+	if (count > fCapacity) {
+		status_t ret = _Resize(count);
+		if (ret < B_OK)
+			return ret;
+	}
+	if (count > 0) {
+		memcpy(fBoundaries, other.fBoundaries + first,
+			count * sizeof(playlist_boundary));
+	}
+	fCount = count;
+
+	return B_OK;
+}
+
+// IndexFor
+int32
+PlaylistBoundaryIndex::IndexFor(int64 frame) const
+{
+	int32 lower = 0;
+	int32 upper = fCount;
+	while (lower < upper) {
+		int32 mid = (lower + upper) / 2;
+		if (fBoundaries[mid].frame < frame)
+			lower = mid + 1;
+		else
+			upper = mid;
+	}
+	return lower;
+}
+
+// FindClosest
+bool
+PlaylistBoundaryIndex::FindClosest(int64 frame, int32 track,
+	int64* _frame) const
+{
+	int64 before;
+	int64 after;
+	bool foundBefore = FindBefore(frame, track, &before);
+	bool foundAfter = FindAfter(frame - 1, track, &after);
+		// at or after the frame
+
+	if (foundBefore && (!foundAfter || frame - before < after - frame))
+		*_frame = before;
+	else if (foundAfter)
+		*_frame = after;
+	else
+		return false;
+
+	return true;
+}
+
+// FindBefore
+//
+// Finds the closest boundary before, but not at the frame.
+bool
+PlaylistBoundaryIndex::FindBefore(int64 frame, int32 track,
+	int64* _frame) const
+{
+	for (int32 i = IndexFor(frame) - 1; i >= 0; i--) {
+		if (_Matches(i, track)) {
+			*_frame = fBoundaries[i].frame;
+			return true;
+		}
+	}
+	return false;
+}
+
+// FindAfter
+//
+// Finds the closest boundary after, but not at the frame.
+bool
+PlaylistBoundaryIndex::FindAfter(int64 frame, int32 track,
+	int64* _frame) const
+{
+	for (int32 i = IndexFor(frame + 1); i < fCount; i++) {
+		if (_Matches(i, track)) {
+			*_frame = fBoundaries[i].frame;
+			return true;
+		}
+	}
+	return false;
+}
+
+// #pragma mark -
+
+// _Matches
+bool
+PlaylistBoundaryIndex::_Matches(int32 index, int32 track) const
+{
+	int32 boundaryTrack = fBoundaries[index].track;
+	return track < 0 || boundaryTrack < 0 || boundaryTrack == track;
+}
+
+// _Resize
+status_t
+PlaylistBoundaryIndex::_Resize(int32 capacity)
+{
+	playlist_boundary* boundaries = (playlist_boundary*)realloc(fBoundaries,
+		capacity * sizeof(playlist_boundary));
+	if (!boundaries)
+		return B_NO_MEMORY;
+
+	fBoundaries = boundaries;
+	fCapacity = capacity;
+	return B_OK;
+}
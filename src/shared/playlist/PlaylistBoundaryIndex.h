@@ -0,0 +1,71 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+// The PlaylistBoundaryIndex holds the start frames and the frames after the
+// end of the items of a Playlist, sorted by frame. The Playlist updates it
+// whenever an item is added, removed, moved or resized, so finding the
+// boundary closest to a frame is a binary search. The boundaries can be
+// filtered by track, a boundary with a negative track belongs to all tracks.
+
+#ifndef PLAYLIST_BOUNDARY_INDEX_H
+#define PLAYLIST_BOUNDARY_INDEX_H
+
+#include <SupportDefs.h>
+
+class PlaylistItem;
+
+struct playlist_boundary {
+	int64				frame;
+	int32				track;
+	const PlaylistItem*	item;
+};
+
+class PlaylistBoundaryIndex {
+ public:
+								PlaylistBoundaryIndex();
+								~PlaylistBoundaryIndex();
+
+			status_t			AddItem(const PlaylistItem* item);
+			void				RemoveItem(const PlaylistItem* item,
+									int64 startFrame, int64 endFrame,
+									uint32 track);
+
+			status_t			AddBoundary(int64 frame, int32 track,
+									const PlaylistItem* item = NULL);
+			bool				RemoveBoundary(int64 frame, int32 track,
+									const PlaylistItem* item = NULL);
+
+			void				MakeEmpty();
+
+			// copies the boundaries within the given range
+			status_t			SetTo(const PlaylistBoundaryIndex& other,
+									int64 firstFrame, int64 lastFrame);
+
+			int32				CountBoundaries() const
+									{ return fCount; }
+			const playlist_boundary& BoundaryAt(int32 index) const
+									{ return fBoundaries[index]; }
+
+			// index of the first boundary at or after the frame
+			int32				IndexFor(int64 frame) const;
+
+			// pass a negative track to consider all tracks
+			bool				FindClosest(int64 frame, int32 track,
+									int64* _frame) const;
+			bool				FindBefore(int64 frame, int32 track,
+									int64* _frame) const;
+			bool				FindAfter(int64 frame, int32 track,
+									int64* _frame) const;
+
+ private:
+			bool				_Matches(int32 index, int32 track) const;
+			status_t			_Resize(int32 capacity);
+
+			playlist_boundary*	fBoundaries;
+			int32				fCount;
+			int32				fCapacity;
+};
+
+#endif // PLAYLIST_BOUNDARY_INDEX_H
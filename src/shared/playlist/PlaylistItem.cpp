@@ -226,7 +226,10 @@ PlaylistItem::SetStartFrame(int64 startFrame)
 {
 	startFrame -= fClipOffset;
 	if (fStartFrame != startFrame) {
+		int64 oldStartFrame = StartFrame();
+		int64 oldEndFrame = EndFrame();
 		fStartFrame = startFrame;
+		_BoundsChanged(oldStartFrame, oldEndFrame, fTrack);
 		Notify();
 	}
 }
@@ -237,7 +240,9 @@ PlaylistItem::SetDuration(uint64 duration)
 {
 	duration += fClipOffset;
 	if (fDuration != duration) {
+		int64 oldEndFrame = EndFrame();
 		fDuration = duration;
+		_BoundsChanged(StartFrame(), oldEndFrame, fTrack);
 
 		// keep the animators informed
 		int32 count = CountProperties();
@@ -278,7 +283,9 @@ PlaylistItem::SetClipOffset(uint64 offset)
 		offset = fDuration - 1;
 
 	if (fClipOffset != offset) {
+		int64 oldStartFrame = StartFrame();
 		fClipOffset = offset;
+		_BoundsChanged(oldStartFrame, EndFrame(), fTrack);
 		Notify();
 	}
 }
@@ -288,7 +295,9 @@ void
 PlaylistItem::SetTrack(uint32 track)
 {
 	if (fTrack != track) {
+		uint32 oldTrack = fTrack;
 		fTrack = track;
+		_BoundsChanged(StartFrame(), EndFrame(), oldTrack);
 		Notify();
 	}
 }
@@ -404,3 +413,13 @@ PlaylistItem::_CreateProperties()
 	AddProperty(fScaleX);
 	AddProperty(fScaleY);
 }
+
+// _BoundsChanged
+void
+PlaylistItem::_BoundsChanged(int64 oldStartFrame, int64 oldEndFrame,
+	uint32 oldTrack)
+{
+	// keep the boundary index of the playlist up to date
+	if (fParent)
+		fParent->ItemBoundsChanged(this, oldStartFrame, oldEndFrame, oldTrack);
+}
@@ -128,6 +128,8 @@ public:
 
  private:
 			void				_CreateProperties();
+			void				_BoundsChanged(int64 oldStartFrame,
+									int64 oldEndFrame, uint32 oldTrack);
 
 			Playlist*			fParent;
 
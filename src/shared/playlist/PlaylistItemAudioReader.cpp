@@ -5,14 +5,21 @@
 
 #include "PlaylistItemAudioReader.h"
 
+#include <math.h>
 #include <stdio.h>
 
 #include <MediaTrack.h>
 
+#include "ClipPlaylistItem.h"
 #include "CommonPropertyIDs.h"
+#include "MediaClip.h"
 #include "PlaylistItem.h"
 #include "PropertyAnimator.h"
 
+// the loudness clips are raised to by the auto gain, a bit louder than
+// the -23 LUFS of EBU R128, which is meant for broadcast with quiet scenes
+static const float kAutoGainTargetLoudness = -18.0;
+
 // constructor
 PlaylistItemAudioReader::PlaylistItemAudioReader(PlaylistItem* item,
 		AudioReader* reader)
@@ -84,21 +91,17 @@ scale_linear(sample* buffer, uint32 channelCount, int32 frames,
 	}
 }
 
-// Read
-status_t
-PlaylistItemAudioReader::Read(void* buffer, int64 pos, int64 frames)
+// _MeasureBufferGain
+//
+// Estimates the gain from the peak of the buffer, smoothed over the
+// previous buffers.
+void
+PlaylistItemAudioReader::_MeasureBufferGain(void* buffer, int64 frames,
+	float maxAutoGain, float* _lastGain, float* _wantedGain)
 {
-//printf("PlaylistItemAudioReader::Read(%p, %lld, %lld)\n", buffer, pos, frames);
-
-	pos += OutOffset();
-	status_t ret = fSource->Read(buffer, pos, frames);
-	if (ret < B_OK)
-		return ret;
-
 	uint32 channelCount = fFormat.u.raw_audio.channel_count;
 
 	float possibleGain = 1.0;
-	float maxAutoGain = fItem->Value(PROPERTY_MAX_AUTO_GAIN, (float)1.0);
 
 	// calculate the max possible gain for this buffer
 	if (maxAutoGain > 1.0) {
@@ -148,8 +151,36 @@ PlaylistItemAudioReader::Read(void* buffer, int64 pos, int64 frames)
 	}
 	wantedGain /= MAX_GAIN_VALUES;
 	wantedGain = min_c(possibleGain, wantedGain);
-	float lastGain = min_c(possibleGain, fLastGain);
+	*_lastGain = min_c(possibleGain, fLastGain);
+	*_wantedGain = wantedGain;
 	fLastGain = wantedGain;
+}
+
+// ReadUnscaled
+status_t
+PlaylistItemAudioReader::ReadUnscaled(void* buffer, int64 pos, int64 frames,
+	float* _startGain, float* _endGain)
+{
+//printf("PlaylistItemAudioReader::ReadUnscaled(%p, %lld, %lld)\n", buffer, pos, frames);
+
+	*_startGain = 1.0;
+	*_endGain = 1.0;
+
+	pos += OutOffset();
+	status_t ret = fSource->Read(buffer, pos, frames);
+	if (ret < B_OK)
+		return ret;
+
+	float maxAutoGain = fItem->Value(PROPERTY_MAX_AUTO_GAIN, (float)1.0);
+
+	float lastGain = fLastGain;
+	float wantedGain;
+	if (maxAutoGain > 1.0 && _GetClipGain(maxAutoGain, &wantedGain)) {
+		// the loudness of the whole clip is known, so a constant gain
+		// is used, it is ramped to only when it just became known
+		fLastGain = wantedGain;
+	} else
+		_MeasureBufferGain(buffer, frames, maxAutoGain, &lastGain, &wantedGain);
 
 //printf("using gain: %.2f\n", wantedGain);
 
@@ -162,8 +193,23 @@ PlaylistItemAudioReader::Read(void* buffer, int64 pos, int64 frames)
 	float itemStartFrame = pos * videoFPS / audioFPS;
 	float itemEndFrame = (pos + frames) * videoFPS / audioFPS;
 	// get the "scale/alpha/whatever" at those frames
-	float startScale = animator->ScaleAtFloat(itemStartFrame) * lastGain;
-	float endScale = animator->ScaleAtFloat(itemEndFrame) * wantedGain;
+	*_startGain = animator->ScaleAtFloat(itemStartFrame) * lastGain;
+	*_endGain = animator->ScaleAtFloat(itemEndFrame) * wantedGain;
+	return B_OK;
+}
+
+// Read
+status_t
+PlaylistItemAudioReader::Read(void* buffer, int64 pos, int64 frames)
+{
+	float startScale;
+	float endScale;
+	status_t ret = ReadUnscaled(buffer, pos, frames, &startScale, &endScale);
+	if (ret < B_OK)
+		return ret;
+
+	uint32 channelCount = fFormat.u.raw_audio.channel_count;
+
 	if (startScale == 1.0 && endScale == 1.0)
 		return B_OK;
 	else if (startScale == 0.0 && endScale == 0.0)
@@ -228,3 +274,39 @@ PlaylistItemAudioReader::InitCheck() const
 {
 	return fItem && fSource ? fSource->InitCheck() : B_NO_INIT;
 }
+
+// SetItem
+//
+// The reader is reused for the copies of the same item in newer snapshots
+// of the playlist.
+void
+PlaylistItemAudioReader::SetItem(PlaylistItem* item)
+{
+	fItem = item;
+}
+
+// _GetClipGain
+//
+// Calculates the gain which raises the clip to the target loudness, as far
+// as the peak of the clip and the maximum auto gain allow. Returns false
+// if the loudness of the clip has not been measured (yet).
+bool
+PlaylistItemAudioReader::_GetClipGain(float maxAutoGain, float* _gain) const
+{
+	ClipPlaylistItem* clipItem = dynamic_cast<ClipPlaylistItem*>(fItem);
+	MediaClip* clip = clipItem
+		? dynamic_cast<MediaClip*>(clipItem->Clip()) : NULL;
+
+	float peak;
+	float loudness;
+	if (!clip || !clip->GetAudioLoudness(&peak, &loudness))
+		return false;
+
+	float gain = powf(10.0, (kAutoGainTargetLoudness - loudness) / 20.0);
+	if (peak > 0.0)
+		gain = min_c(gain, 1.0 / peak);
+	gain = min_c(gain, maxAutoGain);
+
+	*_gain = max_c(gain, 1.0);
+	return true;
+}
@@ -19,10 +19,21 @@ class PlaylistItemAudioReader : public AudioReader {
 	virtual						~PlaylistItemAudioReader();
 
 	virtual	status_t			Read(void* buffer, int64 pos, int64 frames);
+	virtual	status_t			ReadUnscaled(void* buffer, int64 pos,
+									int64 frames, float* _startGain,
+									float* _endGain);
 
 	virtual	status_t			InitCheck() const;
 
+			void				SetItem(PlaylistItem* item);
+
  private:
+			void				_MeasureBufferGain(void* buffer,
+									int64 frames, float maxAutoGain,
+									float* _lastGain, float* _wantedGain);
+			bool				_GetClipGain(float maxAutoGain,
+									float* _gain) const;
+
 			AudioReader*		fSource;
 			PlaylistItem*		fItem;
 
@@ -28,6 +28,13 @@ PlaylistObserver::ItemRemoved(Playlist* playlist, PlaylistItem* item)
 {
 }
 
+// ItemClipChanged
+void
+PlaylistObserver::ItemClipChanged(Playlist* playlist, PlaylistItem* item,
+	Clip* oldClip)
+{
+}
+
 // DurationChanged
 void
 PlaylistObserver::DurationChanged(Playlist* playlist, uint64 duration)
@@ -8,6 +8,7 @@
 
 #include <SupportDefs.h>
 
+class Clip;
 class Playlist;
 class PlaylistItem;
 
@@ -20,6 +21,8 @@ class PlaylistObserver {
 									PlaylistItem* item, int32 index);
 	virtual	void				ItemRemoved(Playlist* playlist,
 									PlaylistItem* item);
+	virtual	void				ItemClipChanged(Playlist* playlist,
+									PlaylistItem* item, Clip* oldClip);
 
 	virtual	void				DurationChanged(Playlist* playlist,
 									uint64 duration);
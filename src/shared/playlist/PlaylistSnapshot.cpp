@@ -0,0 +1,425 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+#include "PlaylistSnapshot.h"
+
+#include <new>
+
+#include <Locker.h>
+
+#include "AutoLocker.h"
+#include "ClipPlaylistItem.h"
+#include "KeyFrame.h"
+#include "Playlist.h"
+#include "Property.h"
+#include "PropertyAnimator.h"
+#include "RWLocker.h"
+#include "TrackProperties.h"
+
+using std::nothrow;
+
+// the latest snapshot of each playlist, which is handed out to all
+// consumers of the same document until the document is changed
+struct SharedSnapshot {
+	const RWLocker*		locker;
+	int32				subPlaylistLevels;
+	PlaylistSnapshot*	snapshot;
+};
+
+static BLocker sSharedSnapshotsLock("playlist snapshots");
+static BList sSharedSnapshots(8);
+
+// the copies of the snapshots which have been released,
+// guarded by sSharedSnapshotsLock as well
+static BList sReleasedPlaylists(8);
+
+// find_shared_snapshot
+static SharedSnapshot*
+find_shared_snapshot(const RWLocker* locker, const Playlist* playlist,
+	int32 subPlaylistLevels)
+{
+	int32 count = sSharedSnapshots.CountItems();
+	for (int32 i = 0; i < count; i++) {
+		SharedSnapshot* shared
+			= (SharedSnapshot*)sSharedSnapshots.ItemAtFast(i);
+		if (shared->locker == locker
+			&& shared->subPlaylistLevels == subPlaylistLevels
+			&& shared->snapshot->Source() == playlist) {
+			return shared;
+		}
+	}
+	return NULL;
+}
+
+// prune_shared_snapshots
+//
+// Forgets the snapshots which are not used by any consumer anymore.
+static void
+prune_shared_snapshots()
+{
+	for (int32 i = sSharedSnapshots.CountItems() - 1; i >= 0; i--) {
+		SharedSnapshot* shared
+			= (SharedSnapshot*)sSharedSnapshots.ItemAtFast(i);
+		if (shared->snapshot->CountReferences() > 1)
+			continue;
+		sSharedSnapshots.RemoveItem(i);
+		shared->snapshot->Release();
+		delete shared;
+	}
+}
+
+// same_animation
+static bool
+same_animation(const PropertyAnimator* a, const PropertyAnimator* b)
+{
+	if (!a || !b)
+		return a == b;
+
+	int32 count = a->CountKeyFrames();
+	if (count != b->CountKeyFrames())
+		return false;
+	for (int32 i = 0; i < count; i++) {
+		KeyFrame* keyA = a->KeyFrameAtFast(i);
+		KeyFrame* keyB = b->KeyFrameAtFast(i);
+		if (keyA->Frame() != keyB->Frame()
+			|| !keyA->Property()->Equals(keyB->Property())) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// same_properties
+static bool
+same_properties(const PropertyObject* a, const PropertyObject* b)
+{
+	int32 count = a->CountProperties();
+	if (count != b->CountProperties())
+		return false;
+	for (int32 i = 0; i < count; i++) {
+		Property* propertyA = a->PropertyAtFast(i);
+		Property* propertyB = b->PropertyAtFast(i);
+		if (propertyA->Identifier() != propertyB->Identifier()
+			|| !propertyA->Equals(propertyB)
+			|| !same_animation(propertyA->Animator(),
+				propertyB->Animator())) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// same_item
+static bool
+same_item(const PlaylistItem* a, const PlaylistItem* b)
+{
+	// other kinds of items are never considered unchanged
+	const ClipPlaylistItem* clipItemA
+		= dynamic_cast<const ClipPlaylistItem*>(a);
+	const ClipPlaylistItem* clipItemB
+		= dynamic_cast<const ClipPlaylistItem*>(b);
+	if (!clipItemA || !clipItemB || clipItemA->Clip() != clipItemB->Clip())
+		return false;
+
+	return a->StartFrame() == b->StartFrame()
+		&& a->Duration() == b->Duration()
+		&& a->ClipOffset() == b->ClipOffset()
+		&& a->Track() == b->Track()
+		&& a->IsVideoMuted() == b->IsVideoMuted()
+		&& a->IsAudioMuted() == b->IsAudioMuted()
+		&& same_properties(a, b);
+}
+
+// same_playlist
+//
+// Compares a copy of a playlist with the original without allocating
+// anything, which is a lot cheaper than copying it again.
+static bool
+same_playlist(const Playlist* a, const Playlist* b)
+{
+	int32 count = a->CountItems();
+	if (count != b->CountItems()
+		|| a->SoloTrack() != b->SoloTrack()
+		|| a->CountTrackProperties() != b->CountTrackProperties()
+		|| !same_properties(a, b)) {
+		return false;
+	}
+
+	int32 trackCount = a->CountTrackProperties();
+	for (int32 i = 0; i < trackCount; i++) {
+		if (*a->TrackPropertiesAtFast(i) != *b->TrackPropertiesAtFast(i))
+			return false;
+	}
+
+	for (int32 i = 0; i < count; i++) {
+		if (!same_item(a->ItemAtFast(i), b->ItemAtFast(i)))
+			return false;
+	}
+	return true;
+}
+
+// #pragma mark -
+
+// constructor
+PlaylistSnapshot::PlaylistSnapshot(const ::Playlist* playlist,
+		int32 generation, int32 subPlaylistLevels,
+		const PlaylistSnapshot* previous)
+	: Referencable()
+	, fSource(playlist)
+	, fPlaylist(new (nothrow) ::Playlist(*playlist, true))
+	, fOriginalItems(64)
+	, fSubPlaylists(64)
+	, fGeneration(generation)
+{
+	if (!fPlaylist || fPlaylist->CountItems() != playlist->CountItems())
+		return;
+
+	fPlaylist->StopObservingClips();
+
+	// the copies are in the same order as the original items
+	int32 count = playlist->CountItems();
+	for (int32 i = 0; i < count; i++) {
+		if (!fOriginalItems.AddItem((void*)playlist->ItemAtFast(i)))
+			return;
+	}
+
+	if (subPlaylistLevels <= 0)
+		return;
+
+	// sub-playlists are shared clips, which may be changed by the user
+	// while the snapshot is in use, so they need a snapshot of their own.
+	// A sub-playlist which is used more than once, or which has not been
+	// changed since the previous snapshot, shares the existing one.
+	for (int32 i = 0; i < count; i++) {
+		ClipPlaylistItem* item
+			= dynamic_cast<ClipPlaylistItem*>(fPlaylist->ItemAtFast(i));
+		::Playlist* subPlaylist
+			= item ? dynamic_cast< ::Playlist*>(item->Clip()) : NULL;
+		PlaylistSnapshot* snapshot = NULL;
+		if (subPlaylist) {
+			PlaylistSnapshot* previousSnapshot = previous
+				? previous->_FindSubPlaylist(subPlaylist) : NULL;
+			snapshot = _FindSubPlaylist(subPlaylist);
+			if (!snapshot && previousSnapshot
+				&& previousSnapshot->_Matches(subPlaylist)) {
+				snapshot = previousSnapshot;
+			}
+
+			if (snapshot)
+				snapshot->Acquire();
+			else {
+				snapshot = new (nothrow) PlaylistSnapshot(subPlaylist,
+					generation, subPlaylistLevels - 1, previousSnapshot);
+				if (snapshot && snapshot->InitCheck() < B_OK) {
+					snapshot->Release();
+					snapshot = NULL;
+				}
+			}
+		}
+		if (!fSubPlaylists.AddItem(snapshot)) {
+			if (snapshot)
+				snapshot->Release();
+			return;
+		}
+	}
+}
+
+// destructor
+PlaylistSnapshot::~PlaylistSnapshot()
+{
+	int32 count = fSubPlaylists.CountItems();
+	for (int32 i = 0; i < count; i++) {
+		PlaylistSnapshot* snapshot
+			= (PlaylistSnapshot*)fSubPlaylists.ItemAtFast(i);
+		if (snapshot)
+			snapshot->Release();
+	}
+
+	// the last reference may be released by any thread
+	if (fPlaylist) {
+		AutoLocker<BLocker> locker(sSharedSnapshotsLock);
+		if (!sReleasedPlaylists.AddItem(fPlaylist))
+			fPlaylist->Release();
+	}
+}
+
+// InitCheck
+status_t
+PlaylistSnapshot::InitCheck() const
+{
+	if (!fPlaylist)
+		return B_NO_MEMORY;
+	if (fOriginalItems.CountItems() != fPlaylist->CountItems())
+		return B_NO_MEMORY;
+	return B_OK;
+}
+
+// OriginalItemAt
+const PlaylistItem*
+PlaylistSnapshot::OriginalItemAt(int32 index) const
+{
+	return (const PlaylistItem*)fOriginalItems.ItemAt(index);
+}
+
+// SubPlaylistAt
+PlaylistSnapshot*
+PlaylistSnapshot::SubPlaylistAt(int32 index) const
+{
+	return (PlaylistSnapshot*)fSubPlaylists.ItemAt(index);
+}
+
+// Update
+//
+// Replaces the snapshot with a new one, if it was taken from another
+// playlist or before the last change to the document. Without a locker,
+// the playlist is supposed to never change. The consumers of the same
+// document share the snapshots; without a locker, that is not possible,
+// since the playlist could have been replaced by another one at the same
+// address.
+status_t
+PlaylistSnapshot::Update(PlaylistSnapshot** _snapshot,
+	const ::Playlist* playlist, const RWLocker* locker,
+	int32 subPlaylistLevels)
+{
+	PlaylistSnapshot* snapshot = *_snapshot;
+	int32 generation = locker ? locker->WriteGeneration() : 0;
+	if (snapshot && snapshot->Source() == playlist
+		&& snapshot->Generation() == generation) {
+		return B_OK;
+	}
+
+	AutoLocker<BLocker> sharedLocker(locker && playlist
+		? &sSharedSnapshotsLock : NULL);
+	SharedSnapshot* shared = locker && playlist
+		? find_shared_snapshot(locker, playlist, subPlaylistLevels) : NULL;
+
+	PlaylistSnapshot* newSnapshot = NULL;
+	status_t ret = B_OK;
+	if (shared && shared->snapshot->Generation() == generation) {
+		// another consumer has already taken this snapshot
+		newSnapshot = shared->snapshot;
+		newSnapshot->Acquire();
+	} else if (playlist) {
+		const PlaylistSnapshot* previous = shared ? shared->snapshot
+			: (snapshot && snapshot->Source() == playlist ? snapshot : NULL);
+		newSnapshot = new (nothrow) PlaylistSnapshot(playlist, generation,
+			subPlaylistLevels, previous);
+		ret = newSnapshot ? newSnapshot->InitCheck() : B_NO_MEMORY;
+		if (ret < B_OK) {
+			if (newSnapshot)
+				newSnapshot->Release();
+			// an outdated snapshot of the same playlist is still
+			// better than nothing
+			if (snapshot && snapshot->Source() == playlist)
+				return ret;
+			newSnapshot = NULL;
+		}
+	}
+
+	if (newSnapshot && sharedLocker.IsLocked()
+		&& (!shared || shared->snapshot != newSnapshot)) {
+		if (!shared) {
+			shared = new (nothrow) SharedSnapshot;
+			if (shared) {
+				shared->locker = locker;
+				shared->subPlaylistLevels = subPlaylistLevels;
+				shared->snapshot = NULL;
+				if (!sSharedSnapshots.AddItem(shared)) {
+					delete shared;
+					shared = NULL;
+				}
+			}
+		}
+		if (shared) {
+			if (shared->snapshot)
+				shared->snapshot->Release();
+			shared->snapshot = newSnapshot;
+			newSnapshot->Acquire();
+		}
+	}
+
+	if (snapshot)
+		snapshot->Release();
+	*_snapshot = newSnapshot;
+
+	if (sharedLocker.IsLocked())
+		prune_shared_snapshots();
+
+	DeleteReleased();
+
+	return ret;
+}
+
+// DeleteReleased
+//
+// Deletes the copies of the released snapshots, which may release
+// the last references to clips of the document.
+void
+PlaylistSnapshot::DeleteReleased()
+{
+	AutoLocker<BLocker> locker(sSharedSnapshotsLock);
+
+	for (int32 i = sReleasedPlaylists.CountItems() - 1; i >= 0; i--)
+		((::Playlist*)sReleasedPlaylists.ItemAtFast(i))->Release();
+	sReleasedPlaylists.MakeEmpty();
+}
+
+// ReleaseSnapshot
+//
+// Releases the snapshot of a consumer which goes away, and deletes
+// the copies of the snapshots which are not used anymore.
+void
+PlaylistSnapshot::ReleaseSnapshot(PlaylistSnapshot** _snapshot,
+	RWLocker* locker)
+{
+	if (*_snapshot) {
+		(*_snapshot)->Release();
+		*_snapshot = NULL;
+	}
+
+	if (!locker || locker->ReadLock()) {
+		DeleteReleased();
+		if (locker)
+			locker->ReadUnlock();
+	}
+}
+
+// #pragma mark -
+
+// _FindSubPlaylist
+PlaylistSnapshot*
+PlaylistSnapshot::_FindSubPlaylist(const ::Playlist* source) const
+{
+	int32 count = fSubPlaylists.CountItems();
+	for (int32 i = 0; i < count; i++) {
+		PlaylistSnapshot* snapshot
+			= (PlaylistSnapshot*)fSubPlaylists.ItemAtFast(i);
+		if (snapshot && snapshot->Source() == source)
+			return snapshot;
+	}
+	return NULL;
+}
+
+// _Matches
+//
+// Returns whether the playlist still has the contents it had when the
+// snapshot was taken, including those of its sub-playlists.
+bool
+PlaylistSnapshot::_Matches(const ::Playlist* playlist) const
+{
+	if (playlist != fSource || InitCheck() < B_OK
+		|| !same_playlist(fPlaylist, playlist)) {
+		return false;
+	}
+
+	int32 count = fSubPlaylists.CountItems();
+	for (int32 i = 0; i < count; i++) {
+		PlaylistSnapshot* snapshot
+			= (PlaylistSnapshot*)fSubPlaylists.ItemAtFast(i);
+		if (snapshot && !snapshot->_Matches(snapshot->Source()))
+			return false;
+	}
+	return true;
+}
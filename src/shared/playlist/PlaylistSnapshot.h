@@ -0,0 +1,81 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+// A PlaylistSnapshot is an immutable copy of a Playlist. It is taken while
+// the document is read locked and tagged with the write generation of the
+// document lock at that time. The playback threads render and mix from the
+// snapshot, so they need the lock only for taking a new snapshot after the
+// document has actually been changed, and they never have to wait for a
+// writer. The items are copied, the clips are shared with the original.
+// The copied items don't observe the clips, so that changes to the clips
+// never reach a snapshot which is being read. Since the copies hold
+// references to the clips of the document, the copies of released
+// snapshots are deleted only by DeleteReleased(), which needs the
+// document to be locked.
+//
+// Renderers and audio readers are cached per item across snapshots, so the
+// snapshot remembers the original item of each copy. These pointers serve
+// as keys only, the original items may have been deleted in the meantime.
+//
+// Snapshots are shared: consumers of the same playlist and generation get
+// the same snapshot from Update(), and the snapshot of a sub-playlist is
+// taken over from the previous snapshot as long as the sub-playlist still
+// has the same contents.
+
+#ifndef PLAYLIST_SNAPSHOT_H
+#define PLAYLIST_SNAPSHOT_H
+
+#include <List.h>
+
+#include "Referencable.h"
+
+class Playlist;
+class PlaylistItem;
+class RWLocker;
+
+class PlaylistSnapshot : public Referencable {
+ public:
+								PlaylistSnapshot(const ::Playlist* playlist,
+									int32 generation,
+									int32 subPlaylistLevels = 0,
+									const PlaylistSnapshot* previous = NULL);
+	virtual						~PlaylistSnapshot();
+
+			status_t			InitCheck() const;
+
+			int32				Generation() const
+									{ return fGeneration; }
+			const ::Playlist*	Source() const
+									{ return fSource; }
+			::Playlist*			Playlist() const
+									{ return fPlaylist; }
+
+			const PlaylistItem*	OriginalItemAt(int32 index) const;
+			PlaylistSnapshot*	SubPlaylistAt(int32 index) const;
+
+	// need to be called with the locker read locked (if there is one)
+	static	status_t			Update(PlaylistSnapshot** _snapshot,
+									const ::Playlist* playlist,
+									const RWLocker* locker,
+									int32 subPlaylistLevels = 0);
+	static	void				DeleteReleased();
+
+	// takes the read lock itself
+	static	void				ReleaseSnapshot(PlaylistSnapshot** _snapshot,
+									RWLocker* locker);
+
+ private:
+			PlaylistSnapshot*	_FindSubPlaylist(
+									const ::Playlist* source) const;
+			bool				_Matches(const ::Playlist* playlist) const;
+
+			const ::Playlist*	fSource;
+			::Playlist*			fPlaylist;
+			BList				fOriginalItems;
+			BList				fSubPlaylists;
+			int32				fGeneration;
+};
+
+#endif // PLAYLIST_SNAPSHOT_H
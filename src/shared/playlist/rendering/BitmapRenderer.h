@@ -10,8 +10,8 @@
 
 #include "ClipRenderer.h"
 
-class BBitmap;
 class BitmapClip;
+class DecodedImage;
 class MemoryBuffer;
 
 class BitmapRenderer : public ClipRenderer {
@@ -29,11 +29,9 @@ class BitmapRenderer : public ClipRenderer {
 	virtual	void				Sync();
 
  private:
-			void				_ConvertToYCbRr(const BBitmap* src,
-												MemoryBuffer* dst);
-
 			BitmapClip*			fClip;
-			MemoryBuffer*		fBuffer;
+			DecodedImage*		fImage;
+			const MemoryBuffer*	fBuffer;
 			uint32				fFadeMode;
 };
 
@@ -53,6 +53,17 @@ ClipRenderer::IsSolid(double frame) const
 	return false;
 }
 
+// SetItem
+//
+// The renderer is kept across snapshots of the playlist, each of which
+// contains its own copy of the item. It has to be pointed at the current
+// copy before anything else is done with it.
+void
+ClipRenderer::SetItem(ClipPlaylistItem* item)
+{
+	fItem = item;
+}
+
 // NeedsReload
 bool
 ClipRenderer::NeedsReload() const
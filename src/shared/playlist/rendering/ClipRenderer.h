@@ -32,9 +32,9 @@ class ClipRenderer : public Referencable {
 			int64				Duration() const
 									{ return fDuration; }
 
+			void				SetItem(ClipPlaylistItem* item);
 			bool				NeedsReload() const;
 
-	// debugging only:
 			const ::Clip*		Clip() const
 									{ return fClip; }
 
@@ -0,0 +1,409 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+#include "DecodedImageCache.h"
+
+#include <new>
+#include <stdio.h>
+#include <string.h>
+
+#include <Bitmap.h>
+#include <TranslationUtils.h>
+
+#include "support_ui.h"
+
+#include "AutoDeleter.h"
+#include "AutoLocker.h"
+#include "BitmapClip.h"
+#include "MemoryBuffer.h"
+
+using std::nothrow;
+
+// constructor
+DecodedImage::DecodedImage(MemoryBuffer* buffer)
+	: Referencable()
+	, fBuffer(buffer)
+{
+}
+
+// destructor
+DecodedImage::~DecodedImage()
+{
+	delete fBuffer;
+}
+
+// MemoryUsage
+size_t
+DecodedImage::MemoryUsage() const
+{
+	// the mip levels, which are generated when the image is drawn
+	// scaled down, add up to another third of the buffer size
+	size_t bytes = fBuffer->BytesPerRow() * fBuffer->Height();
+	return sizeof(DecodedImage) + sizeof(MemoryBuffer) + bytes + bytes / 3;
+}
+
+// #pragma mark -
+
+DecodedImageCache*
+DecodedImageCache::sDefaultCache = NULL;
+
+// constructor
+DecodedImageCache::DecodedImageCache(size_t memoryLimit)
+	: fLock("decoded image cache")
+	, fEntries()
+	, fLRU()
+	, fMemoryUsage(0)
+	, fMemoryLimit(memoryLimit)
+{
+}
+
+// destructor
+DecodedImageCache::~DecodedImageCache()
+{
+	while (Entry* entry = fLRU.GetFirst())
+		_RemoveEntry(entry);
+}
+
+// InitCheck
+status_t
+DecodedImageCache::InitCheck() const
+{
+	if (fLock.Sem() < B_OK)
+		return fLock.Sem();
+	return fEntries.InitCheck();
+}
+
+// CreateDefault
+DecodedImageCache*
+DecodedImageCache::CreateDefault()
+{
+	if (!sDefaultCache) {
+		sDefaultCache = new (nothrow) DecodedImageCache();
+		if (sDefaultCache && sDefaultCache->InitCheck() != B_OK)
+			DeleteDefault();
+	}
+	return sDefaultCache;
+}
+
+// DeleteDefault
+void
+DecodedImageCache::DeleteDefault()
+{
+	delete sDefaultCache;
+	sDefaultCache = NULL;
+}
+
+// Default
+DecodedImageCache*
+DecodedImageCache::Default()
+{
+	return sDefaultCache;
+}
+
+// GetImage
+DecodedImage*
+DecodedImageCache::GetImage(BitmapClip* clip, color_space renderFormat)
+{
+	if (!clip)
+		return NULL;
+
+	BString key = _KeyFor(clip, renderFormat);
+
+	AutoLocker<BLocker> locker(fLock);
+
+	DecodedImage* image = _Lookup(key);
+	if (image)
+		return image;
+
+	// decoding can take a while, don't block the other renderers,
+	// if someone else was faster, his image is used instead of ours
+	locker.Unlock();
+	image = Decode(clip, renderFormat);
+	if (!image)
+		return NULL;
+	locker.Lock();
+
+	return _Insert(key, image);
+}
+
+// Decode
+/*static*/ DecodedImage*
+DecodedImageCache::Decode(BitmapClip* clip, color_space renderFormat)
+{
+	BBitmap* bitmap = NULL;
+	try {
+		bitmap = BTranslationUtils::GetBitmap(clip->Ref());
+	} catch (...) {
+		return NULL;
+	}
+
+	ObjectDeleter<BBitmap> bitmapDeleter(bitmap);
+
+	if (!bitmap || bitmap->InitCheck() < B_OK)
+		return NULL;
+
+	pixel_format format = (pixel_format)bitmap->ColorSpace();
+	uint32 width = bitmap->Bounds().IntegerWidth() + 1;
+	uint32 height = bitmap->Bounds().IntegerHeight() + 1;
+	uint32 bpr = bitmap->BytesPerRow();
+
+	// NOTE: YCbCr422 is not directly supported, Painter knows
+	// how to render both, if the format is either 422 or 444
+	if ((pixel_format)renderFormat == YCbCr444
+		|| (pixel_format)renderFormat == YCbCr422) {
+		if (bitmap->ColorSpace() == B_RGBA32) {
+			// we need an alpha channel
+			format = YCbCrA;
+			bpr = width * 4;
+		} else {
+			format = YCbCr444;
+			bpr = ((width * 3 + 3) / 4) * 4;
+		}
+	}
+
+	// see if the alpha channel is used at all
+	uint8* src = (uint8*)bitmap->Bits();
+	uint32 srcBPR = bitmap->BytesPerRow();
+
+	if ((pixel_format)bitmap->ColorSpace() == BGRA32) {
+		bool hasAlpha = false;
+		for (uint32 y = 0; y < height && !hasAlpha; y++) {
+			uint8* s = src;
+			for (uint32 x = 0; x < width; x++) {
+				if (s[3] < 255) {
+					hasAlpha = true;
+					break;
+				}
+				s += 4;
+			}
+			src += srcBPR;
+		}
+		// override target format by removing superfluous alpha channel
+		if (!hasAlpha) {
+			if (format == YCbCrA) {
+				format = YCbCr444;
+				bpr = ((width * 3 + 3) / 4) * 4;
+			} else {
+				format = BGR32;
+			}
+		}
+	}
+
+	MemoryBuffer* buffer = new (nothrow) MemoryBuffer(width, height,
+		format, bpr);
+	ObjectDeleter<MemoryBuffer> bufferDeleter(buffer);
+
+	status_t ret = buffer ? buffer->InitCheck() : B_NO_MEMORY;
+	if (ret < B_OK) {
+		printf("DecodedImageCache::Decode() - failed to create buffer: %s\n",
+			   strerror(ret));
+		return NULL;
+	}
+
+	if (((pixel_format)bitmap->ColorSpace() == BGR32
+		 || (pixel_format)bitmap->ColorSpace() == BGRA32)
+		&& (format == BGR32 || format == BGRA32)) {
+		// copy contents of the bitmap
+		uint32 bytes = min_c(srcBPR, bpr);
+		src = (uint8*)bitmap->Bits();
+		uint8* dst = (uint8*)buffer->Bits();
+		if (format == BGR32 && (pixel_format)bitmap->ColorSpace() == format) {
+			for (uint32 i = 0; i < height; i++) {
+				memcpy(dst, src, bytes);
+				dst += bpr;
+				src += srcBPR;
+			}
+		} else {
+			for (uint32 y = 0; y < height; y++) {
+				uint8* d = dst;
+				uint8* s = src;
+				if ((pixel_format)bitmap->ColorSpace() == BGRA32) {
+					// bitmap has alpha channel, pre-multiply
+					for (uint32 x = 0; x < width; x++) {
+						if (s[3] < 255) {
+							d[0] = (s[0] * s[3]) >> 8;
+							d[1] = (s[1] * s[3]) >> 8;
+							d[2] = (s[2] * s[3]) >> 8;
+						} else {
+							d[0] = s[0];
+							d[1] = s[1];
+							d[2] = s[2];
+						}
+						d[3] = s[3];
+						d += 4;
+						s += 4;
+					}
+				} else {
+					// ignore bitmap alpha channel
+					for (uint32 x = 0; x < width; x++) {
+						d[0] = s[0];
+						d[1] = s[1];
+						d[2] = s[2];
+						d[3] = 255;
+						d += 4;
+						s += 4;
+					}
+				}
+				dst += bpr;
+				src += srcBPR;
+			}
+		}
+	} else {
+		// convert bitmap to correct colorspace
+		if (format == YCbCr444 || format == YCbCrA)
+			_ConvertToYCbRr(bitmap, buffer);
+	}
+
+	// the buffer is never changed from now on
+	buffer->EnableMipMaps();
+
+	DecodedImage* image = new (nothrow) DecodedImage(buffer);
+	if (image)
+		bufferDeleter.Detach();
+	return image;
+}
+
+// #pragma mark -
+
+// _KeyFor
+/*static*/ BString
+DecodedImageCache::_KeyFor(BitmapClip* clip, color_space renderFormat)
+{
+	// all render formats which lead to the same decoded
+	// format share the same key, the change token is bumped when
+	// the file is reloaded without a new version
+	bool yCbCr = (pixel_format)renderFormat == YCbCr444
+		|| (pixel_format)renderFormat == YCbCr422;
+
+	BString key(clip->ID());
+	key << "-" << clip->Version() << "-" << clip->ChangeToken()
+		<< (yCbCr ? "-ycbcr" : "-rgb");
+	return key;
+}
+
+// _Lookup
+DecodedImage*
+DecodedImageCache::_Lookup(const BString& key)
+{
+	Entry* entry = fEntries.Get(key.String());
+	if (!entry)
+		return NULL;
+
+	// move the entry to the front of the LRU list
+	fLRU.Remove(entry);
+	fLRU.Insert(entry, false);
+
+	entry->image->Acquire();
+	return entry->image;
+}
+
+// _Insert
+DecodedImage*
+DecodedImageCache::_Insert(const BString& key, DecodedImage* image)
+{
+	// the reference of the caller is passed on to the returned image
+	DecodedImage* existing = _Lookup(key);
+	if (existing) {
+		image->Release();
+		return existing;
+	}
+
+	Entry* entry = new (nothrow) Entry;
+	if (!entry)
+		return image;
+
+	entry->key = key;
+	entry->image = image;
+	if (fEntries.Put(key.String(), entry) < B_OK) {
+		delete entry;
+		return image;
+	}
+
+	image->Acquire();
+	fLRU.Insert(entry, false);
+	fMemoryUsage += image->MemoryUsage();
+
+	_Trim();
+
+	return image;
+}
+
+// _RemoveEntry
+void
+DecodedImageCache::_RemoveEntry(Entry* entry)
+{
+	fEntries.Remove(entry->key.String());
+	fLRU.Remove(entry);
+	fMemoryUsage -= entry->image->MemoryUsage();
+
+	// NOTE: images which are still in use by a renderer stay around
+	// until they are released
+	entry->image->Release();
+	delete entry;
+}
+
+// _Trim
+void
+DecodedImageCache::_Trim()
+{
+	// always keep the most recently used image
+	while (fMemoryUsage > fMemoryLimit && fLRU.GetLast() != fLRU.GetFirst())
+		_RemoveEntry(fLRU.GetLast());
+}
+
+// _ConvertToYCbRr
+/*static*/ void
+DecodedImageCache::_ConvertToYCbRr(const BBitmap* src, MemoryBuffer* dst)
+{
+	// convert from B_RGB32/B_RGBA32 to YCbCr444/YCbCrA
+	uint32 width = src->Bounds().IntegerWidth() + 1;
+	uint32 height = src->Bounds().IntegerHeight() + 1;
+
+	uint32 srcBPR = src->BytesPerRow();
+	uint32 dstBPR = dst->BytesPerRow();
+
+	uint8* srcBits = (uint8*)src->Bits();
+	uint8* dstBits = (uint8*)dst->Bits();
+
+	if (dst->PixelFormat() == YCbCr444) {
+		// source is expected to be in B_RGB32 color space
+		for (uint32 y = 0; y < height; y++) {
+			uint8* s = srcBits;
+			uint8* d = dstBits;
+			for (uint32 x = 0; x < width; x++) {
+				d[0] = (8432 * s[2] + 16425 * s[1] + 3176 * s[0]) / 32768 + 16;
+				d[1] = (-4818 * s[2] - 9527 * s[1] + 14345 * s[0]) / 32768 + 128;
+				d[2] = (14345 * s[2] - 12045 * s[1] - 2300 * s[0]) / 32768 + 128;
+				s += 4;
+				d += 3;
+			}
+			srcBits += srcBPR;
+			dstBits += dstBPR;
+		}
+	} else if (dst->PixelFormat() == YCbCrA) {
+		// source is expected to be in B_RGBA32 color space
+		// copy alpha channel as well and premultiply on the fly
+		for (uint32 y = 0; y < height; y++) {
+			uint8* s = srcBits;
+			uint8* d = dstBits;
+			for (uint32 x = 0; x < width; x++) {
+				if (s[3] < 255) {
+					d[0] = (((8432 * s[2] + 16425 * s[1] + 3176 * s[0]) / 32768 + 16) * s[3]) >> 8;
+					d[1] = (((-4818 * s[2] - 9527 * s[1] + 14345 * s[0]) / 32768 + 128) * s[3]) >> 8;
+					d[2] = (((14345 * s[2] - 12045 * s[1] - 2300 * s[0]) / 32768 + 128) * s[3]) >> 8;
+				} else {
+					d[0] = (8432 * s[2] + 16425 * s[1] + 3176 * s[0]) / 32768 + 16;
+					d[1] = (-4818 * s[2] - 9527 * s[1] + 14345 * s[0]) / 32768 + 128;
+					d[2] = (14345 * s[2] - 12045 * s[1] - 2300 * s[0]) / 32768 + 128;
+				}
+				d[3] = s[3];
+				s += 4;
+				d += 4;
+			}
+			srcBits += srcBPR;
+			dstBits += dstBPR;
+		}
+	}
+}
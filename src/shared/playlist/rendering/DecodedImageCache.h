@@ -0,0 +1,104 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+#ifndef DECODED_IMAGE_CACHE_H
+#define DECODED_IMAGE_CACHE_H
+
+#include <GraphicsDefs.h>
+#include <Locker.h>
+#include <String.h>
+
+#include "DLList.h"
+#include "HashMap.h"
+#include "HashString.h"
+#include "Referencable.h"
+
+class BBitmap;
+class BitmapClip;
+class MemoryBuffer;
+
+// DecodedImage
+//
+// The contents of a BitmapClip converted to the pixel format used for
+// rendering. The buffer is never changed after decoding, so any number
+// of renderers can draw from it at the same time.
+class DecodedImage : public Referencable {
+ public:
+								DecodedImage(MemoryBuffer* buffer);
+	virtual						~DecodedImage();
+
+			const MemoryBuffer*	Buffer() const
+									{ return fBuffer; }
+			size_t				MemoryUsage() const;
+
+ private:
+			MemoryBuffer*		fBuffer;
+};
+
+// DecodedImageCache
+//
+// Keeps the decoded images of BitmapClips keyed by clip ID, version and
+// target pixel format, so that all renderers of the same clip share one
+// buffer. Images which are not used by any renderer anymore are kept in
+// a memory bounded LRU, so that re-activating a clip doesn't need to
+// decode it again.
+class DecodedImageCache {
+ public:
+	enum {
+		DEFAULT_MEMORY_LIMIT	= 64 * 1024 * 1024
+	};
+
+								DecodedImageCache(size_t memoryLimit
+									= DEFAULT_MEMORY_LIMIT);
+	virtual						~DecodedImageCache();
+
+			status_t			InitCheck() const;
+
+	static	DecodedImageCache*	CreateDefault();
+	static	void				DeleteDefault();
+	static	DecodedImageCache*	Default();
+
+			DecodedImage*		GetImage(BitmapClip* clip,
+									color_space renderFormat);
+									// returns an acquired image or NULL
+
+			size_t				MemoryUsage() const
+									{ return fMemoryUsage; }
+
+	static	DecodedImage*		Decode(BitmapClip* clip,
+									color_space renderFormat);
+
+ private:
+			struct Entry : DLListLinkImpl<Entry> {
+				BString			key;
+				DecodedImage*	image;
+			};
+
+	typedef HashMap<HashString, Entry*> EntryMap;
+	typedef DLList<Entry> EntryList;
+
+	static	BString				_KeyFor(BitmapClip* clip,
+									color_space renderFormat);
+
+			DecodedImage*		_Lookup(const BString& key);
+			DecodedImage*		_Insert(const BString& key,
+									DecodedImage* image);
+			void				_RemoveEntry(Entry* entry);
+			void				_Trim();
+
+	static	void				_ConvertToYCbRr(const BBitmap* src,
+									MemoryBuffer* dst);
+
+			BLocker				fLock;
+			EntryMap			fEntries;
+			EntryList			fLRU;
+				// most recently used first
+			size_t				fMemoryUsage;
+			size_t				fMemoryLimit;
+
+	static	DecodedImageCache*	sDefaultCache;
+};
+
+#endif // DECODED_IMAGE_CACHE_H
@@ -6,10 +6,16 @@
 #include "PlaylistClipRenderer.h"
 
 #include <new>
+#include <math.h>
 #include <stdio.h>
 
+#include "common.h"
+
+#include "ImageSequenceStream.h"
+#include "MemoryBuffer.h"
 #include "Painter.h"
 #include "Playlist.h"
+#include "PlaylistProxyCache.h"
 #include "RenderPlaylist.h"
 
 using std::nothrow;
@@ -20,12 +26,20 @@ PlaylistClipRenderer::PlaylistClipRenderer(ClipPlaylistItem* item,
 	: ClipRenderer(item, playlist)
 	, fPlaylist(new (nothrow) Playlist(*playlist, true))
 	, fRendererCache(rendererCache)
+	, fProxyKey()
+	, fProxyKeyValid(false)
+	, fProxy(NULL)
+	, fProxyBuffer(NULL)
 {
+	// the copy is rendered without holding the document lock
+	if (fPlaylist)
+		fPlaylist->StopObservingClips();
 }
 
 // destructor
 PlaylistClipRenderer::~PlaylistClipRenderer()
 {
+	_DeleteProxy();
 	if (fPlaylist)
 		fPlaylist->Release();
 }
@@ -38,9 +52,96 @@ PlaylistClipRenderer::Generate(Painter* painter, double frame,
 	if (!fPlaylist)
 		return B_NO_INIT;
 
+	if (_GenerateFromProxy(painter, frame))
+		return B_OK;
+
 	fPlaylist->SetCurrentFrame(frame);
 	RenderPlaylist renderPlaylist(*fPlaylist, frame,
 		(color_space)painter->PixelFormat(), fRendererCache);
 	return renderPlaylist.Generate(painter, frame);
 }
 
+// #pragma mark -
+
+// _GenerateFromProxy
+bool
+PlaylistClipRenderer::_GenerateFromProxy(Painter* painter, double frame)
+{
+	// the proxies are YCbCr422 and are only used for playback
+	// of whole frames, the editor renders to RGB32
+	PlaylistProxyCache* cache = PlaylistProxyCache::Default();
+	if (!cache || frame != floor(frame)
+		|| (painter->PixelFormat() != YCbCr422
+			&& painter->PixelFormat() != YCbCr444)) {
+		return false;
+	}
+
+	// the proxy covers the canvas of the sub-playlist, which is placed
+	// by the transformation of the painter
+	uint32 width = fPlaylist->Width();
+	uint32 height = fPlaylist->Height();
+
+	// the private copy of the sub-playlist does not change,
+	// so neither does the key
+	if (!fProxyKeyValid) {
+		if (!PlaylistProxyCache::GetKey(fPlaylist, width, height,
+				&fProxyKey)) {
+			fProxyKey = "";
+		}
+		fProxyKeyValid = true;
+	}
+	if (fProxyKey.Length() == 0)
+		return false;
+
+	if (!fProxy) {
+		BString path;
+		if (!cache->GetProxy(fProxyKey, fPlaylist, width, height, &path))
+			return false;
+
+		fProxy = new (nothrow) ImageSequenceStream();
+		uint32 bytesPerRow = ((width * 2 + 3) / 4) * 4;
+		fProxyBuffer = new (nothrow) MemoryBuffer(width, height, YCbCr422,
+			bytesPerRow);
+		if (!fProxy || !fProxyBuffer || fProxyBuffer->InitCheck() < B_OK) {
+			_DeleteProxy();
+			return false;
+		}
+		if (fProxy->Init(path.String()) < B_OK) {
+			print_error("PlaylistClipRenderer - unable to open proxy '%s'\n",
+				path.String());
+			cache->RemoveProxy(fProxyKey);
+			_DeleteProxy();
+			return false;
+		}
+
+		// decode the slices of each frame concurrently
+		system_info info;
+		get_system_info(&info);
+		if (info.cpu_count > 1 && fProxy->CountSlices() > 1) {
+			fProxy->SetWorkerCount(min_c((int32)info.cpu_count,
+				fProxy->CountSlices()));
+		}
+	}
+
+	// a frame which cannot be decoded is rendered
+	if (fProxy->SeekToFrame((int64)frame) < B_OK
+		|| fProxy->ReadFrame((uint8*)fProxyBuffer->Bits()) < B_OK) {
+		return false;
+	}
+
+	painter->SetSubpixelPrecise(false);
+	painter->DrawBitmap(fProxyBuffer, fProxyBuffer->Bounds(),
+		BRect(0, 0, width - 1, height - 1));
+
+	return true;
+}
+
+// _DeleteProxy
+void
+PlaylistClipRenderer::_DeleteProxy()
+{
+	delete fProxy;
+	fProxy = NULL;
+	delete fProxyBuffer;
+	fProxyBuffer = NULL;
+}
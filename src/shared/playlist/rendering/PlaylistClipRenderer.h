@@ -6,9 +6,13 @@
 #ifndef PLAYLIST_CLIP_RENDERER_H
 #define PLAYLIST_CLIP_RENDERER_H
 
+#include <String.h>
+
 #include "ClipRenderer.h"
 
 class ClipRendererCache;
+class ImageSequenceStream;
+class MemoryBuffer;
 class Playlist;
 
 class PlaylistClipRenderer : public ClipRenderer {
@@ -22,9 +26,26 @@ class PlaylistClipRenderer : public ClipRenderer {
 	virtual	status_t			Generate(Painter* painter, double frame,
 									const RenderPlaylistItem* item);
 
+	// PlaylistClipRenderer
+			Playlist*			SubPlaylist() const
+									{ return fPlaylist; }
+			ClipRendererCache*	RendererCache() const
+									{ return fRendererCache; }
+
  private:
+			bool				_GenerateFromProxy(Painter* painter,
+									double frame);
+			void				_DeleteProxy();
+
 			Playlist*			fPlaylist;
 			ClipRendererCache*	fRendererCache;
+
+			BString				fProxyKey;
+									// empty if the sub-playlist
+									// has no proxy
+			bool				fProxyKeyValid;
+			ImageSequenceStream* fProxy;
+			MemoryBuffer*		fProxyBuffer;
 };
 
 #endif // PLAYLIST_CLIP_RENDERER_H
@@ -0,0 +1,490 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+#include "PlaylistProxyCache.h"
+
+#include <new>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <Directory.h>
+#include <Entry.h>
+#include <File.h>
+#include <Path.h>
+#include <Region.h>
+
+#include "common.h"
+#include "common_constants.h"
+
+#include "AutoLocker.h"
+#include "ClipPlaylistItem.h"
+#include "ClipRendererCache.h"
+#include "ImageSequenceStream.h"
+#include "MemoryBuffer.h"
+#include "Painter.h"
+#include "Playlist.h"
+#include "RenderedFrameCache.h"
+#include "RenderPlaylist.h"
+
+using std::nothrow;
+
+enum {
+	MAX_NESTING_LEVEL	= 16
+};
+
+// count_layers
+static int32
+count_layers(const Playlist* playlist, int32 level)
+{
+	if (level > MAX_NESTING_LEVEL)
+		return 0;
+
+	int32 layers = 0;
+	int32 count = playlist->CountItems();
+	for (int32 i = 0; i < count; i++) {
+		ClipPlaylistItem* item
+			= dynamic_cast<ClipPlaylistItem*>(playlist->ItemAtFast(i));
+		if (!item || !item->Clip() || !item->HasVideo())
+			continue;
+
+		if (Playlist* subPlaylist = dynamic_cast<Playlist*>(item->Clip()))
+			layers += count_layers(subPlaylist, level + 1);
+		else
+			layers++;
+	}
+	return layers;
+}
+
+// proxy_file
+struct proxy_file {
+	BString		path;
+	BString		key;
+	time_t		time;
+	off_t		size;
+};
+
+// compare_proxy_files
+static int
+compare_proxy_files(const void* a, const void* b)
+{
+	const proxy_file* fileA = *(const proxy_file**)a;
+	const proxy_file* fileB = *(const proxy_file**)b;
+	if (fileA->time < fileB->time)
+		return -1;
+	if (fileA->time > fileB->time)
+		return 1;
+	return 0;
+}
+
+// #pragma mark -
+
+// constructor
+PlaylistProxyCache::PlaylistProxyCache()
+	: fJobs("proxy jobs")
+	, fBuilder(-1)
+	, fQuitting(false)
+	, fLock("playlist proxy cache")
+	, fStates()
+	, fStatus(B_NO_INIT)
+{
+	fStatus = fJobs.InitCheck();
+	if (fStatus < B_OK)
+		return;
+
+	fBuilder = spawn_thread(_BuilderEntry, "proxy builder",
+		B_LOW_PRIORITY, this);
+	if (fBuilder >= B_OK) {
+		fStatus = B_OK;
+		resume_thread(fBuilder);
+	} else
+		fStatus = fBuilder;
+}
+
+// destructor
+PlaylistProxyCache::~PlaylistProxyCache()
+{
+	// a proxy which is being built is given up
+	fQuitting = true;
+
+	const Vector<Job*>* jobs = NULL;
+	if (fJobs.Close(false, &jobs) == B_OK && jobs) {
+		int32 count = jobs->Count();
+		for (int32 i = 0; i < count; i++) {
+			Job* job = jobs->ElementAt(i);
+			job->playlist->Release();
+			delete job;
+		}
+	}
+	if (fBuilder >= B_OK) {
+		status_t dummy;
+		wait_for_thread(fBuilder, &dummy);
+	}
+}
+
+// InitCheck
+status_t
+PlaylistProxyCache::InitCheck() const
+{
+	if (fStatus < B_OK)
+		return fStatus;
+	if (fLock.Sem() < B_OK)
+		return fLock.Sem();
+	return fStates.InitCheck();
+}
+
+// CreateDefault
+PlaylistProxyCache*
+PlaylistProxyCache::CreateDefault()
+{
+	if (!sDefaultCache) {
+		sDefaultCache = new (nothrow) PlaylistProxyCache();
+		if (sDefaultCache && sDefaultCache->InitCheck() != B_OK)
+			DeleteDefault();
+	}
+	return sDefaultCache;
+}
+
+// DeleteDefault
+void
+PlaylistProxyCache::DeleteDefault()
+{
+	delete sDefaultCache;
+	sDefaultCache = NULL;
+}
+
+// Default
+PlaylistProxyCache*
+PlaylistProxyCache::Default()
+{
+	return sDefaultCache;
+}
+
+// GetKey
+/*static*/ bool
+PlaylistProxyCache::GetKey(Playlist* playlist, uint32 width, uint32 height,
+	BString* key)
+{
+	uint64 duration = playlist->Duration();
+	if (duration == 0 || duration > MAX_FRAME_COUNT)
+		return false;
+
+	if (!RenderedFrameCache::IsDeterministic(playlist))
+		return false;
+
+	// a proxy of only a few layers would not decode
+	// much faster than the layers render
+	if (count_layers(playlist, 0) < MIN_LAYER_COUNT)
+		return false;
+
+	// the signature changes with the version of any of the clips used
+	// by the playlist
+	key->SetTo(playlist->ID());
+	*key << "-" << playlist->Version()
+		<< "-" << RenderedFrameCache::VersionSignature(playlist)
+		<< "-" << duration << "-" << width << "x" << height;
+	return true;
+}
+
+// GetProxy
+bool
+PlaylistProxyCache::GetProxy(const BString& key, const Playlist* playlist,
+	uint32 width, uint32 height, BString* path)
+{
+	AutoLocker<BLocker> locker(fLock);
+
+	if (fStates.ContainsKey(key.String())) {
+		if (fStates.Get(key.String()) != PROXY_READY)
+			return false;
+		return _PathFor(key, *path) == B_OK;
+	}
+
+	// the proxy may have been built in a previous session, or building
+	// it may have failed
+	if (_PathFor(key, *path) == B_OK) {
+		BEntry entry(path->String());
+		if (entry.Exists()) {
+			// remember the use for evicting the least recently used
+			entry.SetModificationTime(time(NULL));
+			fStates.Put(key.String(), PROXY_READY);
+			return true;
+		}
+		BString failedPath;
+		if (_FailedPathFor(key, failedPath) == B_OK
+			&& BEntry(failedPath.String()).Exists()) {
+			fStates.Put(key.String(), PROXY_FAILED);
+			return false;
+		}
+	}
+
+	// build the proxy in the background, the builder renders its own
+	// copy of the playlist
+	Job* job = new (nothrow) Job;
+	if (!job)
+		return false;
+
+	job->key = key;
+	job->playlist = new (nothrow) Playlist(*playlist, true);
+	job->width = width;
+	job->height = height;
+	if (!job->playlist) {
+		delete job;
+		return false;
+	}
+
+	if (fStates.Put(key.String(), PROXY_PENDING) < B_OK
+		|| fJobs.Push(job) < B_OK) {
+		fStates.Remove(key.String());
+		job->playlist->Release();
+		delete job;
+	}
+
+	return false;
+}
+
+// RemoveProxy
+void
+PlaylistProxyCache::RemoveProxy(const BString& key)
+{
+	AutoLocker<BLocker> locker(fLock);
+
+	// the next GetProxy() builds it again, for example with
+	// the current stream format
+	fStates.Remove(key.String());
+
+	BString path;
+	if (_PathFor(key, path) == B_OK)
+		BEntry(path.String()).Remove();
+}
+
+// #pragma mark -
+
+// _PathFor
+status_t
+PlaylistProxyCache::_PathFor(const BString& key, BString& _path) const
+{
+	BPath path(kCachePath);
+	status_t ret = path.Append("proxies");
+	if (ret == B_OK)
+		ret = create_directory(path.Path(), 0777);
+	if (ret == B_OK)
+		ret = path.Append(key.String());
+	if (ret == B_OK)
+		_path = path.Path();
+	return ret;
+}
+
+// _FailedPathFor
+status_t
+PlaylistProxyCache::_FailedPathFor(const BString& key, BString& path) const
+{
+	status_t ret = _PathFor(key, path);
+	if (ret == B_OK)
+		path << ".failed";
+	return ret;
+}
+
+// _EvictFiles
+//
+// Removes the least recently used proxies and failure markers until they
+// take up no more than MAX_DISK_USAGE.
+void
+PlaylistProxyCache::_EvictFiles()
+{
+	BPath path(kCachePath);
+	if (path.Append("proxies") != B_OK)
+		return;
+	BDirectory directory(path.Path());
+	if (directory.InitCheck() != B_OK)
+		return;
+
+	BList files(64);
+	off_t diskUsage = 0;
+	BEntry entry;
+	while (directory.GetNextEntry(&entry) == B_OK) {
+		struct stat st;
+		BPath filePath;
+		if (entry.GetStat(&st) != B_OK || !S_ISREG(st.st_mode)
+			|| entry.GetPath(&filePath) != B_OK) {
+			continue;
+		}
+
+		// proxies which are being built are not finished yet
+		BString key(filePath.Leaf());
+		if (key.FindLast(".partial") >= 0)
+			continue;
+		if (key.FindLast(".failed") >= 0)
+			key.Truncate(key.Length() - strlen(".failed"));
+
+		proxy_file* file = new (nothrow) proxy_file;
+		if (!file)
+			break;
+		file->path = filePath.Path();
+		file->key = key;
+		file->time = st.st_mtime;
+		file->size = st.st_size;
+		if (!files.AddItem(file)) {
+			delete file;
+			break;
+		}
+		diskUsage += st.st_size;
+	}
+
+	off_t maxDiskUsage = (off_t)MAX_DISK_USAGE * 1024 * 1024;
+	if (diskUsage > maxDiskUsage)
+		files.SortItems(compare_proxy_files);
+
+	int32 count = files.CountItems();
+	for (int32 i = 0; i < count; i++) {
+		proxy_file* file = (proxy_file*)files.ItemAtFast(i);
+		if (diskUsage > maxDiskUsage
+			&& BEntry(file->path.String()).Remove() == B_OK) {
+			diskUsage -= file->size;
+			fLock.Lock();
+			fStates.Remove(file->key.String());
+			fLock.Unlock();
+			print_info("PlaylistProxyCache - evicted '%s'\n",
+				file->key.String());
+		}
+		delete file;
+	}
+}
+
+// _BuilderEntry
+int32
+PlaylistProxyCache::_BuilderEntry(void* cookie)
+{
+	return ((PlaylistProxyCache*)cookie)->_Builder();
+}
+
+// _Builder
+int32
+PlaylistProxyCache::_Builder()
+{
+	_EvictFiles();
+
+	while (true) {
+		Job* job;
+		status_t ret = fJobs.Pop(&job);
+		if (ret == B_INTERRUPTED)
+			continue;
+		if (ret < B_OK) {
+			// the queue has been closed
+			break;
+		}
+
+		// the proxy is written under a temporary name, so that
+		// an unfinished proxy is never found by GetProxy()
+		BString path;
+		ret = _PathFor(job->key, path);
+		if (ret == B_OK) {
+			BString partialPath(path);
+			partialPath << ".partial";
+
+			bigtime_t startTime = system_time();
+			ret = _Build(job, partialPath.String());
+			if (ret == B_OK) {
+				ret = BEntry(partialPath.String()).Rename(path.String(),
+					true);
+			}
+			if (ret == B_OK) {
+				print_info("PlaylistProxyCache - built proxy '%s' in "
+					"%lld ms\n", job->key.String(),
+					(system_time() - startTime) / 1000);
+			} else
+				BEntry(partialPath.String()).Remove();
+		}
+
+		if (ret != B_OK && ret != B_CANCELED) {
+			// don't try again in the next session
+			BString failedPath;
+			if (_FailedPathFor(job->key, failedPath) == B_OK) {
+				BFile marker(failedPath.String(),
+					B_CREATE_FILE | B_WRITE_ONLY);
+			}
+		}
+
+		fLock.Lock();
+		fStates.Put(job->key.String(),
+			ret == B_OK ? PROXY_READY : PROXY_FAILED);
+		fLock.Unlock();
+
+		if (ret == B_OK)
+			_EvictFiles();
+
+		job->playlist->Release();
+		delete job;
+	}
+
+	return B_OK;
+}
+
+// _Build
+status_t
+PlaylistProxyCache::_Build(const Job* job, const char* path)
+{
+	Playlist* playlist = job->playlist;
+	int64 frameCount = playlist->Duration();
+
+	uint32 bytesPerRow = ((job->width * 2 + 3) / 4) * 4;
+	MemoryBuffer buffer(job->width, job->height, YCbCr422, bytesPerRow);
+	status_t ret = buffer.InitCheck();
+	if (ret < B_OK)
+		return ret;
+
+	Painter painter;
+	if (!painter.AttachToBuffer(&buffer))
+		return B_ERROR;
+
+	// the proxy is written in slices, which are encoded on all CPUs
+	// and which allow playback to decode a frame on several CPUs
+	ImageSequenceStream stream;
+	ret = stream.Init(path, job->width, job->height, YCbCr422, frameCount,
+		SLICE_COUNT);
+	if (ret < B_OK)
+		return ret;
+
+	system_info info;
+	get_system_info(&info);
+	if (info.cpu_count > 1) {
+		stream.SetWorkerCount(min_c((int32)info.cpu_count,
+			stream.CountSlices()));
+	}
+
+	ClipRendererCache rendererCache;
+
+	for (int64 frame = 0; frame < frameCount; frame++) {
+		if (fQuitting)
+			return B_CANCELED;
+
+		rendererCache.DeleteOldRenderers();
+
+		playlist->SetCurrentFrame(frame);
+		RenderPlaylist renderPlaylist(*playlist, frame, B_YCbCr422,
+			&rendererCache);
+
+		// whatever is behind the sub-playlist would
+		// be hidden by the proxy otherwise
+		BRegion uncovered(painter.Bounds());
+		renderPlaylist.RemoveSolidRegion(&uncovered, &painter, frame);
+		if (uncovered.CountRects() > 0)
+			return B_NOT_SUPPORTED;
+
+		painter.ClearBuffer();
+		renderPlaylist.Generate(&painter, frame);
+		painter.FlushCaches();
+
+		ret = stream.WriteFrame((const uint8*)buffer.Bits());
+		if (ret < B_OK)
+			return ret;
+	}
+
+	return stream.Finalize();
+}
+
+// static variables
+
+// sDefaultCache
+PlaylistProxyCache* PlaylistProxyCache::sDefaultCache = NULL;
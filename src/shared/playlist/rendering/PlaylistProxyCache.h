@@ -0,0 +1,109 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+#ifndef PLAYLIST_PROXY_CACHE_H
+#define PLAYLIST_PROXY_CACHE_H
+
+#include <Locker.h>
+#include <String.h>
+
+#include "BlockingQueue.h"
+#include "HashMap.h"
+#include "HashString.h"
+
+class Playlist;
+
+// PlaylistProxyCache
+//
+// Keeps pre-rendered proxies of complex sub-playlists as
+// ImageSequenceStream files below kCachePath, so that playback needs to
+// decode only one frame instead of compositing all the layers of the
+// sub-playlist. A proxy is built once on a background thread, for
+// sub-playlists which don't change with the real time (the same
+// condition as for the RenderedFrameCache), which have enough layers to
+// be worth it and which cover the whole canvas at every frame, since the
+// proxies have no alpha channel. The key of a proxy changes with the
+// version of any of the clips used by the sub-playlist, so proxies never
+// need to be invalidated. Instead, the least recently used proxy files
+// are removed when they take up more than MAX_DISK_USAGE. Sub-playlists
+// for which no proxy could be built are remembered in a marker file, so
+// that this is not tried again in the next session.
+//
+// NOTE: Editing a clip does not bump its version, so the keys only
+// identify the content in the player, where objects change by new
+// versions from the server alone. Only the player creates the default
+// cache.
+class PlaylistProxyCache {
+ public:
+	enum {
+		MIN_LAYER_COUNT			= 3,
+		MAX_FRAME_COUNT			= 25 * 60 * 10,
+		SLICE_COUNT				= 4,
+		MAX_DISK_USAGE			= 2000	// MB
+	};
+
+								PlaylistProxyCache();
+	virtual						~PlaylistProxyCache();
+
+			status_t			InitCheck() const;
+
+	static	PlaylistProxyCache*	CreateDefault();
+	static	void				DeleteDefault();
+	static	PlaylistProxyCache*	Default();
+
+	// Returns false if the playlist doesn't qualify for a proxy.
+	static	bool				GetKey(Playlist* playlist, uint32 width,
+									uint32 height, BString* key);
+
+	// Returns true and the path of the proxy file, if the proxy has been
+	// built. Otherwise the proxy is built in the background, unless that
+	// failed before.
+			bool				GetProxy(const BString& key,
+									const Playlist* playlist, uint32 width,
+									uint32 height, BString* path);
+	// Removes a proxy which turned out to be unusable, so that it
+	// is built again.
+			void				RemoveProxy(const BString& key);
+
+ private:
+			enum {
+				PROXY_PENDING = 0,
+				PROXY_READY,
+				PROXY_FAILED
+			};
+
+			struct Job {
+				BString			key;
+				Playlist*		playlist;
+				uint32			width;
+				uint32			height;
+			};
+
+	typedef HashMap<HashString, int32> StateMap;
+
+			status_t			_PathFor(const BString& key,
+									BString& path) const;
+			status_t			_FailedPathFor(const BString& key,
+									BString& path) const;
+			void				_EvictFiles();
+
+	static	int32				_BuilderEntry(void* cookie);
+			int32				_Builder();
+
+			status_t			_Build(const Job* job, const char* path);
+
+			BlockingQueue<Job>	fJobs;
+			thread_id			fBuilder;
+	volatile bool				fQuitting;
+
+			BLocker				fLock;
+			StateMap			fStates;
+
+			status_t			fStatus;
+
+	static	PlaylistProxyCache*	sDefaultCache;
+};
+
+#endif // PLAYLIST_PROXY_CACHE_H
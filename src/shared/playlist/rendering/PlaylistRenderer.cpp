@@ -15,12 +15,17 @@
 #include "BBitmapBuffer.h"
 #include "Painter.h"
 #include "Playlist.h"
+#include "PlaylistClipRenderer.h"
 #include "RenderPlaylist.h"
 #include "RenderPlaylistItem.h"
+#include "RenderedFrameCache.h"
 #include "VideoRenderer.h"
 
 using std::nothrow;
 
+enum {
+	MAX_NESTING_LEVEL	= 16
+};
 
 class PlaylistRenderer::ChunkReaderSupport {
 public:
@@ -188,6 +193,19 @@ PlaylistRenderer::RenderFrame(int32 frame, bool& wasCached)
 		RenderPlaylist playlist(*fPlaylist, (double)frame,
 			fCacheBitmap->ColorSpace(), &fRendererCache);
 
+		// repeated sub-playlists are rendered only once
+		RenderedFrameCache* frameCache = RenderedFrameCache::Default();
+		BString cacheKey;
+		const Playlist* subPlaylist = NULL;
+		if (frameCache && !frameCache->GetKey(playlist, frame, fCacheBitmap,
+				&cacheKey, &subPlaylist)) {
+			frameCache = NULL;
+		}
+		if (frameCache && frameCache->GetFrame(cacheKey, fCacheBitmap)) {
+			wasCached = true;
+			return B_OK;
+		}
+
 		// clear the buffer only where needed
 		BRegion cleanBG(fPainter.Bounds());
 		playlist.RemoveSolidRegion(&cleanBG, &fPainter, frame);
@@ -202,14 +220,35 @@ PlaylistRenderer::RenderFrame(int32 frame, bool& wasCached)
 				fPrintError = false;
 			}
 			fPainter.ClearBuffer();
-		} else
+		} else {
 			fPrintError = true;
+			if (frameCache)
+				frameCache->AddFrame(cacheKey, subPlaylist, fCacheBitmap);
+		}
 		return B_OK;
 	}
 
 	return B_NO_INIT;
 }
 
+// CanPassThrough
+bool
+PlaylistRenderer::CanPassThrough(int32 frame,
+	const media_codec_info& codecInfo)
+{
+	if (fPlaylist == NULL)
+		return false;
+
+	fPlaylist->SetCurrentFrame(frame);
+	// temporary render playlist
+	RenderPlaylist playlist(*fPlaylist, (double)frame,
+		fCacheBitmap->ColorSpace(), &fRendererCache);
+
+	int64 clipFrame;
+	return _FindChunkProvider(playlist, frame, codecInfo, &clipFrame, 0)
+		!= NULL;
+}
+
 // GetNextVideoChunk
 status_t
 PlaylistRenderer::GetNextVideoChunk(int32 frame, const void*& buffer,
@@ -218,63 +257,123 @@ PlaylistRenderer::GetNextVideoChunk(int32 frame, const void*& buffer,
 	if (fPlaylist == NULL)
 		return B_NO_INIT;
 
+	fPlaylist->SetCurrentFrame(frame);
+	// temporary render playlist
+	RenderPlaylist playlist(*fPlaylist, (double)frame,
+		fCacheBitmap->ColorSpace(), &fRendererCache);
+
+	int64 clipFrame;
+	VideoRenderer* videoRenderer = _FindChunkProvider(playlist, frame,
+		codecInfo, &clipFrame, 0);
+	if (videoRenderer == NULL)
+		return B_ERROR;
+
+	if (fLastChunk == NULL) {
+		fLastChunk = new(std::nothrow) ChunkReaderSupport();
+		if (fLastChunk == NULL)
+			return B_NO_MEMORY;
+	}
+
+	status_t ret = fLastChunk->GetNextChunk((int32)clipFrame,
+		videoRenderer, buffer, size, chunksComplete);
+	if (ret != B_OK)
+		fLastChunk->Unset();
+	return ret;
+}
+
+// ChunkHeader
+const media_header&
+PlaylistRenderer::ChunkHeader() const
+{
+	return fLastChunk->ChunkHeader();
+}
+
+// Bitmap
+const BBitmap*
+PlaylistRenderer::Bitmap() const
+{
+	return fCacheBitmap;
+}
+
+// #pragma mark -
+
+// _FindChunkProvider
+//
+// Returns the renderer of the video clip which makes up the whole frame,
+// also if the clip is alone in a (nested) sub-playlist, and the frame
+// within that clip.
+VideoRenderer*
+PlaylistRenderer::_FindChunkProvider(const RenderPlaylist& playlist,
+	int64 frame, const media_codec_info& codecInfo, int64* clipFrame,
+	int32 level) const
+{
 	// This only works if a couple of conditions are met:
-	// * There is only one video track,
+	// * There is only one video track, at each level of sub-playlists,
 	// * the project dimensions equal the track's video dimensions,
 	// * the video is unmodified in any way (no transformation, no filters),
+	//   at each level of sub-playlists,
 	// * the current frame is a key-frame OR all these conditions were true
 	//   for the previous frame.
+	if (level > MAX_NESTING_LEVEL)
+		return NULL;
 
 	// Iterate over the playlist items at the frame and check most of the
 	// conditions
-	fPlaylist->SetCurrentFrame(frame);
-	// temporary render playlist
-	RenderPlaylist playlist(*fPlaylist, (double)frame,
-		fCacheBitmap->ColorSpace(), &fRendererCache);
 	int32 count = playlist.CountItems();
-	VideoRenderer* videoRenderer = NULL;
 	RenderPlaylistItem* item = NULL;
 	for (int32 i = 0; i < count; i++) {
-		item = dynamic_cast<RenderPlaylistItem*>(playlist.ItemAtFast(i));
-		if (item == NULL)
+		RenderPlaylistItem* other
+			= dynamic_cast<RenderPlaylistItem*>(playlist.ItemAtFast(i));
+		if (other == NULL || !other->HasVideo())
 			continue;
-		if (item->HasVideo()) {
-			if (videoRenderer != NULL)
-				return B_ERROR;
-			videoRenderer = dynamic_cast<VideoRenderer*>(item->Renderer());
-		}
+		if (item != NULL)
+			return NULL;
+		item = other;
 	}
 
-	if (videoRenderer == NULL)
-		return B_ERROR;
+	if (item == NULL || item->Renderer() == NULL)
+		return NULL;
 
-	// TODO: Playlists don't currently support aspect ratio, so there is more
-	// to this than the check below!
-	if (videoRenderer->DisplayBounds() != fCacheBitmap->Bounds()) {
+	// Check unmodified item (no transformation...)
+	// NOTE: We do not need to run the graphics state stack until we hit
+	// our item, since every item on the way to it needs to be unmodified,
+	// we can just check the properties directly.
+	if (!item->Transformation().IsIdentity() || item->Alpha() != 1.0) {
 		fprintf(stderr, "PlaylistRenderer::GetNextVideoChunk() - "
-			"item has wrong video size\n");
-		return B_ERROR;
+			"item has modifications\n");
+		return NULL;
 	}
 
-	if (fLastChunk == NULL) {
-		fLastChunk = new(std::nothrow) ChunkReaderSupport();
-		if (fLastChunk == NULL)
-			return B_NO_MEMORY;
+	// the frame within the clip, like RenderPlaylistItem::Generate()
+	// passes it to the renderer
+	frame = frame - item->StartFrame() + item->ClipOffset();
+
+	// walk into sub-playlists, the items of which need
+	// to meet the same conditions
+	if (PlaylistClipRenderer* playlistRenderer
+			= dynamic_cast<PlaylistClipRenderer*>(item->Renderer())) {
+		Playlist* subPlaylist = playlistRenderer->SubPlaylist();
+		if (subPlaylist == NULL)
+			return NULL;
+
+		subPlaylist->SetCurrentFrame(frame);
+		RenderPlaylist subRenderPlaylist(*subPlaylist, (double)frame,
+			fCacheBitmap->ColorSpace(), playlistRenderer->RendererCache());
+		return _FindChunkProvider(subRenderPlaylist, frame, codecInfo,
+			clipFrame, level + 1);
 	}
 
-	// Check unmodified item (no transformation...)
-	// NOTE: This whole Smart Rendering thing works for the top-level
-	// playlist items only. If there are sub-playlists, there could be
-	// a situation in which Smart Rendering is possible, but since we check
-	// for a VideoRenderer in the top-level items only, it will not be
-	// detected. Therefor we do not need to run the graphics state stack
-	// until we hit our item, we can just check the properties directly.
-	// TODO: If Smart Rendering items in sub-playlists is ever supported,
-	// this would need to be changed of course.
-	if (!item->Transformation().IsIdentity() || item->Alpha() != 1.0) {
+	VideoRenderer* videoRenderer
+		= dynamic_cast<VideoRenderer*>(item->Renderer());
+	if (videoRenderer == NULL)
+		return NULL;
+
+	// TODO: Playlists don't currently support aspect ratio, so there is more
+	// to this than the check below!
+	if (videoRenderer->DisplayBounds() != fCacheBitmap->Bounds()) {
 		fprintf(stderr, "PlaylistRenderer::GetNextVideoChunk() - "
-			"item has modifications\n");
-		return B_ERROR;
+			"item has wrong video size\n");
+		return NULL;
 	}
 
 	// Check that the codec format is even the same...
@@ -282,7 +381,7 @@ PlaylistRenderer::GetNextVideoChunk(int32 frame, const void*& buffer,
 	if (videoRenderer->GetCodecInfo(&chunkCodecInfo) != B_OK) {
 		fprintf(stderr, "PlaylistRenderer::GetNextVideoChunk() - "
 			"unable to retrieve codec info of item\n");
-		return B_ERROR;
+		return NULL;
 	}
 	if (chunkCodecInfo.id != codecInfo.id
 		|| chunkCodecInfo.sub_id != codecInfo.sub_id) {
@@ -290,27 +389,9 @@ PlaylistRenderer::GetNextVideoChunk(int32 frame, const void*& buffer,
 			"mismatching codecs: %ld/%ld <-> %ld/%ld\n",
 			chunkCodecInfo.id, chunkCodecInfo.sub_id, codecInfo.id,
 			codecInfo.sub_id);
-		return B_ERROR;
+		return NULL;
 	}
 
-	status_t ret = fLastChunk->GetNextChunk(frame - item->StartFrame(),
-		videoRenderer, buffer, size, chunksComplete);
-	if (ret != B_OK)
-		fLastChunk->Unset();
-	return ret;
+	*clipFrame = frame;
+	return videoRenderer;
 }
-
-// ChunkHeader
-const media_header&
-PlaylistRenderer::ChunkHeader() const
-{
-	return fLastChunk->ChunkHeader();
-}
-
-// Bitmap
-const BBitmap*
-PlaylistRenderer::Bitmap() const
-{
-	return fCacheBitmap;
-}
-
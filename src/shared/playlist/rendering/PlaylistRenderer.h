@@ -16,6 +16,8 @@
 
 class BBitmap;
 class Playlist;
+class RenderPlaylist;
+class VideoRenderer;
 
 class PlaylistRenderer {
 public:
@@ -31,6 +33,11 @@ public:
 
 			const BBitmap*		Bitmap() const;
 
+								// Whether the video of the frame could be
+								// copied from a clip without re-encoding,
+								// doesn't check for key frames.
+			bool				CanPassThrough(int32 frame,
+									const media_codec_info& codecInfo);
 			status_t			GetNextVideoChunk(int32 frame,
 									const void*& buffer, size_t& size,
 									bool& chunksComplete,
@@ -40,6 +47,12 @@ public:
 private:
 			class ChunkReaderSupport;
 
+			VideoRenderer*		_FindChunkProvider(
+									const RenderPlaylist& playlist,
+									int64 frame,
+									const media_codec_info& codecInfo,
+									int64* clipFrame, int32 level) const;
+
 private:
  			Playlist*			fPlaylist;
  			Painter				fPainter;
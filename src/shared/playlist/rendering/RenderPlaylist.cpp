@@ -12,6 +12,7 @@
 #include <Region.h>
 
 #include "Painter.h"
+#include "PlaylistSnapshot.h"
 #include "RenderPlaylistItem.h"
 #include "TrackProperties.h"
 
@@ -34,36 +35,38 @@ compare_playlist_items(const void* a, const void* b)
 RenderPlaylist::RenderPlaylist(const Playlist& other,
 		double frame, color_space format, ClipRendererCache* rendererCache)
 	: Playlist()
+	, fSnapshot(NULL)
 {
-	// clone all the needed items at the given frame as RenderPlaylistItems
-	// and put the clones in this container's list
-	int32 count = other.CountItems();
-	for (int32 i = 0; i < count; i++) {
-		PlaylistItem* item = other.ItemAtFast(i);
-		if (!other.IsTrackEnabled(item->Track())
-			|| !item->HasVideo() || item->IsVideoMuted()
-			|| item->StartFrame() > frame
-			|| item->EndFrame() < floor(frame)) {
-			continue;
-		}
+	_Init(other, NULL, frame, format, rendererCache, true);
+}
 
-		PlaylistItem* clone
-			= new (nothrow) RenderPlaylistItem(item,
-				frame, format, rendererCache);
-		if (clone && !AddItem(clone)) {
-			// no memory to put the clone in the list
-			printf("RenderPlaylist() - no mem for AddItem()!\n");
-			delete clone;
-			break;
-		}
-	}
+// constructor
+//
+// The items refer to the items of the snapshot, so we keep a reference
+// to it. The renderers are synchronized with their clips only if
+// /syncRenderers/ is true, in which case the document needs to be read
+// locked.
+RenderPlaylist::RenderPlaylist(PlaylistSnapshot* snapshot,
+		double frame, color_space format, ClipRendererCache* rendererCache,
+		bool syncRenderers)
+	: Playlist()
+	, fSnapshot(snapshot)
+{
+	if (!fSnapshot)
+		return;
 
-	SortItems(compare_playlist_items);
+	fSnapshot->Acquire();
+	_Init(*fSnapshot->Playlist(), fSnapshot, frame, format, rendererCache,
+		syncRenderers);
 }
 
 // destructor
 RenderPlaylist::~RenderPlaylist()
 {
+	// the items need to be gone before the snapshot
+	MakeEmpty();
+	if (fSnapshot)
+		fSnapshot->Release();
 }
 
 // Generate
@@ -124,3 +127,40 @@ RenderPlaylist::RemoveSolidRegion(BRegion* cleanBG,
 	}
 }
 
+// #pragma mark -
+
+// _Init
+void
+RenderPlaylist::_Init(const Playlist& other, const PlaylistSnapshot* snapshot,
+	double frame, color_space format, ClipRendererCache* rendererCache,
+	bool syncRenderers)
+{
+	// clone all the needed items at the given frame as RenderPlaylistItems
+	// and put the clones in this container's list
+	int32 count = other.CountItems();
+	for (int32 i = 0; i < count; i++) {
+		PlaylistItem* item = other.ItemAtFast(i);
+		if (!other.IsTrackEnabled(item->Track())
+			|| !item->HasVideo() || item->IsVideoMuted()
+			|| item->StartFrame() > frame
+			|| item->EndFrame() < floor(frame)) {
+			continue;
+		}
+
+		// renderers are cached by the items of the document
+		const PlaylistItem* cacheKey
+			= snapshot ? snapshot->OriginalItemAt(i) : item;
+
+		PlaylistItem* clone
+			= new (nothrow) RenderPlaylistItem(item, cacheKey,
+				frame, format, rendererCache, syncRenderers);
+		if (clone && !AddItem(clone)) {
+			// no memory to put the clone in the list
+			printf("RenderPlaylist() - no mem for AddItem()!\n");
+			delete clone;
+			break;
+		}
+	}
+
+	SortItems(compare_playlist_items);
+}
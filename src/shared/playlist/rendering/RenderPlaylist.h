@@ -13,18 +13,32 @@
 class BRegion;
 class ClipRendererCache;
 class Painter;
+class PlaylistSnapshot;
 
 class RenderPlaylist : public Playlist {
  public:
 								RenderPlaylist(const Playlist& other,
 									double frame, color_space format,
 									ClipRendererCache* rendererCache);
+								RenderPlaylist(PlaylistSnapshot* snapshot,
+									double frame, color_space format,
+									ClipRendererCache* rendererCache,
+									bool syncRenderers);
 	virtual						~RenderPlaylist();
 
 			status_t			Generate(Painter* painter, double frame);
 
 			void				RemoveSolidRegion(BRegion* cleanBG,
 									Painter* painter, double frame);
+
+ private:
+			void				_Init(const Playlist& other,
+									const PlaylistSnapshot* snapshot,
+									double frame, color_space format,
+									ClipRendererCache* rendererCache,
+									bool syncRenderers);
+
+			PlaylistSnapshot*	fSnapshot;
 };
 
 #endif // RENDER_PLAYLIST_H
@@ -43,9 +43,15 @@
 
 using std::nothrow;
 
-// constructor 
-RenderPlaylistItem::RenderPlaylistItem(PlaylistItem* other, double frame,
-		color_space format, ClipRendererCache* rendererCache)
+// constructor
+//
+// The renderer is looked up in the cache by /cacheKey/, which is the item
+// of the document, when /other/ belongs to a PlaylistSnapshot. Renderers
+// are only created or synchronized with their clips, if /syncRenderer/ is
+// true, which requires the document to be read locked.
+RenderPlaylistItem::RenderPlaylistItem(PlaylistItem* other,
+		const PlaylistItem* cacheKey, double frame, color_space format,
+		ClipRendererCache* rendererCache, bool syncRenderer)
 	: PlaylistItem(*other)
 	, fOriginalItem(other)
 	, fRenderer(NULL)
@@ -69,11 +75,23 @@ RenderPlaylistItem::RenderPlaylistItem(PlaylistItem* other, double frame,
 
 	// create a renderer if there is not already one
 	if (fOriginalItem->HasVideo()) {
-		ClipRenderer* renderer = rendererCache->RendererFor(fOriginalItem);
-		if (!renderer || renderer->NeedsReload()) {
+		ClipRenderer* renderer = rendererCache->RendererFor(cacheKey);
+		ClipPlaylistItem* clipItem
+			= dynamic_cast<ClipPlaylistItem*>(fOriginalItem);
+		if (renderer && clipItem)
+			renderer->SetItem(clipItem);
+
+		if (!syncRenderer) {
+			// the clips must not be accessed, keep rendering what the
+			// renderer has synchronized last (if there is a renderer)
+			if (renderer) {
+				fRenderer = renderer;
+				fRenderer->Acquire();
+			}
+		} else if (!renderer || renderer->NeedsReload()) {
 			if (renderer)
-				rendererCache->RemoveRendererFor(fOriginalItem);
-			_CreateRenderer(format, rendererCache);
+				rendererCache->RemoveRendererFor(cacheKey);
+			_CreateRenderer(format, rendererCache, cacheKey);
 		} else {
 			fRenderer = renderer;
 			fRenderer->Acquire();
@@ -212,7 +230,7 @@ RenderPlaylistItem::Alpha() const
 
 void
 RenderPlaylistItem::_CreateRenderer(color_space format,
-	ClipRendererCache* rendererCache)
+	ClipRendererCache* rendererCache, const PlaylistItem* cacheKey)
 {
 	ClipPlaylistItem* clipItem = dynamic_cast<ClipPlaylistItem*>(fOriginalItem);
 	if (!clipItem)
@@ -264,7 +282,7 @@ RenderPlaylistItem::_CreateRenderer(color_space format,
 	}
 
 	if (!renderer
-		|| !rendererCache->AddRenderer(renderer, clipItem)) {
+		|| !rendererCache->AddRenderer(renderer, cacheKey)) {
 		printf("RenderPlaylistItem::_CreateRenderer() - "
 			"no memory to add renderer\n");
 		delete renderer;
@@ -18,8 +18,10 @@ class Painter;
 class RenderPlaylistItem : public PlaylistItem {
 public:
 								RenderPlaylistItem(PlaylistItem* other,
+									const PlaylistItem* cacheKey,
 									double frame, color_space format,
-									ClipRendererCache* rendererCache);
+									ClipRendererCache* rendererCache,
+									bool syncRenderer);
 	virtual						~RenderPlaylistItem();
 
 	// PlaylistItem interface
@@ -46,7 +48,8 @@ public:
 
 private:
 			void				_CreateRenderer(color_space format,
-									ClipRendererCache* rendererCache);
+									ClipRendererCache* rendererCache,
+									const PlaylistItem* cacheKey);
 			float				_ValueAt(const Property* property,
 									double frame,
 									float defaultValue) const;
@@ -0,0 +1,416 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+#include "RenderedFrameCache.h"
+
+#include <new>
+#include <math.h>
+#include <stdlib.h>
+
+#include <Bitmap.h>
+
+#include "AutoLocker.h"
+#include "ClipPlaylistItem.h"
+#include "ClipRenderer.h"
+#include "ClockClip.h"
+#include "CollectingPlaylist.h"
+#include "Playlist.h"
+#include "RenderPlaylist.h"
+#include "RenderPlaylistItem.h"
+#include "ScrollingTextClip.h"
+#include "TimerClip.h"
+#include "WeatherClip.h"
+
+using std::nothrow;
+
+enum {
+	MAX_NESTING_LEVEL	= 16,
+	MAX_FAILED_FRAMES	= 8
+};
+
+// hash_string
+static inline uint32
+hash_string(uint32 hash, const char* string)
+{
+	while (*string)
+		hash = hash * 31 + (uint8)*string++;
+	return hash;
+}
+
+// hash_value
+static inline uint32
+hash_value(uint32 hash, uint32 value)
+{
+	return hash * 31 + value;
+}
+
+// #pragma mark -
+
+RenderedFrameCache*
+RenderedFrameCache::sDefaultCache = NULL;
+
+// constructor
+RenderedFrameCache::RenderedFrameCache(size_t memoryLimit)
+	: fLock("rendered frame cache")
+	, fEntries()
+	, fLRU()
+	, fMemoryUsage(0)
+	, fMemoryLimit(memoryLimit)
+	, fPlaylists()
+	, fHits(0)
+	, fMisses(0)
+{
+}
+
+// destructor
+RenderedFrameCache::~RenderedFrameCache()
+{
+	MakeEmpty();
+}
+
+// InitCheck
+status_t
+RenderedFrameCache::InitCheck() const
+{
+	if (fLock.Sem() < B_OK)
+		return fLock.Sem();
+	if (fEntries.InitCheck() < B_OK)
+		return fEntries.InitCheck();
+	return fPlaylists.InitCheck();
+}
+
+// CreateDefault
+RenderedFrameCache*
+RenderedFrameCache::CreateDefault()
+{
+	if (!sDefaultCache) {
+		sDefaultCache = new (nothrow) RenderedFrameCache();
+		if (sDefaultCache && sDefaultCache->InitCheck() != B_OK)
+			DeleteDefault();
+	}
+	return sDefaultCache;
+}
+
+// DeleteDefault
+void
+RenderedFrameCache::DeleteDefault()
+{
+	delete sDefaultCache;
+	sDefaultCache = NULL;
+}
+
+// Default
+RenderedFrameCache*
+RenderedFrameCache::Default()
+{
+	return sDefaultCache;
+}
+
+// MakeEmpty
+void
+RenderedFrameCache::MakeEmpty()
+{
+	AutoLocker<BLocker> locker(fLock);
+
+	while (Entry* entry = fLRU.GetFirst())
+		_RemoveEntry(entry);
+	fPlaylists.Clear();
+}
+
+// GetKey
+bool
+RenderedFrameCache::GetKey(const RenderPlaylist& playlist, double frame,
+	const BBitmap* bitmap, BString* key, const Playlist** _subPlaylist)
+{
+	// the rendered frame needs to be the sub-playlist frame
+	// and nothing else
+	if (playlist.CountItems() != 1 || frame != floor(frame))
+		return false;
+
+	RenderPlaylistItem* item = (RenderPlaylistItem*)playlist.ItemAtFast(0);
+	if (!item->Renderer() || item->Alpha() != 1.0
+		|| !item->Transformation().IsIdentity()) {
+		return false;
+	}
+
+	const Playlist* subPlaylist
+		= dynamic_cast<const Playlist*>(item->Renderer()->Clip());
+	if (!subPlaylist)
+		return false;
+
+	int64 localFrame = (int64)frame - item->StartFrame();
+	if (localFrame < 0 || localFrame >= (int64)item->Duration())
+		return false;
+	localFrame += item->ClipOffset();
+
+	// the sub-playlist tree is checked only once, not for every frame
+	{
+		AutoLocker<BLocker> locker(fLock);
+
+		PlaylistInfo info;
+		if (fPlaylists.ContainsKey(subPlaylist))
+			info = fPlaylists.Get(subPlaylist);
+		else {
+			info.cacheable = IsDeterministic(subPlaylist);
+			info.failedFrames = 0;
+			fPlaylists.Put(subPlaylist, info);
+		}
+		if (!info.cacheable)
+			return false;
+	}
+
+	key->SetTo(subPlaylist->ID());
+	*key << "-" << (uint64)(addr_t)subPlaylist
+		<< "-" << localFrame
+		<< "-" << bitmap->Bounds().IntegerWidth() + 1
+		<< "x" << bitmap->Bounds().IntegerHeight() + 1
+		<< "-" << (int32)bitmap->ColorSpace();
+	*_subPlaylist = subPlaylist;
+	return true;
+}
+
+// IsDeterministic
+/*static*/ bool
+RenderedFrameCache::IsDeterministic(const Playlist* playlist)
+{
+	return _IsDeterministic(playlist, 0);
+}
+
+// VersionSignature
+/*static*/ uint32
+RenderedFrameCache::VersionSignature(const Playlist* playlist)
+{
+	uint32 signature = 0;
+	_AddVersionSignature(playlist, &signature, 0);
+	return signature;
+}
+
+// GetFrame
+bool
+RenderedFrameCache::GetFrame(const BString& key, BBitmap* bitmap)
+{
+	AutoLocker<BLocker> locker(fLock);
+
+	Entry* entry = fEntries.Get(key.String());
+	if (!entry || entry->bitsLength != (size_t)bitmap->BitsLength()) {
+		fMisses++;
+		return false;
+	}
+
+	// move the entry to the front of the LRU list
+	fLRU.Remove(entry);
+	fLRU.Insert(entry, false);
+
+	_Decode(entry->data, entry->size, (uint32*)bitmap->Bits());
+	fHits++;
+	return true;
+}
+
+// AddFrame
+void
+RenderedFrameCache::AddFrame(const BString& key, const Playlist* subPlaylist,
+	const BBitmap* bitmap)
+{
+	{
+		// don't bother encoding frames which would be thrown away
+		AutoLocker<BLocker> locker(fLock);
+		if (fEntries.ContainsKey(key.String())
+			|| !fPlaylists.ContainsKey(subPlaylist)
+			|| !fPlaylists.Get(subPlaylist).cacheable) {
+			return;
+		}
+	}
+
+	// frames which don't compress to a quarter of their size are most
+	// likely video, they would only push the other frames out of the
+	// cache without being used again before being pushed out themselves
+	size_t bitsLength = bitmap->BitsLength();
+	size_t maxSize = bitsLength / 4;
+
+	uint32* data = (uint32*)malloc(maxSize);
+	if (!data)
+		return;
+
+	size_t size = _Encode((const uint32*)bitmap->Bits(), bitsLength / 4,
+		data, maxSize);
+
+	AutoLocker<BLocker> locker(fLock);
+
+	// after a couple of frames in a row which don't compress, the
+	// sub-playlist is not cached anymore
+	if (fPlaylists.ContainsKey(subPlaylist)) {
+		PlaylistInfo info = fPlaylists.Get(subPlaylist);
+		if (size == 0) {
+			if (++info.failedFrames >= MAX_FAILED_FRAMES)
+				info.cacheable = false;
+		} else
+			info.failedFrames = 0;
+		fPlaylists.Put(subPlaylist, info);
+	}
+
+	if (size == 0 || fEntries.ContainsKey(key.String())) {
+		free(data);
+		return;
+	}
+
+	uint32* compacted = (uint32*)realloc(data, size);
+	if (compacted)
+		data = compacted;
+
+	Entry* entry = new (nothrow) Entry;
+	if (!entry) {
+		free(data);
+		return;
+	}
+
+	entry->key = key;
+	entry->data = data;
+	entry->size = size;
+	entry->bitsLength = bitsLength;
+	if (fEntries.Put(key.String(), entry) < B_OK) {
+		free(data);
+		delete entry;
+		return;
+	}
+
+	fLRU.Insert(entry, false);
+	fMemoryUsage += sizeof(Entry) + entry->key.Length() + size;
+
+	_Trim();
+}
+
+// GetStatistics
+void
+RenderedFrameCache::GetStatistics(int64* hits, int64* misses) const
+{
+	*hits = fHits;
+	*misses = fMisses;
+}
+
+// #pragma mark -
+
+// _IsDeterministic
+/*static*/ bool
+RenderedFrameCache::_IsDeterministic(const Playlist* playlist, int32 level)
+{
+	if (level > MAX_NESTING_LEVEL
+		|| dynamic_cast<const CollectingPlaylist*>(playlist)) {
+		return false;
+	}
+
+	int32 count = playlist->CountItems();
+	for (int32 i = 0; i < count; i++) {
+		ClipPlaylistItem* item
+			= dynamic_cast<ClipPlaylistItem*>(playlist->ItemAtFast(i));
+		if (!item || !item->Clip())
+			continue;
+
+		Clip* clip = item->Clip();
+		if (dynamic_cast<ClockClip*>(clip)
+			|| dynamic_cast<TimerClip*>(clip)
+			|| dynamic_cast<ScrollingTextClip*>(clip)
+			|| dynamic_cast<WeatherClip*>(clip)) {
+			return false;
+		}
+
+		if (Playlist* subPlaylist = dynamic_cast<Playlist*>(clip)) {
+			if (!_IsDeterministic(subPlaylist, level + 1))
+				return false;
+		}
+	}
+	return true;
+}
+
+// _AddVersionSignature
+/*static*/ void
+RenderedFrameCache::_AddVersionSignature(const Playlist* playlist,
+	uint32* signature, int32 level)
+{
+	if (level > MAX_NESTING_LEVEL)
+		return;
+
+	*signature = hash_value(*signature, playlist->ChangeToken());
+
+	int32 count = playlist->CountItems();
+	for (int32 i = 0; i < count; i++) {
+		ClipPlaylistItem* item
+			= dynamic_cast<ClipPlaylistItem*>(playlist->ItemAtFast(i));
+		if (!item || !item->Clip())
+			continue;
+
+		Clip* clip = item->Clip();
+		*signature = hash_string(*signature, clip->ID().String());
+		*signature = hash_value(*signature, clip->Version());
+		*signature = hash_value(*signature, clip->ChangeToken());
+
+		if (Playlist* subPlaylist = dynamic_cast<Playlist*>(clip))
+			_AddVersionSignature(subPlaylist, signature, level + 1);
+	}
+}
+
+// _Encode
+//
+// Encodes the bits as pairs of run length and value. Returns the size of
+// the encoded data, or 0 if it would be larger than maxSize.
+/*static*/ size_t
+RenderedFrameCache::_Encode(const uint32* bits, size_t count, uint32* data,
+	size_t maxSize)
+{
+	size_t maxPairs = maxSize / (2 * sizeof(uint32));
+	size_t pairs = 0;
+
+	size_t i = 0;
+	while (i < count) {
+		if (pairs == maxPairs)
+			return 0;
+
+		uint32 value = bits[i];
+		size_t run = 1;
+		while (i + run < count && bits[i + run] == value
+			&& run < 0xffffffff) {
+			run++;
+		}
+
+		data[pairs * 2] = run;
+		data[pairs * 2 + 1] = value;
+		pairs++;
+		i += run;
+	}
+	return pairs * 2 * sizeof(uint32);
+}
+
+// _Decode
+/*static*/ void
+RenderedFrameCache::_Decode(const uint32* data, size_t size, uint32* bits)
+{
+	size_t pairs = size / (2 * sizeof(uint32));
+	for (size_t i = 0; i < pairs; i++) {
+		uint32 run = data[i * 2];
+		uint32 value = data[i * 2 + 1];
+		while (run--)
+			*bits++ = value;
+	}
+}
+
+// _RemoveEntry
+void
+RenderedFrameCache::_RemoveEntry(Entry* entry)
+{
+	fEntries.Remove(entry->key.String());
+	fLRU.Remove(entry);
+	fMemoryUsage -= sizeof(Entry) + entry->key.Length() + entry->size;
+
+	free(entry->data);
+	delete entry;
+}
+
+// _Trim
+void
+RenderedFrameCache::_Trim()
+{
+	// always keep the most recently used frame
+	while (fMemoryUsage > fMemoryLimit && fLRU.GetLast() != fLRU.GetFirst())
+		_RemoveEntry(fLRU.GetLast());
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+#ifndef RENDERED_FRAME_CACHE_H
+#define RENDERED_FRAME_CACHE_H
+
+#include <Locker.h>
+#include <String.h>
+
+#include "DLList.h"
+#include "HashMap.h"
+#include "HashString.h"
+
+class BBitmap;
+class Playlist;
+class RenderPlaylist;
+
+// RenderedFrameCache
+//
+// Keeps rendered frames of sub-playlists, which are repeated many times
+// within a schedule, so that each of their frames has to be rendered only
+// once. A frame can be cached when the only item at the frame is a
+// sub-playlist without transformation or transparency, and when the
+// sub-playlist doesn't contain anything which changes with the real time
+// (clocks, timers, scrolling text, weather). The frames are kept run
+// length encoded in a memory bounded LRU, sub-playlists whose frames don't
+// compress well (video) are not cached at all.
+//
+// The frames are keyed by the sub-playlist object, since the playlists
+// have no revision which would change with every edit. The cache is
+// therefore emptied whenever an export starts and whenever the document
+// is changed.
+class RenderedFrameCache {
+ public:
+	enum {
+		DEFAULT_MEMORY_LIMIT	= 64 * 1024 * 1024
+	};
+
+								RenderedFrameCache(size_t memoryLimit
+									= DEFAULT_MEMORY_LIMIT);
+	virtual						~RenderedFrameCache();
+
+			status_t			InitCheck() const;
+
+	static	RenderedFrameCache*	CreateDefault();
+	static	void				DeleteDefault();
+	static	RenderedFrameCache*	Default();
+
+			void				MakeEmpty();
+
+	// Returns false if the frame of the render playlist cannot be cached.
+			bool				GetKey(const RenderPlaylist& playlist,
+									double frame, const BBitmap* bitmap,
+									BString* key,
+									const Playlist** _subPlaylist);
+	// Returns false if the playlist contains anything which changes
+	// with the real time.
+	static	bool				IsDeterministic(const Playlist* playlist);
+	// A hash of the IDs, versions and change tokens of the playlist and
+	// of all clips used by it. Editing a clip does not bump its version,
+	// so the signature identifies the content only where objects change
+	// by new versions alone, as in the player.
+	static	uint32				VersionSignature(const Playlist* playlist);
+
+			bool				GetFrame(const BString& key, BBitmap* bitmap);
+			void				AddFrame(const BString& key,
+									const Playlist* subPlaylist,
+									const BBitmap* bitmap);
+
+			size_t				MemoryUsage() const
+									{ return fMemoryUsage; }
+			void				GetStatistics(int64* hits,
+									int64* misses) const;
+
+ private:
+			struct Entry : DLListLinkImpl<Entry> {
+				BString			key;
+				uint32*			data;
+				size_t			size;
+				size_t			bitsLength;
+			};
+
+			struct PlaylistInfo {
+				bool			cacheable;
+				int32			failedFrames;
+					// consecutive frames which didn't compress
+			};
+
+	typedef HashMap<HashString, Entry*> EntryMap;
+	typedef DLList<Entry> EntryList;
+	typedef HashMap<HashKey32<const Playlist*>, PlaylistInfo> PlaylistInfoMap;
+
+	static	bool				_IsDeterministic(const Playlist* playlist,
+									int32 level);
+	static	void				_AddVersionSignature(
+									const Playlist* playlist,
+									uint32* signature, int32 level);
+	static	size_t				_Encode(const uint32* bits, size_t count,
+									uint32* data, size_t maxSize);
+	static	void				_Decode(const uint32* data, size_t size,
+									uint32* bits);
+
+			void				_RemoveEntry(Entry* entry);
+			void				_Trim();
+
+			BLocker				fLock;
+			EntryMap			fEntries;
+			EntryList			fLRU;
+				// most recently used first
+			size_t				fMemoryUsage;
+			size_t				fMemoryLimit;
+			PlaylistInfoMap		fPlaylists;
+
+			int64				fHits;
+			int64				fMisses;
+
+	static	RenderedFrameCache*	sDefaultCache;
+};
+
+#endif // RENDERED_FRAME_CACHE_H
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+// Plays a synthetic source which stalls randomly, like a slow codec or a
+// busy disk would, once directly and once through a ReadAheadAudioReader,
+// and prints how long the reads took in the worst case. Each sample of the
+// source is its frame position plus one, so that the test can check that
+// whatever the ReadAheadAudioReader returns is either silence or the audio
+// at the requested position, also across seeks and invalidations.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+
+#include "ReadAheadAudioReader.h"
+
+static const float kFrameRate = 44100.0;
+static const int64 kBufferFrames = 1024;
+static const int32 kBufferCount = 400;
+static const bigtime_t kReadAheadTime = 500000;
+
+class StallingAudioReader : public AudioReader {
+ public:
+	StallingAudioReader()
+		: AudioReader()
+	{
+		fFormat.type = B_MEDIA_RAW_AUDIO;
+		fFormat.u.raw_audio = media_raw_audio_format::wildcard;
+		fFormat.u.raw_audio.frame_rate = kFrameRate;
+		fFormat.u.raw_audio.channel_count = 1;
+		fFormat.u.raw_audio.format = media_raw_audio_format::B_AUDIO_INT;
+		fFormat.u.raw_audio.byte_order = B_MEDIA_HOST_ENDIAN;
+	}
+
+	virtual status_t Read(void* buffer, int64 pos, int64 frames)
+	{
+		// most reads are fast, some take longer than a buffer lasts
+		int32 dice = rand() % 100;
+		if (dice < 5)
+			snooze(100000 + rand() % 100000);
+		else if (dice < 30)
+			snooze(rand() % 10000);
+
+		int32* samples = (int32*)buffer;
+		for (int64 i = 0; i < frames; i++)
+			samples[i] = (int32)(pos + fOutOffset + i + 1);
+		return B_OK;
+	}
+};
+
+// play
+static void
+play(AudioReader* reader, const char* name)
+{
+	int32 samples[kBufferFrames];
+	bigtime_t bufferDuration = reader->TimeForFrame(kBufferFrames);
+	bigtime_t maxReadTime = 0;
+	bigtime_t totalReadTime = 0;
+	int64 silentFrames = 0;
+	int64 wrongFrames = 0;
+
+	int64 position = 0;
+	bigtime_t nextBuffer = system_time();
+	for (int32 i = 0; i < kBufferCount; i++) {
+		if (i == kBufferCount / 4) {
+			// seek forward
+			position += 100000;
+		} else if (i == kBufferCount / 2) {
+			// seek backward
+			position -= 50000;
+		} else if (i == 3 * kBufferCount / 4) {
+			ReadAheadAudioReader* readAhead
+				= dynamic_cast<ReadAheadAudioReader*>(reader);
+			if (readAhead)
+				readAhead->Invalidate();
+		}
+
+		bigtime_t startTime = system_time();
+		reader->Read(samples, position, kBufferFrames);
+		bigtime_t readTime = system_time() - startTime;
+		if (readTime > maxReadTime)
+			maxReadTime = readTime;
+		totalReadTime += readTime;
+
+		for (int64 j = 0; j < kBufferFrames; j++) {
+			if (samples[j] == 0)
+				silentFrames++;
+			else if (samples[j] != position + j + 1)
+				wrongFrames++;
+		}
+
+		position += kBufferFrames;
+		nextBuffer += bufferDuration;
+		snooze_until(nextBuffer, B_SYSTEM_TIMEBASE);
+	}
+
+	printf("%s:\n", name);
+	printf("  buffer duration: %lld us\n", bufferDuration);
+	printf("  max read time: %lld us, average: %lld us\n", maxReadTime,
+		totalReadTime / kBufferCount);
+	printf("  silent frames: %lld, wrong frames: %lld\n", silentFrames,
+		wrongFrames);
+}
+
+// main
+int
+main(int argc, const char* argv[])
+{
+	StallingAudioReader source;
+
+	srand(0);
+	play(&source, "direct");
+
+	ReadAheadAudioReader readAhead(&source, kReadAheadTime);
+	if (readAhead.InitCheck() != B_OK) {
+		printf("failed to init the read ahead reader: %s\n",
+			strerror(readAhead.InitCheck()));
+		return 1;
+	}
+	// give the worker a head start, like the audio output
+	// would have while connecting
+	snooze(kReadAheadTime);
+
+	srand(0);
+	play(&readAhead, "read ahead");
+
+	read_ahead_statistics statistics;
+	readAhead.GetStatistics(statistics);
+	printf("  reads: %lld, underruns: %lld (%lld frames), restarts: %lld, "
+		"synchronous reads: %lld\n", statistics.reads, statistics.underruns,
+		statistics.underrun_frames, statistics.restarts,
+		statistics.synchronous_reads);
+
+	return 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+// Measures how long the PlaylistItemAudioReader takes to play a quiet
+// clip with auto gain, once with the gain measured for each buffer and
+// once with the constant gain calculated from the loudness of the whole
+// clip. The range of the gains which were used is printed as well, a
+// wide range means the gain was pumping. The loudness is measured with
+// the LoudnessMeter, which the LoudnessAnalyzer uses for real clips.
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <Entry.h>
+#include <Message.h>
+#include <OS.h>
+
+#include "ClipPlaylistItem.h"
+#include "CommonPropertyIDs.h"
+#include "LoudnessAnalyzer.h"
+#include "MediaClip.h"
+#include "PlaylistItemAudioReader.h"
+
+static const float kFrameRate = 44100.0;
+static const uint32 kChannelCount = 2;
+static const int64 kDuration = 600;
+	// seconds
+static const int64 kBufferFrames = 2048;
+static const float kMaxAutoGain = 8.0;
+
+// A tone which is alternating between soft and loud every half second,
+// like a voice recorded too quietly.
+class QuietAudioReader : public AudioReader {
+ public:
+	QuietAudioReader()
+		: AudioReader()
+	{
+		fFormat.type = B_MEDIA_RAW_AUDIO;
+		fFormat.u.raw_audio = media_raw_audio_format::wildcard;
+		fFormat.u.raw_audio.frame_rate = kFrameRate;
+		fFormat.u.raw_audio.channel_count = kChannelCount;
+		fFormat.u.raw_audio.format = media_raw_audio_format::B_AUDIO_FLOAT;
+		fFormat.u.raw_audio.byte_order = B_MEDIA_HOST_ENDIAN;
+
+		// one second of samples, repeated
+		fPeriod = (int64)kFrameRate;
+		fSamples = new float[fPeriod * kChannelCount];
+		for (int64 i = 0; i < fPeriod; i++) {
+			float amplitude = i < fPeriod / 2 ? 0.02 : 0.1;
+			float sample = amplitude * sinf(2 * M_PI * 440.0 * i / kFrameRate);
+			for (uint32 c = 0; c < kChannelCount; c++)
+				fSamples[i * kChannelCount + c] = sample;
+		}
+	}
+
+	virtual ~QuietAudioReader()
+	{
+		delete[] fSamples;
+	}
+
+	virtual status_t Read(void* buffer, int64 pos, int64 frames)
+	{
+		float* samples = (float*)buffer;
+		pos += fOutOffset;
+		while (frames > 0) {
+			int64 offset = pos % fPeriod;
+			int64 count = min_c(frames, fPeriod - offset);
+			memcpy(samples, fSamples + offset * kChannelCount,
+				count * kChannelCount * sizeof(float));
+			samples += count * kChannelCount;
+			pos += count;
+			frames -= count;
+		}
+		return B_OK;
+	}
+
+ private:
+	float*		fSamples;
+	int64		fPeriod;
+};
+
+// create_clip
+static MediaClip*
+create_clip(bool withLoudness)
+{
+	int64 frameCount = (int64)(kDuration * kFrameRate);
+
+	BMessage archive;
+	archive.AddFloat("audio fps", kFrameRate);
+	archive.AddInt64("audio frames", frameCount);
+
+	if (withLoudness) {
+		// what the LoudnessAnalyzer would have stored with the clip
+		QuietAudioReader reader;
+		LoudnessMeter meter(kFrameRate, kChannelCount);
+		float* buffer = new float[kBufferFrames * kChannelCount];
+		for (int64 frame = 0; frame < frameCount; frame += kBufferFrames) {
+			int64 frames = min_c(kBufferFrames, frameCount - frame);
+			reader.Read(buffer, frame, frames);
+			meter.AddSamples(buffer, frames);
+		}
+		delete[] buffer;
+
+		printf("clip peak: %.3f, loudness: %.1f LUFS\n", meter.Peak(),
+			meter.IntegratedLoudness());
+		archive.AddFloat("audio peak", meter.Peak());
+		archive.AddFloat("audio loudness", meter.IntegratedLoudness());
+	}
+
+	entry_ref ref(-1, -1, "quiet clip");
+	return new MediaClip(&ref, archive);
+}
+
+// play
+static void
+play(bool withLoudness, const char* name)
+{
+	MediaClip* clip = create_clip(withLoudness);
+	ClipPlaylistItem item(clip);
+	item.SetValue(PROPERTY_MAX_AUTO_GAIN, kMaxAutoGain);
+
+	PlaylistItemAudioReader reader(&item, new QuietAudioReader());
+
+	int64 frameCount = (int64)(kDuration * kFrameRate);
+	float* buffer = new float[kBufferFrames * kChannelCount];
+
+	// the playback path, gain calculation and scaling
+	bigtime_t startTime = system_time();
+	for (int64 frame = 0; frame < frameCount; frame += kBufferFrames)
+		reader.Read(buffer, frame, kBufferFrames);
+	bigtime_t duration = system_time() - startTime;
+
+	// the gains which have been used, after the first minute
+	// to give the measurement per buffer time to settle
+	float minGain = kMaxAutoGain;
+	float maxGain = 0.0;
+	for (int64 frame = (int64)(60 * kFrameRate); frame < frameCount;
+			frame += kBufferFrames) {
+		float startGain;
+		float endGain;
+		reader.ReadUnscaled(buffer, frame, kBufferFrames, &startGain,
+			&endGain);
+		minGain = min_c(minGain, endGain);
+		maxGain = max_c(maxGain, endGain);
+	}
+
+	delete[] buffer;
+
+	printf("%s:\n", name);
+	printf("  %lld seconds of audio in %lld us, %.0f times real time\n",
+		kDuration, duration, kDuration * 1000000.0 / duration);
+	printf("  gain between %.2f and %.2f\n", minGain, maxGain);
+
+	item.SetClip(NULL);
+	clip->Release();
+}
+
+// main
+int
+main(int argc, const char* argv[])
+{
+	// there is no LoudnessAnalyzer, so the clip without
+	// the loudness keeps being measured per buffer
+	play(false, "gain per buffer");
+	play(true, "gain per clip");
+
+	return 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Entry.h>
+#include <OS.h>
+
+#include "ContentHasher.h"
+
+
+class CountingListener : public ContentHashListener {
+public:
+	CountingListener(int32 count)
+		: fDone(create_sem(0, "hashing done")),
+		  fErrors(0)
+	{
+		fRemaining = count;
+	}
+
+	~CountingListener()
+	{
+		delete_sem(fDone);
+	}
+
+	virtual void ContentHashed(const entry_ref& ref, ContentDigest* digest,
+		status_t status)
+	{
+		if (status < B_OK) {
+			fprintf(stderr, "failed to hash \"%s\": %s\n", ref.name,
+				strerror(status));
+			atomic_add(&fErrors, 1);
+		}
+		if (atomic_add(&fRemaining, -1) == 1)
+			release_sem(fDone);
+	}
+
+	void Wait()
+	{
+		while (acquire_sem(fDone) == B_INTERRUPTED)
+			;
+	}
+
+private:
+	sem_id	fDone;
+	int32	fRemaining;
+	int32	fErrors;
+};
+
+
+static void
+run_benchmark(entry_ref* refs, int32 count, int32 workerCount)
+{
+	ContentHasher hasher(workerCount);
+	if (hasher.InitCheck() < B_OK) {
+		fprintf(stderr, "Error: Failed to init hasher: %s\n",
+			strerror(hasher.InitCheck()));
+		return;
+	}
+
+	// first pass reads all the files, the second one is served
+	// from the cache
+	for (int32 pass = 0; pass < 2; pass++) {
+		CountingListener listener(count);
+		bigtime_t startTime = system_time();
+		for (int32 i = 0; i < count; i++)
+			hasher.HashFile(refs[i], &listener);
+		listener.Wait();
+		bigtime_t duration = system_time() - startTime;
+
+		double gigaBytes = hasher.BytesHashed() / (1024.0 * 1024.0 * 1024.0);
+		printf("%ld workers, pass %ld: %.3f GB in %.3f s, %.3f GB/s "
+			"(cache hits: %ld, misses: %ld)\n", hasher.CountWorkers(),
+			pass + 1, gigaBytes, duration / 1000000.0,
+			pass == 0 ? gigaBytes * 1000000.0 / duration : 0.0,
+			hasher.CacheHits(), hasher.CacheMisses());
+	}
+}
+
+
+int
+main(int argc, const char* argv[])
+{
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s <file> ...\n", argv[0]);
+		exit(1);
+	}
+
+	int32 count = argc - 1;
+	entry_ref refs[count];
+	for (int32 i = 0; i < count; i++) {
+		status_t error = get_ref_for_path(argv[i + 1], &refs[i]);
+		if (error != B_OK) {
+			fprintf(stderr, "Error: Failed to get ref for \"%s\": %s\n",
+				argv[i + 1], strerror(error));
+			exit(1);
+		}
+	}
+
+	// NOTE: only the first run with a single worker measures the disk,
+	// the others will likely hit the file system cache
+	system_info info;
+	get_system_info(&info);
+	for (int32 workers = 1; workers <= info.cpu_count; workers *= 2)
+		run_benchmark(refs, count, workers);
+
+	ContentHasher hasher(1);
+	ContentDigest* digest;
+	if (hasher.HashFileSync(refs[0], &digest) == B_OK) {
+		BString string;
+		digest->GetFileDigestAsString(string);
+		printf("%s: %s (%ld blocks)\n", refs[0].name, string.String(),
+			digest->CountBlocks());
+		digest->Release();
+	}
+
+	return 0;
+}
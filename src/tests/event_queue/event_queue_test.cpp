@@ -0,0 +1,110 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Lets a number of threads add events to an EventQueue at random times
+// within the next fraction of a second, like the playback threads do, and
+// checks that all events are executed, none of them too early. Also tests
+// removing and rescheduling events and prints how late the events were.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <OS.h>
+
+#include "Event.h"
+#include "EventQueue.h"
+
+static const int32 kThreadCount = 4;
+static const int32 kEventsPerThread = 2000;
+static const bigtime_t kMaxEventDelay = 200000;
+
+static vint32 sExecutedEvents = 0;
+static vint32 sEarlyEvents = 0;
+
+class TestEvent : public Event {
+ public:
+	TestEvent(bigtime_t time)
+		: Event(time)
+	{
+	}
+
+	virtual void Execute()
+	{
+		if (system_time() < Time())
+			atomic_add(&sEarlyEvents, 1);
+		atomic_add(&sExecutedEvents, 1);
+	}
+};
+
+// add_events
+static int32
+add_events(void* cookie)
+{
+	EventQueue* queue = (EventQueue*)cookie;
+	for (int32 i = 0; i < kEventsPerThread; i++) {
+		queue->AddEvent(new TestEvent(system_time()
+			+ rand() % kMaxEventDelay));
+		if ((i & 63) == 0)
+			snooze(1000);
+	}
+	return 0;
+}
+
+// main
+int
+main(int argc, const char* const* argv)
+{
+	EventQueue queue;
+	if (queue.InitCheck() != B_OK)
+		return 1;
+
+	thread_id threads[kThreadCount];
+	for (int32 i = 0; i < kThreadCount; i++) {
+		threads[i] = spawn_thread(&add_events, "add events",
+			B_NORMAL_PRIORITY, &queue);
+		resume_thread(threads[i]);
+	}
+	for (int32 i = 0; i < kThreadCount; i++) {
+		status_t result;
+		wait_for_thread(threads[i], &result);
+	}
+	int32 expectedEvents = kThreadCount * kEventsPerThread;
+
+	// a removed event is not executed
+	TestEvent removed(system_time() + kMaxEventDelay / 2);
+	removed.SetAutoDelete(false);
+	queue.AddEvent(&removed);
+	bool success = queue.RemoveEvent(&removed);
+	if (!success)
+		printf("FAILED: could not remove event\n");
+
+	// a rescheduled event is executed at the new time
+	TestEvent* changed = new TestEvent(system_time() + 100 * kMaxEventDelay);
+	queue.AddEvent(changed);
+	queue.ChangeEvent(changed, system_time() + kMaxEventDelay / 2);
+	expectedEvents++;
+
+	snooze(2 * kMaxEventDelay);
+
+	event_queue_statistics statistics;
+	queue.GetStatistics(statistics);
+	printf("executed %ld of %ld events, %lld late, lateness: average %lld us, "
+		"max %lld us\n", sExecutedEvents, expectedEvents,
+		statistics.late_events, statistics.executed_events > 0
+			? statistics.lateness / statistics.executed_events : 0,
+		statistics.max_lateness);
+
+	if (sExecutedEvents != expectedEvents) {
+		printf("FAILED: not all events have been executed\n");
+		success = false;
+	}
+	if (sEarlyEvents > 0) {
+		printf("FAILED: %ld events have been executed too early\n",
+			sEarlyEvents);
+		success = false;
+	}
+
+	return success ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+// Measures how many frames per second the ImageSequenceStream encodes and
+// decodes at 720p and 1080p, once with each frame compressed as a single
+// JPEG by the calling thread, and once with each frame split into slices
+// which are compressed by a worker per CPU. The frames are written to and
+// read from the directory given on the command line, or /tmp.
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <Entry.h>
+#include <OS.h>
+#include <String.h>
+
+#include "ImageSequenceStream.h"
+
+static const int64 kFrameCount = 100;
+
+// fill_frame
+//
+// Some smooth gradients and some detail, so that the encoder has
+// something to do.
+static void
+fill_frame(uint8* bits, uint32 width, uint32 height, uint32 bytesPerRow,
+	int64 frame)
+{
+	for (uint32 y = 0; y < height; y++) {
+		uint8* pixel = bits + y * bytesPerRow;
+		for (uint32 x = 0; x < width; x += 2) {
+			pixel[0] = (uint8)(x + y + frame * 4);
+			pixel[1] = (uint8)(128 + 64 * sin((x + frame) / 50.0));
+			pixel[2] = (uint8)((x ^ y) + frame);
+			pixel[3] = (uint8)(128 + 64 * cos((y + frame) / 30.0));
+			pixel += 4;
+		}
+	}
+}
+
+// run
+static void
+run(const char* path, uint32 width, uint32 height, int32 sliceCount,
+	int32 workerCount)
+{
+	uint32 bytesPerRow = ((width * 2 + 3) / 4) * 4;
+	uint8* bits = new uint8[bytesPerRow * height];
+
+	ImageSequenceStream stream;
+	status_t ret = stream.Init(path, width, height, YCbCr422, kFrameCount,
+		sliceCount);
+	if (ret == B_OK)
+		ret = stream.SetWorkerCount(workerCount);
+	if (ret < B_OK) {
+		printf("creating stream failed: %s\n", strerror(ret));
+		delete[] bits;
+		return;
+	}
+
+	printf("%lux%lu, %ld slices, %ld workers:\n", width, height,
+		stream.CountSlices(), stream.CountWorkers());
+
+	// the time to fill the frames is not measured
+	bigtime_t writeTime = 0;
+	for (int64 frame = 0; frame < kFrameCount; frame++) {
+		fill_frame(bits, width, height, bytesPerRow, frame);
+		bigtime_t startTime = system_time();
+		ret = stream.WriteFrame(bits);
+		writeTime += system_time() - startTime;
+		if (ret < B_OK) {
+			printf("  writing frame %lld failed: %s\n", frame, strerror(ret));
+			break;
+		}
+	}
+	stream.Finalize();
+
+	ret = stream.Init(path);
+	if (ret == B_OK)
+		ret = stream.SetWorkerCount(workerCount);
+	if (ret < B_OK) {
+		printf("  opening stream failed: %s\n", strerror(ret));
+		delete[] bits;
+		return;
+	}
+
+	bigtime_t startTime = system_time();
+	for (int64 frame = 0; frame < kFrameCount; frame++) {
+		ret = stream.ReadFrame(bits);
+		if (ret < B_OK) {
+			printf("  reading frame %lld failed: %s\n", frame, strerror(ret));
+			break;
+		}
+	}
+	bigtime_t readTime = system_time() - startTime;
+
+	printf("  write: %.1f fps\n", kFrameCount * 1000000.0 / writeTime);
+	printf("  read:  %.1f fps\n", kFrameCount * 1000000.0 / readTime);
+
+	delete[] bits;
+}
+
+// main
+int
+main(int argc, const char* argv[])
+{
+	BString path(argc > 1 ? argv[1] : "/tmp");
+	path << "/image_sequence_benchmark";
+
+	system_info info;
+	get_system_info(&info);
+	int32 workerCount = info.cpu_count;
+
+	run(path.String(), 1280, 720, 1, 0);
+	run(path.String(), 1280, 720, 4, workerCount);
+	run(path.String(), 1920, 1080, 1, 0);
+	run(path.String(), 1920, 1080, 4, workerCount);
+
+	BEntry(path.String()).Remove();
+
+	return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2009, Ingo Weinhold <ingo_weinhold@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+
+#include "AsyncLogWriter.h"
+#include "Logger.h"
+#include "Logging.h"
+
+
+static const int32 kThreadCount = 8;
+static const int32 kMessagesPerThread = 100000;
+
+static Logger sLog("benchmark");
+static int64 sDroppedBefore = 0;
+
+
+static int32
+log_thread(void* cookie)
+{
+	int32 index = (int32)(addr_t)cookie;
+
+	for (int32 i = 0; i < kMessagesPerThread; i++)
+		LOG_INFO("thread %ld: message %ld, some payload: %f\n", index, i,
+			i * 0.5);
+
+	return 0;
+}
+
+
+static void
+run_benchmark(bool asynchronous)
+{
+	Logging::Default()->SetAsynchronous(asynchronous);
+
+	thread_id threads[kThreadCount];
+	bigtime_t startTime = system_time();
+
+	for (int32 i = 0; i < kThreadCount; i++) {
+		threads[i] = spawn_thread(&log_thread, "log benchmark",
+			B_NORMAL_PRIORITY, (void*)(addr_t)i);
+		resume_thread(threads[i]);
+	}
+
+	for (int32 i = 0; i < kThreadCount; i++) {
+		status_t result;
+		wait_for_thread(threads[i], &result);
+	}
+
+	// the time the callers were blocked
+	bigtime_t callerTime = system_time() - startTime;
+
+	Logging::Default()->Flush();
+	bigtime_t totalTime = system_time() - startTime;
+
+	// dropped messages make the callers look faster than they are, so
+	// they are reported together with the call rate
+	int64 messageCount = (int64)kThreadCount * kMessagesPerThread;
+	int64 dropped = 0;
+	if (AsyncLogWriter* writer = Logging::Default()->AsyncWriter())
+		dropped = writer->CountDroppedMessages() - sDroppedBefore;
+	sDroppedBefore += dropped;
+
+	printf("%s: %d threads, %lld calls in %.3f s: %.0f calls/s, "
+		"%lld dropped (%.1f%%) (all written after %.3f s)\n",
+		asynchronous ? "asynchronous" : "synchronous ", (int)kThreadCount,
+		messageCount, callerTime / 1000000.0,
+		messageCount * 1000000.0 / callerTime, dropped,
+		dropped * 100.0 / messageCount, totalTime / 1000000.0);
+}
+
+
+int
+main(int argc, const char* argv[])
+{
+	const char* configFile = argc > 1 ? argv[1] : "log_benchmark.properties";
+
+	status_t error = Logging::Default()->Init(configFile);
+	if (error != B_OK) {
+		fprintf(stderr, "Error: Failed to init logging: %s\n", strerror(error));
+		exit(1);
+	}
+
+	run_benchmark(false);
+	run_benchmark(true);
+
+	return 0;
+}
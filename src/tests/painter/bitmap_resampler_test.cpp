@@ -0,0 +1,189 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+// Compares the separable bitmap scaling of the Painter against the generic
+// AGG pipeline for all supported source formats and a range of scales.
+// Prints the pixel differences and the throughput of both, as well as the
+// throughput of the higher quality filters. Returns an error, if the
+// bilinear versions differ by more than rounding errors.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+
+#include "MemoryBuffer.h"
+#include "Painter.h"
+
+static const uint32 kSourceWidth = 720;
+static const uint32 kSourceHeight = 576;
+static const int32 kIterations = 10;
+static const int32 kMaxAllowedDifference = 2;
+
+static const double kScales[] = { 0.37, 0.5, 0.8, 1.25, 1.5, 2.67 };
+static const int32 kScaleCount = sizeof(kScales) / sizeof(double);
+
+// bytes_per_pixel
+static uint32
+bytes_per_pixel(pixel_format format)
+{
+	return format == YCbCr444 ? 3 : 4;
+}
+
+// fill_source
+static void
+fill_source(MemoryBuffer* buffer)
+{
+	uint32 bpp = bytes_per_pixel(buffer->PixelFormat());
+	bool hasAlpha = buffer->PixelFormat() != YCbCr444;
+	uint8* bits = (uint8*)buffer->Bits();
+	srand(1);
+	for (uint32 y = 0; y < buffer->Height(); y++) {
+		uint8* p = bits + y * buffer->BytesPerRow();
+		for (uint32 x = 0; x < buffer->Width(); x++) {
+			// some soft gradients, hard edges and noise
+			uint32 alpha = hasAlpha && ((x / 64 + y / 64) & 1) ? x & 255 : 255;
+			uint32 values[3] = {
+				(x + y) & 255,
+				((x / 16) & 1) ? 235 : 16,
+				rand() & 255
+			};
+			for (uint32 i = 0; i < 3; i++)
+				p[i] = values[i] * alpha / 255;
+			if (hasAlpha)
+				p[3] = alpha;
+			p += bpp;
+		}
+	}
+}
+
+// draw
+static bigtime_t
+draw(const MemoryBuffer* source, MemoryBuffer* dest, double scale,
+	bool separable, bitmap_filter filter, uint8 alpha)
+{
+	Painter painter;
+	if (!painter.AttachToBuffer(dest))
+		return -1;
+
+	painter.SetSeparableScaling(separable);
+	painter.SetBitmapFilter(filter);
+
+	BRect sourceRect = source->Bounds();
+	BRect destRect(3, 5, 3 + (int32)(source->Width() * scale) - 1,
+		5 + (int32)(source->Height() * scale) - 1);
+
+	bigtime_t startTime = system_time();
+	for (int32 i = 0; i < kIterations; i++) {
+		painter.ClearBuffer();
+		painter.SetAlpha(alpha);
+		painter.DrawBitmap(source, sourceRect, destRect);
+	}
+	bigtime_t time = (system_time() - startTime) / kIterations;
+
+	painter.FlushCaches();
+	return time;
+}
+
+// compare
+static int32
+compare(const MemoryBuffer* a, const MemoryBuffer* b, double* _mean)
+{
+	uint32 bpp = bytes_per_pixel(a->PixelFormat());
+	int32 maxDifference = 0;
+	uint64 total = 0;
+	// ignore the border pixels, where the pipelines may clip differently
+	for (uint32 y = 1; y < a->Height() - 1; y++) {
+		const uint8* pa = (const uint8*)a->Bits() + y * a->BytesPerRow() + bpp;
+		const uint8* pb = (const uint8*)b->Bits() + y * b->BytesPerRow() + bpp;
+		for (uint32 i = 0; i < (a->Width() - 2) * bpp; i++) {
+			int32 difference = abs((int32)pa[i] - (int32)pb[i]);
+			if (difference > maxDifference)
+				maxDifference = difference;
+			total += difference;
+		}
+	}
+	*_mean = (double)total / ((a->Width() - 2) * (a->Height() - 2) * bpp);
+	return maxDifference;
+}
+
+// test_format
+static int32
+test_format(pixel_format sourceFormat, const char* name)
+{
+	uint32 sourceBPP = bytes_per_pixel(sourceFormat);
+	MemoryBuffer source(kSourceWidth, kSourceHeight, sourceFormat,
+		(kSourceWidth * sourceBPP + 3) & ~3);
+	if (source.InitCheck() < B_OK)
+		return 1;
+	fill_source(&source);
+
+	// YCbCr sources can only be drawn into YCbCr buffers and vice versa
+	pixel_format destFormat = sourceFormat == BGRA32 ? BGRA32 : YCbCr444;
+	uint32 destBPP = bytes_per_pixel(destFormat);
+
+	int32 failures = 0;
+	for (int32 i = 0; i < kScaleCount; i++) {
+		double scale = kScales[i];
+		uint32 width = (uint32)(kSourceWidth * scale) + 10;
+		uint32 height = (uint32)(kSourceHeight * scale) + 10;
+		uint32 bpr = (width * destBPP + 3) & ~3;
+		MemoryBuffer generic(width, height, destFormat, bpr);
+		MemoryBuffer separable(width, height, destFormat, bpr);
+		if (generic.InitCheck() < B_OK || separable.InitCheck() < B_OK)
+			return 1;
+
+		for (int32 pass = 0; pass < 2; pass++) {
+			uint8 alpha = pass == 0 ? 255 : 160;
+			bigtime_t genericTime = draw(&source, &generic, scale, false,
+				BITMAP_FILTER_BILINEAR, alpha);
+			bigtime_t separableTime = draw(&source, &separable, scale, true,
+				BITMAP_FILTER_BILINEAR, alpha);
+
+			double mean;
+			int32 maxDifference = compare(&generic, &separable, &mean);
+			double pixels = width * height;
+			printf("%-9s scale %.2f alpha %3u: max difference %3ld, "
+				"mean %.3f, generic %6.1f MP/s, separable %6.1f MP/s\n",
+				name, scale, alpha, maxDifference, mean,
+				pixels / genericTime, pixels / separableTime);
+
+			// the generic YCbCrA version uses a nearest neighbor filter
+			if (sourceFormat != YCbCrA
+				&& maxDifference > kMaxAllowedDifference) {
+				failures++;
+			}
+		}
+
+		bigtime_t bicubicTime = draw(&source, &separable, scale, true,
+			BITMAP_FILTER_BICUBIC, 255);
+		bigtime_t lanczosTime = draw(&source, &separable, scale, true,
+			BITMAP_FILTER_LANCZOS, 255);
+		printf("%-9s scale %.2f bicubic %6.1f MP/s, lanczos %6.1f MP/s\n",
+			name, scale, width * height / (double)bicubicTime,
+			width * height / (double)lanczosTime);
+	}
+
+	return failures;
+}
+
+// main
+int
+main(int argc, const char* const* argv)
+{
+	int32 failures = 0;
+	failures += test_format(BGRA32, "BGRA32");
+	failures += test_format(YCbCr444, "YCbCr444");
+	failures += test_format(YCbCrA, "YCbCrA");
+
+	if (failures > 0) {
+		printf("%ld comparisons FAILED\n", failures);
+		return 1;
+	}
+
+	printf("all comparisons passed\n");
+	return 0;
+}
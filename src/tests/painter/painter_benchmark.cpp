@@ -0,0 +1,187 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ */
+
+// Measures how long it takes to draw a large bitmap scaled down to video
+// size, with and without mip maps. For the quality comparison, the result
+// is compared against an exact area average of the source and written to
+// PNG files, so that the aliasing can be inspected as well.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Bitmap.h>
+#include <BitmapStream.h>
+#include <File.h>
+#include <OS.h>
+#include <TranslationKit.h>
+
+#include "BBitmapBuffer.h"
+#include "MemoryBuffer.h"
+#include "Painter.h"
+
+static const uint32 kSourceWidth = 4000;
+static const uint32 kSourceHeight = 3000;
+static const uint32 kTargetWidth = 480;
+static const uint32 kTargetHeight = 360;
+static const int32 kIterations = 20;
+
+// fill_zone_plate
+//
+// Concentric rings of increasing frequency, the worst case for aliasing.
+static void
+fill_zone_plate(MemoryBuffer* buffer)
+{
+	uint32 width = buffer->Width();
+	uint32 height = buffer->Height();
+	double scale = M_PI / (2.0 * width);
+	uint8* bits = (uint8*)buffer->Bits();
+	for (uint32 y = 0; y < height; y++) {
+		uint8* p = bits + y * buffer->BytesPerRow();
+		double dy = y - height / 2.0;
+		for (uint32 x = 0; x < width; x++) {
+			double dx = x - width / 2.0;
+			uint8 value = (uint8)(127.5 + 127.5
+				* cos((dx * dx + dy * dy) * scale));
+			p[0] = value;
+			p[1] = value;
+			p[2] = (uint8)(x * 255 / width);
+			p[3] = 255;
+			p += 4;
+		}
+	}
+}
+
+// create_reference
+//
+// Averages all source pixels covered by each target pixel.
+static uint8*
+create_reference(const MemoryBuffer* source)
+{
+	uint8* reference = new uint8[kTargetWidth * kTargetHeight * 4];
+	const uint8* bits = (const uint8*)source->Bits();
+	uint32 bpr = source->BytesPerRow();
+	for (uint32 y = 0; y < kTargetHeight; y++) {
+		uint32 top = y * source->Height() / kTargetHeight;
+		uint32 bottom = (y + 1) * source->Height() / kTargetHeight;
+		for (uint32 x = 0; x < kTargetWidth; x++) {
+			uint32 left = x * source->Width() / kTargetWidth;
+			uint32 right = (x + 1) * source->Width() / kTargetWidth;
+			uint32 sum[3] = { 0, 0, 0 };
+			for (uint32 sy = top; sy < bottom; sy++) {
+				const uint8* p = bits + sy * bpr + left * 4;
+				for (uint32 sx = left; sx < right; sx++) {
+					sum[0] += p[0];
+					sum[1] += p[1];
+					sum[2] += p[2];
+					p += 4;
+				}
+			}
+			uint32 count = (bottom - top) * (right - left);
+			uint8* d = reference + (y * kTargetWidth + x) * 4;
+			d[0] = sum[0] / count;
+			d[1] = sum[1] / count;
+			d[2] = sum[2] / count;
+			d[3] = 255;
+		}
+	}
+	return reference;
+}
+
+// mean_error
+static double
+mean_error(const BBitmap* bitmap, const uint8* reference)
+{
+	uint64 error = 0;
+	const uint8* bits = (const uint8*)bitmap->Bits();
+	for (uint32 y = 0; y < kTargetHeight; y++) {
+		const uint8* p = bits + y * bitmap->BytesPerRow();
+		const uint8* r = reference + y * kTargetWidth * 4;
+		for (uint32 x = 0; x < kTargetWidth * 4; x++) {
+			if ((x & 3) != 3)
+				error += abs((int)p[x] - (int)r[x]);
+		}
+	}
+	return (double)error / (kTargetWidth * kTargetHeight * 3);
+}
+
+// save_png
+static void
+save_png(BBitmap* bitmap, const char* path)
+{
+	BFile file(path, B_READ_WRITE | B_CREATE_FILE | B_ERASE_FILE);
+	if (file.InitCheck() < B_OK)
+		return;
+
+	BBitmapStream stream(bitmap);
+	BTranslatorRoster::Default()->Translate(&stream, NULL, NULL, &file,
+		B_PNG_FORMAT, 0);
+	stream.DetachBitmap(&bitmap);
+}
+
+// run_benchmark
+static void
+run_benchmark(const char* name, const MemoryBuffer* source,
+	BBitmap* target, const uint8* reference)
+{
+	BBitmapBuffer targetBuffer(target);
+	Painter painter;
+	if (!painter.AttachToBuffer(&targetBuffer)) {
+		fprintf(stderr, "failed to attach painter\n");
+		return;
+	}
+	painter.SetSubpixelPrecise(false);
+
+	BRect targetRect(0, 0, kTargetWidth - 1, kTargetHeight - 1);
+
+	// the first run includes generating the mip levels, if used
+	bigtime_t startTime = system_time();
+	painter.ClearBuffer();
+	painter.DrawBitmap(source, source->Bounds(), targetRect);
+	bigtime_t firstTime = system_time() - startTime;
+
+	startTime = system_time();
+	for (int32 i = 0; i < kIterations; i++) {
+		painter.ClearBuffer();
+		painter.DrawBitmap(source, source->Bounds(), targetRect);
+	}
+	bigtime_t averageTime = (system_time() - startTime) / kIterations;
+
+	printf("%-12s first draw: %7lld us, average: %7lld us, "
+		"mean error: %.2f\n", name, firstTime, averageTime,
+		mean_error(target, reference));
+
+	char path[B_PATH_NAME_LENGTH];
+	snprintf(path, sizeof(path), "/tmp/painter_benchmark_%s.png", name);
+	save_png(target, path);
+}
+
+// main
+int
+main(int argc, const char* const* argv)
+{
+	MemoryBuffer source(kSourceWidth, kSourceHeight, BGR32, kSourceWidth * 4);
+	BBitmap target(BRect(0, 0, kTargetWidth - 1, kTargetHeight - 1), 0,
+		B_RGB32);
+	if (source.InitCheck() < B_OK || target.InitCheck() < B_OK) {
+		fprintf(stderr, "failed to allocate buffers\n");
+		return 1;
+	}
+
+	fill_zone_plate(&source);
+	uint8* reference = create_reference(&source);
+
+	printf("drawing %lux%lu to %lux%lu, %ld iterations\n", kSourceWidth,
+		kSourceHeight, kTargetWidth, kTargetHeight, kIterations);
+
+	run_benchmark("bilinear", &source, &target, reference);
+
+	source.EnableMipMaps();
+	run_benchmark("mipmapped", &source, &target, reference);
+
+	delete[] reference;
+	return 0;
+}
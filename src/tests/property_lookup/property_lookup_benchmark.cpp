@@ -0,0 +1,214 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Measures the property lookups of the PropertyObject in the workloads
+// which use them the most: loading a library of 10000 objects, where each
+// property is set from its string value like the XML import does it, and
+// rendering a frame, where the transformation of every object is read.
+// The lookups are compared with the linear search over the properties,
+// which PropertyObject::FindProperty() used before. Both variants run
+// several times in alternating order, so that neither one always runs
+// with the caches warmed up by the other.
+
+#include <stdio.h>
+
+#include <OS.h>
+
+#include "CommonPropertyIDs.h"
+#include "Property.h"
+#include "PropertyObject.h"
+
+static const int32 kObjectCount = 10000;
+static const int32 kFrameCount = 100;
+static const int32 kRoundCount = 6;
+
+static const uint32 kFloatProperties[] = {
+	PROPERTY_PIVOT_X,
+	PROPERTY_PIVOT_Y,
+	PROPERTY_TRANSLATION_X,
+	PROPERTY_TRANSLATION_Y,
+	PROPERTY_ROTATION,
+	PROPERTY_SCALE_X,
+	PROPERTY_SCALE_Y,
+	PROPERTY_OPACITY,
+	PROPERTY_FONT_SIZE,
+	PROPERTY_SCROLLING_SPEED,
+	PROPERTY_PARAGRAPH_INSET,
+	PROPERTY_PARAGRAPH_SPACING,
+	PROPERTY_LINE_SPACING,
+	PROPERTY_GLYPH_SPACING,
+	PROPERTY_BLOCK_WIDTH
+};
+static const int32 kFloatPropertyCount
+	= sizeof(kFloatProperties) / sizeof(uint32);
+
+static const uint32 kIntProperties[] = {
+	PROPERTY_HORIZONTAL_ALIGNMENT,
+	PROPERTY_VERTICAL_ALIGNMENT,
+	PROPERTY_FADE_MODE,
+	PROPERTY_TABLE_COLUMN_COUNT,
+	PROPERTY_TABLE_ROW_COUNT
+};
+static const int32 kIntPropertyCount
+	= sizeof(kIntProperties) / sizeof(uint32);
+
+// TestObject
+//
+// Has about as many properties as a text clip.
+class TestObject : public PropertyObject {
+ public:
+	TestObject()
+		: PropertyObject()
+	{
+		AddProperty(new StringProperty(PROPERTY_NAME, "object"));
+		AddProperty(new StringProperty(PROPERTY_TEXT, "text"));
+		for (int32 i = 0; i < kFloatPropertyCount; i++)
+			AddProperty(new FloatProperty(kFloatProperties[i]));
+		for (int32 i = 0; i < kIntPropertyCount; i++)
+			AddProperty(new IntProperty(kIntProperties[i]));
+	}
+};
+
+// find_property_linear
+static Property*
+find_property_linear(const PropertyObject* object, uint32 propertyID)
+{
+	int32 count = object->CountProperties();
+	for (int32 i = 0; i < count; i++) {
+		Property* property = object->PropertyAtFast(i);
+		if (property->Identifier() == propertyID)
+			return property;
+	}
+	return NULL;
+}
+
+// reset_values
+//
+// Sets the properties back to values other than the ones the library
+// loading sets, so that every timed SetValue() changes the property.
+static void
+reset_values(TestObject** objects)
+{
+	for (int32 i = 0; i < kObjectCount; i++) {
+		TestObject* object = objects[i];
+		for (int32 j = 0; j < kFloatPropertyCount; j++) {
+			if (Property* property
+					= find_property_linear(object, kFloatProperties[j])) {
+				property->SetValue("0");
+			}
+		}
+		for (int32 j = 0; j < kIntPropertyCount; j++) {
+			if (Property* property
+					= find_property_linear(object, kIntProperties[j])) {
+				property->SetValue("0");
+			}
+		}
+	}
+}
+
+// load_library
+static bigtime_t
+load_library(TestObject** objects, bool linear)
+{
+	bigtime_t startTime = system_time();
+	for (int32 i = 0; i < kObjectCount; i++) {
+		TestObject* object = objects[i];
+		for (int32 j = 0; j < kFloatPropertyCount; j++) {
+			uint32 id = kFloatProperties[j];
+			if (linear) {
+				if (Property* property = find_property_linear(object, id))
+					property->SetValue("1.5");
+			} else
+				object->SetValue(id, "1.5");
+		}
+		for (int32 j = 0; j < kIntPropertyCount; j++) {
+			uint32 id = kIntProperties[j];
+			if (linear) {
+				if (Property* property = find_property_linear(object, id))
+					property->SetValue("2");
+			} else
+				object->SetValue(id, "2");
+		}
+	}
+	return system_time() - startTime;
+}
+
+// render_frames
+static bigtime_t
+render_frames(TestObject** objects, bool linear, float* sum)
+{
+	bigtime_t startTime = system_time();
+	for (int32 frame = 0; frame < kFrameCount; frame++) {
+		for (int32 i = 0; i < kObjectCount; i++) {
+			TestObject* object = objects[i];
+			// the transformation and opacity, which every item needs
+			for (int32 j = 0; j < 8; j++) {
+				uint32 id = kFloatProperties[j];
+				FloatProperty* property = linear
+					? dynamic_cast<FloatProperty*>(
+						find_property_linear(object, id))
+					: object->FindFloatProperty(id);
+				if (property)
+					*sum += property->Value();
+			}
+		}
+	}
+	return system_time() - startTime;
+}
+
+// main
+int
+main(int argc, const char* argv[])
+{
+	TestObject** objects = new TestObject*[kObjectCount];
+
+	bigtime_t startTime = system_time();
+	for (int32 i = 0; i < kObjectCount; i++)
+		objects[i] = new TestObject();
+	printf("creating %ld objects: %lld us\n", kObjectCount,
+		system_time() - startTime);
+
+	bigtime_t linearTime = 0;
+	bigtime_t indexedTime = 0;
+	for (int32 round = 0; round < kRoundCount; round++) {
+		bool linearFirst = round % 2 == 0;
+		for (int32 pass = 0; pass < 2; pass++) {
+			bool linear = (pass == 0) == linearFirst;
+			reset_values(objects);
+			bigtime_t time = load_library(objects, linear);
+			if (linear)
+				linearTime += time;
+			else
+				indexedTime += time;
+		}
+	}
+	printf("loading library: linear %lld us, indexed %lld us "
+		"(average of %ld)\n", linearTime / kRoundCount,
+		indexedTime / kRoundCount, kRoundCount);
+
+	float sum = 0.0;
+	linearTime = 0;
+	indexedTime = 0;
+	for (int32 round = 0; round < kRoundCount; round++) {
+		bool linearFirst = round % 2 == 0;
+		for (int32 pass = 0; pass < 2; pass++) {
+			bool linear = (pass == 0) == linearFirst;
+			bigtime_t time = render_frames(objects, linear, &sum);
+			if (linear)
+				linearTime += time;
+			else
+				indexedTime += time;
+		}
+	}
+	printf("%ld frames: linear %lld us, indexed %lld us (average of %ld, "
+		"%.0f)\n", kFrameCount, linearTime / kRoundCount,
+		indexedTime / kRoundCount, kRoundCount, sum);
+
+	for (int32 i = 0; i < kObjectCount; i++)
+		delete objects[i];
+	delete[] objects;
+
+	return 0;
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright 2009, Stephan Aßmus <superstippi@gmx.de>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Measures how many read locks per second a growing number of threads can
+// take, with and without a writer modifying the protected data once per
+// millisecond, for the RWLocker and the previous implementation. The
+// readers check that they never see the data half modified, to make sure
+// the locking is still correct. The contention statistics of the RWLocker
+// are printed for each run.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+
+#include "BenaphoreRWLocker.h"
+#include "RWLocker.h"
+
+static const int32 kMaxThreads = 8;
+static const int32 kReadLocksPerThread = 200000;
+static const bigtime_t kWriterInterval = 1000;
+
+template<class Locker>
+struct BenchmarkData {
+	Locker		locker;
+	int32		values[2];
+	vint32		inconsistencies;
+	vint32		readersDone;
+	int32		readerCount;
+	int32		writeLocks;
+
+	BenchmarkData()
+		: locker("benchmark")
+		, inconsistencies(0)
+		, readersDone(0)
+		, readerCount(0)
+		, writeLocks(0)
+	{
+		values[0] = 0;
+		values[1] = 0;
+	}
+};
+
+// reader_thread
+template<class Locker>
+static int32
+reader_thread(void* cookie)
+{
+	BenchmarkData<Locker>* data = (BenchmarkData<Locker>*)cookie;
+
+	for (int32 i = 0; i < kReadLocksPerThread; i++) {
+		if (!data->locker.ReadLock())
+			break;
+		// every now and then, lock nested like the GUI does
+		if ((i & 15) == 0)
+			data->locker.ReadLock();
+
+		if (data->values[0] != data->values[1])
+			atomic_add(&data->inconsistencies, 1);
+
+		if ((i & 15) == 0)
+			data->locker.ReadUnlock();
+		data->locker.ReadUnlock();
+	}
+
+	atomic_add(&data->readersDone, 1);
+	return 0;
+}
+
+// writer_thread
+template<class Locker>
+static int32
+writer_thread(void* cookie)
+{
+	BenchmarkData<Locker>* data = (BenchmarkData<Locker>*)cookie;
+
+	while (data->readersDone < data->readerCount) {
+		if (!data->locker.WriteLock())
+			break;
+		data->values[0]++;
+		// give a reader the chance to see the inconsistent state
+		for (volatile int32 i = 0; i < 100; i++)
+			;
+		data->values[1]++;
+		data->locker.WriteUnlock();
+		data->writeLocks++;
+
+		snooze(kWriterInterval);
+	}
+
+	return 0;
+}
+
+// print_statistics
+static void
+print_statistics(BenchmarkData<RWLocker>& data)
+{
+	rw_locker_statistics statistics;
+	data.locker.GetStatistics(statistics);
+
+	printf("    reads: %lld (%lld contended), wait: %lld us (max %lld us), "
+		"max readers: %ld\n", statistics.read_locks,
+		statistics.contended_read_locks, statistics.read_wait_time,
+		statistics.max_read_wait_time, statistics.max_readers);
+	printf("    writes: %lld (%lld contended), wait: %lld us (max %lld us), "
+		"hold: %lld us (max %lld us)\n", statistics.write_locks,
+		statistics.contended_write_locks, statistics.write_wait_time,
+		statistics.max_write_wait_time, statistics.write_hold_time,
+		statistics.max_write_hold_time);
+}
+
+// run_benchmark
+template<class Locker>
+static bool
+run_benchmark(const char* name, int32 threadCount, bool withWriter,
+	BenchmarkData<Locker>& data)
+{
+	data.readerCount = threadCount;
+
+	thread_id threads[kMaxThreads + 1];
+	bigtime_t startTime = system_time();
+
+	for (int32 i = 0; i < threadCount; i++) {
+		threads[i] = spawn_thread(&reader_thread<Locker>, "reader",
+			B_NORMAL_PRIORITY, &data);
+		resume_thread(threads[i]);
+	}
+	int32 totalThreads = threadCount;
+	if (withWriter) {
+		threads[totalThreads] = spawn_thread(&writer_thread<Locker>,
+			"writer", B_NORMAL_PRIORITY, &data);
+		resume_thread(threads[totalThreads++]);
+	}
+
+	for (int32 i = 0; i < totalThreads; i++) {
+		status_t result;
+		wait_for_thread(threads[i], &result);
+	}
+
+	bigtime_t time = system_time() - startTime;
+	double locksPerSecond = (double)threadCount * kReadLocksPerThread
+		* 1000000.0 / time;
+
+	printf("%-10s %ld readers%s: %10.0f read locks/s", name, threadCount,
+		withWriter ? " + writer" : "         ", locksPerSecond);
+	if (withWriter)
+		printf(", %ld writes", data.writeLocks);
+	printf("\n");
+
+	if (data.inconsistencies > 0) {
+		printf("    FAILED: readers saw %ld inconsistent states\n",
+			data.inconsistencies);
+		return false;
+	}
+	return true;
+}
+
+// main
+int
+main(int argc, const char* const* argv)
+{
+	bool success = true;
+
+	for (int32 threads = 1; threads <= kMaxThreads; threads *= 2) {
+		for (int32 writer = 0; writer < 2; writer++) {
+			BenchmarkData<BenaphoreRWLocker> oldData;
+			success &= run_benchmark("benaphore", threads, writer != 0,
+				oldData);
+
+			BenchmarkData<RWLocker> newData;
+			newData.locker.SetStatisticsEnabled(true);
+			success &= run_benchmark("statistics", threads, writer != 0,
+				newData);
+			print_statistics(newData);
+
+			// the statistics have a cost of their own
+			BenchmarkData<RWLocker> plainData;
+			success &= run_benchmark("slots", threads, writer != 0,
+				plainData);
+		}
+	}
+
+	return success ? 0 : 1;
+}